@@ -231,7 +231,7 @@ const char  *PgSQL_message_backend_str[] = {
 								"",                                                         // 0x30 : 0
 								"ParseComplete",                                            // 0x31 : 1 ... Parse完了指示子(B)
 								"BindComplete",                                             // 0x32 : 2 ... Bind完了指示子(B)
-								"CloseComplete ",                                           // 0x33 : 3 ... Close完了指示子(B)
+								"CloseComplete",                                            // 0x33 : 3 ... Close完了指示子(B)
 								"",                                                         // 0x34 : 4
 								"",                                                         // 0x35 : 5
 								"",                                                         // 0x36 : 6
@@ -318,6 +318,8 @@ const char  *PgSQL_client_param_list[] = {
 								"database",                                                 // 接続したいデータベース名
 								"user",                                                     // 接続してきたユーザー名
 								"client_encoding",                                          // クライアントが指定してきた文字コード
+								"options",                                                  // クライアントが指定してきたコマンドラインオプション
+								"default_transaction_read_only",                            // クライアントが指定してきた読み取り専用指定
 };
 
 const char  *PgSQL_server_SASL_list[] = {                                                   // PostgreSQLのSASL認証で送られてくるパラメータ
@@ -330,6 +332,48 @@ const char  *PgSQL_server_SASL_list[] = {
 // ----------------------------------------------------------------------
 // コード部分
 // ----------------------------------------------------------------------
+// --------------------------------
+// メッセージデコード関連
+// --------------------------------
+// evs_api.c に各APIの処理を全部書くと長すぎるので、API毎にファイルを分離する。
+// evs_api.c からincludeされることを想定しているので、evs_main.hなどのヘッダファイルはincludeしていない。
+#include "evs_api_decode.c"
+
+// --------------------------------
+// セッション解析・統計関連
+// --------------------------------
+// evs_api.c に各APIの処理を全部書くと長すぎるので、API毎にファイルを分離する。
+// evs_api.c からincludeされることを想定しているので、evs_main.hなどのヘッダファイルはincludeしていない。
+#include "evs_api_stats.c"
+
+// --------------------------------
+// COPY中継関連
+// --------------------------------
+// evs_api.c に各APIの処理を全部書くと長すぎるので、API毎にファイルを分離する。
+// evs_api.c からincludeされることを想定しているので、evs_main.hなどのヘッダファイルはincludeしていない。
+#include "evs_api_copy.c"
+
+// --------------------------------
+// キャプチャ関連
+// --------------------------------
+// evs_api.c に各APIの処理を全部書くと長すぎるので、API毎にファイルを分離する。
+// evs_api.c からincludeされることを想定しているので、evs_main.hなどのヘッダファイルはincludeしていない。
+#include "evs_api_capture.c"
+
+// --------------------------------
+// ログサンプリング関連
+// --------------------------------
+// evs_api.c に各APIの処理を全部書くと長すぎるので、API毎にファイルを分離する。
+// evs_api.c からincludeされることを想定しているので、evs_main.hなどのヘッダファイルはincludeしていない。
+#include "evs_api_sample.c"
+
+// --------------------------------
+// スプール関連
+// --------------------------------
+// evs_api.c に各APIの処理を全部書くと長すぎるので、API毎にファイルを分離する。
+// evs_api.c からincludeされることを想定しているので、evs_main.hなどのヘッダファイルはincludeしていない。
+#include "evs_api_spool.c"
+
 // --------------------------------
 // クライアント(psql)関連
 // --------------------------------
@@ -337,6 +381,34 @@ const char  *PgSQL_server_SASL_list[] = {
 // evs_api.c からincludeされることを想定しているので、evs_main.hなどのヘッダファイルはincludeしていない。
 #include "evs_api_client.c"
 
+// --------------------------------
+// 経路表関連
+// --------------------------------
+// evs_api.c に各APIの処理を全部書くと長すぎるので、API毎にファイルを分離する。
+// evs_api.c からincludeされることを想定しているので、evs_main.hなどのヘッダファイルはincludeしていない。
+#include "evs_api_route.c"
+
+// --------------------------------
+// 接続先ホスト振り分け関連
+// --------------------------------
+// evs_api.c に各APIの処理を全部書くと長すぎるので、API毎にファイルを分離する。
+// evs_api.c からincludeされることを想定しているので、evs_main.hなどのヘッダファイルはincludeしていない。
+#include "evs_api_balance.c"
+
+// --------------------------------
+// 読み書き分離関連
+// --------------------------------
+// evs_api.c に各APIの処理を全部書くと長すぎるので、API毎にファイルを分離する。
+// evs_api.c からincludeされることを想定しているので、evs_main.hなどのヘッダファイルはincludeしていない。
+#include "evs_api_split.c"
+
+// --------------------------------
+// SCRAM-SHA-256認証関連
+// --------------------------------
+// evs_api.c に各APIの処理を全部書くと長すぎるので、API毎にファイルを分離する。
+// evs_api.c からincludeされることを想定しているので、evs_main.hなどのヘッダファイルはincludeしていない。
+#include "evs_api_scram.c"
+
 // --------------------------------
 // PostgreSQL関連
 // --------------------------------
@@ -344,6 +416,27 @@ const char  *PgSQL_server_SASL_list[] = {
 // evs_api.c からincludeされることを想定しているので、evs_main.hなどのヘッダファイルはincludeしていない。
 #include "evs_api_pgsql.c"
 
+// --------------------------------
+// コネクションプール関連
+// --------------------------------
+// evs_api.c に各APIの処理を全部書くと長すぎるので、API毎にファイルを分離する。
+// evs_api.c からincludeされることを想定しているので、evs_main.hなどのヘッダファイルはincludeしていない。
+#include "evs_api_pool.c"
+
+// --------------------------------
+// 接続受け入れ制御関連
+// --------------------------------
+// evs_api.c に各APIの処理を全部書くと長すぎるので、API毎にファイルを分離する。
+// evs_api.c からincludeされることを想定しているので、evs_main.hなどのヘッダファイルはincludeしていない。
+#include "evs_api_admit.c"
+
+// --------------------------------
+// CancelRequest転送関連
+// --------------------------------
+// evs_api.c に各APIの処理を全部書くと長すぎるので、API毎にファイルを分離する。
+// evs_api.c からincludeされることを想定しているので、evs_main.hなどのヘッダファイルはincludeしていない。
+#include "evs_api_cancel.c"
+
 // --------------------------------
 // PostgreSQLクライアント側処理
 // --------------------------------
@@ -353,8 +446,7 @@ int API_pgsql_client(struct EVS_ev_client_t *this_client)
 	char                            log_str[MAX_LOG_LENGTH];
 
 	// とりあえず表示する
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): START! client_status=%d\n", __func__, this_client->socket_fd, this_client->client_status);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(fd=%d): START! client_status=%d\n", __func__, this_client->socket_fd, this_client->client_status);
 
 	// ------------------------------------
 	// クライアントからのメッセージ解析
@@ -364,12 +456,8 @@ int API_pgsql_client(struct EVS_ev_client_t *this_client)
 	{
 		// クライアント開始メッセージ解析処理を呼び出し(クエリは来ないはず)
 		api_result = API_pgsql_client_start(this_client);
-		// 正常終了でないなら
-		if (api_result != 0)
-		{
-			// 戻る
-			return api_result;
-		}
+		// 戻る(プールの接続が割り当てられて2:クエリメッセージ待ちになっても、開始メッセージはPostgreSQLに送らない)
+		return api_result;
 	}
 	// クライアント毎の状態が、1:開始メッセージ応答待ちなら
 	if (this_client->client_status == 1)
@@ -379,6 +467,16 @@ int API_pgsql_client(struct EVS_ev_client_t *this_client)
 	// クライアント毎の状態が、2:クエリメッセージ待ちなら
 	if (this_client->client_status == 2)
 	{
+		// トランザクション単位のプールで、PostgreSQLの接続が割り当てられていないなら
+		if (this_client->pgsql_info == NULL && this_client->db_info != NULL && ((struct EVS_db_t *)this_client->db_info)->pool_mode == 1)
+		{
+			// プール接続要求処理(割り当てを待つなら、受信したメッセージは割り当てた時に送る)
+			api_result = API_pool_acquire(this_client);
+			if (api_result != 0)
+			{
+				return (api_result < 0) ? -1 : 0;
+			}
+		}
 		// クライアントクエリメッセージ解析処理を呼び出し(クエリ以外の場合もあり)
 		api_result = API_pgsql_client_query(this_client);
 		// 正常終了でないなら
@@ -398,14 +496,12 @@ int API_pgsql_client(struct EVS_ev_client_t *this_client)
 		this_client->client_status > 3)
 	{
 		// エラー
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Illegal Client Status(=%d)!?\n", __func__, this_client->socket_fd, this_client->client_status);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): Illegal Client Status(=%d)!?\n", __func__, this_client->socket_fd, this_client->client_status);
 		// 戻る
 		return -1;
 	}
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): END!\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): END!\n", __func__);
 
 	// 戻る
 	return api_result;
@@ -420,8 +516,7 @@ int API_start(struct EVS_ev_client_t *this_client)
 	char                            log_str[MAX_LOG_LENGTH];
 
 	// とりあえず表示する
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): START!\n", __func__, this_client->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(fd=%d): START!\n", __func__, this_client->socket_fd);
 
 	// PostgreSQLクライアント側処理を通常呼出
 	api_result = API_pgsql_client(this_client);
@@ -0,0 +1,363 @@
+// ----------------------------------------------------------------------
+// Protocol Analyzer for PostgreSQL -
+// Purpose:
+//     Admission control: global and per-database backend connection caps with a fair wait queue.
+//
+// Program:
+//     Takeshi Kaburagi/MyDNS.JP    https://www.fvg-on.net/
+//
+// Usage:
+//     ./evs_pganalyzer [./evserver.ini]
+// ----------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------
+// ヘッダ部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// インクルード宣言
+// --------------------------------
+
+// --------------------------------
+// 定数宣言
+// --------------------------------
+#define ADMIT_HIST_NUM          6                                   // 待ち時間の分布の区分の数(1ms, 10ms, 100ms, 1s, 10s未満と、それ以上)
+
+// --------------------------------
+// 型宣言
+// --------------------------------
+
+// --------------------------------
+// 変数宣言
+// --------------------------------
+static TAILQ_HEAD (EVS_admit_head, EVS_db_t) EVS_admit_tailq = TAILQ_HEAD_INITIALIZER(EVS_admit_tailq);   // 待っているクライアントがいるデータベース別設定(先頭から順番に一人ずつ割り当てる)
+static int                      EVS_admit_queued_num = 0;           // 待っているクライアントがいるデータベース別設定の数
+static int                      EVS_admit_pgsql_num = 0;            // 開いているPostgreSQLとの接続数の合計(接続処理中、割り当て中、プール待機中)
+static int                      EVS_admit_wait_num = 0;             // 接続の空きを待っているクライアント数の合計
+static int                      EVS_admit_wait_max = 0;             // 統計を出力してから、同時に待っていたクライアント数の最大
+static unsigned long            EVS_admit_grant_count = 0;          // 待たせた後に接続を割り当てた回数
+static unsigned long            EVS_admit_timeout_count = 0;        // PoolWaitTimeoutで切断した回数
+static unsigned long            EVS_admit_reject_count = 0;         // 待ち行列が一杯で、待たせずにエラーを返した回数
+static unsigned long            EVS_admit_evict_count = 0;          // 上限に空きを作るために、他の設定のプールの接続を閉じた回数
+static unsigned long            EVS_admit_hist[ADMIT_HIST_NUM];     // 待ち時間の分布(接続を割り当てた時に数える)
+static const ev_tstamp          EVS_admit_hist_limit[ADMIT_HIST_NUM - 1] = {0.001, 0.01, 0.1, 1., 10.};    // 待ち時間の分布の区分の上限(秒)
+static ev_timer                 EVS_admit_timer;                    // 接続が閉じた後に、待っているクライアントに割り当てるタイマー
+static ev_tstamp                EVS_admit_stat_lasttime = 0.;       // 最後に接続の受け入れ制御の統計を出力した日時
+
+// ----------------------------------------------------------------------
+// コード部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// 接続の受け入れ制御について
+// --------------------------------
+// クライアントが一度に接続してきても、PostgreSQLのmax_connectionsを超えないように、PostgreSQLとの接続数を制限する。
+//  ・MaxBackendConnections  : 全体の接続数の上限
+//  ・MaxDatabaseConnections : データベース名毎(ユーザー名が違うデータベース別設定もまとめて)の接続数の上限
+// 接続処理中、割り当て中、プールで待機中の接続を全部数える(事前接続も、上限に余裕がある時だけ行う)。
+//
+// 上限なら、クライアントはデータベース別設定の待ち行列に並んで、受信を止めて待つ(プールしない設定やセッション単位のプールでも同じ)。
+// 接続が閉じて空きができたら、待っているクライアントがいるデータベース別設定(データベース名・ユーザー名)を順番に回って、一人ずつ割り当てる
+// (一つの設定に大量のクライアントが並んでも、他のユーザーが待たされ続けないように)。
+// 他の設定のプールで待機中の接続が上限を使っているなら、一番長く使われていない接続を閉じて空ける。
+//
+// 全体で待っているクライアントがAdmitQueueLengthに達していたら、それ以降のクライアントは待たせずにErrorResponse(53300 too_many_connections)を返して切断する。
+// PoolWaitTimeout(秒)待っても割り当てられなければ、エラーを返して切断する(API_pool_check)。
+//
+// 待ち行列の深さ(現在、最大)、割り当てまでの待ち時間の分布、タイムアウト、拒否の数を、AdmitStatInterval(秒)毎に出力する。
+// --------------------------------
+// データベース名毎の接続数を数えるデータベース別設定の取得処理
+// --------------------------------
+static struct EVS_db_t *API_admit_group(struct EVS_db_t *db_info)
+{
+	return (db_info->admit_group != NULL) ? db_info->admit_group : db_info;
+}
+
+// --------------------------------
+// 接続受け入れ制御初期化処理 ※データベース別設定を作った時(データベース用テールキューに入れる前)に呼ばれる
+// --------------------------------
+// 同じデータベース名の設定が既にあれば、その設定でデータベース名毎の接続数を数える
+void API_admit_init(struct EVS_db_t *db_info)
+{
+	struct EVS_db_t                 *db_list;                           // データベース別設定用構造体ポインタ
+
+	db_info->admit_group = db_info;
+	TAILQ_FOREACH (db_list, &EVS_db_tailq, entries)
+	{
+		if (db_list != db_info && strcmp(db_list->database, db_info->database) == 0)
+		{
+			db_info->admit_group = API_admit_group(db_list);
+			break;
+		}
+	}
+}
+
+// --------------------------------
+// 接続受け入れ制御開放処理 ※データベース別設定を開放する前(接続がなくなってから)に呼ばれる
+// --------------------------------
+// データベース名毎の接続数を数えている設定なら、同じデータベース名の次の設定に引き継ぐ
+void API_admit_release(struct EVS_db_t *db_info)
+{
+	struct EVS_db_t                 *db_list;                           // データベース別設定用構造体ポインタ
+	struct EVS_db_t                 *group_info = NULL;
+
+	if (db_info->admit_queued != 0)
+	{
+		TAILQ_REMOVE(&EVS_admit_tailq, db_info, admit_entries);
+		db_info->admit_queued = 0;
+		EVS_admit_queued_num --;
+	}
+	TAILQ_FOREACH (db_list, &EVS_db_tailq, entries)
+	{
+		if (db_list == db_info || db_list->admit_group != db_info)
+		{
+			continue;
+		}
+		if (group_info == NULL)
+		{
+			group_info = db_list;
+			group_info->admit_num = db_info->admit_num;
+		}
+		db_list->admit_group = group_info;
+	}
+}
+
+// --------------------------------
+// 接続受け入れ制御 : 公平配分タイマーイベント処理
+// --------------------------------
+static void CB_admit_dispatch(struct ev_loop* loop, struct ev_timer *watcher, int revents)
+{
+	(void)loop;                                                         // 一回きりのタイマーなので、ループもイベントも使わない
+	(void)watcher;
+	(void)revents;
+
+	API_admit_dispatch();
+}
+
+// --------------------------------
+// 接続受け入れ制御 : 接続開始処理 ※PostgreSQLへの接続を開いた時に呼ばれる
+// --------------------------------
+void API_admit_open(struct EVS_db_t *db_info)
+{
+	EVS_admit_pgsql_num ++;
+	API_admit_group(db_info)->admit_num ++;
+}
+
+// --------------------------------
+// 接続受け入れ制御 : 接続終了処理 ※PostgreSQLとの接続を閉じた時に呼ばれる
+// --------------------------------
+// 待っているクライアントがいれば、空いた分を割り当てる(接続を閉じる処理の途中で、別の接続を開かないように、タイマーイベントで行う)
+void API_admit_close(struct EVS_db_t *db_info)
+{
+	EVS_admit_pgsql_num --;
+	API_admit_group(db_info)->admit_num --;
+
+	if (!TAILQ_EMPTY(&EVS_admit_tailq) && !ev_is_active(&EVS_admit_timer))
+	{
+		ev_timer_init(&EVS_admit_timer, CB_admit_dispatch, 0., 0.);
+		ev_timer_start(EVS_loop, &EVS_admit_timer);
+	}
+}
+
+// --------------------------------
+// 接続数上限判定処理(1:全体かデータベース名毎の接続数が上限, 0:接続してよい)
+// --------------------------------
+int API_admit_full(struct EVS_db_t *db_info)
+{
+	if (EVS_config.max_backend_conn > 0 && EVS_admit_pgsql_num >= EVS_config.max_backend_conn)
+	{
+		return 1;
+	}
+	if (EVS_config.max_database_conn > 0 && API_admit_group(db_info)->admit_num >= EVS_config.max_database_conn)
+	{
+		return 1;
+	}
+	return 0;
+}
+
+// --------------------------------
+// 待機中接続入れ替え処理(1:プールの接続を閉じたので空いた, 0:閉じられる接続がない)
+// --------------------------------
+// データベース名毎の上限なら同じデータベース名の設定から、全体の上限ならすべての設定から、プールで一番長く使われていない接続を探して閉じる
+int API_admit_evict(struct EVS_db_t *db_info)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_db_t                 *db_list;                           // データベース別設定用構造体ポインタ
+	struct EVS_db_t                 *group_info = API_admit_group(db_info);
+	struct EVS_ev_pgsql_t           *this_pgsql;
+	struct EVS_ev_pgsql_t           *oldest_pgsql = NULL;               // 一番長く使われていない接続
+	int                             group_flag;                         // データベース名毎の上限か(1:同じデータベース名の設定からだけ探す)
+
+	group_flag = (EVS_config.max_database_conn > 0 && group_info->admit_num >= EVS_config.max_database_conn) ? 1 : 0;
+	TAILQ_FOREACH (db_list, &EVS_db_tailq, entries)
+	{
+		if (group_flag != 0 && API_admit_group(db_list) != group_info)
+		{
+			continue;
+		}
+		// プールは先頭が最後に戻した接続なので、最後の接続が一番長く使われていない
+		this_pgsql = TAILQ_LAST(&db_list->pool_tailq, EVS_pool_head);
+		if (this_pgsql != NULL && (oldest_pgsql == NULL || this_pgsql->last_activity < oldest_pgsql->last_activity))
+		{
+			oldest_pgsql = this_pgsql;
+		}
+	}
+	if (oldest_pgsql == NULL)
+	{
+		return 0;
+	}
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "PostgreSQL(%s) Pooled connection closed to admit another client. (database=%s, user=%s, pgsql=%d, for=%s/%s)\n", ((struct EVS_db_t *)oldest_pgsql->db_info)->hostname, ((struct EVS_db_t *)oldest_pgsql->db_info)->database, ((struct EVS_db_t *)oldest_pgsql->db_info)->username, oldest_pgsql->socket_fd, db_info->database, db_info->username);
+	EVS_admit_evict_count ++;
+	CLOSE_pgsql(EVS_loop, (struct ev_io *)oldest_pgsql, 0);
+	return 1;
+}
+
+// --------------------------------
+// 待ち行列長判定処理(1:待ち行列が一杯なので、エラーを返した, 0:待ってよい) ※クライアントを待ち行列に並べる前に呼ばれる
+// --------------------------------
+// エラーを返したクライアントは、呼び出し元で切断する
+int API_admit_reject(struct EVS_ev_client_t *this_client, struct EVS_db_t *db_info)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	if (EVS_config.admit_queue_length <= 0 || EVS_admit_wait_num < EVS_config.admit_queue_length)
+	{
+		return 0;
+	}
+	EVS_admit_reject_count ++;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "PostgreSQL(%s) Client(%s) too many clients waiting for a connection! Reject. (database=%s, user=%s, waiting=%d/%d, backends=%d)\n", db_info->hostname, this_client->addr_str, db_info->database, db_info->username, EVS_admit_wait_num, EVS_config.admit_queue_length, EVS_admit_pgsql_num);
+	API_pool_error(this_client, "53300", "sorry, too many clients waiting for a connection");
+	return 1;
+}
+
+// --------------------------------
+// 接続受け入れ制御 : 待ち行列追加処理 ※データベース別設定の待ち行列にクライアントを並べた時に呼ばれる
+// --------------------------------
+void API_admit_enqueue(struct EVS_db_t *db_info)
+{
+	EVS_admit_wait_num ++;
+	if (EVS_admit_wait_num > EVS_admit_wait_max)
+	{
+		EVS_admit_wait_max = EVS_admit_wait_num;
+	}
+	// 待っているクライアントがいるデータベース別設定の並びの最後に入れる
+	if (db_info->admit_queued == 0)
+	{
+		TAILQ_INSERT_TAIL(&EVS_admit_tailq, db_info, admit_entries);
+		db_info->admit_queued = 1;
+		EVS_admit_queued_num ++;
+	}
+}
+
+// --------------------------------
+// 接続受け入れ制御 : 待ち行列削除処理 ※データベース別設定の待ち行列からクライアントを外した時に呼ばれる
+// --------------------------------
+// grant_flagが1(接続を割り当てた)なら、待ち時間の分布に数える
+void API_admit_dequeue(struct EVS_ev_client_t *this_client, struct EVS_db_t *db_info, int grant_flag)
+{
+	ev_tstamp                       wait_time;
+	int                             hist_index;
+
+	EVS_admit_wait_num --;
+	if (db_info->wait_num == 0 && db_info->admit_queued != 0)
+	{
+		TAILQ_REMOVE(&EVS_admit_tailq, db_info, admit_entries);
+		db_info->admit_queued = 0;
+		EVS_admit_queued_num --;
+	}
+	if (grant_flag == 0)
+	{
+		return;
+	}
+	EVS_admit_grant_count ++;
+	ev_now_update(EVS_loop);                                            // イベントループの日時を現在の日時に更新
+	wait_time = ev_now(EVS_loop) - this_client->wait_time;
+	for (hist_index = 0; hist_index < ADMIT_HIST_NUM - 1 && wait_time >= EVS_admit_hist_limit[hist_index]; hist_index ++)
+	{
+		;
+	}
+	EVS_admit_hist[hist_index] ++;
+}
+
+// --------------------------------
+// 接続受け入れ制御 : 待ち時間切れ計数処理 ※PoolWaitTimeoutでクライアントを切断する時に呼ばれる
+// --------------------------------
+void API_admit_timeout(void)
+{
+	EVS_admit_timeout_count ++;
+}
+
+// --------------------------------
+// 接続受け入れ制御 : 公平配分処理 ※接続が閉じた後のタイマーイベントと、API_pool_check()から呼ばれる
+// --------------------------------
+// 待っているクライアントがいるデータベース別設定を先頭から順番に回って、一人ずつ割り当てる(割り当てた設定は並びの最後に回し、割り当てられなかった設定は順番を変えない)。
+// 一周して誰にも割り当てられなかったら(空きがなくなったら)終わる。
+void API_admit_dispatch(void)
+{
+	struct EVS_db_t                 *db_list;                           // データベース別設定用構造体ポインタ
+	struct EVS_db_t                 *next_list;
+	int                             pass_num;                           // 一周で回るデータベース別設定の数
+	int                             pass_count;
+	int                             grant_num;                          // 一周で割り当てた数
+
+	do
+	{
+		grant_num = 0;
+		pass_num = EVS_admit_queued_num;
+		db_list = TAILQ_FIRST(&EVS_admit_tailq);
+		for (pass_count = 0; pass_count < pass_num && db_list != NULL; pass_count ++)
+		{
+			next_list = TAILQ_NEXT(db_list, admit_entries);
+			if (API_pool_dispatch_one(db_list) != 0)
+			{
+				grant_num ++;
+				// まだ待っているクライアントがいれば、並びの最後に回す
+				if (db_list->admit_queued != 0)
+				{
+					TAILQ_REMOVE(&EVS_admit_tailq, db_list, admit_entries);
+					TAILQ_INSERT_TAIL(&EVS_admit_tailq, db_list, admit_entries);
+				}
+			}
+			db_list = next_list;
+		}
+	} while (grant_num > 0);
+}
+
+// --------------------------------
+// 接続受け入れ制御統計出力処理 ※タイマーイベントから呼ばれる
+// --------------------------------
+// AdmitStatInterval(秒)毎に、接続数、待ち行列の深さ、待ち時間の分布を出力して、数え直す(上限を設定していなくて、誰も待たなかったなら出力しない)
+void API_admit_report(ev_tstamp nowtime)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_db_t                 *db_list;                           // データベース別設定用構造体ポインタ
+
+	if (EVS_config.admitstat_intval <= 0. || nowtime < EVS_admit_stat_lasttime + EVS_config.admitstat_intval)
+	{
+		return;
+	}
+	EVS_admit_stat_lasttime = nowtime;
+
+	if (EVS_config.max_backend_conn > 0 || EVS_config.max_database_conn > 0 || EVS_admit_wait_max > 0 || EVS_admit_reject_count > 0)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "Admission: backends=%d/%d, waiting=%d (max %d), granted=%lu, timeout=%lu, rejected=%lu, evicted=%lu, wait<1ms=%lu, <10ms=%lu, <100ms=%lu, <1s=%lu, <10s=%lu, >=10s=%lu\n", EVS_admit_pgsql_num, EVS_config.max_backend_conn, EVS_admit_wait_num, EVS_admit_wait_max, EVS_admit_grant_count, EVS_admit_timeout_count, EVS_admit_reject_count, EVS_admit_evict_count, EVS_admit_hist[0], EVS_admit_hist[1], EVS_admit_hist[2], EVS_admit_hist[3], EVS_admit_hist[4], EVS_admit_hist[5]);
+	}
+	// 待っているクライアントがいるデータベース別設定毎の待ち行列の深さ
+	TAILQ_FOREACH (db_list, &EVS_admit_tailq, admit_entries)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "Admission: PostgreSQL(%s) database=%s, user=%s, waiting=%d, pgsql=%d, database total=%d/%d\n", db_list->hostname, db_list->database, db_list->username, db_list->wait_num, db_list->pgsql_num, API_admit_group(db_list)->admit_num, EVS_config.max_database_conn);
+	}
+	EVS_admit_wait_max = EVS_admit_wait_num;
+	EVS_admit_grant_count = 0;
+	EVS_admit_timeout_count = 0;
+	EVS_admit_reject_count = 0;
+	EVS_admit_evict_count = 0;
+	memset(EVS_admit_hist, 0, sizeof(EVS_admit_hist));
+}
+
+// --------------------------------
+// 接続受け入れ制御終了処理 ※終了時に呼ばれる
+// --------------------------------
+void API_admit_end(void)
+{
+	ev_timer_stop(EVS_loop, &EVS_admit_timer);
+}
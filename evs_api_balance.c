@@ -0,0 +1,633 @@
+// ----------------------------------------------------------------------
+// Protocol Analyzer for PostgreSQL -
+// Purpose:
+//     Balance connections across multiple backend hosts of a PostgreSQL entry.
+//
+// Program:
+//     Takeshi Kaburagi/MyDNS.JP    https://www.fvg-on.net/
+//
+// Usage:
+//     ./evs_pganalyzer [./evserver.ini]
+// ----------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------
+// ヘッダ部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// インクルード宣言
+// --------------------------------
+
+// --------------------------------
+// 定数宣言
+// --------------------------------
+#define BALANCE_EWMA_WEIGHT     0.2                         // 応答時間の指数移動平均で、新しい応答時間に掛ける重み
+#define BALANCE_FAIL_LIMIT      3                           // 問い合わせ中に接続が切れたのがこの回数続いたら、ホストを切り離す
+#define BALANCE_EJECT_SHIFT     3                           // 続けて切り離す時に、切り離す時間を倍にする最大回数(2^3=8倍まで)
+#define BALANCE_RAMP_MIN        0.05                        // 戻し中のホストへの割り振りの重みの最小値
+#define BALANCE_LATENCY_MIN     0.0001                      // 応答時間の最小値(秒)(まだ計っていないホストでも、応答待ちの問い合わせ数で差がつくように)
+
+// --------------------------------
+// 型宣言
+// --------------------------------
+
+// --------------------------------
+// 変数宣言
+// --------------------------------
+static TAILQ_HEAD (EVS_host_head, EVS_host_t) EVS_host_tailq = TAILQ_HEAD_INITIALIZER(EVS_host_tailq);     // 接続先ホスト別構造体(ホスト名・サービス名毎に一つ)
+
+// ----------------------------------------------------------------------
+// コード部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// 接続先ホストの振り分けについて
+// --------------------------------
+// PostgreSQL設定のホスト名に"|"区切りで複数のホストを指定すると、PostgreSQLに接続する度に、振り分け方法(Balance=)に従ってホストを選ぶ。
+//      RoundRobin    : 順番に選ぶ
+//      LeastRequests : 応答待ちの問い合わせ数が最も少ないホストを選ぶ
+//      Latency       : 応答時間の指数移動平均×(応答待ちの問い合わせ数 + 1)が最も小さいホストを選ぶ
+// 振り分けるのは接続を開く時なので、プールする接続は、開いた時に選んだホストのまま使い回す。
+//
+// ホストの状態はホスト名・サービス名毎に一つだけ持ち、同じホストを使う設定(ワイルドカードから作った設定も)で共有する。
+// ホストの状態は、実際の通信と死活確認(HostProbeInterval毎のノンブロッキングのTCP接続)で更新する。
+// 死活確認の接続先は設定を読み込んだ時に名前解決しておく(イベントループの中でgetaddrinfo()を呼んで止まらないように)。
+//  ・接続できなかったら、すぐにHostEjectTime(秒)切り離す(続けて切り離す度に倍、最大8倍)
+//  ・問い合わせの応答待ち中にPostgreSQL側から切断されたのがBALANCE_FAIL_LIMIT回続いたら、切り離す
+//  ・切り離し時間が過ぎたら死活確認をして、接続できれば戻す。戻したホストには、HostRampTimeかけて徐々に割り振りを増やす
+// 全てのホストを切り離していたら、一番早く切り離しを終えるホストを選ぶ(接続できないよりはまし)。
+// ホストが一つだけなら、これまで通り常にそのホストに接続する(切り離しも死活確認もしない)。
+// 読み書き分離(Split)では、最初のホストをプライマリとして常にそこに接続し、レプリカは残りのホストの中から選ぶ。
+// --------------------------------
+// 死活確認の接続先の名前解決処理(最初のアドレスを覚えておく) ※設定を読み込んだ時に呼ばれる
+// --------------------------------
+static void API_balance_resolve(struct EVS_host_t *this_host)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	int                             api_result;
+	struct addrinfo                 target_hints;                       // 接続先のアドレス構造体を取得するための条件
+	struct addrinfo                 *target_addrinfo;                   // 接続先のアドレス構造体ポインタ
+
+	memset(&target_hints, 0, sizeof(struct addrinfo));
+	target_hints.ai_family = AF_UNSPEC;                                 // IPv4でもIPv6でもどちらが返って来てもよい
+	target_hints.ai_socktype = SOCK_STREAM;                             // ストリームソケット
+	api_result = getaddrinfo(this_host->hostname, this_host->servicename, &target_hints, &target_addrinfo);
+	if (api_result != 0)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "PostgreSQL(%s:%s) Cannot resolve for probe! (%s)\n", this_host->hostname, this_host->servicename, gai_strerror(api_result));
+		this_host->probe_addrlen = 0;
+		return;
+	}
+	memcpy(&this_host->probe_addr, target_addrinfo->ai_addr, target_addrinfo->ai_addrlen);
+	this_host->probe_addrlen = target_addrinfo->ai_addrlen;
+	freeaddrinfo(target_addrinfo);
+}
+
+// --------------------------------
+// 接続先ホスト別構造体取得処理(同じホスト名・サービス名があればそれを、なければ作って返す。できなければNULL) ※設定を読み込んだ時に呼ばれる
+// --------------------------------
+struct EVS_host_t *API_balance_host(const char *hostname, const char *servicename)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_host_t               *this_host;
+
+	TAILQ_FOREACH (this_host, &EVS_host_tailq, entries)
+	{
+		if (strcmp(this_host->hostname, hostname) == 0 && strcmp(this_host->servicename, servicename) == 0)
+		{
+			return this_host;
+		}
+	}
+	this_host = (struct EVS_host_t *)calloc(1, sizeof(struct EVS_host_t));
+	if (this_host == NULL)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
+		return NULL;
+	}
+	snprintf(this_host->hostname, sizeof(this_host->hostname), "%s", hostname);
+	snprintf(this_host->servicename, sizeof(this_host->servicename), "%s", servicename);
+	this_host->probe_fd = -1;
+	API_balance_resolve(this_host);
+	TAILQ_INSERT_TAIL(&EVS_host_tailq, this_host, entries);
+	return this_host;
+}
+
+// --------------------------------
+// 接続先ホスト状態初期化処理 ※設定を読み込んだ時、ワイルドカードの設定から作った時に呼ばれる
+// --------------------------------
+// ホストの状態は共有しているので初期化せず、このデータベース別設定から使っていることだけ数える
+void API_balance_init(struct EVS_db_t *db_info)
+{
+	int                             host_index;
+
+	for (host_index = 0; host_index < db_info->host_num; host_index ++)
+	{
+		db_info->host_list[host_index]->db_num ++;
+		db_info->host_list[host_index]->balance_num += (db_info->host_num > 1) ? 1 : 0;
+		db_info->host_credit[host_index] = 0.;
+	}
+	db_info->host_next = 0;
+}
+
+// --------------------------------
+// 接続先ホスト割り振り重み取得処理(戻し中なら、戻してからの経過時間に比例した0～1の重み)
+// --------------------------------
+static double API_balance_weight(struct EVS_host_t *this_host, ev_tstamp nowtime)
+{
+	double                          host_weight;
+
+	if (this_host->ramp_start == 0.)
+	{
+		return 1.;
+	}
+	host_weight = (EVS_config.host_ramp_time > 0.) ? (nowtime - this_host->ramp_start) / EVS_config.host_ramp_time : 1.;
+	// 割り振りが元に戻ったら、戻し中を終える
+	if (host_weight >= 1.)
+	{
+		this_host->ramp_start = 0.;
+		this_host->eject_count = 0;
+		return 1.;
+	}
+	return (host_weight < BALANCE_RAMP_MIN) ? BALANCE_RAMP_MIN : host_weight;
+}
+
+// --------------------------------
+// 接続先ホスト選択処理(host_listの位置を返す。読み書き分離では0:プライマリ, 1:レプリカから選ぶ)
+// --------------------------------
+int API_balance_select(struct EVS_db_t *db_info, int replica_flag)
+{
+	ev_tstamp                       nowtime;
+	int                             host_count;
+	int                             host_index;
+	int                             first_index = 0;                    // 選ぶ範囲の最初のホストの位置(読み書き分離のレプリカなら1)
+	int                             host_range;                         // 選ぶ範囲のホストの数
+	int                             best_index = -1;                    // 選んだホストの位置(-1:まだ選んでいない)
+	double                          host_weight;                        // ホストの割り振りの重み(戻し中なら1未満)
+	double                          host_score;                         // ホストの点数(小さい方を選ぶ)
+	double                          best_score = 0.;
+	double                          total_weight = 0.;                  // 重みの合計(ラウンドロビン)
+	struct EVS_host_t               *this_host;
+
+	if (db_info->host_num <= 1)
+	{
+		return 0;
+	}
+	host_range = db_info->host_num;
+	// 読み書き分離なら、プライマリは最初のホスト、レプリカは残りのホストから選ぶ
+	if (db_info->split_mode != 0)
+	{
+		if (replica_flag == 0)
+		{
+			return 0;
+		}
+		first_index = 1;
+		host_range --;
+	}
+	nowtime = ev_now(EVS_loop);
+	// 次に振り分けを始めるホストから順に見る(同点なら先に見た方を選ぶ)
+	for (host_count = 0; host_count < host_range; host_count ++)
+	{
+		host_index = first_index + (db_info->host_next + host_count) % host_range;
+		this_host = db_info->host_list[host_index];
+		// 切り離し中なら
+		if (this_host->eject_until != 0.)
+		{
+			continue;
+		}
+		host_weight = API_balance_weight(this_host, nowtime);
+		switch (db_info->balance_mode)
+		{
+			case 1:                                                     // 応答待ちの問い合わせ数が最少(戻し中のホストは、重みの分だけ点数を悪くする)
+				host_score = (double)(this_host->outstanding + 1) / host_weight;
+				break;
+			case 2:                                                     // 応答時間が最短(まだ計っていないホストは0なので、先に選ばれる)
+				host_score = (this_host->latency_ewma + BALANCE_LATENCY_MIN) * (double)(this_host->outstanding + 1) / host_weight;
+				break;
+			default:                                                    // ラウンドロビン(重み付き。持ち点が最も多いホストを選ぶので、戻し中のホストは重みの割合で選ばれる)
+				db_info->host_credit[host_index] += host_weight;
+				total_weight += host_weight;
+				host_score = -db_info->host_credit[host_index];
+				break;
+		}
+		if (best_index < 0 || host_score < best_score)
+		{
+			best_index = host_index;
+			best_score = host_score;
+		}
+	}
+	// 全てのレプリカを切り離していたら、プライマリに送る
+	if (best_index < 0 && first_index != 0)
+	{
+		return 0;
+	}
+	// 全てのホストを切り離していたら、一番早く切り離しを終えるホストを選ぶ
+	if (best_index < 0)
+	{
+		best_index = 0;
+		for (host_index = 1; host_index < db_info->host_num; host_index ++)
+		{
+			if (db_info->host_list[host_index]->eject_until < db_info->host_list[best_index]->eject_until)
+			{
+				best_index = host_index;
+			}
+		}
+	}
+	db_info->host_credit[best_index] -= total_weight;
+	db_info->host_next = (best_index - first_index + 1) % host_range;
+	return best_index;
+}
+
+// --------------------------------
+// 接続先ホスト種類判定処理(1:読み書き分離のレプリカへの接続, 0:プライマリ、もしくは読み書き分離しない接続)
+// --------------------------------
+int API_balance_replica(struct EVS_ev_pgsql_t *this_pgsql)
+{
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_pgsql->db_info;
+
+	return (db_info != NULL && db_info->split_mode != 0 && db_info->host_num > 1 && this_pgsql->host_index != 0) ? 1 : 0;
+}
+
+// --------------------------------
+// 接続先ホスト切り離し処理
+// --------------------------------
+static void API_balance_eject(struct EVS_host_t *this_host, ev_tstamp nowtime, const char *reason_str)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	ev_tstamp                       eject_time;
+
+	eject_time = EVS_config.host_eject_time * (double)(1 << ((this_host->eject_count < BALANCE_EJECT_SHIFT) ? this_host->eject_count : BALANCE_EJECT_SHIFT));
+	this_host->eject_count ++;
+	this_host->eject_until = nowtime + eject_time;
+	this_host->ramp_start = 0.;
+	this_host->fail_count = 0;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "PostgreSQL(%s:%s) Ejected! (%s, %.0f sec, count=%d)\n", this_host->hostname, this_host->servicename, reason_str, eject_time, this_host->eject_count);
+}
+
+// --------------------------------
+// 接続先ホスト戻し処理(HostRampTimeかけて、割り振りを元に戻していく)
+// --------------------------------
+static void API_balance_reinstate(struct EVS_host_t *this_host, ev_tstamp nowtime)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	this_host->eject_until = 0.;
+	this_host->ramp_start = nowtime;
+	this_host->fail_count = 0;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "PostgreSQL(%s:%s) Reinstated. (ramp=%.0f sec)\n", this_host->hostname, this_host->servicename, EVS_config.host_ramp_time);
+}
+
+// --------------------------------
+// 接続先ホスト接続失敗処理 ※サーバー接続開始処理(IPv4/IPv6接続)で接続できなかった時に呼ばれる
+// --------------------------------
+void API_balance_fail(struct EVS_ev_pgsql_t *this_pgsql)
+{
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_pgsql->db_info;
+
+	if (db_info->host_num <= 1)
+	{
+		return;
+	}
+	API_balance_eject(db_info->host_list[this_pgsql->host_index], ev_now(EVS_loop), "connect failed");
+}
+
+// --------------------------------
+// 応答要求判定処理(1:ReadyForQueryが返ってくるメッセージを含む, 0:含まない)
+// --------------------------------
+// Query、Sync、FunctionCall、CopyDone、CopyFailにはReadyForQueryが返ってくる。
+// Terminateや、Sync前のParse/Bind/Executeなどには(まだ)返ってこないので、応答待ちにしない。
+static int API_balance_expect(const char *recv_ptr, int recv_len)
+{
+	int                             message_pos;
+	unsigned int                    message_len;
+
+	for (message_pos = 0; message_pos + 5 <= recv_len; message_pos += 1 + message_len)
+	{
+		switch (recv_ptr[message_pos])
+		{
+			case 'Q':
+			case 'S':
+			case 'F':
+			case 'c':
+			case 'f':
+				return 1;
+		}
+		message_len = API_pgsql_get_int32(recv_ptr + message_pos + 1);
+		if (message_len < 4 || message_len > (unsigned int)(recv_len - message_pos - 1))
+		{
+			break;
+		}
+	}
+	return 0;
+}
+
+// --------------------------------
+// 接続先ホスト問い合わせ開始処理 ※透過モードでクライアントから受信して、PostgreSQLに送る度に呼ばれる
+// --------------------------------
+void API_balance_request(struct EVS_ev_pgsql_t *this_pgsql, const char *recv_ptr, int recv_len)
+{
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_pgsql->db_info;
+
+	// 応答待ちでないなら、応答待ちにする(続けて送ってきたら、最初に送った日時から計る)
+	if (db_info->host_num <= 1 || this_pgsql->request_time != 0.)
+	{
+		return;
+	}
+	// 応答が返ってこないメッセージだけなら(Terminateなど)
+	if (API_balance_expect(recv_ptr, recv_len) == 0)
+	{
+		return;
+	}
+	ev_now_update(EVS_loop);                                            // イベントループの日時を現在の日時に更新
+	this_pgsql->request_time = ev_now(EVS_loop);
+	db_info->host_list[this_pgsql->host_index]->outstanding ++;
+}
+
+// --------------------------------
+// 接続先ホスト応答処理 ※透過モードでPostgreSQLから受信する度に呼ばれる
+// --------------------------------
+// 受信データの最後がReadyForQueryなら、応答待ちを終えて、応答時間の指数移動平均を更新する
+void API_balance_response(struct EVS_ev_pgsql_t *this_pgsql, const char *recv_ptr, int recv_len)
+{
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_pgsql->db_info;
+	struct EVS_host_t               *this_host;
+	ev_tstamp                       latency_time;
+
+	if (db_info->host_num <= 1 || this_pgsql->request_time == 0.)
+	{
+		return;
+	}
+	if (recv_len < 6 || recv_ptr[recv_len - 6] != 'Z' || API_pgsql_get_int32(recv_ptr + recv_len - 5) != 5)
+	{
+		return;
+	}
+	this_host = db_info->host_list[this_pgsql->host_index];
+	ev_now_update(EVS_loop);                                            // イベントループの日時を現在の日時に更新
+	latency_time = ev_now(EVS_loop) - this_pgsql->request_time;
+	if (this_host->latency_ewma == 0.)
+	{
+		this_host->latency_ewma = latency_time;
+	}
+	else
+	{
+		this_host->latency_ewma += (latency_time - this_host->latency_ewma) * BALANCE_EWMA_WEIGHT;
+	}
+	this_host->outstanding --;
+	this_host->fail_count = 0;
+	this_pgsql->request_time = 0.;
+}
+
+// --------------------------------
+// 接続先ホスト切断処理 ※PostgreSQLからの受信で、切断やエラーになった時に(PostgreSQL接続終了処理の前に)呼ばれる
+// --------------------------------
+// 応答待ちのままPostgreSQL側から切断されたなら、失敗として数える(クライアントの切断などで、こちらから閉じた時は数えない)
+void API_balance_lost(struct EVS_ev_pgsql_t *this_pgsql)
+{
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_pgsql->db_info;
+	struct EVS_host_t               *this_host;
+
+	if (db_info == NULL || db_info->host_num <= 1 || this_pgsql->request_time == 0.)
+	{
+		return;
+	}
+	this_host = db_info->host_list[this_pgsql->host_index];
+	this_host->fail_count ++;
+	if (this_host->eject_until == 0. && this_host->fail_count >= BALANCE_FAIL_LIMIT)
+	{
+		API_balance_eject(this_host, ev_now(EVS_loop), "connection lost");
+	}
+}
+
+// --------------------------------
+// 接続先ホスト接続終了処理 ※PostgreSQL接続終了処理(CLOSE_pgsql)から呼ばれる
+// --------------------------------
+// 応答待ちのまま閉じたなら、応答待ちの問い合わせ数を戻す
+void API_balance_close(struct EVS_ev_pgsql_t *this_pgsql)
+{
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_pgsql->db_info;
+
+	if (db_info == NULL || db_info->host_num <= 1 || this_pgsql->request_time == 0.)
+	{
+		return;
+	}
+	db_info->host_list[this_pgsql->host_index]->outstanding --;
+	this_pgsql->request_time = 0.;
+}
+
+// --------------------------------
+// 死活確認終了処理(probe_result 1:接続できた, 0:接続できなかった)
+// --------------------------------
+static void API_balance_probe_end(struct EVS_host_t *this_host, int probe_result)
+{
+	ev_tstamp                       nowtime = ev_now(EVS_loop);
+
+	if (this_host->probe_fd >= 0)
+	{
+		ev_io_stop(EVS_loop, &this_host->probe_watcher);
+		close(this_host->probe_fd);
+		this_host->probe_fd = -1;
+	}
+	if (probe_result != 0)
+	{
+		if (this_host->eject_until != 0.)
+		{
+			API_balance_reinstate(this_host, nowtime);
+		}
+	}
+	else
+	{
+		API_balance_eject(this_host, nowtime, "probe failed");
+	}
+}
+
+// --------------------------------
+// 死活確認コールバック処理(ノンブロッキングのTCP接続が終わった)
+// --------------------------------
+static void CB_balance_probe(struct ev_loop* loop, struct ev_io *watcher, int revents)
+{
+	struct EVS_host_t               *this_host = (struct EVS_host_t *)watcher;     // libevから渡されたwatcherポインタを、本来の拡張構造体ポインタとして変換する
+	int                             socket_error = 0;
+	socklen_t                       error_len = sizeof(socket_error);
+
+	(void)loop;                                                         // 死活確認終了処理はEVS_loopを使う
+	// イベントにエラーフラグが含まれていたら
+	if (EV_ERROR & revents)
+	{
+		API_balance_probe_end(this_host, 0);
+		return;
+	}
+	if (getsockopt(this_host->probe_fd, SOL_SOCKET, SO_ERROR, &socket_error, &error_len) < 0)
+	{
+		socket_error = errno;
+	}
+	API_balance_probe_end(this_host, (socket_error == 0) ? 1 : 0);
+}
+
+// --------------------------------
+// 死活確認開始処理(設定を読み込んだ時に名前解決したアドレスに、ノンブロッキングでTCP接続して、結果はCB_balance_probe()で受け取る)
+// --------------------------------
+static void API_balance_probe(struct EVS_host_t *this_host, ev_tstamp nowtime)
+{
+	int                             api_result;
+	int                             socket_fd;
+
+	this_host->probe_time = nowtime;
+
+	// 名前解決できていないなら
+	if (this_host->probe_addrlen == 0)
+	{
+		API_balance_probe_end(this_host, 0);
+		return;
+	}
+	socket_fd = socket(this_host->probe_addr.ss_family, SOCK_STREAM, 0);
+	if (socket_fd < 0)
+	{
+		return;
+	}
+	fcntl(socket_fd, F_SETFL, fcntl(socket_fd, F_GETFL, 0) | O_NONBLOCK);
+	api_result = connect(socket_fd, (struct sockaddr *)&this_host->probe_addr, this_host->probe_addrlen);
+	this_host->probe_fd = socket_fd;
+	// すぐに接続できたなら
+	if (api_result == 0)
+	{
+		API_balance_probe_end(this_host, 1);
+	}
+	// 接続中なら、書き込めるようになるのを待つ
+	else if (errno == EINPROGRESS)
+	{
+		ev_io_init(&this_host->probe_watcher, CB_balance_probe, socket_fd, EV_WRITE);
+		ev_io_start(EVS_loop, &this_host->probe_watcher);
+	}
+	else
+	{
+		API_balance_probe_end(this_host, 0);
+	}
+}
+
+// --------------------------------
+// 接続先ホスト死活確認処理 ※タイマーイベントから呼ばれる
+// --------------------------------
+// HostProbeInterval(秒)毎に死活確認をする。切り離し中のホストは、切り離し時間が過ぎたら死活確認をして、接続できれば戻す
+// 切り離したホストへのプールで待機中の接続は閉じる(プールから別のホストの接続を使うか、新しく接続させる)
+void API_balance_check(ev_tstamp nowtime)
+{
+	struct EVS_db_t                 *db_list;                           // データベース別設定用構造体ポインタ
+	struct EVS_host_t               *this_host;
+	struct EVS_ev_pgsql_t           *this_pgsql;
+	struct EVS_ev_pgsql_t           *next_pgsql;
+
+	TAILQ_FOREACH (this_host, &EVS_host_tailq, entries)
+	{
+		// 複数のホストを指定した設定から使われていないなら
+		if (this_host->balance_num == 0)
+		{
+			continue;
+		}
+		// 死活確認中なら(接続が確認間隔以上終わらなければ、接続できなかったことにする)
+		if (this_host->probe_fd >= 0)
+		{
+			if (this_host->probe_time + ((EVS_config.host_probe_intval > 1.) ? EVS_config.host_probe_intval : 1.) < nowtime)
+			{
+				API_balance_probe_end(this_host, 0);
+			}
+		}
+		// 切り離し時間が過ぎたら
+		else if (this_host->eject_until != 0.)
+		{
+			if (this_host->eject_until <= nowtime)
+			{
+				if (EVS_config.host_probe_intval > 0.)
+				{
+					API_balance_probe(this_host, nowtime);
+				}
+				else
+				{
+					API_balance_reinstate(this_host, nowtime);
+				}
+			}
+		}
+		else if (EVS_config.host_probe_intval > 0. && this_host->probe_time + EVS_config.host_probe_intval <= nowtime)
+		{
+			API_balance_probe(this_host, nowtime);
+		}
+	}
+	TAILQ_FOREACH (db_list, &EVS_db_tailq, entries)
+	{
+		if (db_list->host_num <= 1)
+		{
+			continue;
+		}
+		for (this_pgsql = TAILQ_FIRST(&db_list->pool_tailq); this_pgsql != NULL; this_pgsql = next_pgsql)
+		{
+			next_pgsql = TAILQ_NEXT(this_pgsql, pool_entries);
+			if (db_list->host_list[this_pgsql->host_index]->eject_until != 0.)
+			{
+				CLOSE_pgsql(EVS_loop, (struct ev_io *)this_pgsql, 0);
+			}
+		}
+	}
+}
+
+// --------------------------------
+// 接続先ホスト使用終了処理 ※データベース別設定を開放する前(接続がなくなってから)に呼ばれる
+// --------------------------------
+// どのデータベース別設定からも使われなくなったホストは、死活確認を止めて開放する(設定の誤りで使われずに残ったホストも)
+void API_balance_free(struct EVS_db_t *db_info)
+{
+	struct EVS_host_t               *this_host;
+	struct EVS_host_t               *next_host;
+	int                             host_index;
+
+	for (host_index = 0; host_index < db_info->host_num; host_index ++)
+	{
+		db_info->host_list[host_index]->db_num --;
+		db_info->host_list[host_index]->balance_num -= (db_info->host_num > 1) ? 1 : 0;
+	}
+	for (this_host = TAILQ_FIRST(&EVS_host_tailq); this_host != NULL; this_host = next_host)
+	{
+		next_host = TAILQ_NEXT(this_host, entries);
+		if (this_host->db_num > 0)
+		{
+			continue;
+		}
+		if (this_host->probe_fd >= 0)
+		{
+			ev_io_stop(EVS_loop, &this_host->probe_watcher);
+			close(this_host->probe_fd);
+		}
+		TAILQ_REMOVE(&EVS_host_tailq, this_host, entries);
+		free(this_host);
+	}
+}
+
+// --------------------------------
+// 接続先ホスト再読み込み処理 ※SIGHUPで設定ファイルを読み直す前に呼ばれる
+// --------------------------------
+// 死活確認の接続先を名前解決し直す(ホストの状態はそのまま)
+void API_balance_reload(void)
+{
+	struct EVS_host_t               *this_host;
+
+	TAILQ_FOREACH (this_host, &EVS_host_tailq, entries)
+	{
+		API_balance_resolve(this_host);
+	}
+}
+
+// --------------------------------
+// 接続先ホスト終了処理(死活確認中のソケットを閉じて、接続先ホスト別構造体を開放する) ※データベース別設定を開放する前に呼ばれる
+// --------------------------------
+void API_balance_end(void)
+{
+	struct EVS_host_t               *this_host;
+
+	while (!TAILQ_EMPTY(&EVS_host_tailq))
+	{
+		this_host = TAILQ_FIRST(&EVS_host_tailq);
+		if (this_host->probe_fd >= 0)
+		{
+			ev_io_stop(EVS_loop, &this_host->probe_watcher);
+			close(this_host->probe_fd);
+		}
+		TAILQ_REMOVE(&EVS_host_tailq, this_host, entries);
+		free(this_host);
+	}
+}
@@ -0,0 +1,336 @@
+// ----------------------------------------------------------------------
+// Protocol Analyzer for PostgreSQL -
+// Purpose:
+//     Route CancelRequest to the PostgreSQL backend serving the client.
+//
+// Program:
+//     Takeshi Kaburagi/MyDNS.JP    https://www.fvg-on.net/
+//
+// Usage:
+//     ./evs_pganalyzer [./evserver.ini]
+// ----------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------
+// ヘッダ部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// インクルード宣言
+// --------------------------------
+
+// --------------------------------
+// 定数宣言
+// --------------------------------
+#define CANCEL_HASH_SIZE        4096                                // CancelRequest用のキー索引の大きさ(2のべき乗。プロセスIDの下位ビットで引く)
+#define CANCEL_REQUEST_LENGTH   16                                  // CancelRequestの長さ(Int32(長さ) + Int32(リクエストコード) + Int32(プロセスID) + Int32(秘密鍵))
+#define CANCEL_TIMEOUT          5.                                  // PostgreSQLへのCancelRequestの転送を諦めるまでの時間(秒)
+
+// --------------------------------
+// 型宣言
+// --------------------------------
+struct EVS_cancel_t {                                       // CancelRequest転送用構造体(転送毎に、PostgreSQLへ短い接続を開く)
+	ev_io           io_watcher;                             // libevのev_io(ノンブロッキングの接続が終わったら送る)
+	int             socket_fd;                              // PostgreSQLに接続した際のファイルディスクリプタ
+	ev_tstamp       start_time;                             // 転送を始めた日時
+	char            message_buf[CANCEL_REQUEST_LENGTH];     // PostgreSQLに送るCancelRequest(PostgreSQLのプロセスIDと秘密鍵)
+	TAILQ_ENTRY (EVS_cancel_t) entries;                     // 次のTAILQ構造体への接続
+};
+
+// --------------------------------
+// 変数宣言
+// --------------------------------
+static struct EVS_ev_client_t   *EVS_cancel_hash[CANCEL_HASH_SIZE]; // CancelRequest用のキー索引(クライアントに渡したプロセスIDから、クライアントを引く)
+static unsigned int             EVS_cancel_next_pid = 0;            // 次にクライアントに渡すプロセスID
+static TAILQ_HEAD (EVS_cancel_head, EVS_cancel_t) EVS_cancel_tailq = TAILQ_HEAD_INITIALIZER(EVS_cancel_tailq);    // 転送中のCancelRequest
+
+// ----------------------------------------------------------------------
+// コード部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// CancelRequestの転送について
+// --------------------------------
+// psqlのCtrl-CやJDBCの文タイムアウトは、開始メッセージで受け取ったBackendKeyData(プロセスIDと秘密鍵)を、新しい接続でCancelRequestとして送ってくる。
+// プールした接続は、最初に接続したクライアントのBackendKeyDataしか持っていないし、トランザクション単位のプールでは接続が変わるので、
+// PostgreSQLのBackendKeyDataはそのままクライアントに渡さずに、PgAnalyzerが割り当てたプロセスIDと秘密鍵(乱数)に書き換えて渡す。
+//
+//      PostgreSQL → BackendKeyData(PostgreSQLのキー) → 接続毎に保存 → クライアントのキーに書き換え → クライアント
+//      クライアント → CancelRequest(クライアントのキー) → キー索引 → そのクライアントに今割り当てている接続 → PostgreSQLのキーで転送
+//
+// キー索引は、プロセスIDを順番に割り当てて、その下位ビットの位置に入れる(秘密鍵が違えば転送しない)。
+// PostgreSQLへは短い接続を開いて送り、そのまま閉じる(PostgreSQLは何も返さない)。クライアントの接続にも何も返さずに閉じる。
+// トランザクション単位のプールで、接続を割り当てていない(トランザクションの外の)クライアントなら、取り消すものがないので何もしない。
+// --------------------------------
+// CancelRequest用キー索引検索処理(クライアントに渡したプロセスIDから、クライアントを探す。なければNULL)
+// --------------------------------
+static struct EVS_ev_client_t *API_cancel_lookup(unsigned int cancel_pid)
+{
+	struct EVS_ev_client_t          *this_client;
+
+	for (this_client = EVS_cancel_hash[cancel_pid & (CANCEL_HASH_SIZE - 1)]; this_client != NULL; this_client = this_client->cancel_next)
+	{
+		if (this_client->cancel_pid == cancel_pid)
+		{
+			break;
+		}
+	}
+	return this_client;
+}
+
+// --------------------------------
+// CancelRequest用キー割り当て処理(まだなら、クライアントにプロセスIDと秘密鍵を割り当てて、キー索引に入れる)
+// --------------------------------
+static void API_cancel_assign(struct EVS_ev_client_t *this_client)
+{
+	unsigned int                    hash_index;
+
+	if (this_client->cancel_pid != 0)
+	{
+		return;
+	}
+	// プロセスIDは1～0x7fffffffを順番に使う(一周して、まだ使っているプロセスIDなら飛ばす)
+	do
+	{
+		EVS_cancel_next_pid = (EVS_cancel_next_pid % 0x7fffffff) + 1;
+	} while (API_cancel_lookup(EVS_cancel_next_pid) != NULL);
+	this_client->cancel_pid = EVS_cancel_next_pid;
+	// 秘密鍵は乱数(取れなければ、random())
+	if (RAND_bytes((unsigned char *)&this_client->cancel_key, sizeof(this_client->cancel_key)) != 1)
+	{
+		this_client->cancel_key = (unsigned int)random();
+	}
+
+	hash_index = this_client->cancel_pid & (CANCEL_HASH_SIZE - 1);
+	this_client->cancel_next = EVS_cancel_hash[hash_index];
+	EVS_cancel_hash[hash_index] = this_client;
+}
+
+// --------------------------------
+// BackendKeyData保存処理 ※PostgreSQLとの接続中(pgsql_status==2)に、PostgreSQLから受け取ったメッセージ毎に呼ばれる
+// --------------------------------
+// CancelRequestを転送する時のために、PostgreSQLのプロセスIDと秘密鍵を接続毎に保存しておく
+void API_cancel_backend(struct EVS_ev_pgsql_t *this_pgsql, struct EVS_pgmsg_t *pgmsg)
+{
+	if (pgmsg->message_type != 'K' || pgmsg->message_len != 4 + sizeof(this_pgsql->cancel_key))
+	{
+		return;
+	}
+	memcpy(this_pgsql->cancel_key, pgmsg->message_ptr + 1 + 4, sizeof(this_pgsql->cancel_key));
+	this_pgsql->cancel_flag = 1;
+}
+
+// --------------------------------
+// BackendKeyData書き換え処理 ※PostgreSQLから受け取った開始メッセージレスポンスを、クライアントに送る前に呼ばれる
+// --------------------------------
+// 送信データの中のBackendKeyDataを、クライアントに割り当てたプロセスIDと秘密鍵に書き換える
+void API_cancel_rewrite(struct EVS_ev_client_t *this_client, char *send_buf, int send_len)
+{
+	char                            *message_ptr = send_buf;
+	char                            *end_ptr = send_buf + send_len;
+	unsigned int                    message_len;
+
+	while (message_ptr + 1 + 4 <= end_ptr)
+	{
+		message_len = API_pgsql_get_int32(message_ptr + 1);
+		if (message_len < 4 || message_ptr + 1 + message_len > end_ptr)
+		{
+			break;
+		}
+		if (message_ptr[0] == 'K' && message_len == 4 + 4 + 4)
+		{
+			API_cancel_assign(this_client);
+			API_pgsql_set_int32(message_ptr + 1 + 4, this_client->cancel_pid);
+			API_pgsql_set_int32(message_ptr + 1 + 4 + 4, this_client->cancel_key);
+		}
+		message_ptr += 1 + message_len;
+	}
+}
+
+// --------------------------------
+// CancelRequest転送終了処理(PostgreSQLへの短い接続を閉じる)
+// --------------------------------
+static void API_cancel_finish(struct EVS_cancel_t *cancel_info)
+{
+	ev_io_stop(EVS_loop, &cancel_info->io_watcher);
+	close(cancel_info->socket_fd);
+	TAILQ_REMOVE(&EVS_cancel_tailq, cancel_info, entries);
+	free(cancel_info);
+}
+
+// --------------------------------
+// CancelRequest送信処理(PostgreSQLへの接続が終わったので、CancelRequestを送って閉じる)
+// --------------------------------
+static void API_cancel_send(struct EVS_cancel_t *cancel_info)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	if (send(cancel_info->socket_fd, cancel_info->message_buf, sizeof(cancel_info->message_buf), MSG_NOSIGNAL) != sizeof(cancel_info->message_buf))
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(fd=%d): Cannot send CancelRequest!? errno=%d (%s)\n", __func__, cancel_info->socket_fd, errno, strerror(errno));
+	}
+	API_cancel_finish(cancel_info);
+}
+
+// --------------------------------
+// CancelRequest転送コールバック処理(ノンブロッキングの接続が終わった)
+// --------------------------------
+static void CB_cancel_connect(struct ev_loop* loop, struct ev_io *watcher, int revents)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_cancel_t             *cancel_info = (struct EVS_cancel_t *)watcher;  // libevから渡されたwatcherポインタを、本来の拡張構造体ポインタとして変換する
+	int                             socket_error = 0;
+	socklen_t                       error_len = sizeof(socket_error);
+
+	(void)loop;                                                         // 後始末はAPI_cancel_finish()がEVS_loopで行う
+
+	// イベントにエラーフラグが含まれていたら
+	if (EV_ERROR & revents)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(fd=%d): Invalid event!?\n", __func__, cancel_info->socket_fd);
+		API_cancel_finish(cancel_info);
+		return;
+	}
+	if (getsockopt(cancel_info->socket_fd, SOL_SOCKET, SO_ERROR, &socket_error, &error_len) < 0)
+	{
+		socket_error = errno;
+	}
+	if (socket_error != 0)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(fd=%d): Cannot connect to PostgreSQL for CancelRequest!? errno=%d (%s)\n", __func__, cancel_info->socket_fd, socket_error, strerror(socket_error));
+		API_cancel_finish(cancel_info);
+		return;
+	}
+	API_cancel_send(cancel_info);
+}
+
+// --------------------------------
+// CancelRequest転送処理 ※クライアント開始メッセージ解析処理で、CancelRequestを受信した時に呼ばれる
+// --------------------------------
+// キー索引からクライアントを探して、そのクライアントに今割り当てている接続と同じPostgreSQLに、その接続のキーでCancelRequestを送る
+void API_cancel_request(struct EVS_ev_client_t *this_client)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	unsigned int                    cancel_pid = API_pgsql_get_int32(this_client->recv_buf + 8);
+	unsigned int                    cancel_key = API_pgsql_get_int32(this_client->recv_buf + 12);
+	struct EVS_ev_client_t          *target_client;                     // 取り消す問い合わせを送ったクライアント
+	struct EVS_ev_pgsql_t           *target_pgsql;                      // そのクライアントに割り当てている接続
+	struct EVS_cancel_t             *cancel_info;
+	struct sockaddr_storage         peer_address;                       // 接続先のPostgreSQLのアドレス(割り当てている接続から取る)
+	socklen_t                       address_len = sizeof(peer_address);
+	int                             api_result;
+
+	target_client = API_cancel_lookup(cancel_pid);
+	// 知らないプロセスIDか、秘密鍵が違うなら(PostgreSQLと同じく、何も返さない)
+	if (target_client == NULL || target_client->cancel_key != cancel_key)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "Client %s -> CancelRequest with unknown key! Ignored. (pid=%u)\n", this_client->addr_str, cancel_pid);
+		return;
+	}
+	target_pgsql = (struct EVS_ev_pgsql_t *)target_client->pgsql_info;
+	// 接続を割り当てていない(トランザクションの外)か、まだ接続処理中なら、取り消すものがない
+	if (target_pgsql == NULL || target_pgsql->pgsql_status != 10 || target_pgsql->cancel_flag == 0)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "Client %s -> CancelRequest for Client(%s), no query running. (pid=%u)\n", this_client->addr_str, target_client->addr_str, cancel_pid);
+		return;
+	}
+	if (getpeername(target_pgsql->socket_fd, (struct sockaddr *)&peer_address, &address_len) != 0)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(pgsql=%d): getpeername(): Cannot get PostgreSQL address? errno=%d (%s)\n", __func__, target_pgsql->socket_fd, errno, strerror(errno));
+		return;
+	}
+
+	cancel_info = (struct EVS_cancel_t *)calloc(1, sizeof(struct EVS_cancel_t));
+	if (cancel_info == NULL)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
+		return;
+	}
+	API_pgsql_set_int32(cancel_info->message_buf, CANCEL_REQUEST_LENGTH);
+	API_pgsql_set_int32(cancel_info->message_buf + 4, CANCEL_REQUEST_CODE);
+	memcpy(cancel_info->message_buf + 8, target_pgsql->cancel_key, sizeof(target_pgsql->cancel_key));
+	cancel_info->start_time = ev_now(EVS_loop);
+
+	cancel_info->socket_fd = socket(peer_address.ss_family, SOCK_STREAM, 0);
+	if (cancel_info->socket_fd < 0)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(): socket(): Cannot create socket? errno=%d (%s)\n", __func__, errno, strerror(errno));
+		free(cancel_info);
+		return;
+	}
+	fcntl(cancel_info->socket_fd, F_SETFL, fcntl(cancel_info->socket_fd, F_GETFL, 0) | O_NONBLOCK);
+	TAILQ_INSERT_TAIL(&EVS_cancel_tailq, cancel_info, entries);
+	ev_io_init(&cancel_info->io_watcher, CB_cancel_connect, cancel_info->socket_fd, EV_WRITE);
+
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "Client %s -> CancelRequest for Client(%s) forwarded to PostgreSQL(%s). (pgsql=%d)\n", this_client->addr_str, target_client->addr_str, ((struct EVS_db_t *)target_pgsql->db_info)->hostname, target_pgsql->socket_fd);
+
+	api_result = connect(cancel_info->socket_fd, (struct sockaddr *)&peer_address, address_len);
+	// すぐに接続できたなら(UNIXドメインソケットなど)
+	if (api_result == 0)
+	{
+		API_cancel_send(cancel_info);
+	}
+	// 接続中なら、書き込めるようになるのを待つ
+	else if (errno == EINPROGRESS || errno == EAGAIN)
+	{
+		ev_io_start(EVS_loop, &cancel_info->io_watcher);
+	}
+	else
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(fd=%d): connect(): Cannot connect to PostgreSQL for CancelRequest!? errno=%d (%s)\n", __func__, cancel_info->socket_fd, errno, strerror(errno));
+		API_cancel_finish(cancel_info);
+	}
+}
+
+// --------------------------------
+// CancelRequest用キー索引削除処理 ※クライアント接続終了時に呼ばれる
+// --------------------------------
+void API_cancel_close(struct EVS_ev_client_t *this_client)
+{
+	struct EVS_ev_client_t          **client_ptr;
+
+	if (this_client->cancel_pid == 0)
+	{
+		return;
+	}
+	for (client_ptr = &EVS_cancel_hash[this_client->cancel_pid & (CANCEL_HASH_SIZE - 1)]; *client_ptr != NULL; client_ptr = &(*client_ptr)->cancel_next)
+	{
+		if (*client_ptr == this_client)
+		{
+			*client_ptr = this_client->cancel_next;
+			break;
+		}
+	}
+	this_client->cancel_pid = 0;
+	this_client->cancel_next = NULL;
+}
+
+// --------------------------------
+// CancelRequest転送タイムアウト確認処理 ※タイマーイベントから呼ばれる
+// --------------------------------
+// CANCEL_TIMEOUT(秒)経っても接続できないPostgreSQLへの転送は諦める
+void API_cancel_check(ev_tstamp nowtime)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_cancel_t             *cancel_info;
+	struct EVS_cancel_t             *next_info;
+
+	for (cancel_info = TAILQ_FIRST(&EVS_cancel_tailq); cancel_info != NULL; cancel_info = next_info)
+	{
+		next_info = TAILQ_NEXT(cancel_info, entries);
+		if (cancel_info->start_time + CANCEL_TIMEOUT < nowtime)
+		{
+			LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(fd=%d): CancelRequest connect timeout! Close.\n", __func__, cancel_info->socket_fd);
+			API_cancel_finish(cancel_info);
+		}
+	}
+}
+
+// --------------------------------
+// CancelRequest転送終了処理 ※終了時に呼ばれる
+// --------------------------------
+void API_cancel_end(void)
+{
+	while (!TAILQ_EMPTY(&EVS_cancel_tailq))
+	{
+		API_cancel_finish(TAILQ_FIRST(&EVS_cancel_tailq));
+	}
+}
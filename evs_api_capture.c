@@ -0,0 +1,411 @@
+// ----------------------------------------------------------------------
+// Protocol Analyzer for PostgreSQL -
+// Purpose:
+//     pcapng capture of relayed sessions.
+//
+// Program:
+//     Takeshi Kaburagi/MyDNS.JP    https://www.fvg-on.net/
+//
+// Usage:
+//     ./evs_pganalyzer [./evserver.ini]
+// ----------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------
+// ヘッダ部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// インクルード宣言
+// --------------------------------
+
+// --------------------------------
+// 定数宣言
+// --------------------------------
+#define PCAPNG_SHB_TYPE         0x0A0D0D0A                  // pcapng : Section Header Block
+#define PCAPNG_IDB_TYPE         0x00000001                  // pcapng : Interface Description Block
+#define PCAPNG_EPB_TYPE         0x00000006                  // pcapng : Enhanced Packet Block
+#define PCAPNG_BYTE_ORDER       0x1A2B3C4D                  // pcapng : バイトオーダーマジック(書いたマシンのバイトオーダーで読まれる)
+#define PCAPNG_LINKTYPE_RAW     101                         // pcapng : リンク層なし(IPヘッダから始まる)
+
+#define CAPTURE_EPB_HEAD_LENGTH 28                          // Enhanced Packet Blockのパケットデータより前の長さ
+#define CAPTURE_IPTCP_LENGTH    40                          // 擬似IPv4ヘッダ＋擬似TCPヘッダの長さ
+#define CAPTURE_SEGMENT_LENGTH  65000                       // 一パケットに入れるデータの最大長(IPv4の全長が65535を超えないように)
+#define CAPTURE_PGSQL_PORT      5432                        // 擬似TCPヘッダのPostgreSQL側ポート番号(Wiresharkのpgsqlディセクタが既定で解析するポート)
+
+#define TCP_FLAG_FIN            0x01
+#define TCP_FLAG_SYN            0x02
+#define TCP_FLAG_PSH            0x08
+#define TCP_FLAG_ACK            0x10
+
+// --------------------------------
+// 型宣言
+// --------------------------------
+
+// --------------------------------
+// 変数宣言
+// --------------------------------
+static int                      EVS_capture_fd = -1;                        // キャプチャファイルのファイルディスクリプタ
+static char                     *EVS_capture_map = NULL;                    // キャプチャファイルをmmap()した領域
+static size_t                   EVS_capture_used = 0;                       // キャプチャファイルに書いた長さ
+static int                      EVS_capture_failed = 0;                     // キャプチャファイルが開けなかったか(1:以降はキャプチャしない)
+static unsigned short           EVS_capture_ipid = 0;                       // 擬似IPv4ヘッダのID
+
+// ----------------------------------------------------------------------
+// コード部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// キャプチャについて
+// --------------------------------
+// データベースチームへのエスカレーション用に、中継しているセッションの両方向のデータを、Wiresharkで読めるpcapng形式で出力する。
+// 実際のTCPパケットではなく、中継したデータ(SSLなら復号後)に、client_addr_strと接続先の設定から作った擬似IPv4/TCPヘッダを付ける。
+// (IPv4以外のアドレスは、10.x.x.xの擬似アドレスにする。PostgreSQL側のポートは、pgsqlディセクタが効くように5432にする)
+// キャプチャファイルはCaptureSizeの大きさで先に確保してmmap()しておき、パケットはmemcpy()するだけにする。
+// 一杯になったら、使った長さに切り詰めて"キャプチャファイル名.1"に名前を変え、新しいキャプチャファイルに切り替える。
+//
+//      pcapng                                                                  https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-00.html
+// --------------------------------
+// キャプチャファイル終了処理(使った長さに切り詰めて閉じる)
+// --------------------------------
+static void API_capture_finish(void)
+{
+	if (EVS_capture_map != NULL)
+	{
+		munmap(EVS_capture_map, EVS_config.capture_size);
+		EVS_capture_map = NULL;
+	}
+	if (EVS_capture_fd != -1)
+	{
+		if (ftruncate(EVS_capture_fd, EVS_capture_used) != 0)
+		{
+			// 切り詰められなくても、pcapngとしては末尾のゼロ埋めを読み飛ばせないだけなので、そのまま閉じる
+		}
+		close(EVS_capture_fd);
+		EVS_capture_fd = -1;
+	}
+	EVS_capture_used = 0;
+}
+
+// --------------------------------
+// キャプチャファイル開始処理(CaptureSizeの大きさで確保してmmap()し、Section Header BlockとInterface Description Blockを書く)
+// --------------------------------
+static int API_capture_open(void)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	int                             api_result;
+	uint32_t                        block_data[7];                      // 書き込むブロック(SHBは28バイト、IDBは20バイト)
+	uint64_t                        section_len = (uint64_t)-1;         // セクション長(不明)
+
+	EVS_capture_fd = open(EVS_config.capture_file, (O_RDWR | O_CREAT | O_TRUNC), (S_IRUSR | S_IWUSR | S_IRGRP));
+	if (EVS_capture_fd == -1)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot open capture file!? (%s) errno=%d (%s)\n", __func__, EVS_config.capture_file, errno, strerror(errno));
+		return -1;
+	}
+	// ディスクの領域も先に確保する(mmap()した領域への書き込みで、ディスクが一杯でSIGBUSにならないように)
+	api_result = posix_fallocate(EVS_capture_fd, 0, EVS_config.capture_size);
+	if (api_result != 0)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot allocate capture file!? (%s, size=%lu) errno=%d (%s)\n", __func__, EVS_config.capture_file, (unsigned long)EVS_config.capture_size, api_result, strerror(api_result));
+		close(EVS_capture_fd);
+		EVS_capture_fd = -1;
+		return -1;
+	}
+	EVS_capture_map = (char *)mmap(NULL, EVS_config.capture_size, (PROT_READ | PROT_WRITE), MAP_SHARED, EVS_capture_fd, 0);
+	if (EVS_capture_map == MAP_FAILED)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot mmap capture file!? (%s) errno=%d (%s)\n", __func__, EVS_config.capture_file, errno, strerror(errno));
+		EVS_capture_map = NULL;
+		close(EVS_capture_fd);
+		EVS_capture_fd = -1;
+		return -1;
+	}
+	EVS_capture_used = 0;
+
+	// Section Header Block
+	block_data[0] = PCAPNG_SHB_TYPE;
+	block_data[1] = 28;
+	block_data[2] = PCAPNG_BYTE_ORDER;
+	block_data[3] = 1;                                                  // メジャーバージョン1、マイナーバージョン0
+	memcpy(&block_data[4], &section_len, sizeof(section_len));
+	block_data[6] = 28;
+	memcpy(EVS_capture_map + EVS_capture_used, block_data, 28);
+	EVS_capture_used += 28;
+
+	// Interface Description Block
+	block_data[0] = PCAPNG_IDB_TYPE;
+	block_data[1] = 20;
+	block_data[2] = PCAPNG_LINKTYPE_RAW;                                // リンク層タイプ(16bit)＋予約(16bit)
+	block_data[3] = 0;                                                  // スナップ長(0:制限なし)
+	block_data[4] = 20;
+	memcpy(EVS_capture_map + EVS_capture_used, block_data, 20);
+	EVS_capture_used += 20;
+
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): Capture file opened. (%s, size=%lu)\n", __func__, EVS_config.capture_file, (unsigned long)EVS_config.capture_size);
+	return 0;
+}
+
+// --------------------------------
+// キャプチャファイル領域確保処理(block_lenバイトを書く位置を返す。一杯なら切り替える。書けないならNULL)
+// --------------------------------
+static char *API_capture_reserve(size_t block_len)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	char                            rotate_file[PATH_MAX + 2];          // 切り替え後の古いキャプチャファイル名(キャプチャファイル名＋".1")
+	char                            *block_ptr;
+
+	// キャプチャファイルが開いていなければ、開く
+	if (EVS_capture_map == NULL)
+	{
+		if (EVS_capture_failed == 1 || API_capture_open() != 0)
+		{
+			EVS_capture_failed = 1;
+			return NULL;
+		}
+	}
+	// 入りきらないなら
+	if (EVS_capture_used + block_len > EVS_config.capture_size)
+	{
+		// 新しいキャプチャファイルでも入りきらないなら
+		if (48 + block_len > EVS_config.capture_size)
+		{
+			return NULL;
+		}
+		// 使った長さに切り詰めて名前を変え、新しいキャプチャファイルに切り替える
+		API_capture_finish();
+		// 名前を変えられなければ、そのまま上書きする(新しいキャプチャファイルは先頭から書き直す)
+		if (snprintf(rotate_file, sizeof(rotate_file), "%s.1", EVS_config.capture_file) >= (int)sizeof(rotate_file))
+		{
+			LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(): Capture file name too long to rotate!? (%s)\n", __func__, EVS_config.capture_file);
+		}
+		else if (rename(EVS_config.capture_file, rotate_file) != 0)
+		{
+			LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(): Cannot rotate capture file!? (%s) errno=%d (%s)\n", __func__, EVS_config.capture_file, errno, strerror(errno));
+		}
+		else
+		{
+			LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): Capture file rotated. (%s.1)\n", __func__, EVS_config.capture_file);
+		}
+		if (API_capture_open() != 0)
+		{
+			EVS_capture_failed = 1;
+			return NULL;
+		}
+	}
+
+	block_ptr = EVS_capture_map + EVS_capture_used;
+	EVS_capture_used += block_len;
+	return block_ptr;
+}
+
+// --------------------------------
+// 擬似パケット出力処理(擬似IPv4/TCPヘッダを付けて、Enhanced Packet Blockとして書く)
+// --------------------------------
+static void API_capture_packet(struct EVS_capture_t *this_capture, int from_client, unsigned char tcp_flags, const char *payload_ptr, unsigned int payload_len)
+{
+	struct timeval                  now_tv;
+	uint64_t                        timestamp;                          // 1970年からのマイクロ秒
+	uint32_t                        epb_head[7];                        // Enhanced Packet Blockのヘッダ
+	uint32_t                        epb_tail;                           // Enhanced Packet Blockの末尾(ブロック長)
+	unsigned char                   iptcp_head[CAPTURE_IPTCP_LENGTH];   // 擬似IPv4ヘッダ＋擬似TCPヘッダ
+	unsigned int                    packet_len = CAPTURE_IPTCP_LENGTH + payload_len;
+	unsigned int                    pad_len = (4 - (packet_len & 3)) & 3;
+	size_t                          block_len = CAPTURE_EPB_HEAD_LENGTH + packet_len + pad_len + sizeof(epb_tail);
+	char                            *block_ptr;
+	int                             src_index = (from_client == 1) ? 0 : 1;     // 送信元(0:クライアント, 1:PostgreSQL)
+	int                             dst_index = 1 - src_index;
+	uint32_t                        ip_sum = 0;
+	int                             sum_pos;
+
+	block_ptr = API_capture_reserve(block_len);
+	if (block_ptr == NULL)
+	{
+		return;
+	}
+
+	gettimeofday(&now_tv, NULL);
+	timestamp = (uint64_t)now_tv.tv_sec * 1000000 + now_tv.tv_usec;
+	epb_head[0] = PCAPNG_EPB_TYPE;
+	epb_head[1] = block_len;
+	epb_head[2] = 0;                                                    // インターフェースID
+	epb_head[3] = (uint32_t)(timestamp >> 32);
+	epb_head[4] = (uint32_t)timestamp;
+	epb_head[5] = packet_len;                                           // キャプチャ長
+	epb_head[6] = packet_len;                                           // 元のパケット長
+	epb_tail = block_len;
+
+	// 擬似IPv4ヘッダ
+	memset(iptcp_head, 0, sizeof(iptcp_head));
+	iptcp_head[0] = 0x45;                                               // バージョン4、ヘッダ長20バイト
+	iptcp_head[2] = packet_len >> 8;                                    // 全長
+	iptcp_head[3] = packet_len;
+	iptcp_head[4] = EVS_capture_ipid >> 8;                              // ID
+	iptcp_head[5] = EVS_capture_ipid;
+	EVS_capture_ipid ++;
+	iptcp_head[6] = 0x40;                                               // Don't Fragment
+	iptcp_head[8] = 64;                                                 // TTL
+	iptcp_head[9] = IPPROTO_TCP;
+	memcpy(iptcp_head + 12, &this_capture->addr[src_index], 4);         // 送信元アドレス(ネットワークバイトオーダー)
+	memcpy(iptcp_head + 16, &this_capture->addr[dst_index], 4);         // 宛先アドレス
+	for (sum_pos = 0; sum_pos < 20; sum_pos += 2)
+	{
+		ip_sum += (iptcp_head[sum_pos] << 8) | iptcp_head[sum_pos + 1];
+	}
+	ip_sum = (ip_sum & 0xFFFF) + (ip_sum >> 16);
+	ip_sum = ~((ip_sum & 0xFFFF) + (ip_sum >> 16));
+	iptcp_head[10] = ip_sum >> 8;                                       // ヘッダチェックサム
+	iptcp_head[11] = ip_sum;
+
+	// 擬似TCPヘッダ(チェックサムは0のまま。Wiresharkは既定では検証しない)
+	iptcp_head[20] = this_capture->port[src_index] >> 8;
+	iptcp_head[21] = this_capture->port[src_index];
+	iptcp_head[22] = this_capture->port[dst_index] >> 8;
+	iptcp_head[23] = this_capture->port[dst_index];
+	iptcp_head[24] = this_capture->seq[src_index] >> 24;                // シーケンス番号
+	iptcp_head[25] = this_capture->seq[src_index] >> 16;
+	iptcp_head[26] = this_capture->seq[src_index] >> 8;
+	iptcp_head[27] = this_capture->seq[src_index];
+	if (tcp_flags & TCP_FLAG_ACK)
+	{
+		iptcp_head[28] = this_capture->seq[dst_index] >> 24;            // 確認応答番号(相手の次のシーケンス番号)
+		iptcp_head[29] = this_capture->seq[dst_index] >> 16;
+		iptcp_head[30] = this_capture->seq[dst_index] >> 8;
+		iptcp_head[31] = this_capture->seq[dst_index];
+	}
+	iptcp_head[32] = 0x50;                                              // ヘッダ長20バイト
+	iptcp_head[33] = tcp_flags;
+	iptcp_head[34] = 0xFF;                                              // ウィンドウサイズ
+	iptcp_head[35] = 0xFF;
+
+	memcpy(block_ptr, epb_head, CAPTURE_EPB_HEAD_LENGTH);
+	memcpy(block_ptr + CAPTURE_EPB_HEAD_LENGTH, iptcp_head, CAPTURE_IPTCP_LENGTH);
+	if (payload_len > 0)
+	{
+		memcpy(block_ptr + CAPTURE_EPB_HEAD_LENGTH + CAPTURE_IPTCP_LENGTH, payload_ptr, payload_len);
+	}
+	memset(block_ptr + CAPTURE_EPB_HEAD_LENGTH + packet_len, 0, pad_len);
+	memcpy(block_ptr + CAPTURE_EPB_HEAD_LENGTH + packet_len + pad_len, &epb_tail, sizeof(epb_tail));
+
+	// シーケンス番号を進める(SYNとFINは1つ分)
+	this_capture->seq[src_index] += payload_len + ((tcp_flags & (TCP_FLAG_SYN | TCP_FLAG_FIN)) ? 1 : 0);
+}
+
+// --------------------------------
+// 擬似アドレス取得処理(IPv4アドレス文字列ならそのまま、そうでなければ10.x.x.xの擬似アドレスにする)
+// --------------------------------
+static uint32_t API_capture_addr(const char *addr_str, unsigned int addr_seed)
+{
+	struct in_addr                  ipv4_addr;
+
+	if (addr_str != NULL && inet_pton(AF_INET, addr_str, &ipv4_addr) == 1)
+	{
+		return ipv4_addr.s_addr;
+	}
+	return htonl(0x0A000000 | (addr_seed & 0x00FFFFFF));
+}
+
+// --------------------------------
+// 擬似サーバーアドレス取得処理(接続先に選んだホストを設定を読み込んだ時に名前解決したIPv4アドレスか、10.x.x.xの擬似アドレスにする)
+// --------------------------------
+static uint32_t API_capture_server_addr(struct EVS_ev_pgsql_t *this_pgsql)
+{
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_pgsql->db_info;
+	struct EVS_host_t               *this_host = NULL;
+
+	if (db_info != NULL && this_pgsql->host_index >= 0 && this_pgsql->host_index < db_info->host_num)
+	{
+		this_host = db_info->host_list[this_pgsql->host_index];
+	}
+	if (this_host != NULL && this_host->probe_addrlen > 0 && this_host->probe_addr.ss_family == AF_INET)
+	{
+		return ((struct sockaddr_in *)&this_host->probe_addr)->sin_addr.s_addr;
+	}
+	// ホスト毎に違うアドレスにする
+	return API_capture_addr((this_host != NULL) ? this_host->hostname : NULL, 0x00FFFFFE - this_pgsql->host_index);
+}
+
+// --------------------------------
+// キャプチャ開始処理 ※クライアントにPostgreSQLとの接続を割り当てた時に呼ばれる
+// --------------------------------
+// 対象のセッションなら、擬似的な3ウェイハンドシェイクと、受信済みのStartupMessage(recv_buf)を出力する
+// (トランザクション単位のプールで割り当てる度に呼ばれても、最初に割り当てた接続でだけ開始する)
+void API_capture_start(struct EVS_ev_client_t *this_client)
+{
+	struct EVS_session_t            *this_session = (struct EVS_session_t *)this_client->session_info;
+	struct EVS_ev_pgsql_t           *this_pgsql = this_client->pgsql_info;
+	struct EVS_capture_t            *this_capture;
+
+	// キャプチャしない設定か、キャプチャファイルが開けなかったなら
+	if (EVS_config.capture_file == NULL || EVS_config.capture_sample <= 0 || EVS_capture_failed == 1)
+	{
+		return;
+	}
+	// セッション別解析情報がないか、サンプリングの対象外か、もう開始しているなら
+	if (this_session == NULL || this_pgsql == NULL || (this_session->session_id % EVS_config.capture_sample) != 0 || this_session->capture.capture_flag == 1)
+	{
+		return;
+	}
+
+	this_capture = &this_session->capture;
+	this_capture->addr[0] = API_capture_addr(this_client->addr_str, this_session->session_id);
+	this_capture->addr[1] = API_capture_server_addr(this_pgsql);
+	this_capture->port[0] = 32768 + (this_session->session_id % 28232);         // クライアント側は、セッションIDで一時ポートの範囲に散らす
+	this_capture->port[1] = CAPTURE_PGSQL_PORT;
+	this_capture->seq[0] = 0x10000000;
+	this_capture->seq[1] = 0x20000000;
+	this_capture->capture_flag = 1;
+
+	API_capture_packet(this_capture, 1, TCP_FLAG_SYN, NULL, 0);
+	API_capture_packet(this_capture, 0, TCP_FLAG_SYN | TCP_FLAG_ACK, NULL, 0);
+	API_capture_packet(this_capture, 1, TCP_FLAG_ACK, NULL, 0);
+	API_capture_data(this_client, 1, this_client->recv_buf, this_client->recv_len);
+}
+
+// --------------------------------
+// キャプチャデータ出力処理 ※中継したデータ(SSLなら復号後)をそのまま渡す
+// --------------------------------
+void API_capture_data(struct EVS_ev_client_t *this_client, int from_client, const char *data_ptr, unsigned int data_len)
+{
+	struct EVS_session_t            *this_session = (struct EVS_session_t *)this_client->session_info;
+	unsigned int                    segment_len;
+
+	// キャプチャ対象のセッションでないなら
+	if (this_session == NULL || this_session->capture.capture_flag == 0)
+	{
+		return;
+	}
+
+	// 一パケットに入る長さずつ
+	while (data_len > 0)
+	{
+		segment_len = (data_len > CAPTURE_SEGMENT_LENGTH) ? CAPTURE_SEGMENT_LENGTH : data_len;
+		API_capture_packet(&this_session->capture, from_client, TCP_FLAG_PSH | TCP_FLAG_ACK, data_ptr, segment_len);
+		data_ptr += segment_len;
+		data_len -= segment_len;
+	}
+}
+
+// --------------------------------
+// キャプチャ終了処理 ※クライアントとの接続を閉じる時に呼ばれる(擬似的なFINを出力する)
+// --------------------------------
+void API_capture_close(struct EVS_ev_client_t *this_client)
+{
+	struct EVS_session_t            *this_session = (struct EVS_session_t *)this_client->session_info;
+
+	if (this_session == NULL || this_session->capture.capture_flag == 0)
+	{
+		return;
+	}
+
+	API_capture_packet(&this_session->capture, 1, TCP_FLAG_FIN | TCP_FLAG_ACK, NULL, 0);
+	API_capture_packet(&this_session->capture, 0, TCP_FLAG_FIN | TCP_FLAG_ACK, NULL, 0);
+	API_capture_packet(&this_session->capture, 1, TCP_FLAG_ACK, NULL, 0);
+	this_session->capture.capture_flag = 0;
+}
+
+// --------------------------------
+// キャプチャファイル終了処理 ※プログラム終了時に呼ばれる
+// --------------------------------
+void API_capture_end(void)
+{
+	API_capture_finish();
+}
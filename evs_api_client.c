@@ -62,12 +62,10 @@ int API_pgsql_client_send(struct EVS_ev_client_t *this_client, unsigned char *me
 		// 送信したバイト数が負(<0)だったら(エラーです)
 		if (api_result < 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): send(): Cannot send message? errno=%d (%s)\n", __func__, this_client->socket_fd, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): send(): Cannot send message? errno=%d (%s)\n", __func__, this_client->socket_fd, errno, strerror(errno));
 			return api_result;
 		}
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): send(): OK. length=%d\n", __func__, this_client->socket_fd, message_len);
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): send(): OK. length=%d\n", __func__, this_client->socket_fd, message_len);
 	}
 	// ----------------
 	// SSLハンドシェイク中なら
@@ -88,12 +86,10 @@ int API_pgsql_client_send(struct EVS_ev_client_t *this_client, unsigned char *me
 		// 送信したバイト数が負(<0)だったら(エラーです)
 		if (api_result < 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): SSL_write(): Cannot write encrypted message!?\n", __func__, this_client->socket_fd, ERR_reason_error_string(ERR_get_error()));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): SSL_write(): Cannot write encrypted message!?\n", __func__, this_client->socket_fd, ERR_reason_error_string(ERR_get_error()));
 			return api_result;
 		}
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): SSL_write(): OK. length=%d\n", __func__, this_client->socket_fd, message_len);
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): SSL_write(): OK. length=%d\n", __func__, this_client->socket_fd, message_len);
 	}
 	// 戻る
 	return 0;
@@ -111,26 +107,26 @@ int API_pgsql_client_decodestartmessage(char *param_ptr, int param_len, char *pa
 
 	char                            separator_data[] = {'\0'};
 	
-	struct EVS_value_t              result_list[10];                    // 設定値とその長さの構造体
+	struct EVS_value_t              result_list[32];                    // 設定値とその長さの構造体
 	int                             list_num;
+	char                            *param_end = param_buf + MAX_STRING_LENGTH;  // 各種設定値用バッファの終わり
 
 	// 各種設定値バッファがNULLだったり、長さが無ければ
 	if (param_ptr == NULL || param_len <= 0)
 	{
 		// エラー
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): param_ptr is NULL!? (param_len=%d)\n", __func__, param_len);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): param_ptr is NULL!? (param_len=%d)\n", __func__, param_len);
 		return -1;
 	}
 
-	// データ分割処理で、各種設定値をセパレータ(\0)で分離する(最大10個まで)
-	api_result = memmemlist(param_ptr, param_len, separator_data, sizeof(separator_data), sizeof(result_list), result_list);
+	// データ分割処理で、各種設定値をセパレータ(\0)で分離する(最大31個まで、memmemlist()は最後の残りも格納するので、一つ空けておく)
+	api_result = memmemlist(param_ptr, param_len, separator_data, sizeof(separator_data), sizeof(result_list) / sizeof(result_list[0]) - 1, result_list);
 
 	// 各種設定値の中から、必要なものを格納する
 	for (list_num = 0; list_num < api_result; list_num += 2)
 	{
-		// 設定値名があるなら
-		if (result_list[list_num].value_ptr && result_list[list_num].value_len)
+		// 設定値名と設定値があるなら
+		if (result_list[list_num].value_ptr && result_list[list_num].value_len && list_num + 1 < api_result)
 		{
 			// ----------------
 			// クライアントからの開始メッセージの各種設定値をスキャンして、該当する設定値名があれば、それをparam_bufにコピーするとともに、param_infoにそのポインタを設定する
@@ -140,12 +136,17 @@ int API_pgsql_client_decodestartmessage(char *param_ptr, int param_len, char *pa
 				// 対象変数名が設定値名と合致すれば
 				if (strncasecmp(result_list[list_num].value_ptr, PgSQL_client_param_list[param_nun], result_list[list_num].value_len) == 0)
 				{
+					// 各種設定値用バッファに収まらないなら(optionsなどは長いことがある)
+					if (param_buf + result_list[list_num + 1].value_len + 1 > param_end)
+					{
+						LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(): StartupMessage %s is too long, ignored.\n", __func__, PgSQL_client_param_list[param_nun]);
+						break;
+					}
 					// 設定値を各種設定値用バッファにコピー
 					param_info[param_nun] = strncpy(param_buf, result_list[list_num + 1].value_ptr, result_list[list_num + 1].value_len);
 					// 各種設定値用バッファポインタをずらす
 					param_buf += strlen(param_info[param_nun]) + 1;
-					snprintf(log_str, MAX_LOG_LENGTH, "%s(): StartupMessage %s=%s\n", __func__, PgSQL_client_param_list[param_nun], param_info[param_nun]);
-					logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+					LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): StartupMessage %s=%s\n", __func__, PgSQL_client_param_list[param_nun], param_info[param_nun]);
 					// for()を抜ける
 					break;
 				}
@@ -153,8 +154,7 @@ int API_pgsql_client_decodestartmessage(char *param_ptr, int param_len, char *pa
 			// PgSQL_client_param_list[]に予め定義されている設定値名がない場合には
 			if (param_nun == CLIENT_PARAM_END)
 			{
-				snprintf(log_str, MAX_LOG_LENGTH, "%s(): StartupMessage %s=%s\n", __func__, result_list[list_num].value_ptr, result_list[list_num + 1].value_ptr);
-				logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+				LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): StartupMessage %s=%s\n", __func__, result_list[list_num].value_ptr, result_list[list_num + 1].value_ptr);
 			}
 		}
 	}
@@ -171,52 +171,25 @@ int API_pgsql_client_message(struct EVS_ev_message_t *message_info)
 	int                             api_result = 0;
 	char                            log_str[MAX_LOG_LENGTH];
 
-	char                            *message_ptr = message_info->message_ptr;
+	struct EVS_pgmsg_t              pgmsg;                              // PostgreSQLメッセージ解析用構造体
+	struct EVS_session_t            *this_session = (struct EVS_session_t *)message_info->session_info;
 
-	unsigned char                   message_type = 0;
-	unsigned int                    message_len = 0;
-
-	unsigned char                   *target_ptr;
-
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): START! message_len=%d, client_status=%d\n", __func__, message_info->client_socket_fd, message_info->message_len, message_info->client_status);
-	logging(LOG_DIRECT, LOGLEVEL_DEBUG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_DIRECT, LOGLEVEL_DEBUG, &(message_info->message_tv), log_str, "%s(fd=%d): START! message_len=%d, client_status=%d\n", __func__, message_info->client_socket_fd, message_info->message_len, message_info->client_status);
 
 	// ダンプ出力
-	dump2log(LOG_DIRECT, LOGLEVEL_DUMP, &(message_info->message_tv), (void *)message_info->message_ptr, message_info->message_len & 0x3FF);
+	dump2log(LOG_DIRECT, LOGLEVEL_DUMP, &(message_info->message_tv), (void *)message_info->message_ptr, message_info->message_len);
 
-	// ------------------------------------
-	// ★ここでクライアント側から来たクエリ(簡易問い合わせ)の解析をすべきか？
-	// ------------------------------------
-	// メッセージタイプを取得
-	message_type = message_ptr[0];
-	// メッセージ長を取得(int32)
-	target_ptr = (unsigned char *)&message_len;
-	*target_ptr =  message_ptr[4];
-	target_ptr ++;
-	*target_ptr =  message_ptr[3];
-	target_ptr ++;
-	*target_ptr =  message_ptr[2];
-	target_ptr ++;
-	*target_ptr =  message_ptr[1];
-
-	// メッセージタイプ別処理分岐
-	switch (message_type)
-	{
-		case 'Q':                                               // 0x51 : Q ... 簡易問い合わせ(F)
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "Client %s -> %s. (message size=%d, len=0x%02x, data:\"%s\")\n", message_info->client_addr_str, PgSQL_message_front_str[message_type], 1 + message_len, message_len, message_ptr + 5);
-			logging(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-			break;
-		case 'X':                                               // 0x58 : X ... 終了(F)
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "Client %s -> %s. (message size=%d, len=0x%02x)\n", message_info->client_addr_str, PgSQL_message_front_str[message_type], 1 + message_len, message_len);
-			logging(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-			break;
-		default:
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Type:%s, Message size=%d Length=%0d, Data=%s Value:...\n", __func__, message_info->client_socket_fd, PgSQL_message_front_str[message_type], 1 + message_len, message_len, message_ptr + 5);
-			logging(LOG_DIRECT, LOGLEVEL_DEBUG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-			break;
-	}
+	// セッション別クライアント問い合わせ開始処理(トランザクション中のアイドル時間の計算)
+	API_session_activity(message_info);
+
+	// 受信データ内の全メッセージのデコード処理(Query/Parseのフィンガープリントもここで設定される)
+	memset(&pgmsg, 0, sizeof(pgmsg));
+	pgmsg.from_client = 1;
+	pgmsg.log_type = LOG_DIRECT;
+	pgmsg.log_tv = &(message_info->message_tv);
+	pgmsg.addr_str = message_info->client_addr_str;
+	pgmsg.session_info = this_session;
+	api_result = API_pgsql_decode_stream(&pgmsg, (this_session != NULL) ? &this_session->stream[0] : NULL, message_info->message_ptr, message_info->message_len);
 
 	// 戻る
 	return api_result;
@@ -231,7 +204,6 @@ int API_pgsql_client_query(struct EVS_ev_client_t *this_client)
 	char                            log_str[MAX_LOG_LENGTH];
 
 	struct EVS_ev_pgsql_t           *this_pgsql = this_client->pgsql_info;
-	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_pgsql->db_info;
 
 	char                            *message_ptr = this_client->recv_buf;
 	unsigned int                    message_len = 0;
@@ -241,13 +213,38 @@ int API_pgsql_client_query(struct EVS_ev_client_t *this_client)
 	// ------------------------------------
 	struct EVS_ev_message_t         *message_info;                      // メッセージ用構造体ポインタ
 
+	// PostgreSQLとの接続がもう閉じられているなら
+	if (this_pgsql == NULL)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): PostgreSQL connection already closed!?\n", __func__, this_client->socket_fd);
+		return -1;
+	}
+
+	// クライアントから送られてきたクエリメッセージを、そのまま接続先のPostgreSQLに対して送信する(プールする接続へのTerminateは送らない)
+	if (API_pool_sent(this_pgsql, this_client->recv_buf, this_client->recv_len) == 0)
+	{
+		api_result = API_pgsql_server_send(this_pgsql, this_client->recv_buf, this_client->recv_len);
+		// 接続先ホスト問い合わせ開始処理(応答が返ってくるメッセージなら、応答待ちの問い合わせ数と、応答時間を計る)
+		API_balance_request(this_pgsql, this_client->recv_buf, this_client->recv_len);
+	}
+	// キャプチャデータ出力処理(COPY中継処理で受信データが詰められる前に)
+	API_capture_data(this_client, 1, this_client->recv_buf, this_client->recv_len);
+
+	// COPY中継処理(CopyDataは数えるだけにして、受信データから取り除く)
+	message_len = API_copy_relay(this_client, 1, this_client->recv_buf, this_client->recv_len);
+	// キューに入れるメッセージが残っていないなら(COPY中のCopyDataだけだったなら)
+	if (message_len == 0)
+	{
+		// 戻る
+		return api_result;
+	}
+
 	// メッセージ用構造体ポインタのメモリ領域を確保
 	message_info = (struct EVS_ev_message_t *)calloc(1, sizeof(struct EVS_ev_message_t));
 	// メモリ領域が確保できなかったら
 	if (message_info == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Cannot calloc message_info's memory? errno=%d (%s)\n", __func__, this_client->socket_fd, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): Cannot calloc message_info's memory? errno=%d (%s)\n", __func__, this_client->socket_fd, errno, strerror(errno));
 		return -1;
 	}
 
@@ -262,32 +259,28 @@ int API_pgsql_client_query(struct EVS_ev_client_t *this_client)
 	message_info->pgsql_status = this_pgsql->pgsql_status;              // PostgreSQL毎の状態
 	message_info->pgsql_ssl_status = this_pgsql->ssl_status;            // PostgreSQL毎のSSL接続状態
 	strcpy(message_info->pgsql_addr_str, this_pgsql->addr_str);         // PostgreSQLのアドレス文字列
+	message_info->session_info = this_client->session_info;             // セッション別解析情報
 
 	gettimeofday(&message_info->message_tv, NULL);                      // 現在時刻を取得してmessage_info->message_tvに格納
 
-	// 受信したデータ分だけメモリ確保
-	message_info->message_ptr = malloc(this_client->recv_len);
+	// 受信したデータ(から取り除いた残り)の分だけメモリ確保
+	message_info->message_ptr = malloc(message_len);
 	// メモリ領域が確保できなかったら
 	if (message_info->message_ptr == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Cannot calloc message_info->message_ptr's memory? errno=%d (%s)\n", __func__, this_client->socket_fd, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): Cannot calloc message_info->message_ptr's memory? errno=%d (%s)\n", __func__, this_client->socket_fd, errno, strerror(errno));
 		return -1;
 	}
 	// 受信したデータをコピー
-	memcpy(message_info->message_ptr, this_client->recv_buf, this_client->recv_len);
-	message_info->message_len = this_client->recv_len;
+	memcpy(message_info->message_ptr, this_client->recv_buf, message_len);
+	message_info->message_len = message_len;
 
 	// --------------------------------
 	// テールキュー処理
 	// --------------------------------
 	// テールキューの最後にこの接続の情報を追加する
-	TAILQ_INSERT_TAIL(&EVS_message_tailq, message_info, entries);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INSERT_TAIL(message): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
-
-	// クライアントから送られてきたクエリメッセージを、そのまま接続先のPostgreSQLに対して送信する
-	api_result = API_pgsql_server_send(this_pgsql, this_client->recv_buf, this_client->recv_len);
+	API_spool_insert(message_info);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): TAILQ_INSERT_TAIL(message): OK.\n", __func__);
 
 	// 戻る
 	return api_result;
@@ -305,34 +298,42 @@ int API_pgsql_client_start(struct EVS_ev_client_t *this_client)
 	unsigned short int              major_version_num = 0;
 	unsigned short int              minor_version_num = 0;
 
-	char                            *target_ptr;
-
 	const char                      *ssl_ok_message[] = {"N", "S"};
 
 	// ダンプ出力
-	dump2log(LOG_QUEUEING, LOGLEVEL_DUMP, NULL, (void *)this_client->recv_buf, this_client->recv_len & 0x3FF);
+	dump2log(LOG_QUEUEING, LOGLEVEL_DUMP, NULL, (void *)this_client->recv_buf, this_client->recv_len);
 
+	// 開始メッセージは、少なくともメッセージ長(int32)とプロトコルバージョン(int32)の8バイトはあるはず
+	if (this_client->recv_len < 8)
+	{
+		// エラー
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): StartupMessage too short!? (recv_len=%0d)\n", __func__, this_client->socket_fd, this_client->recv_len);
+		// 戻る
+		return -1;
+	}
 	// 最初の4バイトからメッセージ長を取得
-	target_ptr = (char *)&message_len;
-	*target_ptr =  this_client->recv_buf[3];
-	target_ptr ++;
-	*target_ptr =  this_client->recv_buf[2];
-	target_ptr ++;
-	*target_ptr =  this_client->recv_buf[1];
-	target_ptr ++;
-	*target_ptr =  this_client->recv_buf[0];
+	message_len = API_pgsql_get_int32(this_client->recv_buf);
 
 	// 受信メッセージの長さが、メッセージ長と異なるなら
 	if (message_len != this_client->recv_len)
 	{
 		// エラー
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): StartupMessage length ERROR!? (message_len=%0d != recv_len=%0d)\n", __func__, this_client->socket_fd, message_len, this_client->recv_len);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): StartupMessage length ERROR!? (message_len=%0d != recv_len=%0d)\n", __func__, this_client->socket_fd, message_len, this_client->recv_len);
 		// 戻る
 		return -1;
 	}
 	// 上記以外は少なくとも開始メッセージとして処理すべき
 
+	// メッセージ長が16で、そのあとの4バイトが固定値(0x04, 0xd2, 0x16, 0x2e(= 1234, 5678))なら、CancelRequest
+	if (message_len == 16 && API_pgsql_get_int32(this_client->recv_buf + 4) == CANCEL_REQUEST_CODE)
+	{
+		// 標準ログに出力
+		LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "Client %s -> CancelRequest. (message size=%d, len=0x%02x)\n", this_client->addr_str, message_len, message_len);
+		// CancelRequest転送処理(クライアントに割り当てている接続のPostgreSQLに、その接続のキーで送る)
+		API_cancel_request(this_client);
+		// 戻る(PostgreSQLと同じく、何も返さずに切断する)
+		return -1;
+	}
 	// メッセージ長が0x00000008なら、そのあとの4バイトが固定値(0x04, 0xd2, 0x16, 0x2f(= 1234, 5678))なら、SSL接続リクエスト。それ以外は通常の開始メッセージ(のはず)
 	if (message_len == 0x08)
 	{
@@ -343,8 +344,7 @@ int API_pgsql_client_start(struct EVS_ev_client_t *this_client)
 			this_client->recv_buf[7] == (char)0x2f)
 		{
 			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "Client %s -> SSLRequest. (message size=%d, len=0x%02x)\n", this_client->addr_str, message_len, message_len);
-			logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "Client %s -> SSLRequest. (message size=%d, len=0x%02x)\n", this_client->addr_str, message_len, message_len);
 
 			// ここで"SSLOK"を送信
 			// ----------------
@@ -354,16 +354,14 @@ int API_pgsql_client_start(struct EVS_ev_client_t *this_client)
 			// 送信したバイト数が負(<0)だったら(エラーです)
 			if (api_result < 0)
 			{
-				snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): send(): Cannot send message? errno=%d (%s)\n", __func__, this_client->socket_fd, errno, strerror(errno));
-				logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+				LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): send(): Cannot send message? errno=%d (%s)\n", __func__, this_client->socket_fd, errno, strerror(errno));
 				return api_result;
 			}
 
 			// ダンプ出力(メッセージタイプの1+を忘れずに)
 			dump2log(LOG_QUEUEING, LOGLEVEL_DUMP, NULL, (void *)ssl_ok_message[this_client->ssl_support], 1);
 
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): send(%s): OK.\n", __func__, this_client->socket_fd, ssl_ok_message[this_client->ssl_support]);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): send(%s): OK.\n", __func__, this_client->socket_fd, ssl_ok_message[this_client->ssl_support]);
 
 			// クライアントが接続してきたポートがSSLに対応しているなら
 			if (this_client->ssl_support == 1)
@@ -372,21 +370,18 @@ int API_pgsql_client_start(struct EVS_ev_client_t *this_client)
 				// SSL接続情報生成＆ファイルディスクリプタ紐づけ
 				// --------------------------------
 				CB_accept_SSL(this_client);
-				snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): this_client->ssl_status %d -> 1!!\n", __func__, this_client->socket_fd, this_client->ssl_status);
-				logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+				LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): this_client->ssl_status %d -> 1!!\n", __func__, this_client->socket_fd, this_client->ssl_status);
 				// SSLハンドシェイク前(=1)に設定
 				this_client->ssl_status = 1;
 				// 標準ログに出力
-				snprintf(log_str, MAX_LOG_LENGTH, "PgAnalyzer -> Client(%s), SSL supported (message size=1 len=0x01)\n", this_client->addr_str);
-				logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
+				LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "PgAnalyzer -> Client(%s), SSL supported (message size=1 len=0x01)\n", this_client->addr_str);
 				// 戻る(SSLハンドシェイク開始)
 				return 0;
 			}
 			else
 			{
 				// 標準ログに出力
-				snprintf(log_str, MAX_LOG_LENGTH, "PgAnalyzer -> Client(%s), No SSL support (message size=1 len=0x01)\n", this_client->addr_str);
-				logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
+				LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "PgAnalyzer -> Client(%s), No SSL support (message size=1 len=0x01)\n", this_client->addr_str);
 				// 戻る(通常のStartupMessageを待つ)
 				return 0;
 			}       
@@ -395,8 +390,7 @@ int API_pgsql_client_start(struct EVS_ev_client_t *this_client)
 		else
 		{
 			// エラー
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): SSLRequest ERROR!?\n", __func__, this_client->socket_fd);
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): SSLRequest ERROR!?\n", __func__, this_client->socket_fd);
 			// 戻る
 			return -1;    
 		}
@@ -404,28 +398,18 @@ int API_pgsql_client_start(struct EVS_ev_client_t *this_client)
 	// それ以外は通常の開始メッセージ(のはず)
 	else
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): this_client->client_status %d -> 1!!\n", __func__, this_client->socket_fd, this_client->client_status);
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): this_client->client_status %d -> 1!!\n", __func__, this_client->socket_fd, this_client->client_status);
 		// クライアント毎の状態を、1:開始メッセージ応答待ちに設定
 		this_client->client_status = 1;
 		// 標準ログに出力
-		snprintf(log_str, MAX_LOG_LENGTH, "Client %s -> StartupMessage. (message size=%d, len=0x%02x)\n", this_client->addr_str, message_len, message_len);
-		logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "Client %s -> StartupMessage. (message size=%d, len=0x%02x)\n", this_client->addr_str, message_len, message_len);
 	}
 
 	// メジャーバージョンとマイナーバージョンを取得
-	target_ptr = (unsigned char *)&major_version_num;
-	*target_ptr =  this_client->recv_buf[5];
-	target_ptr ++;
-	*target_ptr =  this_client->recv_buf[4];
+	major_version_num = API_pgsql_get_int16(this_client->recv_buf + 4);
+	minor_version_num = API_pgsql_get_int16(this_client->recv_buf + 6);
 
-	target_ptr = (unsigned char *)&minor_version_num;
-	*target_ptr =  this_client->recv_buf[7];
-	target_ptr ++;
-	*target_ptr =  this_client->recv_buf[6];
-
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): major_version_num=0x%02hx(=%0d), minor_version_num=0x%02hx(=%0d)\n", __func__, this_client->socket_fd, major_version_num, major_version_num, minor_version_num, minor_version_num);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): major_version_num=0x%02hx(=%0d), minor_version_num=0x%02hx(=%0d)\n", __func__, this_client->socket_fd, major_version_num, major_version_num, minor_version_num, minor_version_num);
 
 	// その他、各種パラメータ取得して、接続してきたユーザー名と接続先のDB名を取得すること。
 	// これらが判れば、どこのサーバーにアクセスすればいいかは設定から判るはず。
@@ -433,6 +417,14 @@ int API_pgsql_client_start(struct EVS_ev_client_t *this_client)
 
 	// クライアントからの開始メッセージの各種設定値を解析してparam_bufにコピーするとともに、param_infoにそのポインタを設定する)
 	API_pgsql_client_decodestartmessage(this_client->recv_buf + 8, this_client->recv_len - 8, this_client->param_buf, this_client->param_info);
+	// セッション別解析情報生成処理
+	api_result = API_session_start(this_client);
+	// 正常終了でないなら
+	if (api_result != 0)
+	{
+		// 戻る
+		return api_result;
+	}
 	// クライアントから送られてきた開始メッセージに基づいて、予め設定ファイルで指定されたPostgreSQLに対して接続を開始する(クエリ以外は来ないはず)
 	api_result = API_pgsql_server_start(this_client);
 	// 正常終了でないなら
@@ -444,6 +436,12 @@ int API_pgsql_client_start(struct EVS_ev_client_t *this_client)
 
 	// PgAnalyzer自身がPostgreSQLとの接続を確立するまでは、クライアントからのメッセージは送ってはならない
 
+	// プールの接続が割り当てられた(2:クエリメッセージ待ちになった)なら、PostgreSQLの代わりに開始メッセージレスポンスを送る
+	if (this_client->client_status == 2)
+	{
+		api_result = API_pool_welcome(this_client);
+	}
+
 	// 戻る
 	return api_result;
 }
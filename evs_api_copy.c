@@ -0,0 +1,360 @@
+// ----------------------------------------------------------------------
+// Protocol Analyzer for PostgreSQL -
+// Purpose:
+//     COPY streaming relay processing.
+//
+// Program:
+//     Takeshi Kaburagi/MyDNS.JP    https://www.fvg-on.net/
+//
+// Usage:
+//     ./evs_pganalyzer [./evserver.ini]
+// ----------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------
+// ヘッダ部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// インクルード宣言
+// --------------------------------
+
+// --------------------------------
+// 定数宣言
+// --------------------------------
+
+// --------------------------------
+// 型宣言
+// --------------------------------
+
+// --------------------------------
+// 変数宣言
+// --------------------------------
+
+// ----------------------------------------------------------------------
+// コード部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// COPYについて
+// --------------------------------
+// COPY FROM STDIN / COPY TO STDOUT が始まると、CopyData(d)が64KB単位などで大量に流れてくる。
+// これを透過モードの他のメッセージと同じようにキューに入れてダンプまですると、中継よりも解析の方が重くなるので、
+// 受信時にメッセージの境界だけを追いかけて、CopyDataは数えるだけにしてキューに入れる受信データからは取り除く。
+// (CopyData以外のメッセージはそのまま残すので、キューの解析処理から見たメッセージの並びは変わらない)
+// COPYが終わったら(CopyDone/CopyFailに対するCommandComplete/ErrorResponseで)、バイト数やスループットを一回だけ出力する。
+//
+//      52.2.5. COPY操作                                                        https://www.postgresql.jp/document/12/html/protocol-flow.html#PROTOCOL-COPY
+// --------------------------------
+// COPY結果出力処理
+// --------------------------------
+static void API_copy_log(struct EVS_ev_client_t *this_client, struct EVS_session_t *this_session, int log_level, const char *result_str, long row_count)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	struct EVS_relay_t              *this_relay = &this_session->relay;
+	struct timeval                  now_tv;                             // 現在の日時
+	double                          copy_time;                          // COPYを開始してからの経過時間(秒)
+	char                            row_str[32];                        // 行数の文字列(不明なら"-")
+
+	gettimeofday(&now_tv, NULL);
+	copy_time = API_stats_difftime(&now_tv, &this_relay->copy_start_tv);
+
+	if (row_count >= 0)
+	{
+		snprintf(row_str, sizeof(row_str), "%ld", row_count);
+	}
+	else
+	{
+		strcpy(row_str, "-");
+	}
+
+	LOGGING(LOG_QUEUEING, log_level, NULL, log_str, "Copy: %s. (client=%s, database=%s, user=%s, direction=%s, bytes=%llu, chunks=%lu, rows=%s, duration=%.6f, throughput=%.3fMB/s)\n",
+		result_str, this_client->addr_str, this_session->database, this_session->username,
+		(this_relay->copy_status == 'G') ? "in" : (this_relay->copy_status == 'H') ? "out" : "both",
+		this_relay->copy_bytes, this_relay->copy_chunks, row_str, copy_time,
+		(copy_time > 0.) ? (double)this_relay->copy_bytes / copy_time / 1048576. : 0.);
+}
+
+// --------------------------------
+// COPY状態遷移処理 ※受信時にメッセージヘッダが揃った時に呼ばれる
+// --------------------------------
+// body_ptrは、メッセージ本文がすべて受信データ内にある場合だけ本文の先頭を指す(なければNULL)
+static void API_copy_message(struct EVS_ev_client_t *this_client, struct EVS_session_t *this_session, int from_client, unsigned char message_type, char *body_ptr)
+{
+	struct EVS_relay_t              *this_relay = &this_session->relay;
+	long                            row_count = -1;                     // COPYした行数(CommandCompleteの"COPY n"から取得、不明なら-1)
+
+	// COPY中ではないなら、PostgreSQLからのCopyInResponse/CopyOutResponse/CopyBothResponseだけを見る
+	if (this_relay->copy_status == 0)
+	{
+		if (from_client == 0 && (message_type == 'G' || message_type == 'H' || message_type == 'W'))
+		{
+			this_relay->copy_status = message_type;
+			this_relay->copy_end = 0;
+			this_relay->copy_bytes = 0;
+			this_relay->copy_chunks = 0;
+			this_relay->report_bytes = 0;
+			this_relay->report_time = ev_now(EVS_loop);
+			gettimeofday(&this_relay->copy_start_tv, NULL);
+		}
+		return;
+	}
+
+	switch (message_type)
+	{
+		// CopyData
+		case 'd':
+			this_relay->copy_chunks ++;
+			break;
+		// CopyDone / CopyFail (CopyFailはクライアントからだけ)
+		case 'c':
+		case 'f':
+			this_relay->copy_end = message_type;
+			break;
+		// CommandComplete / ErrorResponse (PostgreSQLから)
+		case 'C':
+		case 'E':
+			if (from_client == 1)
+			{
+				break;
+			}
+			if (message_type == 'C' && body_ptr != NULL && strncmp(body_ptr, "COPY ", 5) == 0)
+			{
+				row_count = strtol(body_ptr + 5, NULL, 10);
+			}
+			// CopyFailを送ったか、ErrorResponseで終わったなら失敗
+			if (message_type == 'E' || this_relay->copy_end == 'f')
+			{
+				API_copy_log(this_client, this_session, LOGLEVEL_WARN, "failed", row_count);
+			}
+			else
+			{
+				API_copy_log(this_client, this_session, LOGLEVEL_LOG, "done", row_count);
+			}
+			this_relay->copy_status = 0;
+			this_relay->copy_end = 0;
+			break;
+	}
+}
+
+// --------------------------------
+// 問い合わせサイクル追跡処理 ※受信時にメッセージの最後まで来た時に呼ばれる
+// --------------------------------
+// クライアントが送ったQuery/Sync/FunctionCallと、PostgreSQLからのReadyForQueryを突き合わせて、応答待ちの数と最後のトランザクション状態を覚えておく
+// (トランザクション単位の接続プールで、PostgreSQLとの接続を返却してよいかの判定に使う)
+static void API_copy_cycle(struct EVS_relay_t *this_relay, int from_client, unsigned char message_type, char last_byte)
+{
+	if (from_client == 1)
+	{
+		if (message_type == 'Q' || message_type == 'S' || message_type == 'F')
+		{
+			this_relay->sync_count ++;
+		}
+		// クライアントから何か来たなら、問い合わせ中
+		this_relay->ready_status = 0;
+	}
+	else if (message_type == 'Z')
+	{
+		if (this_relay->sync_count > 0)
+		{
+			this_relay->sync_count --;
+		}
+		this_relay->ready_status = last_byte;
+	}
+}
+
+// --------------------------------
+// 残すデータの処理(ログサンプリングで保留中なら保留バッファに移し、それ以外は前に詰める。次の書き込み位置を返す)
+// --------------------------------
+static char *API_copy_keep(struct EVS_ev_client_t *this_client, struct EVS_session_t *this_session, int from_client, char *keep_ptr, char *target_ptr, unsigned int keep_len, int *hold_count)
+{
+	// ログサンプリングで保留中なら(受信データ毎の最初は新しいレコードにする。保留できなかったら残す)
+	if (this_session->sample.hold_status == 1 && API_sample_hold(this_client, from_client, target_ptr, keep_len, ((*hold_count) ++ == 0) ? 1 : 0) == 0)
+	{
+		return keep_ptr;
+	}
+	if (keep_ptr != target_ptr)
+	{
+		memmove(keep_ptr, target_ptr, keep_len);
+	}
+	return keep_ptr + keep_len;
+}
+
+// --------------------------------
+// COPY中継処理 ※透過モードで受信したデータを、キューに入れる前に呼び出す
+// --------------------------------
+// 受信データ内のメッセージの境界を追いかけて、CopyDataを数えながら受信データから取り除き(前に詰める)、残った長さを返す。
+// ログサンプリングの対象外のセッションなら、問い合わせサイクルの受信データも保留バッファに移して取り除く(evs_api_sample.cを参照)。
+// 受信データは書き換えるので、相手への送信が終わってから呼ぶこと。
+unsigned int API_copy_relay(struct EVS_ev_client_t *this_client, int from_client, char *buf_ptr, unsigned int buf_len)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	struct EVS_session_t            *this_session = (struct EVS_session_t *)this_client->session_info;
+	struct EVS_relay_t              *this_relay;                        // COPY中継状態構造体ポインタ
+	struct EVS_stream_t             *this_stream;                       // 受信時のメッセージ境界情報
+
+	char                            *target_ptr = buf_ptr;              // 処理中の位置
+	char                            *end_ptr = buf_ptr + buf_len;       // 受信データの終端(の次)
+	char                            *keep_ptr = buf_ptr;                // 残すデータの書き込み位置
+	unsigned int                    chunk_len;                          // 一度に処理する長さ
+	unsigned int                    message_len;                        // メッセージ長(メッセージ長自身の4バイトを含む)
+	int                             hold_count = 0;                     // この受信データで保留バッファに移した回数
+
+	// セッション別解析情報がないか、メッセージの境界を見失っているなら、そのまま全部残す
+	if (this_session == NULL || this_session->relay.relay_lost == 1)
+	{
+		return buf_len;
+	}
+	this_relay = &this_session->relay;
+	this_stream = &this_relay->stream[(from_client == 1) ? 0 : 1];
+
+	// 受信データを処理できる限り、ループ
+	while (target_ptr < end_ptr)
+	{
+		// メッセージ本文の途中なら、本文をまとめて処理する
+		if (this_stream->skip_len > 0)
+		{
+			chunk_len = end_ptr - target_ptr;
+			if (chunk_len > this_stream->skip_len)
+			{
+				chunk_len = this_stream->skip_len;
+			}
+			// CopyDataなら数えるだけ
+			if (this_stream->header_buf[0] == 'd')
+			{
+				this_relay->copy_bytes += chunk_len;
+			}
+			// それ以外なら残す
+			else
+			{
+				keep_ptr = API_copy_keep(this_client, this_session, from_client, keep_ptr, target_ptr, chunk_len, &hold_count);
+			}
+			target_ptr += chunk_len;
+			this_stream->skip_len -= chunk_len;
+			// メッセージの最後まで来たなら
+			if (this_stream->skip_len == 0)
+			{
+				API_copy_cycle(this_relay, from_client, (unsigned char)this_stream->header_buf[0], target_ptr[-1]);
+				if (this_session->sample.sample_flag == 0)
+				{
+					API_sample_end(this_client, this_session, from_client, (unsigned char)this_stream->header_buf[0], target_ptr[-1]);
+				}
+			}
+			continue;
+		}
+
+		// メッセージの先頭なら(ログサンプリングの対象外のセッションだけ)
+		if (this_stream->header_len == 0 && this_session->sample.sample_flag == 0)
+		{
+			API_sample_begin(this_session, from_client, (unsigned char)*target_ptr);
+		}
+		// メッセージヘッダ(メッセージタイプ1バイト＋メッセージ長4バイト)を一バイトずつ集める(受信データの境界で分断されていてもよいように)
+		this_stream->header_buf[this_stream->header_len ++] = *target_ptr;
+		// CopyData以外なら残す(メッセージタイプは先頭の一バイトで判るので、分断されていても残すかどうかは決められる)
+		if (this_stream->header_buf[0] != 'd')
+		{
+			keep_ptr = API_copy_keep(this_client, this_session, from_client, keep_ptr, target_ptr, 1, &hold_count);
+		}
+		target_ptr ++;
+		// まだヘッダが揃わないなら
+		if (this_stream->header_len < 5)
+		{
+			continue;
+		}
+		this_stream->header_len = 0;
+
+		message_len = API_pgsql_get_int32(this_stream->header_buf + 1);
+		// メッセージ長がおかしいなら(メッセージの境界を見失ったので、以降は取り除かずに全部残す)
+		if (message_len < 4)
+		{
+			LOGGING(LOG_QUEUEING, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): Illegal message length!? (type=0x%02x, len=0x%02x)\n", __func__, this_client->socket_fd, (unsigned char)this_stream->header_buf[0], message_len);
+			this_relay->relay_lost = 1;
+			this_relay->copy_status = 0;
+			// ログサンプリングで保留していたなら、キューに入れる(このセッションは以降全部解析する)
+			API_sample_lost(this_client, this_session);
+			chunk_len = end_ptr - target_ptr;
+			if (keep_ptr != target_ptr)
+			{
+				memmove(keep_ptr, target_ptr, chunk_len);
+			}
+			keep_ptr += chunk_len;
+			break;
+		}
+		this_stream->skip_len = message_len - 4;
+
+		// COPY状態遷移処理(本文がすべて受信データ内にあるなら、本文の先頭も渡す)
+		API_copy_message(this_client, this_session, from_client, (unsigned char)this_stream->header_buf[0], (this_stream->skip_len <= (unsigned int)(end_ptr - target_ptr)) ? target_ptr : NULL);
+		// 本文がないメッセージなら、ここで最後
+		if (this_stream->skip_len == 0)
+		{
+			API_copy_cycle(this_relay, from_client, (unsigned char)this_stream->header_buf[0], this_stream->header_buf[4]);
+			if (this_session->sample.sample_flag == 0)
+			{
+				API_sample_end(this_client, this_session, from_client, (unsigned char)this_stream->header_buf[0], this_stream->header_buf[4]);
+			}
+		}
+	}
+
+	// 残った長さを返す
+	return keep_ptr - buf_ptr;
+}
+
+// --------------------------------
+// COPY中継終了処理 ※クライアント接続終了時に呼ばれる
+// --------------------------------
+// COPYの途中で接続が切れたなら、そこまでの結果を出力する
+void API_copy_close(struct EVS_ev_client_t *this_client)
+{
+	struct EVS_session_t            *this_session = (struct EVS_session_t *)this_client->session_info;
+
+	if (this_session != NULL && this_session->relay.copy_status != 0)
+	{
+		API_copy_log(this_client, this_session, LOGLEVEL_WARN, "aborted", -1);
+		this_session->relay.copy_status = 0;
+	}
+}
+
+// --------------------------------
+// COPY途中経過出力処理 ※タイマーイベントから呼ばれる
+// --------------------------------
+// 長時間のCOPYは終わるまで何も出力されないので、出力間隔毎にバイト数と直近の間隔のスループットを出力する
+void API_copy_check(ev_tstamp nowtime)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	struct EVS_ev_client_t          *client_watcher;                    // クライアント別設定用構造体ポインタ
+	struct EVS_session_t            *this_session;                      // セッション別解析情報構造体ポインタ
+	struct EVS_relay_t              *this_relay;                        // COPY中継状態構造体ポインタ
+	double                          interval_time;                      // 直前に途中経過を出力してからの経過時間(秒)
+
+	// 途中経過を出力しない設定なら
+	if (EVS_config.copystat_intval <= 0.)
+	{
+		return;
+	}
+
+	// クライアント用テールキューからクライアント情報を取得して全て確認
+	TAILQ_FOREACH (client_watcher, &EVS_client_tailq, entries)
+	{
+		this_session = (struct EVS_session_t *)client_watcher->session_info;
+		// セッション別解析情報がないか、COPY中ではないなら
+		if (this_session == NULL || this_session->relay.copy_status == 0)
+		{
+			continue;
+		}
+		this_relay = &this_session->relay;
+		interval_time = nowtime - this_relay->report_time;
+		// まだ出力間隔を経過していないなら
+		if (interval_time < EVS_config.copystat_intval)
+		{
+			continue;
+		}
+		LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "Copy: progress. (client=%s, database=%s, user=%s, direction=%s, bytes=%llu, chunks=%lu, throughput=%.3fMB/s)\n",
+			client_watcher->addr_str, this_session->database, this_session->username,
+			(this_relay->copy_status == 'G') ? "in" : (this_relay->copy_status == 'H') ? "out" : "both",
+			this_relay->copy_bytes, this_relay->copy_chunks,
+			(double)(this_relay->copy_bytes - this_relay->report_bytes) / interval_time / 1048576.);
+		this_relay->report_time = nowtime;
+		this_relay->report_bytes = this_relay->copy_bytes;
+	}
+}
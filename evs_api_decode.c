@@ -0,0 +1,1044 @@
+// ----------------------------------------------------------------------
+// Protocol Analyzer for PostgreSQL -
+// Purpose:
+//     Message decoder processing.
+//
+// Program:
+//     Takeshi Kaburagi/MyDNS.JP    https://www.fvg-on.net/
+//
+// Usage:
+//     ./evs_pganalyzer [./evserver.ini]
+// ----------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------
+// ヘッダ部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// インクルード宣言
+// --------------------------------
+
+// --------------------------------
+// 定数宣言
+// --------------------------------
+
+// --------------------------------
+// 型宣言
+// --------------------------------
+
+// --------------------------------
+// 変数宣言
+// --------------------------------
+static int API_decode_none(struct EVS_pgmsg_t *);
+static int API_decode_Authentication(struct EVS_pgmsg_t *);
+static int API_decode_BackendKeyData(struct EVS_pgmsg_t *);
+static int API_decode_Bind(struct EVS_pgmsg_t *);
+static int API_decode_Close(struct EVS_pgmsg_t *);
+static int API_decode_CommandComplete(struct EVS_pgmsg_t *);
+static int API_decode_CopyData(struct EVS_pgmsg_t *);
+static int API_decode_CopyFail(struct EVS_pgmsg_t *);
+static int API_decode_CopyResponse(struct EVS_pgmsg_t *);
+static int API_decode_DataRow(struct EVS_pgmsg_t *);
+static int API_decode_EmptyQueryResponse(struct EVS_pgmsg_t *);
+static int API_decode_Describe(struct EVS_pgmsg_t *);
+static int API_decode_ErrorResponse(struct EVS_pgmsg_t *);
+static int API_decode_Execute(struct EVS_pgmsg_t *);
+static int API_decode_FunctionCall(struct EVS_pgmsg_t *);
+static int API_decode_FunctionCallResponse(struct EVS_pgmsg_t *);
+static int API_decode_NegotiateProtocolVersion(struct EVS_pgmsg_t *);
+static int API_decode_NotificationResponse(struct EVS_pgmsg_t *);
+static int API_decode_ParameterDescription(struct EVS_pgmsg_t *);
+static int API_decode_ParameterStatus(struct EVS_pgmsg_t *);
+static int API_decode_Parse(struct EVS_pgmsg_t *);
+static int API_decode_PasswordMessage(struct EVS_pgmsg_t *);
+static int API_decode_PortalSuspended(struct EVS_pgmsg_t *);
+static int API_decode_Query(struct EVS_pgmsg_t *);
+static int API_decode_ReadyForQuery(struct EVS_pgmsg_t *);
+static int API_decode_RowDescription(struct EVS_pgmsg_t *);
+static int API_decode_Sync(struct EVS_pgmsg_t *);
+
+// ----------------
+// メッセージタイプ別デコーダ(メッセージタイプの1バイトを添字にする。名称はPgSQL_message_front_str[]/PgSQL_message_backend_str[]を使う)
+// ----------------
+static const struct EVS_decoder_t  EVS_front_decoder[0x80] = {      // フロントエンド(クライアント)からのメッセージ用
+								['B'] = {API_decode_Bind,                   4 + 2 + 2 + 2 + 2},     // 0x42 : B ... Bindコマンド(F)
+								['C'] = {API_decode_Close,                  4 + 1 + 1},             // 0x43 : C ... Closeコマンド(F)
+								['D'] = {API_decode_Describe,               4 + 1 + 1},             // 0x44 : D ... Describeコマンド(F)
+								['E'] = {API_decode_Execute,                4 + 1 + 4},             // 0x45 : E ... Executeコマンド(F)
+								['F'] = {API_decode_FunctionCall,           4 + 4 + 2 + 2 + 2},     // 0x46 : F ... 関数呼び出し(F)
+								['H'] = {API_decode_none,                   4},                     // 0x48 : H ... Flushコマンド(F)
+								['P'] = {API_decode_Parse,                  4 + 1 + 1 + 2},         // 0x50 : P ... Parseコマンド(F)
+								['Q'] = {API_decode_Query,                  4 + 1},                 // 0x51 : Q ... 簡易問い合わせ(F)
+								['S'] = {API_decode_Sync,                   4},                     // 0x53 : S ... Syncコマンド(F)
+								['X'] = {API_decode_none,                   4},                     // 0x58 : X ... 終了(F)
+								['c'] = {API_decode_none,                   4},                     // 0x63 : c ... COPY完了指示子(F&B)
+								['d'] = {API_decode_CopyData,               4},                     // 0x64 : d ... データのCOPY(F&B)
+								['f'] = {API_decode_CopyFail,               4 + 1},                 // 0x66 : f ... COPY失敗指示子(F)
+								['p'] = {API_decode_PasswordMessage,        4},                     // 0x70 : p ... パスワード応答(F)/SASL応答(F)/GSSAPIまたはSSPI応答(F)
+};
+
+static const struct EVS_decoder_t  EVS_backend_decoder[0x80] = {    // バックエンド(PostgreSQL)からのメッセージ用
+								['1'] = {API_decode_none,                   4},                     // 0x31 : 1 ... Parse完了指示子(B)
+								['2'] = {API_decode_none,                   4},                     // 0x32 : 2 ... Bind完了指示子(B)
+								['3'] = {API_decode_none,                   4},                     // 0x33 : 3 ... Close完了指示子(B)
+								['A'] = {API_decode_NotificationResponse,   4 + 4 + 1 + 1},         // 0x41 : A ... 通知応答(B)
+								['C'] = {API_decode_CommandComplete,        4 + 1},                 // 0x43 : C ... コマンド完了(B)
+								['D'] = {API_decode_DataRow,                4 + 2},                 // 0x44 : D ... データ行(B)
+								['E'] = {API_decode_ErrorResponse,          4 + 1},                 // 0x45 : E ... エラー(B)
+								['G'] = {API_decode_CopyResponse,           4 + 1 + 2},             // 0x47 : G ... Start Copy Inの応答(B)
+								['H'] = {API_decode_CopyResponse,           4 + 1 + 2},             // 0x48 : H ... Start Copy Outの応答(B)
+								['I'] = {API_decode_EmptyQueryResponse,     4},                     // 0x49 : I ... 空の問い合わせ文字列に対する応答(B)
+								['K'] = {API_decode_BackendKeyData,         4 + 4 + 4},             // 0x4B : K ... 取り消しする際のキーデータ(B)
+								['N'] = {API_decode_ErrorResponse,          4 + 1},                 // 0x4E : N ... 警報(B)
+								['R'] = {API_decode_Authentication,         4 + 4},                 // 0x52 : R ... 認証要求(B)
+								['S'] = {API_decode_ParameterStatus,        4 + 1 + 1},             // 0x53 : S ... 実行時パラメータ状態報告(B)
+								['T'] = {API_decode_RowDescription,         4 + 2},                 // 0x54 : T ... 行の記述(B)
+								['V'] = {API_decode_FunctionCallResponse,   4 + 4},                 // 0x56 : V ... 関数呼び出しの結果(B)
+								['W'] = {API_decode_CopyResponse,           4 + 1 + 2},             // 0x57 : W ... Start Copy Bothの応答(B)
+								['Z'] = {API_decode_ReadyForQuery,          4 + 1},                 // 0x5A : Z ... 新しい問い合わせサイクルの準備が整った(B)
+								['c'] = {API_decode_none,                   4},                     // 0x63 : c ... COPY完了指示子(F&B)
+								['d'] = {API_decode_CopyData,               4},                     // 0x64 : d ... データのCOPY(F&B)
+								['n'] = {API_decode_none,                   4},                     // 0x6E : n ... データなしの指示子(B)
+								['s'] = {API_decode_PortalSuspended,        4},                     // 0x73 : s ... ポータル中断指示子(B)
+								['t'] = {API_decode_ParameterDescription,   4 + 2},                 // 0x74 : t ... パラメータ記述(B)
+								['v'] = {API_decode_NegotiateProtocolVersion, 4 + 4 + 4},           // 0x76 : v ... プロトコルバージョン交渉(B)
+};
+
+static const char  *EVS_auth_type_str[] = {                         // Authentication(R)の認証方式名
+								"AuthenticationOk",                                         // 0
+								"",                                                         // 1
+								"AuthenticationKerberosV5",                                 // 2
+								"AuthenticationCleartextPassword",                          // 3
+								"",                                                         // 4
+								"AuthenticationMD5Password",                                // 5
+								"AuthenticationSCMCredential",                              // 6
+								"AuthenticationGSS",                                        // 7
+								"AuthenticationGSSContinue",                                // 8
+								"AuthenticationSSPI",                                       // 9
+								"AuthenticationSASL",                                       // 10
+								"AuthenticationSASLContinue",                               // 11
+								"AuthenticationSASLFinal",                                  // 12
+};
+
+// ----------------------------------------------------------------------
+// コード部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// ビッグエンディアンのint16取得処理 ※呼び出し元で2バイトあることを確認しておくこと
+// --------------------------------
+unsigned short API_pgsql_get_int16(const char *target_ptr)
+{
+	const unsigned char             *byte_ptr = (const unsigned char *)target_ptr;
+
+	return (unsigned short)((byte_ptr[0] << 8) | byte_ptr[1]);
+}
+
+// --------------------------------
+// ビッグエンディアンのint32取得処理 ※呼び出し元で4バイトあることを確認しておくこと
+// --------------------------------
+unsigned int API_pgsql_get_int32(const char *target_ptr)
+{
+	const unsigned char             *byte_ptr = (const unsigned char *)target_ptr;
+
+	return ((unsigned int)byte_ptr[0] << 24) | ((unsigned int)byte_ptr[1] << 16) | ((unsigned int)byte_ptr[2] << 8) | (unsigned int)byte_ptr[3];
+}
+
+// --------------------------------
+// ビッグエンディアンのint32設定処理 ※呼び出し元で4バイトあることを確認しておくこと
+// --------------------------------
+void API_pgsql_set_int32(char *target_ptr, unsigned int value)
+{
+	target_ptr[0] = (char)(value >> 24);
+	target_ptr[1] = (char)(value >> 16);
+	target_ptr[2] = (char)(value >> 8);
+	target_ptr[3] = (char)value;
+}
+
+// --------------------------------
+// メッセージ読み込み処理(int8, int16, int32, \0終端文字列, バイト列) ※メッセージの終端を超えるなら-1を返す
+// --------------------------------
+static inline int API_decode_int8(struct EVS_pgmsg_t *pgmsg, unsigned char *value)
+{
+	if (pgmsg->end_ptr - pgmsg->read_ptr < 1)
+	{
+		return -1;
+	}
+	*value = (unsigned char)*pgmsg->read_ptr;
+	pgmsg->read_ptr += 1;
+	return 0;
+}
+
+static inline int API_decode_int16(struct EVS_pgmsg_t *pgmsg, unsigned short *value)
+{
+	if (pgmsg->end_ptr - pgmsg->read_ptr < 2)
+	{
+		return -1;
+	}
+	*value = API_pgsql_get_int16(pgmsg->read_ptr);
+	pgmsg->read_ptr += 2;
+	return 0;
+}
+
+static inline int API_decode_int32(struct EVS_pgmsg_t *pgmsg, unsigned int *value)
+{
+	if (pgmsg->end_ptr - pgmsg->read_ptr < 4)
+	{
+		return -1;
+	}
+	*value = API_pgsql_get_int32(pgmsg->read_ptr);
+	pgmsg->read_ptr += 4;
+	return 0;
+}
+
+static inline int API_decode_string(struct EVS_pgmsg_t *pgmsg, char **value)
+{
+	char                            *value_end;                         // 文字列の終端(\0)
+
+	value_end = memchr(pgmsg->read_ptr, '\0', pgmsg->end_ptr - pgmsg->read_ptr);
+	if (value_end == NULL)
+	{
+		return -1;
+	}
+	*value = pgmsg->read_ptr;
+	pgmsg->read_ptr = value_end + 1;
+	return 0;
+}
+
+static inline int API_decode_bytes(struct EVS_pgmsg_t *pgmsg, unsigned int value_len, char **value)
+{
+	if ((unsigned long)(pgmsg->end_ptr - pgmsg->read_ptr) < value_len)
+	{
+		return -1;
+	}
+	*value = pgmsg->read_ptr;
+	pgmsg->read_ptr += value_len;
+	return 0;
+}
+
+// --------------------------------
+// 長さ付きの値の列(int16の個数＋(int32の長さ＋バイト列)×個数)の読み込み処理 ※長さ-1はNULL
+// --------------------------------
+static int API_decode_values(struct EVS_pgmsg_t *pgmsg, unsigned short *value_num, unsigned int *data_len, unsigned short *null_num)
+{
+	unsigned short                  list_num;
+	unsigned int                    value_len;
+	char                            *value_ptr;
+
+	*data_len = 0;
+	*null_num = 0;
+	if (API_decode_int16(pgmsg, value_num) != 0)
+	{
+		return -1;
+	}
+	for (list_num = 0; list_num < *value_num; list_num++)
+	{
+		if (API_decode_int32(pgmsg, &value_len) != 0)
+		{
+			return -1;
+		}
+		// 長さが-1ならNULL
+		if (value_len == 0xFFFFFFFF)
+		{
+			(*null_num) ++;
+			continue;
+		}
+		if (API_decode_bytes(pgmsg, value_len, &value_ptr) != 0)
+		{
+			return -1;
+		}
+		*data_len += value_len;
+	}
+	return 0;
+}
+
+// --------------------------------
+// 個数付きの値の列(int16の個数＋固定長の値×個数)の読み込み処理
+// --------------------------------
+static int API_decode_array(struct EVS_pgmsg_t *pgmsg, unsigned int value_size, unsigned short *value_num)
+{
+	char                            *value_ptr;
+
+	if (API_decode_int16(pgmsg, value_num) != 0)
+	{
+		return -1;
+	}
+	return API_decode_bytes(pgmsg, value_size * (*value_num), &value_ptr);
+}
+
+// --------------------------------
+// デコード結果のログ出力処理 ※"PostgreSQL -> 名称. (message size=..., len=..., 詳細)" の形式で出力する
+// --------------------------------
+static void API_decode_log(struct EVS_pgmsg_t *pgmsg, const char *detail_format, ...)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	char                            detail_str[MAX_LOG_LENGTH];         // メッセージタイプ別の詳細
+	va_list                         detail_args;
+	const char                      *name_str = "";                     // メッセージ名称
+	int                             event_result;
+
+	// ログ出力しないなら、詳細の書式化もしない
+	if (!LOGLEVEL_ENABLED(LOGLEVEL_LOG))
+	{
+		return;
+	}
+
+	// メッセージ名称を取得(名称テーブルは0x7Fまで)
+	if (pgmsg->message_type < 0x80)
+	{
+		name_str = (pgmsg->from_client == 1) ? PgSQL_message_front_str[pgmsg->message_type] : PgSQL_message_backend_str[pgmsg->message_type];
+	}
+
+	// バイナリイベントログなら、詳細を文字列にせずに出力する(メッセージ用キューの解析処理からだけ。受信時の解析処理のログはキューを経由するのでテキストのまま)
+	if (EVS_config.log_format == 1 && (pgmsg->log_type == LOG_DIRECT || EVS_log_mode == 0))
+	{
+		va_start(detail_args, detail_format);
+		event_result = event_message(LOGLEVEL_LOG, pgmsg->log_tv, (pgmsg->session_info != NULL) ? pgmsg->session_info->session_id : 0,
+			pgmsg->from_client, pgmsg->message_type, pgmsg->message_len, name_str, detail_format, detail_args);
+		va_end(detail_args);
+		if (event_result == 0)
+		{
+			return;
+		}
+	}
+
+	detail_str[0] = '\0';
+	// 詳細があるなら
+	if (detail_format != NULL)
+	{
+		detail_str[0] = ',';
+		detail_str[1] = ' ';
+		va_start(detail_args, detail_format);
+		vsnprintf(detail_str + 2, sizeof(detail_str) - 2, detail_format, detail_args);
+		va_end(detail_args);
+	}
+
+	// 標準ログに出力
+	if (pgmsg->from_client == 1)
+	{
+		snprintf(log_str, MAX_LOG_LENGTH, "Client %s -> %s. (message size=%d, len=0x%02x%s)\n", pgmsg->addr_str, name_str, 1 + pgmsg->message_len, pgmsg->message_len, detail_str);
+	}
+	else
+	{
+		snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> %s. (message size=%d, len=0x%02x%s)\n", name_str, 1 + pgmsg->message_len, pgmsg->message_len, detail_str);
+	}
+	logging(pgmsg->log_type, LOGLEVEL_LOG, pgmsg->log_tv, NULL, NULL, log_str, strlen(log_str));
+}
+
+// --------------------------------
+// 本文なしのメッセージ(ParseComplete, BindComplete, CloseComplete, NoData, Flush, Terminate, CopyDone)
+// --------------------------------
+static int API_decode_none(struct EVS_pgmsg_t *pgmsg)
+{
+	API_decode_log(pgmsg, NULL);
+	return 0;
+}
+
+// --------------------------------
+// Authentication(R) : int32 認証方式＋認証方式別のデータ
+// --------------------------------
+static int API_decode_Authentication(struct EVS_pgmsg_t *pgmsg)
+{
+	const char                      *auth_str = "";                     // 認証方式名
+	char                            *salt_ptr;                          // MD5のソルト(4バイト)
+	char                            *mechanism_ptr;                     // SASL認証メカニズム名
+
+	if (API_decode_int32(pgmsg, &pgmsg->auth_type) != 0)
+	{
+		return -1;
+	}
+	if (pgmsg->auth_type < sizeof(EVS_auth_type_str) / sizeof(EVS_auth_type_str[0]))
+	{
+		auth_str = EVS_auth_type_str[pgmsg->auth_type];
+	}
+
+	// 認証方式別処理分岐
+	switch (pgmsg->auth_type)
+	{
+		case 5:                                                         // AuthenticationMD5Password : byte4 ソルト
+			if (API_decode_bytes(pgmsg, 4, &salt_ptr) != 0)
+			{
+				return -1;
+			}
+			API_decode_log(pgmsg, "%s, salt:0x%02x,0x%02x,0x%02x,0x%02x", auth_str, (unsigned char)salt_ptr[0], (unsigned char)salt_ptr[1], (unsigned char)salt_ptr[2], (unsigned char)salt_ptr[3]);
+			break;
+		case 10:                                                        // AuthenticationSASL : 認証メカニズム名(\0終端)の列
+			if (API_decode_string(pgmsg, &mechanism_ptr) != 0)
+			{
+				return -1;
+			}
+			API_decode_log(pgmsg, "%s, 1st-mechanism:%s", auth_str, mechanism_ptr);
+			break;
+		default:                                                        // その他は認証方式名とデータ長のみ
+			API_decode_log(pgmsg, "%s, auth_type:%u, data_len:%ld", auth_str, pgmsg->auth_type, (long)(pgmsg->end_ptr - pgmsg->read_ptr));
+			break;
+	}
+	return 0;
+}
+
+// --------------------------------
+// BackendKeyData(K) : int32 プロセスID＋int32 秘密鍵
+// --------------------------------
+static int API_decode_BackendKeyData(struct EVS_pgmsg_t *pgmsg)
+{
+	unsigned int                    backend_pid;
+	unsigned int                    backend_key;
+
+	if (API_decode_int32(pgmsg, &backend_pid) != 0 ||
+		API_decode_int32(pgmsg, &backend_key) != 0)
+	{
+		return -1;
+	}
+	API_decode_log(pgmsg, "backend_pid:%u, backend_key:0x%08x", backend_pid, backend_key);
+	return 0;
+}
+
+// --------------------------------
+// Bind(B) : ポータル名＋プリペアド文名＋パラメータ書式コードの列＋パラメータ値の列＋結果書式コードの列
+// --------------------------------
+static int API_decode_Bind(struct EVS_pgmsg_t *pgmsg)
+{
+	char                            *portal_ptr;
+	char                            *statement_ptr;
+	unsigned short                  format_num;
+	unsigned short                  param_num;
+	unsigned short                  null_num;
+	unsigned int                    data_len;
+	unsigned short                  result_format_num;
+
+	if (API_decode_string(pgmsg, &portal_ptr) != 0 ||
+		API_decode_string(pgmsg, &statement_ptr) != 0 ||
+		API_decode_array(pgmsg, 2, &format_num) != 0 ||
+		API_decode_values(pgmsg, &param_num, &data_len, &null_num) != 0 ||
+		API_decode_array(pgmsg, 2, &result_format_num) != 0)
+	{
+		return -1;
+	}
+	// プリペアド文選択処理(以降のExecuteのフィンガープリントになる)
+	API_request_bind(pgmsg, statement_ptr);
+	API_decode_log(pgmsg, "portal:\"%s\", statement:\"%s\", param_num:%d, null_num:%d, data_len:%u, result_format_num:%d", portal_ptr, statement_ptr, param_num, null_num, data_len, result_format_num);
+	return 0;
+}
+
+// --------------------------------
+// Close(C)/Describe(D) : byte1 対象('S':プリペアド文, 'P':ポータル)＋名前
+// --------------------------------
+static int API_decode_Close(struct EVS_pgmsg_t *pgmsg)
+{
+	unsigned char                   target_type;
+	char                            *name_ptr;
+
+	if (API_decode_int8(pgmsg, &target_type) != 0 ||
+		API_decode_string(pgmsg, &name_ptr) != 0)
+	{
+		return -1;
+	}
+	API_decode_log(pgmsg, "%s:\"%s\"", (target_type == 'S') ? "statement" : "portal", name_ptr);
+	return 0;
+}
+
+static int API_decode_Describe(struct EVS_pgmsg_t *pgmsg)
+{
+	return API_decode_Close(pgmsg);
+}
+
+// --------------------------------
+// CommandComplete(C) : コマンドタグ
+// --------------------------------
+static int API_decode_CommandComplete(struct EVS_pgmsg_t *pgmsg)
+{
+	char                            *tag_ptr;
+
+	if (API_decode_string(pgmsg, &tag_ptr) != 0)
+	{
+		return -1;
+	}
+	API_decode_log(pgmsg, "data=%s", tag_ptr);
+	// 応答待ちリクエスト完了処理
+	API_request_complete(pgmsg, tag_ptr);
+	return 0;
+}
+
+// --------------------------------
+// CopyData(d) : バイト列(長さのみ)
+// --------------------------------
+static int API_decode_CopyData(struct EVS_pgmsg_t *pgmsg)
+{
+	API_decode_log(pgmsg, "data_len:%ld", (long)(pgmsg->end_ptr - pgmsg->read_ptr));
+	return 0;
+}
+
+// --------------------------------
+// CopyFail(f) : エラーメッセージ
+// --------------------------------
+static int API_decode_CopyFail(struct EVS_pgmsg_t *pgmsg)
+{
+	char                            *error_ptr;
+
+	if (API_decode_string(pgmsg, &error_ptr) != 0)
+	{
+		return -1;
+	}
+	API_decode_log(pgmsg, "error:\"%s\"", error_ptr);
+	return 0;
+}
+
+// --------------------------------
+// CopyInResponse(G)/CopyOutResponse(H)/CopyBothResponse(W) : int8 全体の書式＋列の書式コードの列
+// --------------------------------
+static int API_decode_CopyResponse(struct EVS_pgmsg_t *pgmsg)
+{
+	unsigned char                   copy_format;
+	unsigned short                  column_num;
+
+	if (API_decode_int8(pgmsg, &copy_format) != 0 ||
+		API_decode_array(pgmsg, 2, &column_num) != 0)
+	{
+		return -1;
+	}
+	API_decode_log(pgmsg, "format:%s, column_num:%d", (copy_format == 0) ? "text" : "binary", column_num);
+	return 0;
+}
+
+// --------------------------------
+// DataRow(D) : 列値の列
+// --------------------------------
+static int API_decode_DataRow(struct EVS_pgmsg_t *pgmsg)
+{
+	unsigned short                  column_num;
+	unsigned short                  null_num;
+	unsigned int                    data_len;
+
+	if (API_decode_values(pgmsg, &column_num, &data_len, &null_num) != 0)
+	{
+		return -1;
+	}
+	API_decode_log(pgmsg, "column_num:%d, null_num:%d, data_len:%u", column_num, null_num, data_len);
+	// 応答待ちリクエストの行数加算処理
+	API_request_datarow(pgmsg);
+	return 0;
+}
+
+// --------------------------------
+// EmptyQueryResponse(I) : 本文なし
+// --------------------------------
+static int API_decode_EmptyQueryResponse(struct EVS_pgmsg_t *pgmsg)
+{
+	API_decode_log(pgmsg, NULL);
+	// 応答待ちリクエスト完了処理
+	API_request_complete(pgmsg, NULL);
+	return 0;
+}
+
+// --------------------------------
+// ErrorResponse(E)/NoticeResponse(N) : フィールドの列 ※ログ出力＆エラー集計はAPI_pgsql_errorresponse()で行う
+// --------------------------------
+static int API_decode_ErrorResponse(struct EVS_pgmsg_t *pgmsg)
+{
+	// ErrorResponseなら、応答待ちリクエストエラー処理(エラーになったリクエストのフィンガープリントで集計されるように先に呼ぶ)
+	if (pgmsg->message_type == 'E')
+	{
+		API_request_error(pgmsg);
+	}
+	return API_pgsql_errorresponse(pgmsg->log_type, pgmsg->log_tv, pgmsg->session_info, pgmsg->message_ptr, pgmsg->message_len);
+}
+
+// --------------------------------
+// Execute(E) : ポータル名＋int32 最大行数(0:無制限)
+// --------------------------------
+static int API_decode_Execute(struct EVS_pgmsg_t *pgmsg)
+{
+	char                            *portal_ptr;
+	unsigned int                    max_rows;
+
+	if (API_decode_string(pgmsg, &portal_ptr) != 0 ||
+		API_decode_int32(pgmsg, &max_rows) != 0)
+	{
+		return -1;
+	}
+	API_decode_log(pgmsg, "portal:\"%s\", max_rows:%u", portal_ptr, max_rows);
+	// 応答待ちリクエスト登録処理(フィンガープリントは直近のBindで指定されたプリペアド文のもの)
+	API_request_push(pgmsg, 'E', (pgmsg->session_info != NULL) ? pgmsg->session_info->bind_fingerprint : 0);
+	return 0;
+}
+
+// --------------------------------
+// FunctionCall(F) : int32 関数のOID＋引数書式コードの列＋引数値の列＋int16 結果の書式コード
+// --------------------------------
+static int API_decode_FunctionCall(struct EVS_pgmsg_t *pgmsg)
+{
+	unsigned int                    function_oid;
+	unsigned short                  format_num;
+	unsigned short                  arg_num;
+	unsigned short                  null_num;
+	unsigned int                    data_len;
+	unsigned short                  result_format;
+
+	if (API_decode_int32(pgmsg, &function_oid) != 0 ||
+		API_decode_array(pgmsg, 2, &format_num) != 0 ||
+		API_decode_values(pgmsg, &arg_num, &data_len, &null_num) != 0 ||
+		API_decode_int16(pgmsg, &result_format) != 0)
+	{
+		return -1;
+	}
+	API_decode_log(pgmsg, "function_oid:%u, arg_num:%d, null_num:%d, data_len:%u", function_oid, arg_num, null_num, data_len);
+	return 0;
+}
+
+// --------------------------------
+// FunctionCallResponse(V) : int32 結果の長さ(-1:NULL)＋結果
+// --------------------------------
+static int API_decode_FunctionCallResponse(struct EVS_pgmsg_t *pgmsg)
+{
+	unsigned int                    value_len;
+	char                            *value_ptr;
+
+	if (API_decode_int32(pgmsg, &value_len) != 0)
+	{
+		return -1;
+	}
+	if (value_len == 0xFFFFFFFF)
+	{
+		API_decode_log(pgmsg, "result:NULL");
+		return 0;
+	}
+	if (API_decode_bytes(pgmsg, value_len, &value_ptr) != 0)
+	{
+		return -1;
+	}
+	API_decode_log(pgmsg, "result_len:%u", value_len);
+	return 0;
+}
+
+// --------------------------------
+// NegotiateProtocolVersion(v) : int32 サポートする最新のマイナーバージョン＋int32 認識しなかったオプション数＋オプション名の列
+// --------------------------------
+static int API_decode_NegotiateProtocolVersion(struct EVS_pgmsg_t *pgmsg)
+{
+	unsigned int                    request_minorversion_num;
+	unsigned int                    unknown_option_num;
+	char                            *option_name = "";
+
+	if (API_decode_int32(pgmsg, &request_minorversion_num) != 0 ||
+		API_decode_int32(pgmsg, &unknown_option_num) != 0)
+	{
+		return -1;
+	}
+	if (unknown_option_num > 0 && API_decode_string(pgmsg, &option_name) != 0)
+	{
+		return -1;
+	}
+	API_decode_log(pgmsg, "request_minorversion_num:%u, unknown_option_num:%u, 1st-option_name:%s", request_minorversion_num, unknown_option_num, option_name);
+	return 0;
+}
+
+// --------------------------------
+// NotificationResponse(A) : int32 通知元のプロセスID＋チャネル名＋ペイロード
+// --------------------------------
+static int API_decode_NotificationResponse(struct EVS_pgmsg_t *pgmsg)
+{
+	unsigned int                    backend_pid;
+	char                            *channel_ptr;
+	char                            *payload_ptr;
+
+	if (API_decode_int32(pgmsg, &backend_pid) != 0 ||
+		API_decode_string(pgmsg, &channel_ptr) != 0 ||
+		API_decode_string(pgmsg, &payload_ptr) != 0)
+	{
+		return -1;
+	}
+	API_decode_log(pgmsg, "backend_pid:%u, channel:\"%s\", payload:\"%s\"", backend_pid, channel_ptr, payload_ptr);
+	return 0;
+}
+
+// --------------------------------
+// ParameterDescription(t) : パラメータのデータ型OID(int32)の列
+// --------------------------------
+static int API_decode_ParameterDescription(struct EVS_pgmsg_t *pgmsg)
+{
+	unsigned short                  param_num;
+
+	if (API_decode_array(pgmsg, 4, &param_num) != 0)
+	{
+		return -1;
+	}
+	API_decode_log(pgmsg, "param_num:%d", param_num);
+	return 0;
+}
+
+// --------------------------------
+// ParameterStatus(S) : 設定値名＋設定値
+// --------------------------------
+static int API_decode_ParameterStatus(struct EVS_pgmsg_t *pgmsg)
+{
+	char                            *name_ptr;                          // 設定値名ポインタ
+	char                            *value_ptr;                         // 設定値ポインタ
+
+	if (API_decode_string(pgmsg, &name_ptr) != 0 ||
+		API_decode_string(pgmsg, &value_ptr) != 0)
+	{
+		return -1;
+	}
+	API_decode_log(pgmsg, "%s=%s", name_ptr, value_ptr);
+	return 0;
+}
+
+// --------------------------------
+// Parse(P) : プリペアド文名＋クエリ文字列＋パラメータのデータ型OID(int32)の列
+// --------------------------------
+static int API_decode_Parse(struct EVS_pgmsg_t *pgmsg)
+{
+	char                            *statement_ptr;
+	char                            *query_ptr;                         // クエリ文字列ポインタ
+	unsigned short                  param_num;
+	unsigned int                    fingerprint;                        // クエリのフィンガープリント
+
+	if (API_decode_string(pgmsg, &statement_ptr) != 0 ||
+		API_decode_string(pgmsg, &query_ptr) != 0 ||
+		API_decode_array(pgmsg, 4, &param_num) != 0)
+	{
+		return -1;
+	}
+	fingerprint = API_pgsql_fingerprint(query_ptr, strlen(query_ptr));
+	// セッション別解析情報があるなら、クエリのフィンガープリントを設定(以降のエラー集計などに使う)
+	if (pgmsg->session_info != NULL)
+	{
+		pgmsg->session_info->fingerprint = fingerprint;
+	}
+	// プリペアド文登録処理
+	API_request_parse(pgmsg, statement_ptr, fingerprint);
+	API_decode_log(pgmsg, "statement:\"%s\", fingerprint:%08x, param_num:%d, data:\"%s\"", statement_ptr, fingerprint, param_num, query_ptr);
+	return 0;
+}
+
+// --------------------------------
+// PasswordMessage/SASLInitialResponse/SASLResponse/GSSResponse(p) ※パスワードなどを含むので、長さのみ
+// --------------------------------
+static int API_decode_PasswordMessage(struct EVS_pgmsg_t *pgmsg)
+{
+	API_decode_log(pgmsg, "data_len:%ld", (long)(pgmsg->end_ptr - pgmsg->read_ptr));
+	return 0;
+}
+
+// --------------------------------
+// PortalSuspended(s) : 本文なし ※Executeの最大行数に達した(続きは次のExecuteで取得する)
+// --------------------------------
+static int API_decode_PortalSuspended(struct EVS_pgmsg_t *pgmsg)
+{
+	API_decode_log(pgmsg, NULL);
+	// 応答待ちリクエスト完了処理
+	API_request_complete(pgmsg, NULL);
+	return 0;
+}
+
+// --------------------------------
+// Query(Q) : クエリ文字列
+// --------------------------------
+static int API_decode_Query(struct EVS_pgmsg_t *pgmsg)
+{
+	char                            *query_ptr;                         // クエリ文字列ポインタ
+	unsigned int                    fingerprint;                        // クエリのフィンガープリント
+
+	if (API_decode_string(pgmsg, &query_ptr) != 0)
+	{
+		return -1;
+	}
+	fingerprint = API_pgsql_fingerprint(query_ptr, strlen(query_ptr));
+	// セッション別解析情報があるなら、クエリのフィンガープリントを設定(以降のエラー集計などに使う)
+	if (pgmsg->session_info != NULL)
+	{
+		pgmsg->session_info->fingerprint = fingerprint;
+	}
+	API_decode_log(pgmsg, "fingerprint:%08x, data:\"%s\"", fingerprint, query_ptr);
+	// 応答待ちリクエスト登録処理
+	API_request_push(pgmsg, 'Q', fingerprint);
+	return 0;
+}
+
+// --------------------------------
+// ReadyForQuery(Z) : byte1 トランザクション状態
+// --------------------------------
+static int API_decode_ReadyForQuery(struct EVS_pgmsg_t *pgmsg)
+{
+	unsigned char                   txn_status;
+
+	if (API_decode_int8(pgmsg, &txn_status) != 0)
+	{
+		return -1;
+	}
+	pgmsg->txn_status = (char)txn_status;
+	API_decode_log(pgmsg, "Transaction:%c", pgmsg->txn_status);
+	// セッション別トランザクション状態遷移処理
+	API_session_ready(pgmsg);
+	// 応答待ちリクエスト同期処理
+	API_request_ready(pgmsg);
+	return 0;
+}
+
+// --------------------------------
+// RowDescription(T) : フィールドの列(フィールド名＋int32 テーブルOID＋int16 列番号＋int32 データ型OID＋int16 型の長さ＋int32 型修飾子＋int16 書式コード)
+// --------------------------------
+static int API_decode_RowDescription(struct EVS_pgmsg_t *pgmsg)
+{
+	unsigned short                  field_num;
+	unsigned short                  list_num;
+	char                            *field_name;
+	char                            *first_name = "";
+	char                            *field_attr;
+
+	if (API_decode_int16(pgmsg, &field_num) != 0)
+	{
+		return -1;
+	}
+	for (list_num = 0; list_num < field_num; list_num++)
+	{
+		if (API_decode_string(pgmsg, &field_name) != 0 ||
+			API_decode_bytes(pgmsg, 4 + 2 + 4 + 2 + 4 + 2, &field_attr) != 0)
+		{
+			return -1;
+		}
+		if (list_num == 0)
+		{
+			first_name = field_name;
+		}
+	}
+	API_decode_log(pgmsg, "field_num:%d, 1st-field_name:%s", field_num, first_name);
+	return 0;
+}
+
+// --------------------------------
+// Sync(S) : 本文なし ※パイプラインの区切り(PostgreSQLはReadyForQueryを返す)
+// --------------------------------
+static int API_decode_Sync(struct EVS_pgmsg_t *pgmsg)
+{
+	API_decode_log(pgmsg, NULL);
+	// 応答待ちリクエスト登録処理
+	API_request_push(pgmsg, 'S', 0);
+	return 0;
+}
+
+// --------------------------------
+// メッセージヘッダ解析処理
+// --------------------------------
+// buf_ptrからbuf_endまでの受信データの先頭にあるメッセージのヘッダ(メッセージタイプ1バイト＋メッセージ長4バイト)を解析して、pgmsgに設定する。
+// 戻り値は、1:メッセージ全体が受信データ内にある, 0:メッセージが受信データの終端で分断されている, -1:メッセージ長がおかしい
+int API_pgsql_decode_header(struct EVS_pgmsg_t *pgmsg, char *buf_ptr, char *buf_end)
+{
+	// ヘッダ部分すら揃っていないなら
+	if (buf_end - buf_ptr < 5)
+	{
+		return 0;
+	}
+	pgmsg->message_type = (unsigned char)buf_ptr[0];
+	pgmsg->message_len = API_pgsql_get_int32(buf_ptr + 1);
+	pgmsg->message_ptr = buf_ptr;
+	pgmsg->read_ptr = buf_ptr + 5;
+	// メッセージ長は、メッセージ長自身の4バイトより短いことはなく、PostgreSQLが扱える長さより長いこともない(1＋メッセージ長が桁あふれしないように)
+	if (pgmsg->message_len < 4 || pgmsg->message_len > MAX_PGSQL_MESSAGE_LENGTH)
+	{
+		return -1;
+	}
+	// メッセージが受信データの終端で分断されているなら
+	if ((unsigned long)(buf_end - buf_ptr) - 1 < pgmsg->message_len)
+	{
+		pgmsg->end_ptr = buf_end;
+		return 0;
+	}
+	pgmsg->end_ptr = buf_ptr + 1 + pgmsg->message_len;
+	return 1;
+}
+
+// --------------------------------
+// メッセージタイプ別デコード処理 ※API_pgsql_decode_header()でメッセージ全体が揃っていることを確認してから呼ぶこと
+// --------------------------------
+int API_pgsql_decode_message(struct EVS_pgmsg_t *pgmsg)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	const struct EVS_decoder_t      *decoder_list = (pgmsg->from_client == 1) ? EVS_front_decoder : EVS_backend_decoder;
+	const char                      **name_list = (pgmsg->from_client == 1) ? PgSQL_message_front_str : PgSQL_message_backend_str;
+	unsigned char                   message_type = pgmsg->message_type;
+
+	// 未定義のメッセージタイプなら
+	if (message_type >= 0x80 || decoder_list[message_type].decode_func == NULL)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, pgmsg->log_tv, log_str, "%s(): Unknown %s message type!? (type=0x%02x, message size=%u, len=0x%02x)\n", __func__, (pgmsg->from_client == 1) ? "frontend" : "backend", message_type, 1 + pgmsg->message_len, pgmsg->message_len);
+		return -1;
+	}
+	// メッセージ長が短すぎるか、デコードできなかったら
+	if (pgmsg->message_len < decoder_list[message_type].min_len ||
+		decoder_list[message_type].decode_func(pgmsg) != 0)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, pgmsg->log_tv, log_str, "%s(): Illegal %s message!? (message size=%u, len=0x%02x)\n", __func__, name_list[message_type], 1 + pgmsg->message_len, pgmsg->message_len);
+		return -1;
+	}
+	return 0;
+}
+
+// --------------------------------
+// 分断されたメッセージの組み立て開始処理 ※API_pgsql_decode_header()でヘッダが揃っていることを確認してから呼ぶこと
+// --------------------------------
+// メッセージ全体の長さ分のバッファに受信済みの部分を入れて、残りは次の受信データで組み立てる(streamのskip_lenに残りの長さを覚えておく)。
+// MAX_STREAM_SPLIT_LENGTHより長いか、バッファが確保できなければ、メッセージタイプと長さだけをログに出力して、残りは読み飛ばす。
+static void API_pgsql_split_start(struct EVS_pgmsg_t *pgmsg, struct EVS_stream_t *stream, const char *data_ptr, unsigned int data_len)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	unsigned long                   message_size = 1UL + pgmsg->message_len;    // メッセージ全体の長さ(メッセージ長が壊れていても桁あふれしないように)
+	char                            *new_buf;
+
+	if (stream == NULL)
+	{
+		API_decode_log(pgmsg, "split");
+		return;
+	}
+	// 組み立てるには長すぎるか、受信済みの部分の方が長い(ヘッダがおかしい)なら
+	if (message_size > MAX_STREAM_SPLIT_LENGTH || message_size <= data_len)
+	{
+		API_decode_log(pgmsg, "split");
+		// 組み立てずに、残りを読み飛ばす
+		stream->split_len = 0;
+		stream->skip_len = (message_size > data_len) ? (unsigned int)(message_size - data_len) : 0;
+		return;
+	}
+	// バッファが足りないなら
+	if (message_size > stream->split_size)
+	{
+		new_buf = (char *)realloc(stream->split_buf, message_size);
+		if (new_buf == NULL)
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, pgmsg->log_tv, log_str, "%s(): Cannot realloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
+			API_decode_log(pgmsg, "split");
+			// 組み立てずに、残りを読み飛ばす
+			stream->split_len = 0;
+			stream->skip_len = (unsigned int)(message_size - data_len);
+			return;
+		}
+		stream->split_buf = new_buf;
+		stream->split_size = message_size;
+	}
+	// 組み立てる(skip_lenは、組み立てるか読み飛ばすかを決めてから設定する。split_lenが0以外なら、skip_lenの分を組み立てる)
+	memcpy(stream->split_buf, data_ptr, data_len);
+	stream->split_len = data_len;
+	stream->skip_len = (unsigned int)(message_size - data_len);
+}
+
+// --------------------------------
+// 受信データ内の全メッセージのデコード処理 ※メッセージ用キューの解析処理から呼ばれる
+// --------------------------------
+// 受信データの境界で分断されたメッセージは、streamのバッファで組み立てて、次の受信データで揃ったところでデコードする
+// (COPY中継の分断されたヘッダと同じように、streamに持ち越す)。組み立てるには長すぎるメッセージは、メッセージタイプと長さだけを
+// ログに出力し、残りの部分は次の受信データの先頭で読み飛ばす。
+// pgmsgには、予めメッセージの方向やログ出力方法などを設定しておくこと。streamがNULLなら、分断されたメッセージの組み立てや読み飛ばしはしない。
+int API_pgsql_decode_stream(struct EVS_pgmsg_t *pgmsg, struct EVS_stream_t *stream, char *buf_ptr, unsigned int buf_len)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	char                            *target_ptr = buf_ptr;
+	char                            *end_ptr = buf_ptr + buf_len;
+	unsigned int                    copy_len;
+	int                             header_result;
+
+	// 前の受信データの終端でヘッダが分断されていたなら、ヘッダの残りを補う
+	if (stream != NULL && stream->header_len > 0)
+	{
+		copy_len = 5 - stream->header_len;
+		if (copy_len > buf_len)
+		{
+			copy_len = buf_len;
+		}
+		memcpy(stream->header_buf + stream->header_len, target_ptr, copy_len);
+		stream->header_len += copy_len;
+		target_ptr += copy_len;
+		// まだヘッダが揃わないなら
+		if (stream->header_len < 5)
+		{
+			return 0;
+		}
+		stream->header_len = 0;
+		// ヘッダが揃ったので、分断されたメッセージの組み立てを始める
+		header_result = API_pgsql_decode_header(pgmsg, stream->header_buf, stream->header_buf + 5);
+		if (header_result < 0)
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, pgmsg->log_tv, log_str, "%s(): Illegal message length!? (type=0x%02x, len=0x%02x)\n", __func__, pgmsg->message_type, pgmsg->message_len);
+			return -1;
+		}
+		// 本文のないメッセージなら、もう揃っている
+		if (header_result > 0)
+		{
+			if (API_pgsql_decode_message(pgmsg) != 0)
+			{
+				return -1;
+			}
+		}
+		else
+		{
+			API_pgsql_split_start(pgmsg, stream, stream->header_buf, 5);
+		}
+	}
+	// 前の受信データの終端で分断されたメッセージの残りがあるなら、組み立てるか読み飛ばす
+	if (stream != NULL && stream->skip_len > 0)
+	{
+		copy_len = stream->skip_len;
+		if (copy_len > (unsigned int)(end_ptr - target_ptr))
+		{
+			copy_len = end_ptr - target_ptr;
+		}
+		if (stream->split_len > 0)
+		{
+			memcpy(stream->split_buf + stream->split_len, target_ptr, copy_len);
+			stream->split_len += copy_len;
+		}
+		target_ptr += copy_len;
+		stream->skip_len -= copy_len;
+		// 組み立てていたメッセージが揃ったなら、デコードする
+		if (stream->skip_len == 0 && stream->split_len > 0)
+		{
+			header_result = API_pgsql_decode_header(pgmsg, stream->split_buf, stream->split_buf + stream->split_len);
+			stream->split_len = 0;
+			if (header_result <= 0 || API_pgsql_decode_message(pgmsg) != 0)
+			{
+				return -1;
+			}
+		}
+	}
+
+	// 受信データが解析できる限り、ループ
+	while (target_ptr < end_ptr)
+	{
+		// メッセージヘッダ解析処理
+		header_result = API_pgsql_decode_header(pgmsg, target_ptr, end_ptr);
+		// メッセージ長がおかしいなら(メッセージの境界を見失っているので、この受信データの残りは諦める)
+		if (header_result < 0)
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, pgmsg->log_tv, log_str, "%s(): Illegal message length!? (type=0x%02x, len=0x%02x)\n", __func__, pgmsg->message_type, pgmsg->message_len);
+			return -1;
+		}
+		// メッセージが受信データの終端で分断されているなら
+		if (header_result == 0)
+		{
+			// ヘッダすら揃っていないなら、ヘッダの受信済み部分を覚えておく
+			if (end_ptr - target_ptr < 5)
+			{
+				if (stream != NULL)
+				{
+					stream->header_len = end_ptr - target_ptr;
+					memcpy(stream->header_buf, target_ptr, stream->header_len);
+				}
+			}
+			// ヘッダが揃っているなら、分断されたメッセージの組み立てを始める
+			else
+			{
+				API_pgsql_split_start(pgmsg, stream, target_ptr, end_ptr - target_ptr);
+			}
+			break;
+		}
+		// メッセージタイプ別デコード処理
+		if (API_pgsql_decode_message(pgmsg) != 0)
+		{
+			return -1;
+		}
+		// 次のメッセージへ
+		target_ptr += 1 + pgmsg->message_len;
+	}
+
+	return 0;
+}
@@ -29,6 +29,8 @@
 // --------------------------------
 // 変数宣言
 // --------------------------------
+static EVP_MD_CTX               *EVS_md5_ctx = NULL;                        // MD5認証で、接続毎に使い回すダイジェストコンテキスト
+
 // ----------------------------------------------------------------------
 // コード部分
 // ----------------------------------------------------------------------
@@ -65,528 +67,159 @@
 // なので、バッファポインタを駆使して、メッセージ毎に処理をしないといけない
 
 // --------------------------------
-// PostgreSQL側各種クエリレスポンス解析処理 ※透過モード時に溜め込んだメッセージを解析してログに出力する
+// PostgreSQL側各種クエリレスポンス処理 ※メッセージのデコード(ログ出力)はAPI_pgsql_decode_message()で済ませてから呼ぶこと
 // --------------------------------
-int API_pgsql_message_decodequeryresponse(struct EVS_ev_message_t *message_info, char *message_ptr, unsigned int message_len)
+int API_pgsql_server_decodequeryresponse(struct EVS_ev_pgsql_t *this_pgsql, struct EVS_pgmsg_t *pgmsg)
 {
 	int                             api_result = 0;
 	char                            log_str[MAX_LOG_LENGTH];
 
-	unsigned char                   message_type = message_ptr[0];
-
-	unsigned char                   *target_ptr;
+	struct EVS_ev_client_t          *this_client = (struct EVS_ev_client_t *)this_pgsql->client_info;
 
 	// ------------------------------------
 	// ★ここで、PostgreSQLから来たメッセージ別に、現在のクライアントの状態(client_status)等を変更しないといけないョ!!
 	// ------------------------------------
-	unsigned int                    auth_type;
-	unsigned short                  field_num;
-	unsigned short                  column_num;
-	unsigned int                    column_len;
-	unsigned int                    backend_pid;
-	unsigned int                    backend_key;
-
-	char                            *name_ptr = message_ptr + 5;        // 設定値名ポインタ
-	int                             name_len = 0;                       // 設定値名の長さ
-
-	char                            *value_ptr = NULL;                  // 設定値ポインタ
-	int                             value_len = 0;                      // 設定値の長さ
+	// 開始メッセージレスポンス保存処理(プールした接続を次のクライアントに割り当てる時に送るメッセージを保存しておく)
+	API_pool_startup(this_pgsql, pgmsg);
+	// BackendKeyData保存処理(CancelRequestを転送する時のために、PostgreSQLのプロセスIDと秘密鍵を覚えておく)
+	API_cancel_backend(this_pgsql, pgmsg);
 
-	// ダンプ出力
-	dump2log(LOG_DIRECT, LOGLEVEL_DUMP, &(message_info->message_tv), (void *)message_ptr, (1 + message_len) & 0x3FF);
-
-	// メッセージタイプ別処理分岐
-	switch (message_type)
+	// 事前接続(クライアントのいない接続)なら、ReadyForQueryで透過モードにするだけ(プールにはAPI_pool_ready()で入れる)
+	if (this_client == NULL)
 	{
-		case 'C':                                                       // 0x43 : C ... コマンド完了(B)
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> %s. (message size=%d, len=0x%02x, data=%s)\n", PgSQL_message_backend_str[message_type], 1 + message_len, message_len, message_ptr + 5);
-			logging(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-			break;
-		case 'D':                                                       // 0x44 : D ... データ行(B)
-			// 列値を取得(int16)
-			target_ptr = (unsigned char *)&column_num;
-			*target_ptr =  message_ptr[6];
-			target_ptr ++;
-			*target_ptr =  message_ptr[5];
-			// メッセージ長を取得(int32)
-			target_ptr = (unsigned char *)&column_len;
-			*target_ptr =  message_ptr[10];
-			target_ptr ++;
-			*target_ptr =  message_ptr[9];
-			target_ptr ++;
-			*target_ptr =  message_ptr[8];
-			target_ptr ++;
-			*target_ptr =  message_ptr[7];
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> %s. (message size=%d, len=0x%02x, column_num:%d, 1st_column_len:%d)\n", PgSQL_message_backend_str[message_type], 1 + message_len, message_len, column_num, column_len);
-			logging(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-			break;
-		case 'E':                                                       // 0x45 : E ... エラー(B)
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> %s. (message size=%d, len=0x%02x, 1st-field:%c, 1st-value:%s)\n", PgSQL_message_backend_str[message_type], 1 + message_len, message_len, message_ptr[5], message_ptr + 6);
-			logging(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-			break;
-		case 'K':                                                       // 0x4B : K ... 取り消しする際のキーデータ(B)
-			// バックエンドのプロセスIDを取得(int32)
-			target_ptr = (unsigned char *)&backend_pid;
-			*target_ptr =  message_ptr[8];
-			target_ptr ++;
-			*target_ptr =  message_ptr[7];
-			target_ptr ++;
-			*target_ptr =  message_ptr[6];
-			target_ptr ++;
-			*target_ptr =  message_ptr[5];
-			// バックエンドの秘密鍵を取得(int32)
-			target_ptr = (unsigned char *)&backend_key;
-			*target_ptr =  message_ptr[12];
-			target_ptr ++;
-			*target_ptr =  message_ptr[11];
-			target_ptr ++;
-			*target_ptr =  message_ptr[10];
-			target_ptr ++;
-			*target_ptr =  message_ptr[9];
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> %s. (message size=%d, len=0x%02x, backend_pid:%d, backend_key:0x%08x)\n", PgSQL_message_backend_str[message_type], 1 + message_len, message_len, backend_pid, backend_key);
-			logging(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-			break;
-		case 'R':                                                       // 0x52 : R ... OKか、特定の認証が必要かはメッセージ内容による(B)
-			// 認証方式を取得(int32)
-			target_ptr = (unsigned char *)&auth_type;
-			*target_ptr =  message_ptr[8];
-			target_ptr ++;
-			*target_ptr =  message_ptr[7];
-			target_ptr ++;
-			*target_ptr =  message_ptr[6];
-			target_ptr ++;
-			*target_ptr =  message_ptr[5];
-			// 認証方式別処理分岐
-			switch (auth_type)
-			{
-				case 0:                                                 // AuthenticationOk ※PosgreSQLと2:接続中(pgsql_status==2)になったら、こっちに処理が来るようにする
-					snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): client_status %d -> 2!\n", __func__, message_info->pgsql_socket_fd, message_info->client_status);
-					logging(LOG_DIRECT, LOGLEVEL_DEBUG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-					// 標準ログに出力
-					snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> AuthenticationOk. (message size=%d, len=0x%02x)\n", 1 + message_len, message_len);
-					logging(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-					break;
-				default:
-					// エラー
-					snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Illegal Authentication Response!? (client_status=%d, auth_type=%d)\n", __func__, message_info->pgsql_socket_fd, message_info->client_status, auth_type);
-					logging(LOG_DIRECT, LOGLEVEL_ERROR, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-					// 戻る
-					return -1;
-					break;
-			}
-			break;
-		case 'S':                                                       // 0x53 : S ... 実行時パラメータ状態報告(B)
-			// 設定値名の長さを取得
-			name_len = strlen(name_ptr);
-			// 設定値の長さが各種設定値の全体長よりも長いなら\0が見つからない？等おかしいので
-			if (name_ptr + name_len + 1 > message_ptr + 5 + message_len)
-			{
-				// エラー
-				snprintf(log_str, MAX_LOG_LENGTH, "%s(): name_ptr + name_len + 1 > message_ptr + 5 + message_len!?\n", __func__);
-				logging(LOG_DIRECT, LOGLEVEL_ERROR, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-				return -1;
-			}
-			// 設定値ポインタを設定値名の次(\0の次なので+1)に移動する
-			value_ptr = name_ptr + name_len + 1;
-			// 設定値の長さを取得
-			value_len = strlen(value_ptr);
-			// 設定値の長さが各種設定値の全体長よりも長いなら\0が見つからない？等おかしいので
-			if (value_ptr + value_len + 1 > message_ptr + 5 + message_len)
-			{
-				// エラー
-				snprintf(log_str, MAX_LOG_LENGTH, "%s(): value_ptr + value_len + 1 > message_ptr + 5 + message_len!?\n", __func__);
-				logging(LOG_DIRECT, LOGLEVEL_ERROR, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-				return -1;
-			}
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> %s. (message size=%d, len=0x%02x, %s=%s)\n", PgSQL_message_backend_str[message_type], 1 + message_len, message_len, name_ptr, value_ptr);
-			logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-			break;
-		case 'T':                                                       // 0x54 : T ... 行の記述(B)
-			// 行のフィールド数を取得(int16)
-			target_ptr = (unsigned char *)&field_num;
-			*target_ptr =  message_ptr[6];
-			target_ptr ++;
-			*target_ptr =  message_ptr[5];
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> %s. (message size=%d, len=0x%02x, field_num:%d)\n", PgSQL_message_backend_str[message_type], 1 + message_len, message_len, field_num);
-			logging(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-			break;
-		case 'Z':                                                       // 0x5A : Z ... 新しい問い合わせサイクルの準備が整った
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): this_pgsql->pgsql_status %d -> 10!!\n", __func__, message_info->pgsql_socket_fd, message_info->pgsql_status);
-			logging(LOG_DIRECT, LOGLEVEL_DEBUG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> %s. (message size=%d, len=0x%02x, Transaction:%c)\n", PgSQL_message_backend_str[message_type], 1 + message_len, message_len, message_ptr[5]);
-			logging(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-			break;
-		default:
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): Type:%s Length:%0d Data:%s Value:...\n", __func__, PgSQL_message_backend_str[message_type], message_len, message_ptr + 5);
-			logging(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-			break;
+		if (pgmsg->message_type == 'Z')
+		{
+			this_pgsql->pgsql_status = 10;
+		}
+		return 0;
 	}
 
-	// PostgreSQLから送られてきたクエリメッセージを、クライアントに対して送信する(PostgreSQL→クライアントは、そのままでは送らない)
-////    api_result = API_pgsql_client_send(this_client, message_ptr, 1 + message_len);
-
-	// 標準ログに出力
-	snprintf(log_str, MAX_LOG_LENGTH, "PgAnalyzer -> Client(%s) (message size=%d, len=0x%02x)\n", message_info->client_addr_str, 1 + message_len, message_len);
-	logging(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-
-	// 戻る
-	return api_result;
-}
-
-// --------------------------------
-// PostgreSQL側各種クエリレスポンス解析処理
-// --------------------------------
-int API_pgsql_server_decodequeryresponse(struct EVS_ev_pgsql_t *this_pgsql, char *message_ptr, unsigned int message_len)
-{
-	int                             api_result = 0;
-	char                            log_str[MAX_LOG_LENGTH];
-
-	struct EVS_ev_client_t          *this_client = (struct EVS_ev_client_t *)this_pgsql->client_info;
-
-	unsigned char                   message_type = message_ptr[0];
-	unsigned char                   *target_ptr;
-
-	// ------------------------------------
-	// ★ここで、PostgreSQLから来たメッセージ別に、現在のクライアントの状態(client_status)等を変更しないといけないョ!!
-	// ------------------------------------
-	unsigned int                    auth_type;
-	unsigned short                  field_num;
-	unsigned short                  column_num;
-	unsigned int                    column_len;
-	unsigned int                    backend_pid;
-	unsigned int                    backend_key;
-
-	char                            *name_ptr = message_ptr + 5;        // 設定値名ポインタ
-	int                             name_len = 0;                       // 設定値名の長さ
-
-	char                            *value_ptr = NULL;                  // 設定値ポインタ
-	int                             value_len = 0;                      // 設定値の長さ
-
-	// ダンプ出力
-	dump2log(LOG_QUEUEING, LOGLEVEL_DUMP, NULL, (void *)message_ptr, (1 + message_len) & 0x3FF);
-
 	// メッセージタイプ別処理分岐
-	switch (message_type)
+	switch (pgmsg->message_type)
 	{
-		case 'C':                                                       // 0x43 : C ... コマンド完了(B)
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> %s. (message size=%d, len=0x%02x, data=%s)\n", PgSQL_message_backend_str[message_type], 1 + message_len, message_len, message_ptr + 5);
-			logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-			break;
-		case 'D':                                                       // 0x44 : D ... データ行(B)
-			// 列値を取得(int16)
-			target_ptr = (unsigned char *)&column_num;
-			*target_ptr =  message_ptr[6];
-			target_ptr ++;
-			*target_ptr =  message_ptr[5];
-			// メッセージ長を取得(int32)
-			target_ptr = (unsigned char *)&column_len;
-			*target_ptr =  message_ptr[10];
-			target_ptr ++;
-			*target_ptr =  message_ptr[9];
-			target_ptr ++;
-			*target_ptr =  message_ptr[8];
-			target_ptr ++;
-			*target_ptr =  message_ptr[7];
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> %s. (message size=%d, len=0x%02x, column_num:%d, 1st_column_len:%d)\n", PgSQL_message_backend_str[message_type], 1 + message_len, message_len, column_num, column_len);
-			logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-			break;
-		case 'E':                                                       // 0x45 : E ... エラー(B)
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> %s. (message size=%d, len=0x%02x, 1st-field:%c, 1st-value:%s)\n", PgSQL_message_backend_str[message_type], 1 + message_len, message_len, message_ptr[5], message_ptr + 6);
-			logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-			break;
-		case 'K':                                                       // 0x4B : K ... 取り消しする際のキーデータ(B)
-			// バックエンドのプロセスIDを取得(int32)
-			target_ptr = (unsigned char *)&backend_pid;
-			*target_ptr =  message_ptr[8];
-			target_ptr ++;
-			*target_ptr =  message_ptr[7];
-			target_ptr ++;
-			*target_ptr =  message_ptr[6];
-			target_ptr ++;
-			*target_ptr =  message_ptr[5];
-			// バックエンドの秘密鍵を取得(int32)
-			target_ptr = (unsigned char *)&backend_key;
-			*target_ptr =  message_ptr[12];
-			target_ptr ++;
-			*target_ptr =  message_ptr[11];
-			target_ptr ++;
-			*target_ptr =  message_ptr[10];
-			target_ptr ++;
-			*target_ptr =  message_ptr[9];
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> %s. (message size=%d, len=0x%02x, backend_pid:%d, backend_key:0x%08x)\n", PgSQL_message_backend_str[message_type], 1 + message_len, message_len, backend_pid, backend_key);
-			logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-			break;
 		case 'R':                                                       // 0x52 : R ... OKか、特定の認証が必要かはメッセージ内容による(B)
-			// 認証方式を取得(int32)
-			target_ptr = (unsigned char *)&auth_type;
-			*target_ptr =  message_ptr[8];
-			target_ptr ++;
-			*target_ptr =  message_ptr[7];
-			target_ptr ++;
-			*target_ptr =  message_ptr[6];
-			target_ptr ++;
-			*target_ptr =  message_ptr[5];
 			// 認証方式別処理分岐
-			switch (auth_type)
+			switch (pgmsg->auth_type)
 			{
 				case 0:                                                 // AuthenticationOk ※PosgreSQLと2:接続中(pgsql_status==2)になったら、こっちに処理が来るようにする
-					snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): this_client->client_status %d -> 2!\n", __func__, this_pgsql->socket_fd, this_client->client_status);
-					logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+					LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): this_client->client_status %d -> 2!\n", __func__, this_pgsql->socket_fd, this_client->client_status);
 					// クライアント毎の状態を、2:クエリメッセージ待ちに設定
 					this_client->client_status = 2;
-					// 標準ログに出力
-					snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> AuthenticationOk. (message size=%d, len=0x%02x)\n", 1 + message_len, message_len);
-					logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
 					break;
 				default:
 					// エラー
-					snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Illegal Authentication Response!? (client_status=%d, auth_type=%d)\n", __func__, this_pgsql->socket_fd, this_client->client_status, auth_type);
-					logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+					LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): Illegal Authentication Response!? (client_status=%d, auth_type=%d)\n", __func__, this_pgsql->socket_fd, this_client->client_status, pgmsg->auth_type);
 					// 戻る
 					return -1;
 					break;
 			}
 			break;
-		case 'S':                                                       // 0x53 : S ... 実行時パラメータ状態報告(B)
-			// 設定値名の長さを取得
-			name_len = strlen(name_ptr);
-			// 設定値の長さが各種設定値の全体長よりも長いなら\0が見つからない？等おかしいので
-			if (name_ptr + name_len + 1 > message_ptr + 5 + message_len)
-			{
-				// エラー
-				snprintf(log_str, MAX_LOG_LENGTH, "%s(): name_ptr + name_len + 1 > message_ptr + 5 + message_len!?\n", __func__);
-				logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
-				return -1;
-			}
-			// 設定値ポインタを設定値名の次(\0の次なので+1)に移動する
-			value_ptr = name_ptr + name_len + 1;
-			// 設定値の長さを取得
-			value_len = strlen(value_ptr);
-			// 設定値の長さが各種設定値の全体長よりも長いなら\0が見つからない？等おかしいので
-			if (value_ptr + value_len + 1 > message_ptr + 5 + message_len)
-			{
-				// エラー
-				snprintf(log_str, MAX_LOG_LENGTH, "%s(): value_ptr + value_len + 1 > message_ptr + 5 + message_len!?\n", __func__);
-				logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
-				return -1;
-			}
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> %s. (message size=%d, len=0x%02x, %s=%s)\n", PgSQL_message_backend_str[message_type], 1 + message_len, message_len, name_ptr, value_ptr);
-			logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-			break;
-		case 'T':                                                       // 0x54 : T ... 行の記述(B)
-			// 行のフィールド数を取得(int16)
-			target_ptr = (unsigned char *)&field_num;
-			*target_ptr =  message_ptr[6];
-			target_ptr ++;
-			*target_ptr =  message_ptr[5];
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> %s. (message size=%d, len=0x%02x, field_num:%d)\n", PgSQL_message_backend_str[message_type], 1 + message_len, message_len, field_num);
-			logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-			break;
 		case 'Z':                                                       // 0x5A : Z ... 新しい問い合わせサイクルの準備が整った
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): this_pgsql->pgsql_status %d -> 10!!\n", __func__, this_pgsql->socket_fd, this_pgsql->pgsql_status);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): this_pgsql->pgsql_status %d -> 10!!\n", __func__, this_pgsql->socket_fd, this_pgsql->pgsql_status);
 			// PostgreSQLへの接続状態を、10:テストの透過モードに設定
 			this_pgsql->pgsql_status = 10;
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> %s. (message size=%d, len=0x%02x, Transaction:%c)\n", PgSQL_message_backend_str[message_type], 1 + message_len, message_len, message_ptr[5]);
-			logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
 			break;
 		default:
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): Type:%s Length:%0d Data:%s Value:...\n", __func__, PgSQL_message_backend_str[message_type], message_len, message_ptr + 5);
-			logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
 			break;
 	}
 
+	// 接続を待っているクライアントのために開いた接続なら、開始メッセージレスポンスはクライアントに送らない(送り済み)
+	if (this_pgsql->pool_pending != 0)
+	{
+		return 0;
+	}
+
+	// BackendKeyDataなら、PgAnalyzerがクライアントに割り当てたキーに書き換える(CancelRequestはPgAnalyzerが受けて、今割り当てている接続に転送する)
+	if (pgmsg->message_type == 'K')
+	{
+		API_cancel_rewrite(this_client, pgmsg->message_ptr, 1 + pgmsg->message_len);
+	}
 	// PostgreSQLから送られてきたクエリメッセージを、クライアントに対して送信する(PostgreSQL→クライアントは、そのままでは送らない)
-	api_result = API_pgsql_client_send(this_client, message_ptr, 1 + message_len);
+	api_result = API_pgsql_client_send(this_client, pgmsg->message_ptr, 1 + pgmsg->message_len);
+	// キャプチャデータ出力処理
+	API_capture_data(this_client, 0, pgmsg->message_ptr, 1 + pgmsg->message_len);
 
 	// 標準ログに出力
-	snprintf(log_str, MAX_LOG_LENGTH, "PgAnalyzer -> Client(%s) (message size=%d, len=0x%02x)\n", this_client->addr_str, 1 + message_len, message_len);
-	logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "PgAnalyzer -> Client(%s) (message size=%d, len=0x%02x)\n", this_client->addr_str, 1 + pgmsg->message_len, pgmsg->message_len);
 
 	// 戻る
 	return api_result;
 }
 			
 // --------------------------------
-// PostgreSQL側開始メッセージレスポンス解析処理
+// PostgreSQL側開始メッセージレスポンス処理 ※メッセージのデコード(ログ出力)はAPI_pgsql_decode_message()で済ませてから呼ぶこと
 // --------------------------------
-int API_pgsql_server_decodestartresponse(struct EVS_ev_pgsql_t *this_pgsql, char *message_ptr, unsigned int message_len)
+int API_pgsql_server_decodestartresponse(struct EVS_ev_pgsql_t *this_pgsql, struct EVS_pgmsg_t *pgmsg)
 {
 	int                             api_result = 0;
 	char                            log_str[MAX_LOG_LENGTH];
 
-	unsigned char                   message_type = message_ptr[0];
-	unsigned char                   *target_ptr;
-
-	unsigned int                    auth_type;
-	unsigned int                    request_minorversion_num;
-	unsigned int                    unknown_option_num;
-	char                            *option_name;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): START! recv_len=%d, message_len=%d, pgsql_status=%d\n", __func__, this_pgsql->socket_fd, this_pgsql->recv_len, pgmsg->message_len, this_pgsql->pgsql_status);
 
-	// ダンプ出力
-	dump2log(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, (void *)this_pgsql->recv_buf, this_pgsql->recv_len & 0x3FF);
-
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): START! recv_len=%d, message_len=%d, pgsql_status=%d\n", __func__, this_pgsql->socket_fd, this_pgsql->recv_len, message_len, this_pgsql->pgsql_status);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
-
-	// ここではまだPostgreSQLとの接続はできていないので、'S'(SSL OK)か'N'(SSL NO)の一バイトメッセージか、
-	// もしくはメッセージタイプが'R'(Authentication)、'E'(ErrorResponse)、'v'(NegotiateProtocolVersion)以外は受け付けない
+	// ここではまだPostgreSQLとの接続はできていないので、メッセージタイプが'R'(Authentication)、'E'(ErrorResponse)、'v'(NegotiateProtocolVersion)以外は受け付けない
 	// メッセージタイプ別処理分岐
-	switch (message_type)
+	switch (pgmsg->message_type)
 	{
-		case 'S':                                                       // PostgreSQLからのレスポンスが'S'(SSL OK)なら
-			// PostgreSQLから受信したメッセージの長さは確認できないので、そのまま受け入れるしかない
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): this_pgsql->ssl_status %d -> 1!\n", __func__, this_pgsql->socket_fd, this_pgsql->ssl_status);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
-			// SSLハンドシェイク中(=1)に設定
-			this_pgsql->ssl_status = 1;
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> SSLRequest ACCEPTED.\n");
-			logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-			// PostgreSQL SSLハンドシェイク処理
-			api_result =  API_pgsql_SSLHandshake(this_pgsql);
-			// 戻る
-			return  api_result;
-			break;
-		case 'N':                                                       // PostgreSQLからのレスポンスが'N'(SSL NO)なら
-			// SSL/TLS接続は非対応らしい
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): this_pgsql->ssl_status %d -> 0!\n", __func__, this_pgsql->socket_fd, this_pgsql->ssl_status);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
-			// SSL接続状態を、0:非SSLに設定
-			this_pgsql->ssl_status = 0;
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> SSLRequest REJECTED.\n");
-			logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-			// PostgreSQL StartupMessage送信処理
-			api_result = API_pgsql_send_StartupMessage(this_pgsql);
-			// 戻る
-			return api_result;
-			break;
-		// --------------------------------
-		// 上記以外は通常のメッセージフォーマットのはず
-		// --------------------------------
-		case 'E':                                                       // 0x45 : E ... エラー(B)
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> %s. (message size=%d, len=0x%02x, 1st-field:%c, 1st-value:%s)\n", PgSQL_message_backend_str[message_type], 1 + message_len, message_len, message_ptr[5], message_ptr + 6);
-			logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-			break;
+		case 'E':                                                       // 0x45 : E ... エラー(B) ※認証エラー(28P01など)もデコード時に集計済み
 		case 'v':                                                       // 0x76 : v ... プロトコルバージョン交渉(B)
-			// サーバがサポートする最新のマイナープロトコルバージョンを取得(int32)
-			target_ptr = (unsigned char *)&request_minorversion_num;
-			*target_ptr =  message_ptr[8];
-			target_ptr ++;
-			*target_ptr =  message_ptr[7];
-			target_ptr ++;
-			*target_ptr =  message_ptr[6];
-			target_ptr ++;
-			*target_ptr =  message_ptr[5];
-			// サーバが認識しなかったプロトコルオプションの数(int32)
-			target_ptr = (unsigned char *)&unknown_option_num;
-			*target_ptr =  message_ptr[12];
-			target_ptr ++;
-			*target_ptr =  message_ptr[11];
-			target_ptr ++;
-			*target_ptr =  message_ptr[10];
-			target_ptr ++;
-			*target_ptr =  message_ptr[9];
-			// サーバが認識しなかったプロトコルオプション名(\0区切りで複数の可能性あり)
-			option_name = message_ptr + 13;
-			// 標準ログに出力
-			snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> %s. (message size=%d, len=0x%02x, request_minorversion_num:%d, unknown_option_num:%d, 1st-option_name:%s)\n", PgSQL_message_backend_str[message_type], 1 + message_len, message_len, request_minorversion_num, unknown_option_num, option_name);
-			logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
 			break;
 		case 'R':                                                       // 0x52 : R ... OKか、特定の認証が必要かはメッセージ内容による(B)
 			// PostgreSQL毎の状態が、1:接続開始でないなら
 			if (this_pgsql->pgsql_status != 1)
 			{
 				// エラー
-				snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Illegal Authentication Response!? (pgsql_status=%d)\n", __func__, this_pgsql->socket_fd, this_pgsql->pgsql_status);
-				logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+				LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): Illegal Authentication Response!? (pgsql_status=%d)\n", __func__, this_pgsql->socket_fd, this_pgsql->pgsql_status);
 				// 戻る
 				return -1;
 			}
-			// 認証方式を取得(int32)
-			target_ptr = (unsigned char *)&auth_type;
-			*target_ptr =  message_ptr[8];
-			target_ptr ++;
-			*target_ptr =  message_ptr[7];
-			target_ptr ++;
-			*target_ptr =  message_ptr[6];
-			target_ptr ++;
-			*target_ptr =  message_ptr[5];
 			// 認証方式別処理分岐
-			switch (auth_type)
+			switch (pgmsg->auth_type)
 			{
 				case 0:                                                 // AuthenticationOk
-					snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): this_pgsql->pgsql_status %d -> 2!!\n", __func__, this_pgsql->socket_fd, this_pgsql->pgsql_status);
-					logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+					// SCRAM-SHA-256認証の途中なら(サーバー署名を確かめていないので、なりすましかもしれない)
+					if (this_pgsql->scram_status == 1 || this_pgsql->scram_status == 2)
+					{
+						LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): AuthenticationOk before SCRAM completed!? (scram_status=%d)\n", __func__, this_pgsql->socket_fd, this_pgsql->scram_status);
+						return -1;
+					}
+					LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): this_pgsql->pgsql_status %d -> 2!!\n", __func__, this_pgsql->socket_fd, this_pgsql->pgsql_status);
 					// PostgreSQLへの接続状態を、2:接続中に設定
 					this_pgsql->pgsql_status = 2;
-					// AuthenticationOkについては、API_pgsql_server_decodequeryresponse()の方でログに出力するので、ここではログに出力しないことにする
 					break;
 				case 2:                                                 // AuthenticationKerberosV5 : Kerberos V5認証が必要
-					snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Type:AuthenticationKerberosV5 Length:%0d\n", __func__, this_pgsql->socket_fd, message_len);
-					logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-					break;
 				case 3:                                                 // AuthenticationCleartextPassword : 平文パスワードが必要
-					snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Type:AuthenticationCleartextPassword Length:%0d\n", __func__, this_pgsql->socket_fd, message_len);
-					logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-					break;
-				case 5:                                                 // AuthenticationMD5Password : MD5暗号化パスワードが必要
-					// 標準ログに出力
-					snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL -> AuthenticationMD5Password. (message size=%d, len=0x%02x, salt:0x%0hhx,0x%0hhx,0x%0hhx,0x%0hhx)\n", 1 + message_len, message_len, message_ptr[9], message_ptr[10], message_ptr[11], message_ptr[12]);
-					logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-					// PostgreSQL PasswordMessage(MD5)処理 (※ソルトキーはthis_pgsql->recv_buf + 9から4バイトで入っている)
-					api_result = API_pgsql_send_PasswordMessageMD5(this_pgsql);
-					break;
 				case 6:                                                 // AuthenticationSCMCredential : SCM資格証明メッセージが必要
-					snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Type:AuthenticationSCMCredential Length:%0d\n", __func__, this_pgsql->socket_fd, message_len);
-					logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-					break;
 				case 7:                                                 // AuthenticationGSS : GSSAPI認証証明メッセージが必要
-					snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Type:AuthenticationGSS Length:%0d\n", __func__, this_pgsql->socket_fd, message_len);
-					logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-					break;
 				case 8:                                                 // AuthenticationGSSContinue : GSSPAIまたはSSPIデータを含む
-					snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Type:AuthenticationGSSContinue Length:%0d Data:0x%0hx...\n", __func__, this_pgsql->socket_fd, message_len, message_ptr[9]);
-					logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-					break;
 				case 9:                                                 // AuthenticationSSPI : SSPI認証証明メッセージが必要
-					snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Type:AuthenticationSSPI Length:%0d Data:%s...\n", __func__, this_pgsql->socket_fd, message_len, message_ptr + 9);
-					logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
+					// ログへの出力はデコード時に済んでいる
+					break;
+				case 5:                                                 // AuthenticationMD5Password : MD5暗号化パスワードが必要
+					// PostgreSQL PasswordMessage(MD5)処理 (※ソルトキーはthis_pgsql->recv_buf + 9から4バイトで入っている)
+					api_result = API_pgsql_send_PasswordMessageMD5(this_pgsql);
 					break;
-				// GitHUB公開版では、SASL認証(sha256認証)については削除する(OpenSSLのBASE64関連が使いづらく、PostgreSQLのソースからBASE64関連含めてコピーしたらできるよ)
 				case 10:                                                // AuthenticationSASL : SASL認証が必要
+					// SCRAM-SHA-256認証開始処理(SASLInitialResponseを送る)
+					api_result = API_scram_start(this_pgsql, pgmsg);
+					break;
 				case 11:                                                // AuthenticationSASLContinue : SASLのチャレンジを含む
+					// SCRAM-SHA-256認証継続処理(SASLResponseを送る)
+					api_result = API_scram_continue(this_pgsql, pgmsg);
+					break;
 				case 12:                                                // AuthenticationSASLFinal : SASL認証が完了
+					// SCRAM-SHA-256認証完了処理(サーバー署名を確かめる。この後にAuthenticationOkが来る)
+					api_result = API_scram_final(this_pgsql, pgmsg);
+					break;
 				default:
 					// エラー
-					snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Illegal Authentication Response!? (auth_type=%d)\n", __func__, this_pgsql->socket_fd, auth_type);
-					logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+					LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): Illegal Authentication Response!? (auth_type=%d)\n", __func__, this_pgsql->socket_fd, pgmsg->auth_type);
 					// 戻る
 					return -1;
 					break;
 			}
 			break;
 		default:
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Illegal SSLRequest Response!? Type:%s Length:%0d Data:%s!?\n", __func__, this_pgsql->socket_fd, PgSQL_message_backend_str[message_type], message_len, message_ptr + 5);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): Illegal Startup Response!? Type:%s Length:%0d!?\n", __func__, this_pgsql->socket_fd, PgSQL_message_backend_str[pgmsg->message_type & 0x7F], pgmsg->message_len);
 			// 戻る
 			return -1;
 			break;
@@ -595,69 +228,82 @@ int API_pgsql_server_decodestartresponse(struct EVS_ev_pgsql_t *this_pgsql, char
 }
 
 // --------------------------------
-// PostgreSQL側メッセージ処理 ※この処理はアイドルイベント時にのみ、溜まっているメッセージ用キューのログへの出力として呼び出される。なので、PostgreSQLの状態は2より大きいはず。
+// PostgreSQL側SSLRequestレスポンス処理 ※'S'(SSL OK)か'N'(SSL NO)の一バイトメッセージ
 // --------------------------------
-int API_pgsql_server_message(struct EVS_ev_message_t *message_info)
+int API_pgsql_server_sslresponse(struct EVS_ev_pgsql_t *this_pgsql, char ssl_response)
 {
 	int                             api_result = 0;
 	char                            log_str[MAX_LOG_LENGTH];
 
-////    struct EVS_ev_client_t          *this_client = (struct EVS_ev_client_t *)this_pgsql->client_info;
+	// ダンプ出力
+	dump2log(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, (void *)this_pgsql->recv_buf, this_pgsql->recv_len);
+
+	// PostgreSQLからのレスポンスが'S'(SSL OK)なら
+	if (ssl_response == 'S')
+	{
+		// PostgreSQLから受信したメッセージの長さは確認できないので、そのまま受け入れるしかない
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): this_pgsql->ssl_status %d -> 1!\n", __func__, this_pgsql->socket_fd, this_pgsql->ssl_status);
+		// SSLハンドシェイク中(=1)に設定
+		this_pgsql->ssl_status = 1;
+		// 標準ログに出力
+		LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "PostgreSQL -> SSLRequest ACCEPTED.\n");
+		// PostgreSQL SSLハンドシェイク処理
+		api_result =  API_pgsql_SSLHandshake(this_pgsql);
+	}
+	// PostgreSQLからのレスポンスが'N'(SSL NO)なら
+	else
+	{
+		// SSL/TLS接続は非対応らしい
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): this_pgsql->ssl_status %d -> 0!\n", __func__, this_pgsql->socket_fd, this_pgsql->ssl_status);
+		// SSL接続状態を、0:非SSLに設定
+		this_pgsql->ssl_status = 0;
+		// 標準ログに出力
+		LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "PostgreSQL -> SSLRequest REJECTED.\n");
+		// PostgreSQL StartupMessage送信処理
+		api_result = API_pgsql_send_StartupMessage(this_pgsql);
+	}
+	// 戻る
+	return api_result;
+}
 
-	char                            *message_ptr = message_info->message_ptr;
-	unsigned int                    message_len = message_info->message_len;
+// --------------------------------
+// PostgreSQL側メッセージ処理 ※この処理はアイドルイベント時にのみ、溜まっているメッセージ用キューのログへの出力として呼び出される。なので、PostgreSQLの状態は2より大きいはず。
+// --------------------------------
+int API_pgsql_server_message(struct EVS_ev_message_t *message_info)
+{
+	int                             api_result = 0;
+	char                            log_str[MAX_LOG_LENGTH];
 
-	unsigned char                   *target_ptr;
+	struct EVS_pgmsg_t              pgmsg;                              // PostgreSQLメッセージ解析用構造体
+	struct EVS_session_t            *this_session = (struct EVS_session_t *)message_info->session_info;
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): START! message_len=%d, pgsql_status=%d\n", __func__, message_info->pgsql_socket_fd, message_info->message_len, message_info->pgsql_status);
-	logging(LOG_DIRECT, LOGLEVEL_DEBUG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_DIRECT, LOGLEVEL_DEBUG, &(message_info->message_tv), log_str, "%s(pgsql=%d): START! message_len=%d, pgsql_status=%d\n", __func__, message_info->pgsql_socket_fd, message_info->message_len, message_info->pgsql_status);
 
-	// PostgreSQL用受信バッファが解析できる限り、ループ
-	while (1)
+	// PostgreSQLの状態が、10:透過モードでないなら
+	if (message_info->pgsql_status != 10)
 	{
-		// PostgreSQLの状態が、10:透過モードでないなら
-		if (message_info->pgsql_status != 10)
-		{
-			// エラー
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Illegal PostgreSQL Status(=%d)!?\n", __func__, message_info->pgsql_socket_fd, message_info->pgsql_status);
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
-			// 戻る
-			return -1;
-		}
+		// エラー
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): Illegal PostgreSQL Status(=%d)!?\n", __func__, message_info->pgsql_socket_fd, message_info->pgsql_status);
+		// 戻る
+		return -1;
+	}
 
-		// メッセージ長を取得(int32)
-		target_ptr = (unsigned char *)&message_len;
-		*target_ptr =  message_ptr[4];
-		target_ptr ++;
-		*target_ptr =  message_ptr[3];
-		target_ptr ++;
-		*target_ptr =  message_ptr[2];
-		target_ptr ++;
-		*target_ptr =  message_ptr[1];
-
-		// PostgreSQL側各種クエリレスポンス解析処理
-		api_result = API_pgsql_message_decodequeryresponse(message_info, message_ptr, message_len);
-		// 正常終了でないなら
-		if (api_result != 0)
-		{
-			// 戻る
-			return api_result;
-		}
+	// ダンプ出力
+	dump2log(LOG_DIRECT, LOGLEVEL_DUMP, &(message_info->message_tv), message_info->message_ptr, message_info->message_len);
 
-		// メッセージの先頭ポインタを更新
-		message_ptr += message_len + 1;
-		// メッセージの先頭ポインタが、PostgreSQLからのメッセージ長を超えたら 
-		if (message_ptr >= (char *)(message_info->message_ptr + message_info->message_len))
-		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Message END!\n", __func__, message_info->pgsql_socket_fd);
-			logging(LOG_DIRECT, LOGLEVEL_DEBUG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
-			// while()を抜ける
-			break;
-		}
-	}
+	// 受信データ内の全メッセージのデコード処理
+	memset(&pgmsg, 0, sizeof(pgmsg));
+	pgmsg.from_client = 0;
+	pgmsg.log_type = LOG_DIRECT;
+	pgmsg.log_tv = &(message_info->message_tv);
+	pgmsg.addr_str = message_info->client_addr_str;
+	pgmsg.session_info = this_session;
+	api_result = API_pgsql_decode_stream(&pgmsg, (this_session != NULL) ? &this_session->stream[1] : NULL, message_info->message_ptr, message_info->message_len);
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): END!\n", __func__, message_info->pgsql_socket_fd);
-	logging(LOG_DIRECT, LOGLEVEL_DEBUG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
+	// PostgreSQLから送られてきたメッセージは、受信時にそのままクライアントに送信済み
+	LOGGING(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), log_str, "PgAnalyzer -> Client(%s) (message size=%d)\n", message_info->client_addr_str, message_info->message_len);
+
+	LOGGING(LOG_DIRECT, LOGLEVEL_DEBUG, &(message_info->message_tv), log_str, "%s(pgsql=%d): END!\n", __func__, message_info->pgsql_socket_fd);
 
 	// 戻る
 	return api_result;
@@ -674,12 +320,18 @@ int API_pgsql_server(struct EVS_ev_pgsql_t *this_pgsql)
 	struct EVS_ev_client_t          *this_client = (struct EVS_ev_client_t *)this_pgsql->client_info;
 
 	char                            *message_ptr = this_pgsql->recv_buf;
-	unsigned int                    message_len = this_pgsql->recv_len;
+	char                            *end_ptr = this_pgsql->recv_buf + this_pgsql->recv_len;
 
-	unsigned char                   *target_ptr;
+	struct EVS_pgmsg_t              pgmsg;                              // PostgreSQLメッセージ解析用構造体
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): START! recv_len=%d, pgsql_status=%d\n", __func__, this_pgsql->socket_fd, this_pgsql->recv_len, this_pgsql->pgsql_status);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): START! recv_len=%d, pgsql_status=%d\n", __func__, this_pgsql->socket_fd, this_pgsql->recv_len, this_pgsql->pgsql_status);
+
+	// PostgreSQLの状態が、20:プール待機中か21:リセット中なら(クライアントには送らない)
+	if (this_pgsql->pgsql_status == 20 || this_pgsql->pgsql_status == 21)
+	{
+		// プール接続受信処理
+		return API_pool_server(this_pgsql);
+	}
 
 	// PostgreSQLの状態が、2:接続中より大きいなら
 	if (this_pgsql->pgsql_status > 2)
@@ -688,14 +340,34 @@ int API_pgsql_server(struct EVS_ev_pgsql_t *this_pgsql)
 		// 透過モード処理　※メッセージをその都度解析していたら遅くなるので、いったん接続状態になったら、メッセージをキューに入れて後で解析する
 		// ------------------------------------
 		struct EVS_ev_message_t         *message_info;                      // メッセージ用構造体ポインタ
+		unsigned int                    message_len;                        // キューに入れるメッセージ長
+
+		// PostgreSQLから送られてきたクエリメッセージを、クライアントに対して送信する(PostgreSQL→クライアントは、そのままでは送らない)
+		api_result = API_pgsql_client_send(this_client, this_pgsql->recv_buf, this_pgsql->recv_len);
+		// キャプチャデータ出力処理(COPY中継処理で受信データが詰められる前に)
+		API_capture_data(this_client, 0, this_pgsql->recv_buf, this_pgsql->recv_len);
+		// 問い合わせ終了判定処理(受信データの最後がReadyForQueryなら、プールに戻せる)
+		API_pool_received(this_pgsql, this_pgsql->recv_buf, this_pgsql->recv_len);
+		// 接続先ホスト応答処理(受信データの最後がReadyForQueryなら、応答時間を更新する)
+		API_balance_response(this_pgsql, this_pgsql->recv_buf, this_pgsql->recv_len);
+
+		// COPY中継処理(CopyDataは数えるだけにして、受信データから取り除く)
+		message_len = API_copy_relay(this_client, 0, this_pgsql->recv_buf, this_pgsql->recv_len);
+		// キューに入れるメッセージが残っていないなら(COPY中のCopyDataだけだったなら)
+		if (message_len == 0)
+		{
+			// プール接続解放判定処理(トランザクション単位のプールで、トランザクションが終わったならプールに返す)
+			API_pool_idle(this_pgsql);
+			// 戻る
+			return api_result;
+		}
 
 		// メッセージ用構造体ポインタのメモリ領域を確保
 		message_info = (struct EVS_ev_message_t *)calloc(1, sizeof(struct EVS_ev_message_t));
 		// メモリ領域が確保できなかったら
 		if (message_info == NULL)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Cannot calloc message_info's memory? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): Cannot calloc message_info's memory? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, errno, strerror(errno));
 			return -1;
 		}
 
@@ -710,71 +382,95 @@ int API_pgsql_server(struct EVS_ev_pgsql_t *this_pgsql)
 		message_info->pgsql_status = this_pgsql->pgsql_status;              // PostgreSQL毎の状態
 		message_info->pgsql_ssl_status = this_pgsql->ssl_status;            // PostgreSQL毎のSSL接続状態
 		strcpy(message_info->pgsql_addr_str, this_pgsql->addr_str);         // PostgreSQLのアドレス文字列
+		message_info->session_info = this_client->session_info;             // セッション別解析情報
 
 		gettimeofday(&message_info->message_tv, NULL);                      // 現在時刻を取得してmessage_info->message_tvに格納
 
-		// 受信したデータ分だけメモリ確保
-		message_info->message_ptr = malloc(this_pgsql->recv_len);
+		// 受信したデータ(から取り除いた残り)の分だけメモリ確保
+		message_info->message_ptr = malloc(message_len);
 		// メモリ領域が確保できなかったら
 		if (message_info->message_ptr == NULL)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Cannot calloc message_info->message_ptr's memory? errno=%d (%s)\n", __func__, this_client->socket_fd, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): Cannot calloc message_info->message_ptr's memory? errno=%d (%s)\n", __func__, this_client->socket_fd, errno, strerror(errno));
 			return -1;
 		}
 		// 受信したデータをコピー
-		memcpy(message_info->message_ptr, this_pgsql->recv_buf, this_pgsql->recv_len);
-		message_info->message_len = this_pgsql->recv_len;
+		memcpy(message_info->message_ptr, this_pgsql->recv_buf, message_len);
+		message_info->message_len = message_len;
 
 		// --------------------------------
 		// テールキュー処理
 		// --------------------------------
 		// テールキューの最後にこの接続の情報を追加する
-		TAILQ_INSERT_TAIL(&EVS_message_tailq, message_info, entries);
+		API_spool_insert(message_info);
 
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INSERT_TAIL(message): OK.\n", __func__);
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): TAILQ_INSERT_TAIL(message): OK.\n", __func__);
 
-		// PostgreSQLから送られてきたクエリメッセージを、クライアントに対して送信する(PostgreSQL→クライアントは、そのままでは送らない)
-		api_result = API_pgsql_client_send(this_client, this_pgsql->recv_buf, this_pgsql->recv_len);
+		// プール接続解放判定処理(トランザクション単位のプールで、トランザクションが終わったならプールに返す)
+		API_pool_idle(this_pgsql);
 
 		// 戻る
 		return api_result;
 	}
 	//// 透過モード、ここまで
 
+	// PostgreSQLの状態が、1:接続開始で、'S'(SSL OK)か'N'(SSL NO)の一バイトだけが来たなら、SSLRequestへのレスポンス
+	if (this_pgsql->pgsql_status == 1 && this_pgsql->recv_len == 1 && (message_ptr[0] == 'S' || message_ptr[0] == 'N'))
+	{
+		// PostgreSQL側SSLRequestレスポンス処理
+		return API_pgsql_server_sslresponse(this_pgsql, message_ptr[0]);
+	}
+
+	// ダンプ出力
+	dump2log(LOG_QUEUEING, LOGLEVEL_DUMP, NULL, (void *)this_pgsql->recv_buf, this_pgsql->recv_len);
+
+	memset(&pgmsg, 0, sizeof(pgmsg));
+	pgmsg.from_client = 0;
+	pgmsg.log_type = LOG_QUEUEING;
+	pgmsg.log_tv = NULL;
+	// 事前接続(クライアントのいない接続)なら、PostgreSQLのアドレスでログに出力する
+	pgmsg.addr_str = (this_client != NULL) ? this_client->addr_str : this_pgsql->addr_str;
+	pgmsg.session_info = (this_client != NULL) ? (struct EVS_session_t *)this_client->session_info : NULL;
+
 	// PostgreSQL用受信バッファが解析できる限り、ループ
-	while (1)
+	while (message_ptr < end_ptr)
 	{
 		// PostgreSQLの状態が、0:未接続、もしくは1:接続開始や2:接続中以外なら
 		if (this_pgsql->pgsql_status == 0 ||
 			this_pgsql->pgsql_status > 2)
 		{
 			// エラー
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Illegal PostgreSQL Status(=%d)!?\n", __func__, this_pgsql->socket_fd, this_pgsql->pgsql_status);
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): Illegal PostgreSQL Status(=%d)!?\n", __func__, this_pgsql->socket_fd, this_pgsql->pgsql_status);
 			// 戻る
 			return -1;
 		}
 
-		// メッセージ長を取得(int32)
-		target_ptr = (unsigned char *)&message_len;
-		*target_ptr =  message_ptr[4];
-		target_ptr ++;
-		*target_ptr =  message_ptr[3];
-		target_ptr ++;
-		*target_ptr =  message_ptr[2];
-		target_ptr ++;
-		*target_ptr =  message_ptr[1];
+		// メッセージヘッダ解析処理(メッセージ全体が受信バッファ内に収まっていないなら)
+		if (API_pgsql_decode_header(&pgmsg, message_ptr, end_ptr) != 1)
+		{
+			// エラー
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): Illegal message length!? (recv_len=%d, offset=%d)\n", __func__, this_pgsql->socket_fd, this_pgsql->recv_len, (int)(message_ptr - this_pgsql->recv_buf));
+			// 戻る
+			return -1;
+		}
 
 		// ------------------------------------
 		// PostgreSQLからのメッセージ解析
 		// ------------------------------------
+		// メッセージタイプ別デコード処理(ログ出力や、エラー集計などの解析)
+		api_result = API_pgsql_decode_message(&pgmsg);
+		// 正常終了でないなら
+		if (api_result != 0)
+		{
+			// 戻る
+			return api_result;
+		}
+
 		// PostgreSQLの状態が、1:接続開始なら
 		if (this_pgsql->pgsql_status == 1)
 		{
-			// PostgreSQL側開始メッセージレスポンス解析処理
-			api_result = API_pgsql_server_decodestartresponse(this_pgsql, message_ptr, message_len);
+			// PostgreSQL側開始メッセージレスポンス処理
+			api_result = API_pgsql_server_decodestartresponse(this_pgsql, &pgmsg);
 			// 正常終了でないなら
 			if (api_result != 0)
 			{
@@ -786,8 +482,8 @@ int API_pgsql_server(struct EVS_ev_pgsql_t *this_pgsql)
 		// PostgreSQLの状態が、2:接続中なら
 		if (this_pgsql->pgsql_status == 2)
 		{
-			// PostgreSQL側各種クエリレスポンス解析処理
-			api_result = API_pgsql_server_decodequeryresponse(this_pgsql, message_ptr, message_len);
+			// PostgreSQL側各種クエリレスポンス処理
+			api_result = API_pgsql_server_decodequeryresponse(this_pgsql, &pgmsg);
 			// 正常終了でないなら
 			if (api_result != 0)
 			{
@@ -797,19 +493,22 @@ int API_pgsql_server(struct EVS_ev_pgsql_t *this_pgsql)
 		}
 
 		// メッセージの先頭ポインタを更新
-		message_ptr += message_len + 1;
-		// メッセージの先頭ポインタが、PostgreSQLからのメッセージ長を超えたら 
-		if (message_ptr >= this_pgsql->recv_buf + this_pgsql->recv_len)
-		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Message END!\n", __func__, this_pgsql->socket_fd);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
-			// while()を抜ける
-			break;
-		}
+		message_ptr += pgmsg.message_len + 1;
+	}
+
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): Message END!\n", __func__, this_pgsql->socket_fd);
+
+	// 事前接続なら
+	if (this_pgsql->pool_warm != 0)
+	{
+		// プール事前接続完了処理(接続処理が終わったなら、プールに入れる)
+		return API_pool_ready(this_pgsql);
 	}
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): END!\n", __func__, this_pgsql->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	// プール接続解放判定処理(トランザクション単位のプールで、接続処理が終わったならプールに返すか、待っていたクライアントの問い合わせを送る)
+	API_pool_idle(this_pgsql);
+
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): END!\n", __func__, this_pgsql->socket_fd);
 
 	// 戻る
 	return api_result;
@@ -836,15 +535,13 @@ static void CB_pgsqlrecv(struct ev_loop* loop, struct ev_io *watcher, int revent
 	// イベントにエラーフラグが含まれていたら
 	if (EV_ERROR & revents)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Invalid event!?\n", __func__);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Invalid event!?\n", __func__);
 		// アイドルイベント開始(メッセージ用キュー処理)
 		ev_idle_start(loop, &idle_message_watcher);
 		return;
 	}
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): OK. ssl_status=%d\n", __func__, this_pgsql->socket_fd, this_pgsql->ssl_status);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): OK. ssl_status=%d\n", __func__, this_pgsql->socket_fd, this_pgsql->ssl_status);
 
 /*  // PostgreSQLについては無通信タイムアウトチェックをひとまず実装しないことにする
 	// ----------------
@@ -854,8 +551,7 @@ static void CB_pgsqlrecv(struct ev_loop* loop, struct ev_io *watcher, int revent
 	{
 		ev_now_update(loop);                                            // イベントループの日時を現在の日時に更新
 		this_pgsql->last_activity = ev_now(loop);                       // 最終アクティブ日時(監視対象が最後にアクティブとなった日時)を設定する
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): last_activity=%.0f\n", __func__, this_pgsql->socket_fd, this_pgsql->last_activity);
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): last_activity=%.0f\n", __func__, this_pgsql->socket_fd, this_pgsql->last_activity);
 	}
 */
 	// ----------------
@@ -871,8 +567,11 @@ static void CB_pgsqlrecv(struct ev_loop* loop, struct ev_io *watcher, int revent
 		// 読み込めたメッセージ量が負(<0)だったら(エラーです)
 		if (socket_result < 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Cannot recv message? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): Cannot recv message? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, errno, strerror(errno));
+			// 直前のイベントを調べられるように、フライトレコーダーをダンプする
+			flight_dump("CB_pgsqlrecv(): recv() error", 0);
+			// 接続先ホスト切断処理(応答待ちのまま切断されたなら、失敗として数える)
+			API_balance_lost(this_pgsql);
 			// ----------------
 			// PostgreSQL接続終了処理(バッファ開放、ソケットクローズ、PostgreSQL用キューからの削除、イベントの停止)
 			// ----------------
@@ -884,8 +583,9 @@ static void CB_pgsqlrecv(struct ev_loop* loop, struct ev_io *watcher, int revent
 		// 読み込めたメッセージ量が0だったら(切断処理をする)
 		else if (socket_result == 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): socket_result == 0.\n", __func__, this_pgsql->socket_fd);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): socket_result == 0.\n", __func__, this_pgsql->socket_fd);
+			// 接続先ホスト切断処理(応答待ちのまま切断されたなら、失敗として数える)
+			API_balance_lost(this_pgsql);
 			// ----------------
 			// PostgreSQL接続終了処理(バッファ開放、ソケットクローズ、PostgreSQL用キューからの削除、イベントの停止)
 			// ----------------
@@ -901,8 +601,7 @@ static void CB_pgsqlrecv(struct ev_loop* loop, struct ev_io *watcher, int revent
 			this_pgsql->recv_len = socket_result;
 			this_pgsql->recv_buf[this_pgsql->recv_len] = '\0';
 
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Recieved %d bytes, recv_len=%d. A\n", __func__, this_pgsql->socket_fd, socket_result, this_pgsql->recv_len);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): Recieved %d bytes, recv_len=%d. A\n", __func__, this_pgsql->socket_fd, socket_result, this_pgsql->recv_len);
 		}
 		// クライアント毎の状態が、3:レスポンスデータ待ちなら
 		else
@@ -911,8 +610,7 @@ static void CB_pgsqlrecv(struct ev_loop* loop, struct ev_io *watcher, int revent
 			this_pgsql->recv_len += socket_result;
 			this_pgsql->recv_buf[this_pgsql->recv_len] = '\0';
 
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Recieved %d bytes, recv_len=%d. B\n", __func__, this_pgsql->socket_fd, socket_result, this_pgsql->recv_len);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): Recieved %d bytes, recv_len=%d. B\n", __func__, this_pgsql->socket_fd, socket_result, this_pgsql->recv_len);
 		}
 	}
 	// ----------------
@@ -922,8 +620,7 @@ static void CB_pgsqlrecv(struct ev_loop* loop, struct ev_io *watcher, int revent
 	{
 		// 対PostgreSQL(クライアントとして動作)の場合には、接続からハンドシェイクがうまくいったかどうかまで、API_pgsql_server_decodestartresponse()で処理しないといけない
 		// が、PostgreSQLとのやり取りをするということは、CB_pgsqlrecv()が呼ばれるのでハンドシェイク中に呼ばれた場合にはスルーしないといけない
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Recieved msg_len=%d.\n", __func__, this_pgsql->socket_fd, this_pgsql->recv_len);
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): Recieved msg_len=%d.\n", __func__, this_pgsql->socket_fd, this_pgsql->recv_len);
 		// アイドルイベント開始(メッセージ用キュー処理)
 		ev_idle_start(loop, &idle_message_watcher);
 		return;
@@ -941,8 +638,11 @@ static void CB_pgsqlrecv(struct ev_loop* loop, struct ev_io *watcher, int revent
 		// 読み込めたメッセージ量が負(<0)だったら(エラーです)
 		if (socket_result < 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): SSL_read(): Cannot read decrypted message!?\n", __func__, this_pgsql->socket_fd, ERR_reason_error_string(ERR_get_error()));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): SSL_read(): Cannot read decrypted message!?\n", __func__, this_pgsql->socket_fd, ERR_reason_error_string(ERR_get_error()));
+			// 直前のイベントを調べられるように、フライトレコーダーをダンプする
+			flight_dump("CB_pgsqlrecv(): SSL_read() error", 0);
+			// 接続先ホスト切断処理(応答待ちのまま切断されたなら、失敗として数える)
+			API_balance_lost(this_pgsql);
 			// ----------------
 			// PostgreSQL接続終了処理(バッファ開放、ソケットクローズ、PostgreSQL用キューからの削除、イベントの停止)
 			// ----------------
@@ -954,8 +654,9 @@ static void CB_pgsqlrecv(struct ev_loop* loop, struct ev_io *watcher, int revent
 		// 読み込めたメッセージ量が0だったら(切断処理をする)
 		if (socket_result == 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): socket_result == 0.\n", __func__, this_pgsql->socket_fd);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): socket_result == 0.\n", __func__, this_pgsql->socket_fd);
+			// 接続先ホスト切断処理(応答待ちのまま切断されたなら、失敗として数える)
+			API_balance_lost(this_pgsql);
 			// ----------------
 			// PostgreSQL接続終了処理(バッファ開放、ソケットクローズ、PostgreSQL用キューからの削除、イベントの停止)
 			// ----------------
@@ -972,8 +673,7 @@ static void CB_pgsqlrecv(struct ev_loop* loop, struct ev_io *watcher, int revent
 			this_pgsql->recv_len = socket_result;
 			this_pgsql->recv_buf[this_pgsql->recv_len] = '\0';
 
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Recieved %d bytes, recv_len=%d. C\n", __func__, this_pgsql->socket_fd, socket_result, this_pgsql->recv_len);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): Recieved %d bytes, recv_len=%d. C\n", __func__, this_pgsql->socket_fd, socket_result, this_pgsql->recv_len);
 		}
 		// クライアント毎の状態が、3:レスポンスデータ待ちなら
 		else
@@ -982,8 +682,7 @@ static void CB_pgsqlrecv(struct ev_loop* loop, struct ev_io *watcher, int revent
 			this_pgsql->recv_len += socket_result;
 			this_pgsql->recv_buf[this_pgsql->recv_len] = '\0';
 
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Recieved %d bytes, recv_len=%d. D\n", __func__, this_pgsql->socket_fd, socket_result, this_pgsql->recv_len);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): Recieved %d bytes, recv_len=%d. D\n", __func__, this_pgsql->socket_fd, socket_result, this_pgsql->recv_len);
 		}
 	}
 
@@ -996,8 +695,9 @@ static void CB_pgsqlrecv(struct ev_loop* loop, struct ev_io *watcher, int revent
 	// APIの処理結果がエラー(=-1)だったら(切断処理をする)
 	if (socket_result != 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): API ERROR!? socket_result=%d\n", __func__, this_pgsql->socket_fd, socket_result);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): API ERROR!? socket_result=%d\n", __func__, this_pgsql->socket_fd, socket_result);
+		// 直前のイベントを調べられるように、フライトレコーダーをダンプする
+		flight_dump("CB_pgsqlrecv(): API error", 0);
 		// ----------------
 		// PostgreSQL接続終了処理(バッファ開放、ソケットクローズ、PostgreSQL用キューからの削除、イベントの停止)
 		// ----------------
@@ -1037,12 +737,10 @@ int API_pgsql_server_send(struct EVS_ev_pgsql_t *this_pgsql, unsigned char *mess
 		// 送信したバイト数が負(<0)だったら(エラーです)
 		if (api_result < 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): send(): Cannot send message? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): send(): Cannot send message? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, errno, strerror(errno));
 			return api_result;
 		}
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): send(): OK. length=%d\n", __func__, this_pgsql->socket_fd, message_len);
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): send(): OK. length=%d\n", __func__, this_pgsql->socket_fd, message_len);
 	}
 	// ----------------
 	// SSLハンドシェイク中なら
@@ -1063,20 +761,61 @@ int API_pgsql_server_send(struct EVS_ev_pgsql_t *this_pgsql, unsigned char *mess
 		// 送信したバイト数が負(<0)だったら(エラーです)
 		if (api_result < 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): SSL_write(): Cannot write encrypted message!?\n", __func__, this_pgsql->socket_fd, ERR_reason_error_string(ERR_get_error()));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): SSL_write(): Cannot write encrypted message!?\n", __func__, this_pgsql->socket_fd, ERR_reason_error_string(ERR_get_error()));
 			return api_result;
 		}
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): SSL_write(): OK. length=%d\n", __func__, this_pgsql->socket_fd, message_len);
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): SSL_write(): OK. length=%d\n", __func__, this_pgsql->socket_fd, message_len);
 	}
 	// 戻る
 	return 0;
 }
 
+// --------------------------------
+// PostgreSQL接続用データ事前生成処理 ※設定を読み込んだ時、ワイルドカードの設定から作った時に呼ばれる
+// --------------------------------
+// 接続毎に同じになるStartupMessageと、MD5認証のmd5(パスワード+ユーザー名)は、データベース別設定毎に一度だけ作っておく
+int API_pgsql_prepare(struct EVS_db_t *db_info)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	char                            *target_ptr = db_info->startup_message;
+	int                             hash_len;
+
+	// StartupMessage : int32 長さ + int32 プロトコルバージョン(3.0) + 設定値名と設定値(\0終端)の列 + \0
+	target_ptr += 8;
+	target_ptr += snprintf(target_ptr, sizeof(db_info->startup_message) - (target_ptr - db_info->startup_message), "database") + 1;
+	target_ptr += snprintf(target_ptr, sizeof(db_info->startup_message) - (target_ptr - db_info->startup_message), "%s", db_info->database) + 1;
+	target_ptr += snprintf(target_ptr, sizeof(db_info->startup_message) - (target_ptr - db_info->startup_message), "user") + 1;
+	target_ptr += snprintf(target_ptr, sizeof(db_info->startup_message) - (target_ptr - db_info->startup_message), "%s", db_info->username) + 1;
+	// アプリケーション名(必要なのかな!?)
+	target_ptr += snprintf(target_ptr, sizeof(db_info->startup_message) - (target_ptr - db_info->startup_message), "application_name") + 1;
+	target_ptr += snprintf(target_ptr, sizeof(db_info->startup_message) - (target_ptr - db_info->startup_message), "%s", EVS_NAME) + 1;
+	// StartupMessageは0x00で終わる事!!
+	*target_ptr ++ = 0x00;
+	db_info->startup_message_len = target_ptr - db_info->startup_message;
+	db_info->startup_message[0] = (char)(db_info->startup_message_len >> 24);
+	db_info->startup_message[1] = (char)(db_info->startup_message_len >> 16);
+	db_info->startup_message[2] = (char)(db_info->startup_message_len >> 8);
+	db_info->startup_message[3] = (char)db_info->startup_message_len;
+	db_info->startup_message[4] = 0x00;
+	db_info->startup_message[5] = 0x03;
+	db_info->startup_message[6] = 0x00;
+	db_info->startup_message[7] = 0x00;
+
+	// 暗号化データ生成(md5(パスワード+ユーザー名)のHEX文字列。接続毎には、これとソルトのmd5だけを求める)
+	hash_len = gethashdata("md5", db_info->password, strlen(db_info->password), db_info->username, strlen(db_info->username), db_info->md5_password);
+	if (hash_len != MD5_HEX_LENGTH)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): gethashdata() error!? (hash_len=%d)\n", __func__, hash_len);
+		db_info->md5_password[0] = '\0';
+		return -1;
+	}
+	return 0;
+}
+
 // --------------------------------
 // PostgreSQL PasswordMessage(MD5)処理 (※ソルトキーはthis_pgsql->recv_buf + 9から4バイトで入っている)
 // --------------------------------
+// "md5" + md5(md5(パスワード+ユーザー名) + ソルト)を送る。md5(パスワード+ユーザー名)はAPI_pgsql_prepare()で求めてある
 int API_pgsql_send_PasswordMessageMD5(struct EVS_ev_pgsql_t *this_pgsql)
 {
 	int                             api_result = 0;
@@ -1084,103 +823,51 @@ int API_pgsql_send_PasswordMessageMD5(struct EVS_ev_pgsql_t *this_pgsql)
 
 	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_pgsql->db_info;
 
-	char                            *hash_type = {"md5"};               // ハッシュ化タイプ("md5", "sha256"など)
-
-	char                            *hash_passwordusername;             // gethashdata(password+username)のハッシュ化データ格納ポインタ
-	char                            *hash_data;                         // gethashdata("md5" + gethashdata(password+username) + salt_key)のハッシュ化データ格納ポインタ
-	int                             hash_len;
-
 	char                            *message_ptr = this_pgsql->recv_buf;
+	char                            hash_data[5 + 3 + MD5_HEX_LENGTH + 1];     // PasswordMessage : 'p' + int32 長さ + "md5" + HEX文字列 + \0
+	unsigned char                   md_value[EVP_MAX_MD_SIZE];          // ダイジェスト値格納先
+	unsigned int                    md_len;                             // ダイジェスト長
 	unsigned int                    message_len;
 
-	// ----------------
-	// gethashdata(password+username)のハッシュ化データ格納ポインタのメモリ領域を確保(EVP_MAX_MD_SIZE*2 + \0分でいいんだけど、面倒なのでMAX_SIZE_1K)
-	// ----------------
-	hash_passwordusername = (char *)calloc(1, MAX_SIZE_1K);
-	// メモリ領域が確保できなかったら
-	if (hash_passwordusername == NULL)
+	// 接続毎に使い回すダイジェストコンテキスト(初めて使う時に作る)
+	if (EVS_md5_ctx == NULL && (EVS_md5_ctx = EVP_MD_CTX_new()) == NULL)
 	{
-		// エラー
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Cannot calloc hash_passwordusername's memory? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): EVP_MD_CTX_new() error!? %s\n", __func__, this_pgsql->socket_fd, ERR_reason_error_string(ERR_get_error()));
 		return -1;
 	}
-	// ----------------
-	// 暗号化データ生成(暗号化方式(文字列で"md5", "sha256"など)、暗号対象データ、暗号対象データ長、ソルトデータ、ソルトデータ長、ハッシュ化データ格納ポインタ)
-	// ----------------
-	hash_len = gethashdata(hash_type, db_info->password, strlen(db_info->password), db_info->username, strlen(db_info->username), hash_passwordusername);
-	if (hash_len == -1)
+	if (db_info->md5_password[0] == '\0' ||
+		EVP_DigestInit_ex(EVS_md5_ctx, EVP_md5(), NULL) != 1 ||
+		EVP_DigestUpdate(EVS_md5_ctx, db_info->md5_password, MD5_HEX_LENGTH) != 1 ||
+		EVP_DigestUpdate(EVS_md5_ctx, message_ptr + 9, 4) != 1 ||
+		EVP_DigestFinal_ex(EVS_md5_ctx, md_value, &md_len) != 1)
 	{
-		// エラー
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): gethashdata() error!?\n", __func__, this_pgsql->socket_fd);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
-		free(hash_passwordusername);
-		return -1;
-	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): hash_passwordusername's hash_len=%d\n", __func__, this_pgsql->socket_fd, hash_len);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
-
-	// ----------------
-	// gethashdata("md5" + gethashdata(password+username) + salt_key)のハッシュ化データ格納ポインタのメモリ領域を確保 (PasswordMessage:5 + strlen(hash_type) + EVP_MAX_MD_SIZE*2 + \0分)
-	// ----------------
-	hash_data = (char *)calloc(1, 5 + strlen(hash_type) + (EVP_MAX_MD_SIZE * 2) + 1);
-	// メモリ領域が確保できなかったら
-	if (hash_data == NULL)
-	{
-		// エラー
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Cannot calloc hash data's memory? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
-		free(hash_passwordusername);
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): Cannot make MD5 password!? %s\n", __func__, this_pgsql->socket_fd, ERR_reason_error_string(ERR_get_error()));
 		return -1;
 	}
-	// PasswordMessageのメッセージタイプをハッシュ化データ格納ポインタの先頭にコピー
-	hash_data[0] = 'p';
-	// ※PasswordMessageのメッセージ長は後で設定
-	// ハッシュ化タイプ文字列をハッシュ化データ格納ポインタにコピー
-	snprintf(hash_data + 5, strlen(hash_type) + 1, "%s", hash_type);
-	// ----------------
-	// 暗号化データ生成(暗号化方式(文字列で"md5", "sha256"など)、暗号対象データ、暗号対象データ長、ソルトデータ、ソルトデータ長、ハッシュ化データ格納ポインタ)
-	// ----------------
-	hash_len = gethashdata(hash_type, hash_passwordusername, hash_len, message_ptr + 9, 4, hash_data + 5 + strlen(hash_type));
-	if (hash_len == -1)
-	{
-		// エラー
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): gethashdata() error!?\n", __func__, this_pgsql->socket_fd);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
-		free(hash_data);
-		free(hash_passwordusername);
-		return -1;
-	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): hash_data's hash_len=%d\n", __func__, this_pgsql->socket_fd, hash_len);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
 
 	// PasswordMessageのメッセージ長を設定(最初の'p'の分は除く)
-	message_len = 4 + strlen(hash_type) + hash_len + 1;
-	hash_data[4] = *(char *)&message_len;
-	hash_data[3] = *((char *)&message_len + 1);
-	hash_data[2] = *((char *)&message_len + 2);
-	hash_data[1] = *((char *)&message_len + 3);
+	message_len = 4 + 3 + byte2hex(md_value, md_len, hash_data + 5 + 3) + 1;
+	memcpy(hash_data + 5, "md5", 3);
+	hash_data[0] = 'p';
+	hash_data[1] = (char)(message_len >> 24);
+	hash_data[2] = (char)(message_len >> 16);
+	hash_data[3] = (char)(message_len >> 8);
+	hash_data[4] = (char)message_len;
 
 	// PostgreSQL送信処理(メッセージタイプの1+を忘れずに)
-	api_result = API_pgsql_server_send(this_pgsql, hash_data, 1 + message_len);
+	api_result = API_pgsql_server_send(this_pgsql, (unsigned char *)hash_data, 1 + message_len);
 	// 正常終了でないなら
 	if (api_result != 0)
 	{
-		free(hash_data);
-		free(hash_passwordusername);
 		// 戻る
 		return api_result;
 	}
 
 	// ダンプ出力(メッセージタイプの1+を忘れずに)
-	dump2log(LOG_QUEUEING, LOGLEVEL_DUMP, NULL, (void *)hash_data, (1 + message_len) & 0x3FF);
+	dump2log(LOG_QUEUEING, LOGLEVEL_DUMP, NULL, (void *)hash_data, 1 + message_len);
 
 	// 標準ログに出力
-	snprintf(log_str, MAX_LOG_LENGTH, "PgAnalyzer -> PostgreSQL(%s) PasswordMessage(MD5). (message size=%d, len=0x%02x)\n", db_info->hostname, 1 + message_len, message_len);
-	logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-
-	free(hash_data);
-	free(hash_passwordusername);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "PgAnalyzer -> PostgreSQL(%s) PasswordMessage(MD5). (message size=%d, len=0x%02x)\n", db_info->hostname, 1 + message_len, message_len);
 
 	// 戻る
 	return api_result;
@@ -1189,6 +876,7 @@ int API_pgsql_send_PasswordMessageMD5(struct EVS_ev_pgsql_t *this_pgsql)
 // --------------------------------
 // PostgreSQL StartupMessage送信処理
 // --------------------------------
+// StartupMessageは、API_pgsql_prepare()で作っておいたものをそのまま送る
 int API_pgsql_send_StartupMessage(struct EVS_ev_pgsql_t *this_pgsql)
 {
 	int                             api_result = 0;
@@ -1196,50 +884,8 @@ int API_pgsql_send_StartupMessage(struct EVS_ev_pgsql_t *this_pgsql)
 
 	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_pgsql->db_info;
 
-	char                            pgsql_message[MAX_SIZE_1K] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, };
-	unsigned int                    message_len = 0;
-
-	char                            *target_ptr;
-
-	// コピー先ポインタを設定
-	target_ptr = pgsql_message + 8;
-
-	// メッセージバッファにデータベース名をコピー
-	strcpy(target_ptr, "database");
-	// コピー先ポインタを移動(\0分を忘れずに)
-	target_ptr += strlen(target_ptr) + 1;
-	strcpy(target_ptr, db_info->database);
-	// コピー先ポインタを移動(\0分を忘れずに)
-	target_ptr += strlen(target_ptr) + 1;
-
-	// メッセージバッファにユーザー名をコピー
-	strcpy(target_ptr, "user");
-	// コピー先ポインタを移動(\0分を忘れずに)
-	target_ptr += strlen(target_ptr) + 1;
-	strcpy(target_ptr, db_info->username);
-	// コピー先ポインタを移動(\0分を忘れずに)
-	target_ptr += strlen(target_ptr) + 1;
-
-	// メッセージバッファにアプリケーション名をコピー(必要なのかな!?)
-	strcpy(target_ptr, "application_name");
-	// コピー先ポインタを移動(\0分を忘れずに)
-	target_ptr += strlen(target_ptr) + 1;
-	strncpy(target_ptr, EVS_NAME, strlen(EVS_NAME));
-	// コピー先ポインタを移動
-	target_ptr += strlen(EVS_NAME);
-	// \0を追加(EVS_NAMEには\0がないので)
-	*target_ptr = 0x00;
-	target_ptr ++;
-
-	// メッセージ長を設定(StartupMessageは0x00,0x00で終わる事!!)
-	message_len = target_ptr - pgsql_message + 1;
-	pgsql_message[3] = *(char *)&message_len;
-	pgsql_message[2] = *((char *)&message_len + 1);
-	pgsql_message[1] = *((char *)&message_len + 2);
-	pgsql_message[0] = *((char *)&message_len + 3);
-
 	// PostgreSQL送信処理(これはStartupMessageなのでメッセージタイプはないから1+しない)
-	api_result = API_pgsql_server_send(this_pgsql, pgsql_message, message_len);
+	api_result = API_pgsql_server_send(this_pgsql, (unsigned char *)db_info->startup_message, db_info->startup_message_len);
 	// 正常終了でないなら
 	if (api_result != 0)
 	{
@@ -1248,16 +894,27 @@ int API_pgsql_send_StartupMessage(struct EVS_ev_pgsql_t *this_pgsql)
 	}
 
 	// ダンプ出力(これはStartupMessageなのでメッセージタイプはないから1+しない)
-	dump2log(LOG_QUEUEING, LOGLEVEL_DUMP, NULL, (void *)pgsql_message, message_len & 0x3FF);
+	dump2log(LOG_QUEUEING, LOGLEVEL_DUMP, NULL, (void *)db_info->startup_message, db_info->startup_message_len);
 
 	// 標準ログに出力
-	snprintf(log_str, MAX_LOG_LENGTH, "PgAnalyzer -> PostgreSQL(%s) StartupMessage. (message size=%d, len=0x%02x)\n", db_info->hostname, message_len, message_len);
-	logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "PgAnalyzer -> PostgreSQL(%s) StartupMessage. (message size=%d, len=0x%02x)\n", db_info->hostname, db_info->startup_message_len, db_info->startup_message_len);
 
 	// 戻る
 	return api_result;
 }
 
+// --------------------------------
+// PostgreSQL接続用データ終了処理(使い回しているダイジェストコンテキストを解放する)
+// --------------------------------
+void API_pgsql_end(void)
+{
+	if (EVS_md5_ctx != NULL)
+	{
+		EVP_MD_CTX_free(EVS_md5_ctx);
+		EVS_md5_ctx = NULL;
+	}
+}
+
 // --------------------------------
 // PostgreSQL SSLRequest送信処理
 // --------------------------------
@@ -1277,8 +934,7 @@ int API_pgsql_send_SSLRequest(struct EVS_ev_pgsql_t *this_pgsql)
 	// 送信したバイト数が負(<0)だったら(エラーです)
 	if (api_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): send(): Cannot send message? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): send(): Cannot send message? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, errno, strerror(errno));
 		return -1;
 	}
 
@@ -1286,8 +942,7 @@ int API_pgsql_send_SSLRequest(struct EVS_ev_pgsql_t *this_pgsql)
 	dump2log(LOG_QUEUEING, LOGLEVEL_DUMP, NULL, (void *)pgsql_message, 8);
 
 	// 標準ログに出力
-	snprintf(log_str, MAX_LOG_LENGTH, "PgAnalyzer -> PostgreSQL(%s) SSLRequest. (message size=%d, len=0x%02x)\n", db_info->hostname, 8, 8);
-	logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "PgAnalyzer -> PostgreSQL(%s) SSLRequest. (message size=%d, len=0x%02x)\n", db_info->hostname, 8, 8);
 
 	return 0;
 }
@@ -1301,8 +956,7 @@ int API_pgsql_SSLHandshake(struct EVS_ev_pgsql_t *this_pgsql)
 	char                            log_str[MAX_LOG_LENGTH];
 
 	// SSLハンドシェイクを開始
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): SSL/TLS handshake START!\n", __func__, this_pgsql->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): SSL/TLS handshake START!\n", __func__, this_pgsql->socket_fd);
 
 	// ----------------
 	// SSL設定情報を作成
@@ -1312,8 +966,7 @@ int API_pgsql_SSLHandshake(struct EVS_ev_pgsql_t *this_pgsql)
 	this_pgsql->ctx = SSL_CTX_new(TLS_client_method());
 	if (this_pgsql->ctx == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): SSL_CTX_new(): Cannot initialize SSL_CTX!? %s\n", __func__, this_pgsql->socket_fd, ERR_reason_error_string(ERR_get_error()));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): SSL_CTX_new(): Cannot initialize SSL_CTX!? %s\n", __func__, this_pgsql->socket_fd, ERR_reason_error_string(ERR_get_error()));
 		return -1;
 	}
 	// SSL設定でTLSv1.2以上しか許可しない(1.1.0以降はSSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION)、でいい)
@@ -1326,8 +979,7 @@ int API_pgsql_SSLHandshake(struct EVS_ev_pgsql_t *this_pgsql)
 	this_pgsql->ssl = SSL_new(this_pgsql->ctx);
 	if (this_pgsql->ssl == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): SSL_new(): Cannot get SSL!? %s\n", __func__, this_pgsql->socket_fd,ERR_reason_error_string(ERR_get_error()));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): SSL_new(): Cannot get SSL!? %s\n", __func__, this_pgsql->socket_fd,ERR_reason_error_string(ERR_get_error()));
 		return -1;
 	}
 
@@ -1337,8 +989,7 @@ int API_pgsql_SSLHandshake(struct EVS_ev_pgsql_t *this_pgsql)
 	api_result = SSL_set_fd(this_pgsql->ssl, this_pgsql->socket_fd);
 	if (api_result == 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): SSL_CTX_new(): Cannot set SSL_set_fd!? %s\n", __func__, this_pgsql->socket_fd, ERR_reason_error_string(ERR_get_error()));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): SSL_CTX_new(): Cannot set SSL_set_fd!? %s\n", __func__, this_pgsql->socket_fd, ERR_reason_error_string(ERR_get_error()));
 		return  -1;
 	}
 
@@ -1349,13 +1000,11 @@ int API_pgsql_SSLHandshake(struct EVS_ev_pgsql_t *this_pgsql)
 	// OpenSSL(SSL_connect : PosgtreSQLに対してSSL接続開始)
 	// ----------------
 	api_result = SSL_connect(this_pgsql->ssl);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): SSL_connect(): api_result=%d.\n", __func__, this_pgsql->socket_fd, api_result);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): SSL_connect(): api_result=%d.\n", __func__, this_pgsql->socket_fd, api_result);
 
 	// SSL/TLSハンドシェイクの結果コードを取得
 	api_result = SSL_get_error(this_pgsql->ssl, api_result);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): SSL_get_error(): api_result=%d.\n", __func__, this_pgsql->socket_fd, api_result);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): SSL_get_error(): api_result=%d.\n", __func__, this_pgsql->socket_fd, api_result);
 
 	// SSL/TLSハンドシェイクの結果コード別処理分岐
 	switch (api_result)
@@ -1364,8 +1013,7 @@ int API_pgsql_SSLHandshake(struct EVS_ev_pgsql_t *this_pgsql)
 			// エラーなし(ハンドシェイク成功)
 			// SSL接続中に設定
 			this_pgsql->ssl_status = 2;
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): SSL/TLS handshake OK.\n", __func__, this_pgsql->socket_fd);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): SSL/TLS handshake OK.\n", __func__, this_pgsql->socket_fd);
 			// PostgreSQL StartupMessage送信処理
 			api_result = API_pgsql_send_StartupMessage(this_pgsql);
 			// 戻る
@@ -1374,8 +1022,7 @@ int API_pgsql_SSLHandshake(struct EVS_ev_pgsql_t *this_pgsql)
 		case SSL_ERROR_SSL :
 		case SSL_ERROR_SYSCALL :
 			// SSL/TLSハンドシェイクがエラー
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Cannot SSL/TLS handshake!? %s\n", __func__, this_pgsql->socket_fd, ERR_reason_error_string(ERR_get_error()));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): Cannot SSL/TLS handshake!? %s\n", __func__, this_pgsql->socket_fd, ERR_reason_error_string(ERR_get_error()));
 			// ----------------
 			// PostgreSQL接続終了処理(バッファ開放、ソケットクローズ、PostgreSQL用キューからの削除、イベントの停止)
 			// ----------------
@@ -1398,21 +1045,23 @@ int API_pgsql_SSLHandshake(struct EVS_ev_pgsql_t *this_pgsql)
 // --------------------------------
 // サーバー接続開始処理(IPv4/IPv6接続)
 // --------------------------------
-int API_pgsql_server_start_inet(struct EVS_ev_client_t *this_client)
+int API_pgsql_server_start_inet(struct EVS_ev_pgsql_t *this_pgsql)
 {
 	int                             api_result = 0;
 	char                            log_str[MAX_LOG_LENGTH];
 
-	struct EVS_ev_pgsql_t           *this_pgsql = this_client->pgsql_info;
-	char                            **db_param = this_client->param_info;
-
 	struct addrinfo                 target_hints;                       // 接続先のアドレス構造体を取得するための条件
 	struct addrinfo                 *target_addrinfo, *addrinfo_ptr;    // 接続先のアドレス構造体ポインタ
 
 	struct EVS_db_t                 *db_info;                           // データベース別設定用構造体ポインタ
+	struct EVS_host_t               *this_host;                         // 接続先ホスト別構造体ポインタ
 
 	db_info = this_pgsql->db_info;
 
+	// 接続先ホスト選択処理(複数のホストが指定されていれば、振り分け方法に従って選ぶ。事前接続はプライマリに接続する)
+	this_pgsql->host_index = API_balance_select(db_info, (this_pgsql->client_info != NULL) ? ((struct EVS_ev_client_t *)this_pgsql->client_info)->route_replica : 0);
+	this_host = db_info->host_list[this_pgsql->host_index];
+
 	// ----------------
 	// 接続先のアドレス構造体取得
 	// ----------------
@@ -1426,13 +1075,14 @@ int API_pgsql_server_start_inet(struct EVS_ev_client_t *this_client)
 	target_hints.ai_flags = 0;                                          // 追加オプション無し
 
 	// 接続先のアドレス構造体取得
-	api_result = getaddrinfo(db_info->hostname, db_info->servicename, &target_hints, &target_addrinfo);
+	api_result = getaddrinfo(this_host->hostname, this_host->servicename, &target_hints, &target_addrinfo);
 	// 接続先のアドレス構造体が得られないなら
 	if (api_result != 0)
 	{
 		// エラー
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot get PostgreSQL's address info!? errno=%d (%s)\n", __func__, api_result, gai_strerror(api_result));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot get PostgreSQL's address info!? errno=%d (%s)\n", __func__, api_result, gai_strerror(api_result));
+		// 接続先ホスト接続失敗処理(このホストを切り離す)
+		API_balance_fail(this_pgsql);
 		return -1;
 	}
 
@@ -1447,12 +1097,10 @@ int API_pgsql_server_start_inet(struct EVS_ev_client_t *this_client)
 		if (api_result == -1)
 		{
 			// エラー…ではなくて、次のアドレス構造体に対してソケット生成を試す
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): socket(%s, SOCK_STREAM, 0): Cannot create new socket? errno=%d (%s)\n", __func__, pf_name_list[addrinfo_ptr->ai_family], errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): socket(%s, SOCK_STREAM, 0): Cannot create new socket? errno=%d (%s)\n", __func__, pf_name_list[addrinfo_ptr->ai_family], errno, strerror(errno));
 			continue;
 		}
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): socket(%s, SOCK_STREAM, 0): Create new socket. fd=%d\n", __func__, pf_name_list[addrinfo_ptr->ai_family], api_result);
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): socket(%s, SOCK_STREAM, 0): Create new socket. fd=%d\n", __func__, pf_name_list[addrinfo_ptr->ai_family], api_result);
 		// ソケットディスクリプタを設定
 		this_pgsql->socket_fd = api_result;
 		
@@ -1461,8 +1109,7 @@ int API_pgsql_server_start_inet(struct EVS_ev_client_t *this_client)
 		// ----------------
 		if (connect(this_pgsql->socket_fd, addrinfo_ptr->ai_addr, addrinfo_ptr->ai_addrlen) != -1)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Cannot connect PostgreSQL!? try to next address info\n", __func__, this_pgsql->socket_fd);
-			logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(pgsql=%d): Cannot connect PostgreSQL!? try to next address info\n", __func__, this_pgsql->socket_fd);
 			// 接続できたのでfor文を抜ける
 			break;
 		}
@@ -1473,23 +1120,23 @@ int API_pgsql_server_start_inet(struct EVS_ev_client_t *this_client)
 		// ソケットのクローズ結果がエラーだったら
 		if (api_result < 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): close(): Cannot socket close? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): close(): Cannot socket close? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, errno, strerror(errno));
 			return -1;
 		}
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): Cannot connect PostgreSQL!? try to next address info\n", __func__, this_pgsql->socket_fd);
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(pgsql=%d): Cannot connect PostgreSQL!? try to next address info\n", __func__, this_pgsql->socket_fd);
 	}
 	// 全てのアドレス構造体に対して接続を試したが接続ができなかったら
 	if (addrinfo_ptr == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): close(): Cannot socket close? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): close(): Cannot socket close? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, errno, strerror(errno));
+		// 接続先のアドレス構造体を解放
+		freeaddrinfo(target_addrinfo);
+		// 接続先ホスト接続失敗処理(このホストを切り離す)
+		API_balance_fail(this_pgsql);
 		return -1;
 	}
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): connect(%s:%s): OK!\n", __func__, this_pgsql->socket_fd, db_info->hostname, db_info->servicename);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): connect(%s:%s): OK!\n", __func__, this_pgsql->socket_fd, this_host->hostname, this_host->servicename);
 
 	// 接続先のアドレス構造体を解放
 	freeaddrinfo(target_addrinfo);
@@ -1497,12 +1144,10 @@ int API_pgsql_server_start_inet(struct EVS_ev_client_t *this_client)
 	// PostgreSQL処理への接続情報構造体のその他の値を設定する
 	ev_now_update(EVS_loop);                                            // イベントループの日時を現在の日時に更新
 	this_pgsql->last_activity = ev_now(EVS_loop);                       // 最終アクティブ日時(PostgreSQLとのやり取りが最後にアクティブとなった日時)を設定する(※loopがないのでグローバル変数で)
-	this_pgsql->client_info = (void *)this_client;                      // クライアント毎の付帯情報(HTTPのリクエストヘッダ情報とか)へのポインタを設定する
 
 	// テールキューの最後にこの接続の情報を追加する
 	TAILQ_INSERT_TAIL(&EVS_pgsql_tailq, this_pgsql, entries);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INSERT_TAIL(pgsql=%d): OK.\n", __func__, this_pgsql->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): TAILQ_INSERT_TAIL(pgsql=%d): OK.\n", __func__, this_pgsql->socket_fd);
 
 	// --------------------------------
 	// libev 処理
@@ -1510,19 +1155,15 @@ int API_pgsql_server_start_inet(struct EVS_ev_client_t *this_client)
 	// PostgreSQL別設定用構造体ポインタのI/O監視オブジェクトに対して、コールバック処理とソケットファイルディスクリプタ、そしてイベントのタイプを設定する
 	ev_io_init(&this_pgsql->io_watcher, CB_pgsqlrecv, this_pgsql->socket_fd, EV_READ);
 	ev_io_start(EVS_loop, &this_pgsql->io_watcher);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_io_init(CB_pgsqlrecv, pgsql=%d, EV_READ): OK.\n", __func__, this_pgsql->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_io_start(): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): ev_io_init(CB_pgsqlrecv, pgsql=%d, EV_READ): OK.\n", __func__, this_pgsql->socket_fd);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): ev_io_start(): OK.\n", __func__);
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): this_pgsql->pgsql_status %d -> 1!!\n", __func__, this_pgsql->socket_fd, this_pgsql->pgsql_status);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): this_pgsql->pgsql_status %d -> 1!!\n", __func__, this_pgsql->socket_fd, this_pgsql->pgsql_status);
 	// PostgreSQLへの接続状態を、1:接続開始に設定
 	this_pgsql->pgsql_status = 1;
 
 	// 標準ログに出力
-	snprintf(log_str, MAX_LOG_LENGTH, "Postgresql Connected.(%s, %s)\n", db_info->hostname, db_info->servicename);
-	logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "Postgresql Connected.(%s, %s)\n", this_host->hostname, this_host->servicename);
 
 	// PostgreSQL SSLRequest送信処理
 	api_result =  API_pgsql_send_SSLRequest(this_pgsql);
@@ -1533,14 +1174,11 @@ int API_pgsql_server_start_inet(struct EVS_ev_client_t *this_client)
 // --------------------------------
 // サーバー接続開始処理(UNIXドメインソケット)
 // --------------------------------
-int API_pgsql_server_start_unix(struct EVS_ev_client_t *this_client)
+int API_pgsql_server_start_unix(struct EVS_ev_pgsql_t *this_pgsql)
 {
 	int                             api_result = 0;
 	char                            log_str[MAX_LOG_LENGTH];
 
-	struct EVS_ev_pgsql_t           *this_pgsql = this_client->pgsql_info;
-	char                            **db_param = this_client->param_info;
-
 	// ----------------
 	// ソケット生成(socket : UNIXドメインソケットでかつストリームで)
 	// ----------------
@@ -1549,14 +1187,10 @@ int API_pgsql_server_start_unix(struct EVS_ev_client_t *this_client)
 	// ソケット生成が出来なかったら
 	if (api_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): socket(%s, SOCK_STREAM): Cannot create new socket? errno=%d (%s)\n", __func__, pf_name_list[this_pgsql->socket_address.sa_un.sun_family], errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
-		free(this_pgsql);
-		this_pgsql = NULL;
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): socket(%s, SOCK_STREAM): Cannot create new socket? errno=%d (%s)\n", __func__, pf_name_list[this_pgsql->socket_address.sa_un.sun_family], errno, strerror(errno));
 		return -1;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): socket(%s, SOCK_STREAM): Create new socket. pgsql=%d\n", __func__, pf_name_list[this_pgsql->socket_address.sa_un.sun_family], api_result);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): socket(%s, SOCK_STREAM): Create new socket. pgsql=%d\n", __func__, pf_name_list[this_pgsql->socket_address.sa_un.sun_family], api_result);
 
 	// ソケットディスクリプタを設定
 	this_pgsql->socket_fd = api_result;
@@ -1570,24 +1204,19 @@ int API_pgsql_server_start_unix(struct EVS_ev_client_t *this_client)
 	// ソケットアドレスの紐づけが出来なかったら
 	if (api_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): connect(pgsql=%d, %s): Cannot socket binding? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, this_pgsql->socket_address.sa_un.sun_path, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
-		free(this_pgsql);
-		this_pgsql = NULL;
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): connect(pgsql=%d, %s): Cannot socket binding? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, this_pgsql->socket_address.sa_un.sun_path, errno, strerror(errno));
+		close(this_pgsql->socket_fd);
 		return -1;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): connect(pgsql=%d, %s): OK!\n", __func__, this_pgsql->socket_fd, this_pgsql->socket_address.sa_un.sun_path);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): connect(pgsql=%d, %s): OK!\n", __func__, this_pgsql->socket_fd, this_pgsql->socket_address.sa_un.sun_path);
 
 	// PostgreSQL処理への接続情報構造体のその他の値を設定する
 	ev_now_update(EVS_loop);                                            // イベントループの日時を現在の日時に更新
 	this_pgsql->last_activity = ev_now(EVS_loop);                       // 最終アクティブ日時(PostgreSQLとのやり取りが最後にアクティブとなった日時)を設定する(※loopがないのでグローバル変数で)
-	this_pgsql->client_info = (void *)this_client;                      // クライアント毎の付帯情報(HTTPのリクエストヘッダ情報とか)へのポインタを設定する
 
 	// テールキューの最後にこの接続の情報を追加する
 	TAILQ_INSERT_TAIL(&EVS_pgsql_tailq, this_pgsql, entries);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INSERT_TAIL(pgsql=%d): OK.\n", __func__, this_pgsql->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): TAILQ_INSERT_TAIL(pgsql=%d): OK.\n", __func__, this_pgsql->socket_fd);
 
 	// --------------------------------
 	// libev 処理
@@ -1595,19 +1224,15 @@ int API_pgsql_server_start_unix(struct EVS_ev_client_t *this_client)
 	// PostgreSQL別設定用構造体ポインタのI/O監視オブジェクトに対して、コールバック処理とソケットファイルディスクリプタ、そしてイベントのタイプを設定する
 	ev_io_init(&this_pgsql->io_watcher, CB_pgsqlrecv, this_pgsql->socket_fd, EV_READ);
 	ev_io_start(EVS_loop, &this_pgsql->io_watcher);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_io_init(CB_pgsqlrecv, pgsql=%d, EV_READ): OK.\n", __func__, this_pgsql->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_io_start(): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): ev_io_init(CB_pgsqlrecv, pgsql=%d, EV_READ): OK.\n", __func__, this_pgsql->socket_fd);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): ev_io_start(): OK.\n", __func__);
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): this_pgsql->pgsql_status %d -> 1!!\n", __func__, this_pgsql->socket_fd, this_pgsql->pgsql_status);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): this_pgsql->pgsql_status %d -> 1!!\n", __func__, this_pgsql->socket_fd, this_pgsql->pgsql_status);
 	// PostgreSQLへの接続状態を、1:接続開始に設定
 	this_pgsql->pgsql_status = 1;
 
 	// 標準ログに出力
-	snprintf(log_str, MAX_LOG_LENGTH, "Postgresql Connected. (%s)\n", this_pgsql->socket_address.sa_un.sun_path);
-	logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "Postgresql Connected. (%s)\n", this_pgsql->socket_address.sa_un.sun_path);
 
 	// PostgreSQL StartupMessage送信処理
 	api_result = API_pgsql_send_StartupMessage(this_pgsql);
@@ -1620,7 +1245,7 @@ int API_pgsql_server_start_unix(struct EVS_ev_client_t *this_client)
 // --------------------------------
 int API_pgsql_server_start(struct EVS_ev_client_t *this_client)
 {
-	int                             api_result = 0;
+	int                             api_result;
 	char                            log_str[MAX_LOG_LENGTH];
 
 	struct EVS_ev_pgsql_t           *this_pgsql = NULL;                 // この関数でpgsql_infoの領域を確保するので、初期化ではNULLにしておく
@@ -1629,51 +1254,81 @@ int API_pgsql_server_start(struct EVS_ev_client_t *this_client)
 	struct EVS_db_t                 *db_list;                           // データベース別設定用構造体ポインタ
 
 	// とりあえず表示する
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): START! (database=%s, username=%s)\n", __func__, this_client->socket_fd, param_info[CLIENT_DATABASE], param_info[CLIENT_USERNAME]);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(fd=%d): START! (database=%s, username=%s)\n", __func__, this_client->socket_fd, param_info[CLIENT_DATABASE], param_info[CLIENT_USERNAME]);
 
 	// --------------------------------
 	// データベース別処理(設定に、クライアントから指定されたユーザー名とデータベースに基づいたPostgreSQLの指定があるか探す)
 	// --------------------------------
-	// データベース用テールキューからポート情報を取得して全て処理
-	TAILQ_FOREACH (db_list, &EVS_db_tailq, entries)
-	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): db_list MATCH? database=%s, username=%s\n", __func__, db_list->database, db_list->username);
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
-
-		// データベース名とユーザー名が合致していれば
-		if (strcmp(param_info[CLIENT_DATABASE], db_list->database) == 0 && strcmp(param_info[CLIENT_USERNAME], db_list->username) == 0)
-		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): db_list MATCH! database=%s, username=%s\n", __func__, db_list->database, db_list->username);
-			logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
-			api_result = 1;
-			break;
-		}
-	}
+	// 経路表探索処理(ワイルドカードの設定に該当したなら、このデータベース名・ユーザー名の設定が作られる)
+	db_list = API_route_lookup(param_info[CLIENT_DATABASE], param_info[CLIENT_USERNAME]);
 	// 設定に、クライアントから指定されたユーザー名とデータベースに基づいたPostgreSQLの指定がないなら
-	if (api_result != 1)
+	if (db_list == NULL)
 	{
 		// エラー
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot find PostgreSQL setting!?\n", __func__);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot find PostgreSQL setting!?\n", __func__);
 		return -1;
 	}
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): db_list MATCH! database=%s, username=%s\n", __func__, db_list->database, db_list->username);
+
+	// 接続先のデータベース別設定を覚えておく(トランザクション単位のプールで、問い合わせ毎に接続を割り当てるため)
+	this_client->db_info = db_list;
+	// この設定を使っているクライアント数(使われなくなったワイルドカードの設定を開放するため)
+	db_list->client_num ++;
+	// 読み書き分離セッション開始処理(読み取り専用のセッションなら、レプリカに接続する)
+	this_client->route_replica = API_split_session(this_client, db_list);
+
+	// --------------------------------
+	// プール接続取得処理(待機中の接続があれば、PostgreSQLへは接続しないで、それを割り当てる)
+	// --------------------------------
+	this_pgsql = API_pool_get(db_list, this_client->route_replica);
+	if (this_pgsql != NULL)
+	{
+		// プール接続割り当て処理(開始メッセージレスポンスは、API_pgsql_client_start()でAPI_pool_welcome()から送る)
+		API_pool_attach(this_client, this_pgsql);
+		return 0;
+	}
+	// プール接続数上限判定処理(トランザクション単位のプールや、全体、データベース名毎の接続数が上限なら空きを待つ。待ち行列が一杯ならエラーを返したので切断する)
+	api_result = API_pool_limit(this_client, db_list);
+	if (api_result != 0)
+	{
+		return (api_result < 0) ? -1 : 0;
+	}
+
+	// サーバー接続処理
+	return API_pgsql_server_open(this_client, db_list);
+}
+
+// --------------------------------
+// サーバー接続処理(PostgreSQL用構造体の確保と接続)
+// --------------------------------
+// this_clientがNULLなら、プールの事前接続(接続処理が終わったら、API_pool_ready()でプールに入れる)
+int API_pgsql_server_open(struct EVS_ev_client_t *this_client, struct EVS_db_t *db_list)
+{
+	int                             api_result = 0;
+	char                            log_str[MAX_LOG_LENGTH];
+	int                             host_count;                         // 接続を試したホストの数
+
+	struct EVS_ev_pgsql_t           *this_pgsql = NULL;                 // この関数でpgsql_infoの領域を確保するので、初期化ではNULLにしておく
 
 	// ----------------
 	// PostgreSQL用構造体ポインタのメモリ領域を確保
 	// ----------------
-	this_client->pgsql_info = (struct EVS_ev_pgsql_t *)calloc(1, sizeof(struct EVS_ev_pgsql_t));
+	this_pgsql = (struct EVS_ev_pgsql_t *)calloc(1, sizeof(struct EVS_ev_pgsql_t));
 	// メモリ領域が確保できなかったら
-	if (this_client->pgsql_info == NULL)
+	if (this_pgsql == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 		return -1;
 	}
 
-	// 確保したPostgreSQL用構造体のPosgreSQLデータベース情報ポインタを設定
-	this_pgsql = this_client->pgsql_info;
+	// 確保したPostgreSQL用構造体のPosgreSQLデータベース情報ポインタと、クライアント毎の付帯情報へのポインタを設定
 	this_pgsql->db_info = db_list;
+	this_pgsql->client_info = (void *)this_client;
+	this_pgsql->pool_warm = (this_client == NULL) ? 1 : 0;
+	if (this_client != NULL)
+	{
+		this_client->pgsql_info = this_pgsql;
+	}
 
 	// --------------------------------
 	// 指定されたPostgreSQLに対して接続
@@ -1682,13 +1337,41 @@ int API_pgsql_server_start(struct EVS_ev_client_t *this_client)
 	if (strcmp(db_list->hostname, "UNIXSOCKET") == 0)
 	{
 		// サーバー接続開始処理(UNIXドメインソケット)
-		api_result = API_pgsql_server_start_unix(this_client);
+		api_result = API_pgsql_server_start_unix(this_pgsql);
 	}
 	// それ以外は
 	else
 	{
-		// サーバー接続開始処理(IPv4/IPv6接続)
-		api_result = API_pgsql_server_start_inet(this_client);
+		// サーバー接続開始処理(IPv4/IPv6接続)(接続できなかったホストは切り離されるので、複数のホストがあれば、次のホストで試す)
+		for (host_count = 0; host_count < db_list->host_num || host_count == 0; host_count ++)
+		{
+			api_result = API_pgsql_server_start_inet(this_pgsql);
+			if (this_pgsql->pgsql_status != 0)
+			{
+				break;
+			}
+		}
+	}
+	// 接続できなかった(PostgreSQL用キューに入らなかった)なら、PostgreSQL用構造体はここで開放する
+	if (this_pgsql->pgsql_status == 0)
+	{
+		if (this_client != NULL)
+		{
+			this_client->pgsql_info = NULL;
+		}
+		free(this_pgsql);
+		return -1;
+	}
+	// このデータベース別設定で開いている接続数
+	db_list->pgsql_num ++;
+	// 接続受け入れ制御 : 接続開始処理(全体とデータベース名毎の接続数)
+	API_admit_open(db_list);
+	if (this_client != NULL)
+	{
+		// 読み書き分離計数処理
+		API_split_count(this_pgsql);
+		// キャプチャ開始処理(対象のセッションなら、受信済みのStartupMessageから出力する)
+		API_capture_start(this_client);
 	}
 	return api_result;
 }
@@ -0,0 +1,909 @@
+// ----------------------------------------------------------------------
+// Protocol Analyzer for PostgreSQL -
+// Purpose:
+//     Session-mode pool of authenticated PostgreSQL connections.
+//
+// Program:
+//     Takeshi Kaburagi/MyDNS.JP    https://www.fvg-on.net/
+//
+// Usage:
+//     ./evs_pganalyzer [./evserver.ini]
+// ----------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------
+// ヘッダ部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// インクルード宣言
+// --------------------------------
+
+// --------------------------------
+// 定数宣言
+// --------------------------------
+
+// --------------------------------
+// 型宣言
+// --------------------------------
+
+// --------------------------------
+// 変数宣言
+// --------------------------------
+
+// ----------------------------------------------------------------------
+// コード部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// 接続プールについて
+// --------------------------------
+// クライアントが切断しても、PostgreSQLとの接続(SSLハンドシェイク、StartupMessage、MD5認証済み)は閉じずに、データベース別設定(EVS_db_t)毎のプールに戻す。
+// 同じデータベース・ユーザーで次のクライアントが接続してきたら、プールの接続を割り当てて、PostgreSQLへの接続処理を全部省略する。
+//
+//      クライアント切断 → PoolResetQuery(既定はDISCARD ALL)を送信 → 20:プール待機中 → 次のクライアントに割り当て → 10:透過モード
+//
+// クライアントには、最初に接続した時にPostgreSQLから受け取ったParameterStatusとBackendKeyDataを保存しておいて、
+// AuthenticationOk、保存したメッセージ、ReadyForQueryを続けて送る(PostgreSQLにはメッセージを送らない)。
+// 問い合わせの途中(最後に受け取ったのがReadyForQueryではない)で切断されたなら、プールには戻さずに閉じる。
+// トランザクション中なら、ROLLBACKしてからリセットする。
+//
+// "PostgreSQL = ..., Transaction"のデータベース別設定は、トランザクション単位でプールする(PoolSizeが、そのデータベース別設定で開く接続の上限になる)。
+// クライアントが最初のメッセージを送ってきた時に接続を割り当て、ReadyForQuery('I')が来て応答待ちの問い合わせがなくなったらプールに返す(リセットはしない)。
+// 接続が全部使われているなら、クライアントは受信を止めて先に待った順に並び、PoolWaitTimeout(秒)待っても空かなければエラーで切断する。
+// (全体やデータベース名毎の接続数の上限で待つ時も、同じ待ち行列に並ぶ → evs_api_admit.c)
+//
+//      クライアント → [待ち行列] → 割り当て → 10:透過モード → ReadyForQuery('I') → 20:プール待機中 → 次の待ち行列の先頭へ
+//
+// セッションを跨ぐ状態(プリペアド文、SET、一時テーブル、LISTENなど)は、次のトランザクションでは別の接続になるので使えない。
+//
+// データベース別設定に"MinIdle=N"があれば、プールで待機中と事前接続中の接続がN未満にならないように、クライアントなしで事前に接続しておく(タイマーイベント毎)。
+// 再起動直後にPostgreSQLへ接続が集中しないように、最初の接続も含めて、PoolWarmJitter(ミリ秒)以内の乱数だけ間を空けて一つずつ接続する。
+// "MaxSize=N"があれば、そのデータベース別設定だけPoolSizeの代わりに使う。
+// --------------------------------
+// 接続プール上限取得処理(データベース別設定のMaxSize、なければPoolSize)
+// --------------------------------
+static int API_pool_max(struct EVS_db_t *db_info)
+{
+	return (db_info->pool_max > 0) ? db_info->pool_max : EVS_config.pool_size;
+}
+
+// --------------------------------
+// 接続プール使用可否判定処理(1:プールする, 0:しない)
+// --------------------------------
+static int API_pool_enabled(struct EVS_db_t *db_info)
+{
+	return (db_info != NULL && API_pool_max(db_info) > 0);
+}
+
+// --------------------------------
+// 開始メッセージレスポンス保存処理 ※PostgreSQLとの接続中(pgsql_status==2)に、クライアントに送るメッセージ毎に呼ばれる
+// --------------------------------
+// プールした接続を次のクライアントに割り当てる時に送れるように、ParameterStatusとBackendKeyDataを保存しておく
+void API_pool_startup(struct EVS_ev_pgsql_t *this_pgsql, struct EVS_pgmsg_t *pgmsg)
+{
+	// プールしない設定か、保存しきれなかった接続なら
+	if (API_pool_enabled((struct EVS_db_t *)this_pgsql->db_info) == 0 || this_pgsql->startup_len < 0)
+	{
+		return;
+	}
+	switch (pgmsg->message_type)
+	{
+		case 'S':                                                       // 0x53 : S ... ParameterStatus
+		case 'K':                                                       // 0x4B : K ... BackendKeyData
+			// 保存しきれないなら、この接続はプールしない
+			if (this_pgsql->startup_len + 1 + pgmsg->message_len > sizeof(this_pgsql->startup_buf))
+			{
+				this_pgsql->startup_len = -1;
+				break;
+			}
+			memcpy(this_pgsql->startup_buf + this_pgsql->startup_len, pgmsg->message_ptr, 1 + pgmsg->message_len);
+			this_pgsql->startup_len += 1 + pgmsg->message_len;
+			break;
+		case 'Z':                                                       // 0x5A : Z ... ReadyForQuery
+			this_pgsql->ready_status = pgmsg->txn_status;
+			// 問い合わせサイクル追跡の初期状態(トランザクション単位のプールで、接続処理が終わったら返却できるように)
+			if (this_pgsql->client_info != NULL && ((struct EVS_ev_client_t *)this_pgsql->client_info)->session_info != NULL)
+			{
+				((struct EVS_session_t *)((struct EVS_ev_client_t *)this_pgsql->client_info)->session_info)->relay.ready_status = pgmsg->txn_status;
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+// --------------------------------
+// 問い合わせ終了判定処理 ※透過モードでPostgreSQLから受信する度に呼ばれる
+// --------------------------------
+// 受信データの最後がReadyForQueryなら、そのトランザクション状態('I', 'T', 'E')を覚えておく(それ以外は0:問い合わせ中)
+void API_pool_received(struct EVS_ev_pgsql_t *this_pgsql, const char *recv_ptr, int recv_len)
+{
+	if (recv_len >= 6 && recv_ptr[recv_len - 6] == 'Z' && API_pgsql_get_int32(recv_ptr + recv_len - 5) == 5)
+	{
+		this_pgsql->ready_status = recv_ptr[recv_len - 1];
+	}
+	else
+	{
+		this_pgsql->ready_status = 0;
+	}
+}
+
+// --------------------------------
+// クライアント送信判定処理(1:PostgreSQLに送らない, 0:送る) ※透過モードでクライアントから受信する度に呼ばれる
+// --------------------------------
+// プールする接続なら、Terminateは送らない(PostgreSQLが接続を閉じてしまうので)。クライアントはこの後に切断してくる。
+int API_pool_sent(struct EVS_ev_pgsql_t *this_pgsql, const char *recv_ptr, int recv_len)
+{
+	if (API_pool_enabled((struct EVS_db_t *)this_pgsql->db_info) != 0 && this_pgsql->startup_len >= 0 && recv_len == 5 && recv_ptr[0] == 'X' && API_pgsql_get_int32(recv_ptr + 1) == 4)
+	{
+		return 1;
+	}
+	// 問い合わせ中にする
+	this_pgsql->ready_status = 0;
+	return 0;
+}
+
+// --------------------------------
+// プール接続取得処理(データベース別設定のプールから、待機中の接続を取り出す。なければNULL)
+// --------------------------------
+// 読み書き分離なら、replica_flag(0:プライマリ, 1:レプリカ)と同じ種類の接続を取り出す。
+// レプリカが欲しいのに接続数が上限なら、プライマリの接続でもよい(プライマリでも読み取りはできる)。
+struct EVS_ev_pgsql_t *API_pool_get(struct EVS_db_t *db_info, int replica_flag)
+{
+	struct EVS_ev_pgsql_t           *this_pgsql;
+
+	if (API_pool_enabled(db_info) == 0 || TAILQ_EMPTY(&db_info->pool_tailq))
+	{
+		return NULL;
+	}
+	// 最後に戻した接続から使う(使われない接続がPoolIdleTimeoutで閉じられるように)
+	TAILQ_FOREACH (this_pgsql, &db_info->pool_tailq, pool_entries)
+	{
+		if (API_balance_replica(this_pgsql) == replica_flag)
+		{
+			break;
+		}
+	}
+	if (this_pgsql == NULL)
+	{
+		if (replica_flag == 0 || db_info->pgsql_num < API_pool_max(db_info))
+		{
+			return NULL;
+		}
+		this_pgsql = TAILQ_FIRST(&db_info->pool_tailq);
+	}
+	TAILQ_REMOVE(&db_info->pool_tailq, this_pgsql, pool_entries);
+	db_info->pool_num --;
+	db_info->pool_reuse_count ++;
+	return this_pgsql;
+}
+
+// --------------------------------
+// プール接続割り当て処理 ※API_pool_get()で取り出した接続を、クライアントに割り当てる
+// --------------------------------
+void API_pool_attach(struct EVS_ev_client_t *this_client, struct EVS_ev_pgsql_t *this_pgsql)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	this_client->pgsql_info = this_pgsql;
+	this_pgsql->client_info = (void *)this_client;
+	// 読み書き分離計数処理
+	API_split_count(this_pgsql);
+	// キャプチャ開始処理(対象のセッションなら、受信済みのStartupMessageから出力する)
+	API_capture_start(this_client);
+
+	ev_now_update(EVS_loop);                                            // イベントループの日時を現在の日時に更新
+	this_pgsql->last_activity = ev_now(EVS_loop);                       // 最終アクティブ日時
+
+	// PostgreSQLへの接続状態を10:透過モード、クライアントの状態を2:クエリメッセージ待ちにする(クライアントへの開始メッセージレスポンスはAPI_pool_welcome()で送る)
+	this_pgsql->pgsql_status = 10;
+	this_pgsql->ready_status = 'I';
+	this_client->client_status = 2;
+
+	// トランザクション単位のプールなら、トランザクション毎に割り当てるのでログレベルを下げる
+	LOGGING(LOG_QUEUEING, (((struct EVS_db_t *)this_pgsql->db_info)->pool_mode == 1) ? LOGLEVEL_DEBUG : LOGLEVEL_LOG, NULL, log_str, "PostgreSQL(%s) Pooled connection attached. (client=%s, pgsql=%d)\n", ((struct EVS_db_t *)this_pgsql->db_info)->hostname, this_client->addr_str, this_pgsql->socket_fd);
+}
+
+// --------------------------------
+// プール接続開始メッセージレスポンス送信処理 ※API_pool_attach()で割り当てた後に呼ばれる
+// --------------------------------
+// PostgreSQLの代わりに、AuthenticationOk、保存しておいたParameterStatusとBackendKeyData、ReadyForQuery('I')をクライアントに送る
+int API_pool_welcome(struct EVS_ev_client_t *this_client)
+{
+	int                             api_result;
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_ev_pgsql_t           *this_pgsql = this_client->pgsql_info;
+	static const char               auth_ok[] = {'R', 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00};
+	static const char               ready_idle[] = {'Z', 0x00, 0x00, 0x00, 0x05, 'I'};
+	char                            message_buf[sizeof(auth_ok) + sizeof(this_pgsql->startup_buf) + sizeof(ready_idle)];
+	int                             message_len = 0;
+
+	memcpy(message_buf + message_len, auth_ok, sizeof(auth_ok));
+	message_len += sizeof(auth_ok);
+	memcpy(message_buf + message_len, this_pgsql->startup_buf, this_pgsql->startup_len);
+	message_len += this_pgsql->startup_len;
+	memcpy(message_buf + message_len, ready_idle, sizeof(ready_idle));
+	message_len += sizeof(ready_idle);
+	// BackendKeyData書き換え処理(保存してあるのは最初に接続したクライアントに渡したPostgreSQLのキーなので、このクライアントのキーにする)
+	API_cancel_rewrite(this_client, message_buf, message_len);
+
+	api_result = API_pgsql_client_send(this_client, (unsigned char *)message_buf, message_len);
+	// キャプチャデータ出力処理
+	API_capture_data(this_client, 0, message_buf, message_len);
+
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "PgAnalyzer -> Client(%s) AuthenticationOk and ReadyForQuery from pool. (message size=%d)\n", this_client->addr_str, message_len);
+
+	this_pgsql->ready_status = 'I';
+	if (this_client->session_info != NULL)
+	{
+		((struct EVS_session_t *)this_client->session_info)->relay.ready_status = 'I';
+	}
+	// プール接続解放判定処理(トランザクション単位のプールなら、最初の問い合わせまで接続は使わない)
+	if (api_result == 0)
+	{
+		API_pool_idle(this_pgsql);
+	}
+	return api_result;
+}
+
+// --------------------------------
+// プール接続リセット送信処理(Queryメッセージを一つ送る)
+// --------------------------------
+static int API_pool_query(struct EVS_ev_pgsql_t *this_pgsql, const char *query_str)
+{
+	char                            message_buf[5 + MAX_STRING_LENGTH];
+	unsigned int                    query_len = strlen(query_str) + 1;
+
+	if (5 + query_len > sizeof(message_buf))
+	{
+		return -1;
+	}
+	message_buf[0] = 'Q';
+	message_buf[1] = (char)((4 + query_len) >> 24);
+	message_buf[2] = (char)((4 + query_len) >> 16);
+	message_buf[3] = (char)((4 + query_len) >> 8);
+	message_buf[4] = (char)(4 + query_len);
+	memcpy(message_buf + 5, query_str, query_len);
+	return API_pgsql_server_send(this_pgsql, (unsigned char *)message_buf, 5 + query_len);
+}
+
+// --------------------------------
+// プール接続追加処理(リセットが終わった接続を、待機中にしてプールに入れる)
+// --------------------------------
+static void API_pool_put(struct EVS_ev_pgsql_t *this_pgsql)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_pgsql->db_info;
+
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): this_pgsql->pgsql_status %d -> 20!!\n", __func__, this_pgsql->socket_fd, this_pgsql->pgsql_status);
+	this_pgsql->pgsql_status = 20;
+	this_pgsql->ready_status = 'I';
+
+	ev_now_update(EVS_loop);                                            // イベントループの日時を現在の日時に更新
+	this_pgsql->last_activity = ev_now(EVS_loop);                       // プールに戻した日時(PoolIdleTimeoutの基準)
+
+	TAILQ_INSERT_HEAD(&db_info->pool_tailq, this_pgsql, pool_entries);
+	db_info->pool_num ++;
+
+	LOGGING(LOG_QUEUEING, (db_info->pool_mode == 1) ? LOGLEVEL_DEBUG : LOGLEVEL_LOG, NULL, log_str, "PostgreSQL(%s) Pooled. (database=%s, user=%s, pgsql=%d, pool=%d/%d)\n", db_info->hostname, db_info->database, db_info->username, this_pgsql->socket_fd, db_info->pool_num, API_pool_max(db_info));
+}
+
+// --------------------------------
+// プール接続待ち処理(クライアントを待ち行列の最後に並べて、割り当てるまで受信を止める)
+// --------------------------------
+static void API_pool_wait(struct EVS_ev_client_t *this_client, struct EVS_db_t *db_info)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	if (this_client->pool_wait == 0)
+	{
+		TAILQ_INSERT_TAIL(&db_info->wait_tailq, this_client, wait_entries);
+		db_info->wait_num ++;
+		this_client->pool_wait = 1;
+		ev_now_update(EVS_loop);                                        // イベントループの日時を現在の日時に更新
+		this_client->wait_time = ev_now(EVS_loop);
+		// 接続受け入れ制御 : 待ち行列追加処理
+		API_admit_enqueue(db_info);
+	}
+	// 割り当てるまでは、クライアントからの受信を止める(受信済みのデータは割り当てた時に送る)
+	ev_io_stop(EVS_loop, &this_client->io_watcher);
+
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "PostgreSQL(%s) Client(%s) waiting for a connection. (database=%s, user=%s, pgsql=%d/%d, waiting=%d)\n", db_info->hostname, this_client->addr_str, db_info->database, db_info->username, db_info->pgsql_num, API_pool_max(db_info), db_info->wait_num);
+}
+
+// --------------------------------
+// プール接続待ち解除処理(待ち行列から外して、受信を再開する)
+// --------------------------------
+static void API_pool_unwait(struct EVS_ev_client_t *this_client)
+{
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_client->db_info;
+
+	if (this_client->pool_wait != 0)
+	{
+		TAILQ_REMOVE(&db_info->wait_tailq, this_client, wait_entries);
+		db_info->wait_num --;
+		this_client->pool_wait = 0;
+		// 接続受け入れ制御 : 待ち行列削除処理(割り当てまでの待ち時間を数える)
+		API_admit_dequeue(this_client, db_info, 1);
+	}
+	ev_io_start(EVS_loop, &this_client->io_watcher);
+}
+
+// --------------------------------
+// プール接続再開処理(接続を割り当てたクライアントの、止めていた処理を続ける)
+// --------------------------------
+// 開始メッセージ応答待ちなら開始メッセージレスポンスを送り、そうでなければ受信済みの問い合わせをPostgreSQLに送る
+static int API_pool_resume(struct EVS_ev_client_t *this_client, int startup_flag)
+{
+	if (startup_flag != 0)
+	{
+		return API_pool_welcome(this_client);
+	}
+	return API_pgsql_client_query(this_client);
+}
+
+// --------------------------------
+// プール接続エラー送信処理(SQLSTATEを付けて、FATALのErrorResponseをクライアントに送る)
+// --------------------------------
+static void API_pool_error(struct EVS_ev_client_t *this_client, const char *sqlstate_str, const char *message_str)
+{
+	char                            message_buf[256];                   // 送信用メッセージバッファ
+	int                             message_len;
+
+	// 'E' + Int32(長さ) + "SFATAL\0" + "VFATAL\0" + "C<SQLSTATE>\0" + "M<メッセージ>\0" + "\0"
+	message_len = 1 + 4;
+	message_len += snprintf(message_buf + message_len, sizeof(message_buf) - message_len, "SFATAL") + 1;
+	message_len += snprintf(message_buf + message_len, sizeof(message_buf) - message_len, "VFATAL") + 1;
+	message_len += snprintf(message_buf + message_len, sizeof(message_buf) - message_len, "C%.5s", sqlstate_str) + 1;
+	// メッセージは、'M'と二つの'\0'を入れた残りに収まる長さで切る(snprintf()の戻り値が、実際に書いた長さになるように)
+	message_len += snprintf(message_buf + message_len, sizeof(message_buf) - message_len, "M%.*s", (int)(sizeof(message_buf) - message_len - 3), message_str) + 1;
+	message_buf[message_len ++] = '\0';
+	message_buf[0] = 'E';
+	message_buf[1] = (char)((message_len - 1) >> 24);
+	message_buf[2] = (char)((message_len - 1) >> 16);
+	message_buf[3] = (char)((message_len - 1) >> 8);
+	message_buf[4] = (char)(message_len - 1);
+
+	API_pgsql_client_send(this_client, (unsigned char *)message_buf, message_len);
+}
+
+// --------------------------------
+// プール接続入れ替え処理(1:閉じたので新しく接続できる, 0:閉じなかった)
+// --------------------------------
+// 読み書き分離で、接続数が上限なのに、プールには違う種類(書き込みたいのにレプリカ)の接続しかない時は、一番長く使われていない接続を閉じる
+static int API_pool_evict(struct EVS_db_t *db_info)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_ev_pgsql_t           *this_pgsql;
+
+	if (db_info->split_mode == 0 || TAILQ_EMPTY(&db_info->pool_tailq) || db_info->pgsql_num < API_pool_max(db_info))
+	{
+		return 0;
+	}
+	this_pgsql = TAILQ_LAST(&db_info->pool_tailq, EVS_pool_head);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): Pooled connection closed to open another host. (host=%d)\n", __func__, this_pgsql->socket_fd, this_pgsql->host_index);
+	CLOSE_pgsql(EVS_loop, (struct ev_io *)this_pgsql, 0);
+	return 1;
+}
+
+// --------------------------------
+// プール接続空き判定処理(1:新しく接続してよい, 0:接続数が上限)
+// --------------------------------
+// トランザクション単位のプールは、データベース別設定毎の接続数(MaxSize、PoolSize)で制限する(読み書き分離で、違う種類の接続しかないなら入れ替える)
+// 全体(MaxBackendConnections)かデータベース名毎(MaxDatabaseConnections)の上限なら、他の設定のプールで待機中の接続を閉じて空ける
+static int API_pool_room(struct EVS_db_t *db_info)
+{
+	if (API_pool_enabled(db_info) != 0 && db_info->pool_mode == 1 && db_info->pgsql_num >= API_pool_max(db_info) && API_pool_evict(db_info) == 0)
+	{
+		return 0;
+	}
+	while (API_admit_full(db_info) != 0)
+	{
+		if (API_admit_evict(db_info) == 0)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// --------------------------------
+// プール接続配分処理(1:待ち行列の先頭のクライアントを待ち行列から外した, 0:空きがないので待たせたまま)
+// --------------------------------
+// プールが空で、まだ接続数が上限に達していないなら、先頭のクライアントのために新しく接続する
+static int API_pool_dispatch_one(struct EVS_db_t *db_info)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_ev_client_t          *this_client;
+	struct EVS_ev_pgsql_t           *this_pgsql;
+	int                             startup_flag;                       // 開始メッセージ応答待ちのクライアントか(1:開始メッセージレスポンスを送る)
+	int                             api_result;
+
+	if (TAILQ_EMPTY(&db_info->wait_tailq))
+	{
+		return 0;
+	}
+	this_client = TAILQ_FIRST(&db_info->wait_tailq);
+	startup_flag = (this_client->client_status != 2) ? 1 : 0;
+	this_pgsql = API_pool_get(db_info, this_client->route_replica);
+	// プールに接続がないなら
+	if (this_pgsql == NULL)
+	{
+		// 接続数が上限なら、返却されるのを待つ
+		if (API_pool_room(db_info) == 0)
+		{
+			return 0;
+		}
+		API_pool_unwait(this_client);
+		api_result = API_pgsql_server_open(this_client, db_info);
+		if (api_result == 0 && startup_flag == 0)
+		{
+			// 開始メッセージレスポンスはクライアントに送らずに、接続処理が終わったら受信済みの問い合わせを送る
+			((struct EVS_ev_pgsql_t *)this_client->pgsql_info)->pool_pending = 1;
+			ev_io_stop(EVS_loop, &this_client->io_watcher);
+		}
+	}
+	else
+	{
+		API_pool_unwait(this_client);
+		API_pool_attach(this_client, this_pgsql);
+		api_result = API_pool_resume(this_client, startup_flag);
+	}
+	if (api_result != 0)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(fd=%d): Cannot resume client!? (client=%s)\n", __func__, this_client->socket_fd, this_client->addr_str);
+		CLOSE_client(EVS_loop, (struct ev_io *)this_client, 0);
+	}
+	return 1;
+}
+
+// --------------------------------
+// プール接続配分処理(待ち行列の先頭のクライアントから、割り当てられなくなるまで続ける)
+// --------------------------------
+static void API_pool_dispatch(struct EVS_db_t *db_info)
+{
+	while (API_pool_dispatch_one(db_info) != 0)
+	{
+		;
+	}
+}
+
+// --------------------------------
+// プール接続数上限判定処理(1:上限なので待ち行列に並べた, 0:接続してよい, -1:待ち行列が一杯なのでエラーを返した) ※接続開始時に、プールに接続がなかった時に呼ばれる
+// --------------------------------
+int API_pool_limit(struct EVS_ev_client_t *this_client, struct EVS_db_t *db_info)
+{
+	// 先に待っているクライアントがいなくて、接続数に空きがあるなら
+	if (TAILQ_EMPTY(&db_info->wait_tailq) && API_pool_room(db_info) != 0)
+	{
+		return 0;
+	}
+	// 待ち行列長判定処理(全体で待っているクライアントが多すぎるなら、待たせずにエラーを返す)
+	if (API_admit_reject(this_client, db_info) != 0)
+	{
+		return -1;
+	}
+	API_pool_wait(this_client, db_info);
+	return 1;
+}
+
+// --------------------------------
+// プール接続要求処理(0:割り当てた, 1:割り当てを待つ, -1:エラー) ※トランザクション単位のプールで、接続のないクライアントから受信した時に呼ばれる
+// --------------------------------
+int API_pool_acquire(struct EVS_ev_client_t *this_client)
+{
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_client->db_info;
+	struct EVS_ev_pgsql_t           *this_pgsql;
+
+	if (db_info == NULL)
+	{
+		return -1;
+	}
+	// Terminateだけなら、接続は要らない(クライアントはこの後に切断してくる)
+	if (this_client->recv_len == 5 && this_client->recv_buf[0] == 'X' && API_pgsql_get_int32(this_client->recv_buf + 1) == 4)
+	{
+		return 1;
+	}
+	// 読み書き分離判定処理(プライマリとレプリカのどちらの接続を割り当てるか)
+	this_client->route_replica = API_split_route(this_client);
+	// 待っているクライアントがいなくて、プールに接続があるなら
+	if (TAILQ_EMPTY(&db_info->wait_tailq) && (this_pgsql = API_pool_get(db_info, this_client->route_replica)) != NULL)
+	{
+		API_pool_attach(this_client, this_pgsql);
+		return 0;
+	}
+	// まだ接続数が上限に達していない(プールの接続を入れ替えた)なら、新しく接続する(開始メッセージレスポンスはクライアントに送らずに、接続処理が終わったら受信済みの問い合わせを送る)
+	if (TAILQ_EMPTY(&db_info->wait_tailq) && API_pool_room(db_info) != 0)
+	{
+		if (API_pgsql_server_open(this_client, db_info) != 0)
+		{
+			return -1;
+		}
+		((struct EVS_ev_pgsql_t *)this_client->pgsql_info)->pool_pending = 1;
+		ev_io_stop(EVS_loop, &this_client->io_watcher);
+		return 1;
+	}
+	// 待ち行列長判定処理(全体で待っているクライアントが多すぎるなら、待たせずにエラーを返す)
+	if (API_admit_reject(this_client, db_info) != 0)
+	{
+		return -1;
+	}
+	// 空くまで待つ
+	API_pool_wait(this_client, db_info);
+	return 1;
+}
+
+// --------------------------------
+// プール接続解放判定処理 ※トランザクション単位のプールで、PostgreSQLから受信したメッセージを処理し終わる度に呼ばれる
+// --------------------------------
+// 応答待ちの問い合わせがなく、最後のReadyForQueryがトランザクション外('I')なら、接続をプールに返して待ち行列の先頭に割り当てる
+void API_pool_idle(struct EVS_ev_pgsql_t *this_pgsql)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_ev_client_t          *this_client = (struct EVS_ev_client_t *)this_pgsql->client_info;
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_pgsql->db_info;
+	struct EVS_session_t            *this_session;
+
+	if (API_pool_enabled(db_info) == 0 || db_info->pool_mode != 1 || this_client == NULL || this_pgsql->pgsql_status != 10 || this_pgsql->startup_len < 0)
+	{
+		return;
+	}
+	// 接続を待っているクライアントのために開いた接続の、接続処理が終わったなら
+	if (this_pgsql->pool_pending != 0)
+	{
+		this_pgsql->pool_pending = 0;
+		ev_io_start(EVS_loop, &this_client->io_watcher);
+		if (API_pool_resume(this_client, 0) != 0)
+		{
+			LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(fd=%d): Cannot resume client!? (client=%s)\n", __func__, this_client->socket_fd, this_client->addr_str);
+			CLOSE_client(EVS_loop, (struct ev_io *)this_client, 0);
+		}
+		return;
+	}
+	// メッセージの境界を見失ったセッションや、問い合わせ中、トランザクション中、COPY中なら、そのまま使い続ける
+	this_session = (struct EVS_session_t *)this_client->session_info;
+	if (this_session == NULL || this_session->relay.relay_lost != 0 || this_session->relay.sync_count > 0 ||
+		this_session->relay.ready_status != 'I' || this_session->relay.copy_status != 0)
+	{
+		return;
+	}
+
+	// クライアントとの紐づけを外して、プールに戻す
+	this_client->pgsql_info = NULL;
+	this_pgsql->client_info = NULL;
+	API_pool_put(this_pgsql);
+
+	// 待っているクライアントに割り当てる
+	API_pool_dispatch(db_info);
+}
+
+// --------------------------------
+// プール接続返却処理 ※クライアント接続終了時に呼ばれる
+// --------------------------------
+// プールに戻せる接続ならリセットを送って21:リセット中にし、戻せない接続は閉じる
+void API_pool_release(struct EVS_ev_client_t *this_client)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_ev_pgsql_t           *this_pgsql = this_client->pgsql_info;
+	struct EVS_db_t                 *db_info;
+
+	// 接続の空きを待っていたなら、待ち行列から外す
+	if (this_client->pool_wait != 0)
+	{
+		db_info = (struct EVS_db_t *)this_client->db_info;
+		TAILQ_REMOVE(&db_info->wait_tailq, this_client, wait_entries);
+		db_info->wait_num --;
+		this_client->pool_wait = 0;
+		// 接続受け入れ制御 : 待ち行列削除処理
+		API_admit_dequeue(this_client, db_info, 0);
+	}
+	if (this_pgsql == NULL)
+	{
+		return;
+	}
+	db_info = (struct EVS_db_t *)this_pgsql->db_info;
+
+	// クライアントとの紐づけを外す
+	this_client->pgsql_info = NULL;
+	this_pgsql->client_info = NULL;
+
+	// プールしない設定か、保存しきれなかった接続か、透過モードでない(接続処理中の)か、問い合わせ中か、プールが一杯なら(トランザクション単位のプールは、接続数で上限を決めている)
+	if (API_pool_enabled(db_info) == 0 || this_pgsql->startup_len < 0 || this_pgsql->pgsql_status != 10 || this_pgsql->pool_pending != 0 || this_pgsql->ready_status == 0 ||
+		(db_info->pool_mode != 1 && db_info->pool_num + db_info->pool_reset_num >= API_pool_max(db_info)))
+	{
+		// プールしないなら、クライアントが切断した接続はもう使わない
+		if (API_pool_enabled(db_info) != 0)
+		{
+			LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(pgsql=%d): Not pooled. (pgsql_status=%d, ready_status=0x%02x, pool=%d/%d)\n", __func__, this_pgsql->socket_fd, this_pgsql->pgsql_status, (unsigned char)this_pgsql->ready_status, db_info->pool_num, API_pool_max(db_info));
+		}
+		CLOSE_pgsql(EVS_loop, (struct ev_io *)this_pgsql, 0);
+		return;
+	}
+
+	// トランザクション中なら、先にROLLBACKする
+	this_pgsql->reset_count = 0;
+	if (this_pgsql->ready_status != 'I')
+	{
+		if (API_pool_query(this_pgsql, "ROLLBACK") != 0)
+		{
+			CLOSE_pgsql(EVS_loop, (struct ev_io *)this_pgsql, 0);
+			return;
+		}
+		this_pgsql->reset_count ++;
+	}
+	// トランザクション単位のプールは、セッションの状態を引き継がない前提なのでリセットしない
+	if (db_info->pool_mode != 1 && EVS_config.pool_reset_query != NULL && EVS_config.pool_reset_query[0] != '\0')
+	{
+		if (API_pool_query(this_pgsql, EVS_config.pool_reset_query) != 0)
+		{
+			CLOSE_pgsql(EVS_loop, (struct ev_io *)this_pgsql, 0);
+			return;
+		}
+		this_pgsql->reset_count ++;
+	}
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): this_pgsql->pgsql_status %d -> 21!!\n", __func__, this_pgsql->socket_fd, this_pgsql->pgsql_status);
+	this_pgsql->pgsql_status = 21;
+	db_info->pool_reset_num ++;
+
+	// リセットするものがなければ、そのままプールに戻して、待っているクライアントに割り当てる
+	if (this_pgsql->reset_count == 0)
+	{
+		db_info->pool_reset_num --;
+		API_pool_put(this_pgsql);
+		API_pool_dispatch(db_info);
+	}
+}
+
+// --------------------------------
+// 事前接続間隔取得処理(0～PoolWarmJitter秒の乱数)
+// --------------------------------
+static ev_tstamp API_pool_jitter(void)
+{
+	uint32_t                        rand_value = 0;
+
+	// 乱数が取れなければ、間隔の半分
+	if (RAND_bytes((unsigned char *)&rand_value, sizeof(rand_value)) != 1)
+	{
+		return EVS_config.pool_warm_jitter / 2.;
+	}
+	return EVS_config.pool_warm_jitter * ((double)rand_value / 4294967296.);
+}
+
+// --------------------------------
+// プール事前接続処理 ※タイマーイベント(API_pool_check)から呼ばれる
+// --------------------------------
+// プールで待機中と事前接続中の接続数がMinIdle未満で、上限(MaxSize、PoolSize)に余裕があれば、クライアントなしでPostgreSQLに接続する
+// 接続処理(SSLハンドシェイク、StartupMessage、認証)は、受信イベントで進める(終わったらAPI_pool_ready()でプールに入れる)
+static void API_pool_fill(struct EVS_db_t *db_info, ev_tstamp nowtime)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	int                             pgsql_num;
+
+	while (db_info->pool_num + db_info->warm_num < db_info->pool_min)
+	{
+		// 上限に余裕がないなら(トランザクション単位のプールは開いている接続数、セッション単位のプールは待機中の接続数で数える。全体とデータベース名毎の上限も超えない)
+		if ((db_info->pool_mode == 1 && db_info->pgsql_num >= API_pool_max(db_info)) ||
+			(db_info->pool_mode != 1 && db_info->pool_num + db_info->pool_reset_num + db_info->warm_num >= API_pool_max(db_info)) ||
+			API_admit_full(db_info) != 0)
+		{
+			break;
+		}
+		// 最初の接続も、乱数だけ遅らせる(複数のPgAnalyzerやデータベース別設定が、同時に接続しないように)
+		if (db_info->warm_time == 0.)
+		{
+			db_info->warm_time = nowtime + API_pool_jitter();
+		}
+		if (db_info->warm_time > nowtime)
+		{
+			break;
+		}
+		pgsql_num = db_info->pgsql_num;
+		API_pgsql_server_open(NULL, db_info);
+		// 接続できなかったなら、次のタイマーイベント以降に試す
+		if (db_info->pgsql_num == pgsql_num)
+		{
+			LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "PostgreSQL(%s) Cannot open a pre-warmed connection!? (database=%s, user=%s, pool=%d/%d)\n", db_info->hostname, db_info->database, db_info->username, db_info->pool_num, db_info->pool_min);
+			db_info->warm_time = nowtime + EVS_config.timer_checkintval + API_pool_jitter();
+			break;
+		}
+		db_info->warm_num ++;
+		db_info->warm_time += API_pool_jitter();
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "PostgreSQL(%s) Pre-warming a connection. (database=%s, user=%s, pool=%d, warming=%d, min=%d)\n", db_info->hostname, db_info->database, db_info->username, db_info->pool_num, db_info->warm_num, db_info->pool_min);
+	}
+	// 足りているなら、次に足りなくなった時の最初の接続も乱数だけ遅らせる
+	if (db_info->pool_num + db_info->warm_num >= db_info->pool_min)
+	{
+		db_info->warm_time = 0.;
+	}
+}
+
+// --------------------------------
+// プール事前接続完了処理(-1:プールできないので閉じる) ※事前接続の受信処理(API_pgsql_server)の最後に呼ばれる
+// --------------------------------
+int API_pool_ready(struct EVS_ev_pgsql_t *this_pgsql)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_pgsql->db_info;
+
+	// まだ接続処理中なら
+	if (this_pgsql->pgsql_status != 10)
+	{
+		return 0;
+	}
+	this_pgsql->pool_warm = 0;
+	db_info->warm_num --;
+	// 開始メッセージレスポンスを保存しきれなかったなら
+	if (this_pgsql->startup_len < 0)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(pgsql=%d): Startup response too long to pool! Close.\n", __func__, this_pgsql->socket_fd);
+		return -1;
+	}
+	API_pool_put(this_pgsql);
+	// 待っているクライアントに割り当てる
+	API_pool_dispatch(db_info);
+	return 0;
+}
+
+// --------------------------------
+// プール接続受信処理(20:プール待機中、21:リセット中にPostgreSQLから受信したメッセージの処理。-1なら接続を閉じる)
+// --------------------------------
+// リセット中は、送ったQueryの数だけReadyForQueryが来たら待機中にする(エラーが来たら閉じる)。
+// 待機中は、ParameterStatusとNoticeResponse以外が来たら閉じる(管理者による切断など)。
+int API_pool_server(struct EVS_ev_pgsql_t *this_pgsql)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	char                            *message_ptr = this_pgsql->recv_buf;
+	char                            *end_ptr = this_pgsql->recv_buf + this_pgsql->recv_len;
+	struct EVS_pgmsg_t              pgmsg;                              // PostgreSQLメッセージ解析用構造体
+
+	memset(&pgmsg, 0, sizeof(pgmsg));
+	while (message_ptr < end_ptr)
+	{
+		// メッセージヘッダ解析処理(メッセージ全体が受信バッファ内に収まっていないなら)
+		if (API_pgsql_decode_header(&pgmsg, message_ptr, end_ptr) != 1)
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): Illegal message length!? (recv_len=%d, offset=%d)\n", __func__, this_pgsql->socket_fd, this_pgsql->recv_len, (int)(message_ptr - this_pgsql->recv_buf));
+			return -1;
+		}
+		switch (pgmsg.message_type)
+		{
+			case 'S':                                                   // 0x53 : S ... ParameterStatus(リセットで初期値に戻った通知)
+			case 'N':                                                   // 0x4E : N ... NoticeResponse
+				break;
+			case 'E':                                                   // 0x45 : E ... ErrorResponse
+				LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(pgsql=%d): ErrorResponse in pool! Close. (pgsql_status=%d)\n", __func__, this_pgsql->socket_fd, this_pgsql->pgsql_status);
+				return -1;
+			case 'Z':                                                   // 0x5A : Z ... ReadyForQuery
+				if (this_pgsql->pgsql_status == 21 && this_pgsql->reset_count > 0)
+				{
+					this_pgsql->reset_count --;
+					// 全部のリセットが終わったら(これ以降のメッセージは、待機中として扱う)
+					if (this_pgsql->reset_count == 0)
+					{
+						((struct EVS_db_t *)this_pgsql->db_info)->pool_reset_num --;
+						API_pool_put(this_pgsql);
+					}
+					break;
+				}
+				// fall through
+			default:
+				// リセット中のCommandCompleteなど
+				if (this_pgsql->pgsql_status == 21)
+				{
+					break;
+				}
+				LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(pgsql=%d): Unexpected message in pool! Close. (type=0x%02x, pgsql_status=%d)\n", __func__, this_pgsql->socket_fd, pgmsg.message_type, this_pgsql->pgsql_status);
+				return -1;
+		}
+		// メッセージの先頭ポインタを更新
+		message_ptr += pgmsg.message_len + 1;
+	}
+	// リセットが終わって戻った接続を、待っているクライアントに割り当てる
+	if (this_pgsql->pgsql_status == 20)
+	{
+		API_pool_dispatch((struct EVS_db_t *)this_pgsql->db_info);
+	}
+	return 0;
+}
+
+// --------------------------------
+// プール接続終了処理 ※PostgreSQL接続終了処理(CLOSE_pgsql)から呼ばれる
+// --------------------------------
+// プールに入っていればプールから外し、クライアントに割り当てられていれば紐づけを外す
+// トランザクション単位のプールで、接続を待っていたクライアントのために開いた接続なら、クライアントを待ち行列の先頭に戻す
+// 割り当て中(トランザクション中かもしれない)なら、別の接続で続けられないので、クライアントも切断させる
+void API_pool_close(struct EVS_ev_pgsql_t *this_pgsql)
+{
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_pgsql->db_info;
+	struct EVS_ev_client_t          *this_client = (struct EVS_ev_client_t *)this_pgsql->client_info;
+
+	if (db_info != NULL && this_pgsql->pgsql_status != 0)
+	{
+		db_info->pgsql_num --;
+		// 接続受け入れ制御 : 接続終了処理(待っているクライアントがいれば、空いた分を割り当てる)
+		API_admit_close(db_info);
+	}
+	// 事前接続中に閉じたなら
+	if (db_info != NULL && this_pgsql->pool_warm != 0)
+	{
+		db_info->warm_num --;
+		this_pgsql->pool_warm = 0;
+	}
+	if (this_pgsql->pgsql_status == 20 && db_info != NULL)
+	{
+		TAILQ_REMOVE(&db_info->pool_tailq, this_pgsql, pool_entries);
+		db_info->pool_num --;
+	}
+	else if (this_pgsql->pgsql_status == 21 && db_info != NULL)
+	{
+		db_info->pool_reset_num --;
+	}
+	if (this_client != NULL)
+	{
+		this_client->pgsql_info = NULL;
+		this_pgsql->client_info = NULL;
+		if (db_info != NULL && db_info->pool_mode == 1 && API_pool_enabled(db_info) != 0)
+		{
+			if (this_pgsql->pool_pending != 0)
+			{
+				TAILQ_INSERT_HEAD(&db_info->wait_tailq, this_client, wait_entries);
+				db_info->wait_num ++;
+				this_client->pool_wait = 1;
+				API_admit_enqueue(db_info);
+			}
+			else
+			{
+				shutdown(this_client->socket_fd, SHUT_RDWR);
+			}
+		}
+	}
+	this_pgsql->pgsql_status = 0;
+}
+
+// --------------------------------
+// プール接続タイムアウト確認処理 ※タイマーイベントから呼ばれる
+// --------------------------------
+// PoolIdleTimeout(秒)以上使われなかった待機中の接続を閉じる
+// PoolWaitTimeout(秒)以上接続を待っているクライアントは、エラーを返して切断する(プールしない設定でも、接続数の上限で待っていることがある)
+void API_pool_check(ev_tstamp nowtime)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_db_t                 *db_list;                           // データベース別設定用構造体ポインタ
+	struct EVS_ev_pgsql_t           *this_pgsql;
+	struct EVS_ev_pgsql_t           *next_pgsql;
+	struct EVS_ev_client_t          *this_client;
+	struct EVS_ev_client_t          *next_client;
+
+	TAILQ_FOREACH (db_list, &EVS_db_tailq, entries)
+	{
+		if (API_pool_enabled(db_list) != 0)
+		{
+			for (this_pgsql = TAILQ_FIRST(&db_list->pool_tailq); this_pgsql != NULL && EVS_config.pool_idle_timeout > 0.; this_pgsql = next_pgsql)
+			{
+				next_pgsql = TAILQ_NEXT(this_pgsql, pool_entries);
+				// MinIdle分の接続は閉じない
+				if (this_pgsql->last_activity + EVS_config.pool_idle_timeout < nowtime && db_list->pool_num > db_list->pool_min)
+				{
+					CLOSE_pgsql(EVS_loop, (struct ev_io *)this_pgsql, 0);
+				}
+			}
+			// プール事前接続処理(MinIdleに足りなければ、接続しておく) ※経路表から外した設定は、接続しておかない
+			if (db_list->route_retired == 0)
+			{
+				API_pool_fill(db_list, nowtime);
+			}
+		}
+		for (this_client = TAILQ_FIRST(&db_list->wait_tailq); this_client != NULL && EVS_config.pool_wait_timeout > 0.; this_client = next_client)
+		{
+			next_client = TAILQ_NEXT(this_client, wait_entries);
+			if (this_client->wait_time + EVS_config.pool_wait_timeout < nowtime)
+			{
+				LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "PostgreSQL(%s) Client(%s) pool wait timeout! Close. (waiting=%d)\n", db_list->hostname, this_client->addr_str, db_list->wait_num);
+				API_admit_timeout();
+				API_pool_error(this_client, "08P01", "pool wait timeout");
+				CLOSE_client(EVS_loop, (struct ev_io *)this_client, 0);
+			}
+		}
+	}
+	// 接続できなかったなどで空きができていれば、待っているクライアントに割り当てる(データベース別設定を順番に、一人ずつ)
+	API_admit_dispatch();
+}
@@ -0,0 +1,542 @@
+// ----------------------------------------------------------------------
+// Protocol Analyzer for PostgreSQL -
+// Purpose:
+//     Hash-indexed routing table of PostgreSQL entries by database/user.
+//
+// Program:
+//     Takeshi Kaburagi/MyDNS.JP    https://www.fvg-on.net/
+//
+// Usage:
+//     ./evs_pganalyzer [./evserver.ini]
+// ----------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------
+// ヘッダ部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// インクルード宣言
+// --------------------------------
+
+// --------------------------------
+// 定数宣言
+// --------------------------------
+#define ROUTE_WILDCARD          "*"                         // データベース名、ユーザー名のワイルドカード
+#define MIN_ROUTE_LIST_SIZE     64                          // 経路表の最小エントリ数(2のべき乗)
+#define ROUTE_EXPAND_IDLE_TIME  60.                         // ワイルドカードの設定から作った設定を、使われなくなってから開放するまでの時間(秒)
+
+// --------------------------------
+// 型宣言
+// --------------------------------
+struct EVS_route_t {                                        // 経路表(データベース名、ユーザー名別のデータベース別設定のハッシュ表)
+	unsigned int    list_size;                              // exact_listのエントリ数(2のべき乗)
+	unsigned int    list_num;                               // exact_listに登録した数
+	struct EVS_db_t **exact_list;                           // ワイルドカードを含まないデータベース別設定(オープンアドレス法、NULL:空き)
+	unsigned int    wild_size;                              // wild_listのエントリ数(2のべき乗)
+	unsigned int    wild_num;                               // wild_listに登録した数
+	struct EVS_db_t **wild_list;                            // ワイルドカードを含むデータベース別設定(二次索引)
+};
+
+// --------------------------------
+// 変数宣言
+// --------------------------------
+static struct EVS_route_t       *EVS_route_table = NULL;                    // 現在の経路表(作り直したら、丸ごと差し替える)
+static int                      EVS_route_stale = 0;                        // 経路表を作り直せなかった(経路表から外した設定が、まだ古い経路表に残っているので開放しない)
+static int                      EVS_route_expand_num = 0;                   // ワイルドカードの設定から作った設定の数
+
+// ----------------------------------------------------------------------
+// コード部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// 経路表について
+// --------------------------------
+// クライアントが接続してくる度に、データベース用テールキューを先頭から比較していると、データベース別設定の数に比例して遅くなる。
+// そこで、設定を読み込んだら(データベース名, ユーザー名)をキーにしたハッシュ表を作って、一回の探索で見つけられるようにする。
+//
+// データベース名かユーザー名が"*"の設定は、二次索引(wild_list)に入れておき、該当する設定がない時だけ、以下の順に探す。
+//      (database, *) → (*, username) → (*, *)
+// 見つかったら、その設定をひな形にして、クライアントのデータベース名・ユーザー名の設定を作って登録する(プールはこの設定毎になる)。
+//
+// ワイルドカードの設定から作った設定は、認証前のクライアントが名前を変えるだけでいくらでも増やせるので、
+//  ・MaxWildcardEntriesを上限にする(上限なら、使われていない設定を開放して空ける。空かなければ接続させない)
+//  ・使っているクライアントがいなくなってからROUTE_EXPAND_IDLE_TIME(秒)経ったら、経路表から外して開放する
+//
+// 経路表は作り直してからポインタを差し替える(探索中に半端な経路表を見ることはない)。
+// SIGHUPで設定ファイルのPostgreSQL設定を読み直したら、変わっていない設定はプールごとそのまま使い、
+// 無くなった設定、変わった設定は経路表から外して、使っているクライアントと接続がなくなったら開放する。
+// --------------------------------
+// 経路表キー用ハッシュ値生成処理
+// --------------------------------
+static unsigned int API_route_hash(const char *database, const char *username)
+{
+	unsigned int                    hash;
+
+	hash = API_stats_hash(2166136261U, database, strlen(database) + 1);
+	hash = API_stats_hash(hash, username, strlen(username) + 1);
+	return hash;
+}
+
+// --------------------------------
+// 経路表エントリ数計算処理(登録数の二倍以上の2のべき乗)
+// --------------------------------
+static unsigned int API_route_size(unsigned int entry_num)
+{
+	unsigned int                    list_size = MIN_ROUTE_LIST_SIZE;
+
+	while (list_size < entry_num * 2)
+	{
+		list_size *= 2;
+	}
+	return list_size;
+}
+
+// --------------------------------
+// 経路表登録処理(1:同じキーが登録済みなので登録しない, 0:登録した)
+// --------------------------------
+static int API_route_insert(struct EVS_db_t **route_list, unsigned int list_size, struct EVS_db_t *db_info)
+{
+	unsigned int                    list_num;
+
+	// 線形探索で空きエントリを探す(登録数は常にエントリ数の半分以下)
+	for (list_num = API_route_hash(db_info->database, db_info->username) & (list_size - 1); route_list[list_num] != NULL; list_num = (list_num + 1) & (list_size - 1))
+	{
+		if (strcmp(route_list[list_num]->database, db_info->database) == 0 && strcmp(route_list[list_num]->username, db_info->username) == 0)
+		{
+			return 1;
+		}
+	}
+	route_list[list_num] = db_info;
+	return 0;
+}
+
+// --------------------------------
+// 経路表探索処理(なければNULL)
+// --------------------------------
+static struct EVS_db_t *API_route_find(struct EVS_db_t **route_list, unsigned int list_size, const char *database, const char *username)
+{
+	unsigned int                    list_num;
+
+	for (list_num = API_route_hash(database, username) & (list_size - 1); route_list[list_num] != NULL; list_num = (list_num + 1) & (list_size - 1))
+	{
+		if (strcmp(route_list[list_num]->database, database) == 0 && strcmp(route_list[list_num]->username, username) == 0)
+		{
+			return route_list[list_num];
+		}
+	}
+	return NULL;
+}
+
+// --------------------------------
+// 経路表開放処理
+// --------------------------------
+static void API_route_free(struct EVS_route_t *route_table)
+{
+	if (route_table == NULL)
+	{
+		return;
+	}
+	free(route_table->exact_list);
+	free(route_table->wild_list);
+	free(route_table);
+}
+
+// --------------------------------
+// 経路表作成処理(データベース用テールキューから作り直して、差し替える)
+// --------------------------------
+// 同じデータベース名・ユーザー名の設定が複数あれば、先に書かれた設定を使う
+int API_route_build(void)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_route_t              *route_table;
+	struct EVS_route_t              *old_table;
+	struct EVS_db_t                 *db_list;                           // データベース別設定用構造体ポインタ
+	unsigned int                    exact_num = 0;
+	unsigned int                    wild_num = 0;
+	int                             insert_result;
+
+	// ワイルドカードを含む設定と、含まない設定を数える(経路表から外した設定は数えない)
+	TAILQ_FOREACH (db_list, &EVS_db_tailq, entries)
+	{
+		if (db_list->route_retired != 0)
+		{
+			continue;
+		}
+		if (strcmp(db_list->database, ROUTE_WILDCARD) == 0 || strcmp(db_list->username, ROUTE_WILDCARD) == 0)
+		{
+			wild_num ++;
+		}
+		else
+		{
+			exact_num ++;
+		}
+	}
+
+	// 経路表のメモリ領域を確保
+	route_table = (struct EVS_route_t *)calloc(1, sizeof(struct EVS_route_t));
+	if (route_table == NULL)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
+		EVS_route_stale = 1;
+		return -1;
+	}
+	route_table->list_size = API_route_size(exact_num);
+	route_table->wild_size = API_route_size(wild_num);
+	route_table->exact_list = (struct EVS_db_t **)calloc(route_table->list_size, sizeof(struct EVS_db_t *));
+	route_table->wild_list = (struct EVS_db_t **)calloc(route_table->wild_size, sizeof(struct EVS_db_t *));
+	if (route_table->exact_list == NULL || route_table->wild_list == NULL)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
+		API_route_free(route_table);
+		EVS_route_stale = 1;
+		return -1;
+	}
+
+	// 経路表に登録
+	TAILQ_FOREACH (db_list, &EVS_db_tailq, entries)
+	{
+		if (db_list->route_retired != 0)
+		{
+			continue;
+		}
+		if (strcmp(db_list->database, ROUTE_WILDCARD) == 0 || strcmp(db_list->username, ROUTE_WILDCARD) == 0)
+		{
+			insert_result = API_route_insert(route_table->wild_list, route_table->wild_size, db_list);
+			route_table->wild_num += (insert_result == 0) ? 1 : 0;
+		}
+		else
+		{
+			insert_result = API_route_insert(route_table->exact_list, route_table->list_size, db_list);
+			route_table->list_num += (insert_result == 0) ? 1 : 0;
+		}
+		if (insert_result != 0)
+		{
+			LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(): Duplicate PostgreSQL setting! Ignored. (database=%s, username=%s)\n", __func__, db_list->database, db_list->username);
+		}
+	}
+
+	// 経路表を差し替えて、古い経路表を開放する
+	old_table = EVS_route_table;
+	EVS_route_table = route_table;
+	API_route_free(old_table);
+	EVS_route_stale = 0;
+
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): Routing table built. (entries=%u/%u, wildcard=%u/%u)\n", __func__, route_table->list_num, route_table->list_size, route_table->wild_num, route_table->wild_size);
+	return 0;
+}
+
+// --------------------------------
+// データベース別設定比較処理(1:接続先とプールの設定が同じ, 0:違う) ※データベース名・ユーザー名は比べない
+// --------------------------------
+static int API_route_same(struct EVS_db_t *db_info, struct EVS_db_t *other_info)
+{
+	return (strcmp(db_info->password, other_info->password) == 0 && strcmp(db_info->hostname, other_info->hostname) == 0 && strcmp(db_info->servicename, other_info->servicename) == 0 &&
+		db_info->pool_mode == other_info->pool_mode && db_info->pool_min == other_info->pool_min && db_info->pool_max == other_info->pool_max &&
+		db_info->balance_mode == other_info->balance_mode && db_info->split_mode == other_info->split_mode);
+}
+
+// --------------------------------
+// データベース別設定開放処理(データベース用テールキューから外して開放する) ※クライアントも接続も使っていない設定だけ
+// --------------------------------
+static void API_route_release(struct EVS_db_t *db_info)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): PostgreSQL setting released. (database=%s, username=%s, expanded=%d)\n", __func__, db_info->database, db_info->username, db_info->route_expanded);
+	TAILQ_REMOVE(&EVS_db_tailq, db_info, entries);
+	if (db_info->route_expanded != 0)
+	{
+		EVS_route_expand_num --;
+	}
+	// 接続受け入れ制御開放処理(データベース名毎の接続数のまとめ役なら、同じデータベース名の別の設定に引き継ぐ)
+	API_admit_release(db_info);
+	// 接続先ホスト使用終了処理(どの設定からも使われなくなったホストは開放する)
+	API_balance_free(db_info);
+	free(db_info);
+}
+
+// --------------------------------
+// 使われなくなった設定の開放処理(force_flag 1:ワイルドカードの設定から作った設定は、使われなくなってからの時間に関わらず開放する)
+// --------------------------------
+// 経路表から外した設定は、使っているクライアントがいなければプールの接続を閉じて、接続処理中やリセット中の接続もなくなったら開放する
+static void API_route_sweep(ev_tstamp nowtime, int force_flag)
+{
+	struct EVS_db_t                 *db_list;                           // データベース別設定用構造体ポインタ
+	struct EVS_db_t                 *next_db;
+	struct EVS_ev_pgsql_t           *this_pgsql;
+	int                             retire_flag = 0;
+
+	// 使われなくなったワイルドカードの設定を、経路表から外す
+	TAILQ_FOREACH (db_list, &EVS_db_tailq, entries)
+	{
+		if (db_list->route_expanded != 0 && db_list->route_retired == 0 && db_list->client_num == 0 && db_list->wait_num == 0 &&
+			(force_flag != 0 || db_list->route_lasttime + ROUTE_EXPAND_IDLE_TIME < nowtime))
+		{
+			db_list->route_retired = 1;
+			retire_flag = 1;
+		}
+	}
+	// 経路表を作り直せなければ(古い経路表から探されるかもしれないので)開放しない
+	if ((retire_flag != 0 || EVS_route_stale != 0) && API_route_build() != 0)
+	{
+		return;
+	}
+	for (db_list = TAILQ_FIRST(&EVS_db_tailq); db_list != NULL; db_list = next_db)
+	{
+		next_db = TAILQ_NEXT(db_list, entries);
+		if (db_list->route_retired == 0 || db_list->client_num != 0 || db_list->wait_num != 0)
+		{
+			continue;
+		}
+		while ((this_pgsql = TAILQ_FIRST(&db_list->pool_tailq)) != NULL)
+		{
+			CLOSE_pgsql(EVS_loop, (struct ev_io *)this_pgsql, 0);
+		}
+		if (db_list->pgsql_num == 0)
+		{
+			API_route_release(db_list);
+		}
+	}
+}
+
+// --------------------------------
+// ワイルドカード設定展開処理(ひな形の設定から、データベース名・ユーザー名を置き換えた設定を作って登録する。できなければNULL)
+// --------------------------------
+static struct EVS_db_t *API_route_expand(struct EVS_db_t *template_info, const char *database, const char *username)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_db_t                 *db_list;                           // データベース別設定用構造体ポインタ
+
+	// データベース名・ユーザー名が入りきらないなら(切り詰めて登録すると、次に同じ名前で探しても見つからずに、接続の度に作ってしまう)
+	if (strlen(database) >= sizeof(template_info->database) || strlen(username) >= sizeof(template_info->username))
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(): Too long database or username to expand wildcard setting! (database=%s, username=%s)\n", __func__, database, username);
+		return NULL;
+	}
+	// 作った設定の数が上限なら、使われていない設定を開放して空ける
+	if (EVS_config.max_wildcard_entries > 0 && EVS_route_expand_num >= EVS_config.max_wildcard_entries)
+	{
+		API_route_sweep(ev_now(EVS_loop), 1);
+		if (EVS_route_expand_num >= EVS_config.max_wildcard_entries)
+		{
+			LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(): Too many PostgreSQL settings expanded from wildcard! (database=%s, username=%s, max=%d)\n", __func__, database, username, EVS_config.max_wildcard_entries);
+			return NULL;
+		}
+	}
+	// データベース別設定用構造体ポインタのメモリ領域を確保
+	db_list = (struct EVS_db_t *)calloc(1, sizeof(struct EVS_db_t));
+	if (db_list == NULL)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
+		return NULL;
+	}
+	// 接続先とプールの設定だけを引き継ぐ(プールの状態は引き継がない)
+	snprintf(db_list->database, sizeof(db_list->database), "%s", database);
+	snprintf(db_list->username, sizeof(db_list->username), "%s", username);
+	memcpy(db_list->password, template_info->password, sizeof(db_list->password));
+	memcpy(db_list->hostname, template_info->hostname, sizeof(db_list->hostname));
+	memcpy(db_list->servicename, template_info->servicename, sizeof(db_list->servicename));
+	db_list->port = template_info->port;
+	db_list->pool_mode = template_info->pool_mode;
+	db_list->pool_min = template_info->pool_min;
+	db_list->pool_max = template_info->pool_max;
+	memcpy(db_list->host_list, template_info->host_list, sizeof(db_list->host_list));
+	db_list->host_num = template_info->host_num;
+	db_list->balance_mode = template_info->balance_mode;
+	db_list->split_mode = template_info->split_mode;
+	db_list->route_expanded = 1;
+	db_list->route_lasttime = ev_now(EVS_loop);
+	API_balance_init(db_list);
+	API_pgsql_prepare(db_list);
+	API_admit_init(db_list);
+	TAILQ_INIT(&db_list->pool_tailq);
+	TAILQ_INIT(&db_list->wait_tailq);
+	TAILQ_INSERT_TAIL(&EVS_db_tailq, db_list, entries);
+	EVS_route_expand_num ++;
+
+	// 経路表の空きが半分を切るなら、作り直す
+	if ((EVS_route_table->list_num + 1) * 2 > EVS_route_table->list_size)
+	{
+		if (API_route_build() != 0)
+		{
+			return NULL;
+		}
+	}
+	else
+	{
+		API_route_insert(EVS_route_table->exact_list, EVS_route_table->list_size, db_list);
+		EVS_route_table->list_num ++;
+	}
+
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): PostgreSQL setting expanded from wildcard. (database=%s, username=%s, template=%s/%s)\n", __func__, db_list->database, db_list->username, template_info->database, template_info->username);
+	return db_list;
+}
+
+// --------------------------------
+// 経路表探索処理(クライアントから指定されたデータベース名・ユーザー名のデータベース別設定を返す。なければNULL)
+// --------------------------------
+struct EVS_db_t *API_route_lookup(const char *database, const char *username)
+{
+	struct EVS_db_t                 *db_list;                           // データベース別設定用構造体ポインタ
+
+	// まだ経路表がないなら、作る
+	if (EVS_route_table == NULL && API_route_build() != 0)
+	{
+		return NULL;
+	}
+	db_list = API_route_find(EVS_route_table->exact_list, EVS_route_table->list_size, database, username);
+	if (db_list != NULL || EVS_route_table->wild_num == 0)
+	{
+		return db_list;
+	}
+	// ワイルドカードの設定を、具体的な順に探す
+	if ((db_list = API_route_find(EVS_route_table->wild_list, EVS_route_table->wild_size, database, ROUTE_WILDCARD)) == NULL &&
+		(db_list = API_route_find(EVS_route_table->wild_list, EVS_route_table->wild_size, ROUTE_WILDCARD, username)) == NULL &&
+		(db_list = API_route_find(EVS_route_table->wild_list, EVS_route_table->wild_size, ROUTE_WILDCARD, ROUTE_WILDCARD)) == NULL)
+	{
+		return NULL;
+	}
+	return API_route_expand(db_list, database, username);
+}
+
+// --------------------------------
+// 経路表クライアント終了処理 ※クライアント接続終了処理(CLOSE_client)から呼ばれる
+// --------------------------------
+void API_route_leave(struct EVS_ev_client_t *this_client)
+{
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_client->db_info;
+
+	if (db_info == NULL)
+	{
+		return;
+	}
+	db_info->client_num --;
+	db_info->route_lasttime = ev_now(EVS_loop);
+}
+
+// --------------------------------
+// 経路表再読み込み処理(-1:経路表を作り直せなかった) ※設定ファイルのPostgreSQL設定を読み直した後に呼ばれる
+// --------------------------------
+// last_infoより後ろが読み直した設定。abort_flagが0以外なら、読み直した設定を全て捨てる(設定ファイルに誤りがあった)
+// 読み直した設定に、データベース名・ユーザー名と接続先・プールの設定が同じ設定があれば、前の設定をそのまま使い(読み直した方を捨てる)、
+// なければ前の設定を経路表から外す。ワイルドカードの設定から作った設定は、今のひな形と同じならそのまま使う。
+int API_route_reload(struct EVS_db_t *last_info, int abort_flag)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_db_t                 *db_list;                           // データベース別設定用構造体ポインタ(前の設定)
+	struct EVS_db_t                 *new_list;                          // データベース別設定用構造体ポインタ(読み直した設定)
+	struct EVS_db_t                 *next_db;
+	struct EVS_db_t                 *template_info;
+	int                             keep_num = 0;
+	int                             retire_num = 0;
+	int                             add_num = 0;
+
+	// 読み直した設定を全て捨てる
+	if (abort_flag != 0)
+	{
+		for (new_list = (last_info != NULL) ? TAILQ_NEXT(last_info, entries) : TAILQ_FIRST(&EVS_db_tailq); new_list != NULL; new_list = next_db)
+		{
+			next_db = TAILQ_NEXT(new_list, entries);
+			API_route_release(new_list);
+		}
+		return 0;
+	}
+	// 設定ファイルに書かれた前の設定を、読み直した設定と比べる
+	for (db_list = TAILQ_FIRST(&EVS_db_tailq); last_info != NULL && db_list != NULL; db_list = TAILQ_NEXT(db_list, entries))
+	{
+		if (db_list->route_retired == 0 && db_list->route_expanded == 0)
+		{
+			for (new_list = TAILQ_NEXT(last_info, entries); new_list != NULL; new_list = TAILQ_NEXT(new_list, entries))
+			{
+				if (new_list->route_retired == 0 && strcmp(new_list->database, db_list->database) == 0 && strcmp(new_list->username, db_list->username) == 0 && API_route_same(new_list, db_list) != 0)
+				{
+					break;
+				}
+			}
+			if (new_list != NULL)
+			{
+				// 同じ設定なので、読み直した方を経路表に入れない(誰も使っていないので、後で開放される)
+				new_list->route_retired = 1;
+				keep_num ++;
+			}
+			else
+			{
+				db_list->route_retired = 1;
+				retire_num ++;
+			}
+		}
+		if (db_list == last_info)
+		{
+			break;
+		}
+	}
+	// 書き直した設定ファイルで、ワイルドカードでない設定になった名前は、そちらを使う
+	TAILQ_FOREACH (db_list, &EVS_db_tailq, entries)
+	{
+		if (db_list->route_expanded == 0 || db_list->route_retired != 0)
+		{
+			continue;
+		}
+		TAILQ_FOREACH (new_list, &EVS_db_tailq, entries)
+		{
+			if (new_list->route_expanded == 0 && new_list->route_retired == 0 && strcmp(new_list->database, db_list->database) == 0 && strcmp(new_list->username, db_list->username) == 0)
+			{
+				db_list->route_retired = 1;
+				retire_num ++;
+				break;
+			}
+		}
+	}
+	// 経路表を作り直して(ワイルドカードの設定から作った設定は、経路表から外さなければそのまま入る)
+	if (API_route_build() != 0)
+	{
+		return -1;
+	}
+	// ワイルドカードの設定から作った設定は、今の経路表で該当するひな形と同じ設定でなければ外す
+	TAILQ_FOREACH (db_list, &EVS_db_tailq, entries)
+	{
+		if (db_list->route_expanded == 0 || db_list->route_retired != 0)
+		{
+			continue;
+		}
+		if ((template_info = API_route_find(EVS_route_table->wild_list, EVS_route_table->wild_size, db_list->database, ROUTE_WILDCARD)) == NULL &&
+			(template_info = API_route_find(EVS_route_table->wild_list, EVS_route_table->wild_size, ROUTE_WILDCARD, db_list->username)) == NULL)
+		{
+			template_info = API_route_find(EVS_route_table->wild_list, EVS_route_table->wild_size, ROUTE_WILDCARD, ROUTE_WILDCARD);
+		}
+		if (template_info == NULL || API_route_same(db_list, template_info) == 0)
+		{
+			db_list->route_retired = 1;
+			retire_num ++;
+		}
+	}
+	for (new_list = (last_info != NULL) ? TAILQ_NEXT(last_info, entries) : TAILQ_FIRST(&EVS_db_tailq); new_list != NULL; new_list = TAILQ_NEXT(new_list, entries))
+	{
+		add_num += (new_list->route_retired == 0) ? 1 : 0;
+	}
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "Reload: PostgreSQL settings reloaded. (kept=%d, added=%d, retired=%d)\n", keep_num, add_num, retire_num);
+	// 外した設定を経路表から消して、使われていなければ開放する
+	if (API_route_build() != 0)
+	{
+		return -1;
+	}
+	API_route_sweep(ev_now(EVS_loop), 0);
+	return 0;
+}
+
+// --------------------------------
+// 経路表確認処理 ※タイマーイベントから呼ばれる
+// --------------------------------
+// 使われなくなってからROUTE_EXPAND_IDLE_TIME(秒)経ったワイルドカードの設定と、経路表から外した設定を開放する
+void API_route_check(ev_tstamp nowtime)
+{
+	API_route_sweep(nowtime, 0);
+}
+
+// --------------------------------
+// 経路表終了処理
+// --------------------------------
+void API_route_close(void)
+{
+	API_route_free(EVS_route_table);
+	EVS_route_table = NULL;
+}
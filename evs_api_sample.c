@@ -0,0 +1,441 @@
+// ----------------------------------------------------------------------
+// Protocol Analyzer for PostgreSQL -
+// Purpose:
+//     Per-session and per-fingerprint log sampling.
+//
+// Program:
+//     Takeshi Kaburagi/MyDNS.JP    https://www.fvg-on.net/
+//
+// Usage:
+//     ./evs_pganalyzer [./evserver.ini]
+// ----------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------
+// ヘッダ部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// インクルード宣言
+// --------------------------------
+
+// --------------------------------
+// 定数宣言
+// --------------------------------
+
+// --------------------------------
+// 型宣言
+// --------------------------------
+struct EVS_sample_record_t {                                // 保留バッファのレコードヘッダ(この後に受信データが続く。境界は揃っていないので、memcpy()で読み書きする)
+	int             from_client;                            // 受信データの方向(1:クライアント→PostgreSQL, 0:PostgreSQL→クライアント)
+	unsigned int    data_len;                               // 受信データ長
+	struct timeval  data_tv;                                // 受信日時
+};
+
+// --------------------------------
+// 変数宣言
+// --------------------------------
+static unsigned int             EVS_sample_count[MAX_SAMPLE_FINGERPRINT_NUM];   // フィンガープリント別の実行回数(フィンガープリントの剰余で引く)
+
+// ----------------------------------------------------------------------
+// コード部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// ログサンプリングについて
+// --------------------------------
+// ログの量を減らすために、LogSample_Session個に一つのセッションだけ全メッセージを解析し、それ以外のセッションは以下の問い合わせだけを解析する。
+//   ・ErrorResponseになった問い合わせ
+//   ・LogSample_SlowTime秒以上かかった問い合わせ
+//   ・フィンガープリント別に、LogSample_Statement回に一回
+// 対象外のセッションの受信データは、COPY中継処理(メッセージの境界を追いかける処理)の中で、クライアントのメッセージの先頭から
+// ReadyForQueryまでを問い合わせサイクル(パイプラインなら複数をまとめて)として保留バッファに移し、メッセージ用キューには入れない。
+// ReadyForQueryが来た時点で上の条件に当たれば、保留していた受信データを受信日時ごとキューに入れ、当たらなければ捨てる。
+// (捨てる時も、トランザクション状態が変わったなら、113:ReadyForQueryだけをキューに入れて、トランザクションの状態遷移は追いかける)
+// --------------------------------
+// ログサンプリング開始処理 ※セッション開始時に呼ばれる
+// --------------------------------
+void API_sample_start(struct EVS_session_t *this_session)
+{
+	this_session->sample.sample_flag = (EVS_config.logsample_session <= 1 || this_session->session_id % EVS_config.logsample_session == 0) ? 1 : 0;
+	this_session->sample.txn_status = 'I';
+}
+
+// --------------------------------
+// メッセージ用キュー追加処理(受信日時とデータを指定して、キューの最後に積む)
+// --------------------------------
+static int API_sample_queue(struct EVS_ev_client_t *this_client, int from_to, struct timeval *data_tv, const char *data_ptr, unsigned int data_len)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	struct EVS_ev_pgsql_t           *this_pgsql = this_client->pgsql_info;
+	struct EVS_ev_message_t         *message_info;                      // メッセージ用構造体ポインタ
+
+	// メッセージ用構造体ポインタのメモリ領域を確保
+	message_info = (struct EVS_ev_message_t *)calloc(1, sizeof(struct EVS_ev_message_t));
+	// メモリ領域が確保できなかったら
+	if (message_info == NULL)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): Cannot calloc message_info's memory? errno=%d (%s)\n", __func__, this_client->socket_fd, errno, strerror(errno));
+		return -1;
+	}
+
+	// メッセージ情報にメッセージの各種情報をコピー
+	message_info->from_to = from_to;                                    // メッセージの方向
+	message_info->client_socket_fd = this_client->socket_fd;            // 接続してきたクライアントのファイルディスクリプタ
+	message_info->client_status = this_client->client_status;           // クライアント毎の状態
+	message_info->client_ssl_status = this_client->ssl_status;          // クライアント毎のSSL接続状態
+	strcpy(message_info->client_addr_str, this_client->addr_str);       // クライアントのアドレス文字列
+
+	if (this_pgsql != NULL)
+	{
+		message_info->pgsql_socket_fd = this_pgsql->socket_fd;          // 接続したPostgreSQLのファイルディスクリプタ
+		message_info->pgsql_status = this_pgsql->pgsql_status;          // PostgreSQL毎の状態
+		message_info->pgsql_ssl_status = this_pgsql->ssl_status;        // PostgreSQL毎のSSL接続状態
+		strcpy(message_info->pgsql_addr_str, this_pgsql->addr_str);     // PostgreSQLのアドレス文字列
+	}
+	message_info->session_info = this_client->session_info;             // セッション別解析情報
+
+	message_info->message_tv = *data_tv;                                // 受信日時(保留していたなら、保留した時の日時)
+
+	// データの分だけメモリ確保
+	message_info->message_ptr = malloc(data_len);
+	// メモリ領域が確保できなかったら
+	if (message_info->message_ptr == NULL)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): Cannot calloc message_info->message_ptr's memory? errno=%d (%s)\n", __func__, this_client->socket_fd, errno, strerror(errno));
+		free(message_info);
+		return -1;
+	}
+	memcpy(message_info->message_ptr, data_ptr, data_len);
+	message_info->message_len = data_len;
+
+	// テールキューの最後にこの接続の情報を追加する
+	API_spool_insert(message_info);
+
+	return 0;
+}
+
+// --------------------------------
+// 保留データ出力処理(保留していた受信データを、全部メッセージ用キューに入れる)
+// --------------------------------
+static void API_sample_flush(struct EVS_ev_client_t *this_client, struct EVS_sample_t *this_sample)
+{
+	struct EVS_sample_record_t      record;                             // 保留バッファのレコードヘッダ
+	unsigned int                    record_pos;                         // 処理中のレコードの位置
+
+	for (record_pos = 0; record_pos < this_sample->hold_len; record_pos += sizeof(record) + record.data_len)
+	{
+		memcpy(&record, this_sample->hold_buf + record_pos, sizeof(record));
+		API_sample_queue(this_client, (record.from_client == 1) ? 101 : 112, &record.data_tv, this_sample->hold_buf + record_pos + sizeof(record), record.data_len);
+	}
+	this_sample->hold_len = 0;
+}
+
+// --------------------------------
+// 文のサンプリング判定処理(保留中のQuery/Parseのフィンガープリント別に実行回数を数えて、どれかがN回に一回に当たれば1を返す)
+// --------------------------------
+// クライアントのメッセージが受信データの境界で分断されていても、本文の続きを読み飛ばせるようにskip_lenを持ち越す。
+// (メッセージヘッダが分断されているなら、以降のレコードは数えない)
+static int API_sample_statement(struct EVS_sample_t *this_sample)
+{
+	struct EVS_sample_record_t      record;                             // 保留バッファのレコードヘッダ
+	unsigned int                    record_pos;                         // 処理中のレコードの位置
+	char                            *data_ptr;                          // 処理中の位置
+	char                            *data_end;                          // レコードの受信データの終端(の次)
+	char                            *query_ptr;                         // SQL文の先頭
+	char                            *body_end;                          // メッセージ本文の終端(の次)
+	unsigned int                    skip_len = 0;                       // 次のレコードに持ち越す、メッセージ本文の残りの長さ
+	unsigned int                    message_len;                        // メッセージ長(メッセージ長自身の4バイトを含む)
+	unsigned int                    fingerprint;
+	int                             found_flag = 0;                     // Query/Parseがあったか
+	int                             sample_flag = 0;
+
+	// 文のサンプリングをしないなら
+	if (EVS_config.logsample_statement <= 0)
+	{
+		return 0;
+	}
+
+	for (record_pos = 0; record_pos < this_sample->hold_len; record_pos += sizeof(record) + record.data_len)
+	{
+		memcpy(&record, this_sample->hold_buf + record_pos, sizeof(record));
+		if (record.from_client != 1)
+		{
+			continue;
+		}
+		data_ptr = this_sample->hold_buf + record_pos + sizeof(record);
+		data_end = data_ptr + record.data_len;
+		// 前のレコードから続いている本文を読み飛ばす
+		if (skip_len >= record.data_len)
+		{
+			skip_len -= record.data_len;
+			continue;
+		}
+		data_ptr += skip_len;
+		skip_len = 0;
+
+		while (data_end - data_ptr >= 5)
+		{
+			message_len = API_pgsql_get_int32(data_ptr + 1);
+			if (message_len < 4 || message_len > MAX_PGSQL_MESSAGE_LENGTH)
+			{
+				// メッセージの境界を見失ったなら、出力しておく
+				return 1;
+			}
+			// 本文が全部このレコード内にある、Query/Parseなら
+			if (message_len + 1 <= (unsigned int)(data_end - data_ptr) && (data_ptr[0] == 'Q' || data_ptr[0] == 'P'))
+			{
+				query_ptr = data_ptr + 5;
+				body_end = data_ptr + 1 + message_len;
+				// Parseならプリペアドステートメント名を読み飛ばす
+				if (data_ptr[0] == 'P')
+				{
+					query_ptr += strnlen(query_ptr, body_end - query_ptr) + 1;
+				}
+				if (query_ptr < body_end)
+				{
+					fingerprint = API_pgsql_fingerprint(query_ptr, strnlen(query_ptr, body_end - query_ptr));
+					if (EVS_sample_count[fingerprint % MAX_SAMPLE_FINGERPRINT_NUM] ++ % EVS_config.logsample_statement == 0)
+					{
+						sample_flag = 1;
+					}
+					found_flag = 1;
+				}
+			}
+			// 本文が次のレコードに続くなら
+			if (message_len + 1 > (unsigned int)(data_end - data_ptr))
+			{
+				skip_len = message_len + 1 - (data_end - data_ptr);
+				data_ptr = data_end;
+				break;
+			}
+			data_ptr += message_len + 1;
+		}
+		// メッセージヘッダが次のレコードに続くなら
+		if (data_ptr < data_end)
+		{
+			break;
+		}
+	}
+	// Query/Parseがない問い合わせサイクル(Bind/Executeだけなど)は、まとめて数える
+	if (found_flag == 0 && EVS_sample_count[0] ++ % EVS_config.logsample_statement == 0)
+	{
+		sample_flag = 1;
+	}
+	return sample_flag;
+}
+
+// --------------------------------
+// 問い合わせサイクル終了処理(保留していた受信データを、キューに入れるか捨てる)
+// --------------------------------
+static void API_sample_finish(struct EVS_ev_client_t *this_client, struct EVS_sample_t *this_sample, char txn_status)
+{
+	struct timeval                  now_tv;
+	int                             sample_flag;                        // キューに入れるか(1:入れる)
+
+	if (this_sample->hold_status == 1)
+	{
+		gettimeofday(&now_tv, NULL);
+		// 文のサンプリングの実行回数は、エラーや遅い問い合わせでも数える
+		sample_flag = API_sample_statement(this_sample);
+		if (this_sample->hold_error == 1)
+		{
+			sample_flag = 1;
+		}
+		if (EVS_config.logsample_slowtime > 0. && (double)(now_tv.tv_sec - this_sample->hold_tv.tv_sec) + (double)(now_tv.tv_usec - this_sample->hold_tv.tv_usec) / 1000000. >= EVS_config.logsample_slowtime)
+		{
+			sample_flag = 1;
+		}
+
+		if (sample_flag == 1)
+		{
+			API_sample_flush(this_client, this_sample);
+		}
+		// 捨てるけど、トランザクションに関係するなら、トランザクション状態だけキューに入れる
+		else if (txn_status != 'I' || this_sample->txn_status != 'I')
+		{
+			API_sample_queue(this_client, 113, &now_tv, &txn_status, 1);
+		}
+	}
+	this_sample->txn_status = txn_status;
+	this_sample->hold_status = 0;
+	this_sample->hold_len = 0;
+}
+
+// --------------------------------
+// ログサンプリング : メッセージ開始処理 ※COPY中継処理で、メッセージの先頭の一バイトを受信した時に呼ばれる
+// --------------------------------
+void API_sample_begin(struct EVS_session_t *this_session, int from_client, unsigned char message_type)
+{
+	struct EVS_sample_t             *this_sample = &this_session->sample;
+
+	// 全メッセージを解析するセッションなら
+	if (this_sample->sample_flag == 1)
+	{
+		return;
+	}
+	if (from_client == 1)
+	{
+		// 保留していないなら、クライアントのメッセージから問い合わせサイクルの保留を開始する
+		if (this_sample->hold_status == 0)
+		{
+			this_sample->hold_status = 1;
+			this_sample->hold_pending = 0;
+			this_sample->hold_error = 0;
+			this_sample->hold_len = 0;
+			gettimeofday(&this_sample->hold_tv, NULL);
+		}
+		// Query/Sync/FunctionCallなら、ReadyForQueryが一つ来る
+		if (message_type == 'Q' || message_type == 'S' || message_type == 'F')
+		{
+			this_sample->hold_pending ++;
+		}
+	}
+	// ErrorResponseなら
+	else if (message_type == 'E' && this_sample->hold_status != 0)
+	{
+		this_sample->hold_error = 1;
+	}
+}
+
+// --------------------------------
+// ログサンプリング : メッセージ終了処理 ※COPY中継処理で、メッセージの最後の一バイトを受信した時に呼ばれる
+// --------------------------------
+// ReadyForQueryなら、last_charはトランザクション状態
+void API_sample_end(struct EVS_ev_client_t *this_client, struct EVS_session_t *this_session, int from_client, unsigned char message_type, char last_char)
+{
+	struct EVS_sample_t             *this_sample = &this_session->sample;
+	struct EVS_stream_t             *client_stream = &this_session->relay.stream[0];
+
+	// 全メッセージを解析するセッションか、PostgreSQLからのReadyForQueryでないなら
+	if (this_sample->sample_flag == 1 || from_client == 1 || message_type != 'Z')
+	{
+		return;
+	}
+	if (this_sample->hold_pending > 0)
+	{
+		this_sample->hold_pending --;
+	}
+	// 保留中の問い合わせサイクルが全部終わって、クライアントのメッセージの途中でもないなら(途中なら、次のReadyForQueryまで保留を続ける)
+	if (this_sample->hold_pending == 0 && client_stream->skip_len == 0 && client_stream->header_len == 0)
+	{
+		API_sample_finish(this_client, this_sample, last_char);
+	}
+}
+
+// --------------------------------
+// ログサンプリング : 受信データ保留処理 ※COPY中継処理で、保留中に残すデータがあれば呼ばれる
+// --------------------------------
+// new_flagが1なら(受信データ毎の最初なら)新しいレコードにする。保留したら0、保留できなかったら(保留をやめたので、呼び出し元で残すなら)-1を返す。
+int API_sample_hold(struct EVS_ev_client_t *this_client, int from_client, const char *data_ptr, unsigned int data_len, int new_flag)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	struct EVS_session_t            *this_session = (struct EVS_session_t *)this_client->session_info;
+	struct EVS_sample_t             *this_sample = &this_session->sample;
+	struct EVS_sample_record_t      record;                             // 保留バッファのレコードヘッダ
+	unsigned int                    need_len;                           // 必要な保留バッファの長さ
+	unsigned int                    new_size;
+	char                            *new_buf;
+
+	if (new_flag == 1 || this_sample->hold_len == 0)
+	{
+		new_flag = 1;
+		need_len = this_sample->hold_len + sizeof(record) + data_len;
+	}
+	else
+	{
+		need_len = this_sample->hold_len + data_len;
+	}
+	// 保留バッファが足りないなら
+	if (need_len > this_sample->hold_size)
+	{
+		new_size = (this_sample->hold_size > 0) ? this_sample->hold_size : MAX_SIZE_16K;
+		while (new_size < need_len && new_size < MAX_SAMPLE_HOLD_LENGTH)
+		{
+			new_size *= 2;
+		}
+		new_buf = (need_len <= new_size) ? realloc(this_sample->hold_buf, new_size) : NULL;
+		// 最大長を超えるか、メモリ領域が確保できなかったら、保留をやめて、ここまでの受信データをキューに入れる(この問い合わせサイクルは全部解析する)
+		if (new_buf == NULL)
+		{
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): Hold buffer full. (hold_len=%u, data_len=%u)\n", __func__, this_client->socket_fd, this_sample->hold_len, data_len);
+			API_sample_flush(this_client, this_sample);
+			this_sample->hold_status = 2;
+			return -1;
+		}
+		this_sample->hold_buf = new_buf;
+		this_sample->hold_size = new_size;
+	}
+
+	if (new_flag == 1)
+	{
+		record.from_client = from_client;
+		record.data_len = 0;
+		gettimeofday(&record.data_tv, NULL);
+		this_sample->record_pos = this_sample->hold_len;
+		memcpy(this_sample->hold_buf + this_sample->hold_len, &record, sizeof(record));
+		this_sample->hold_len += sizeof(record);
+	}
+	memcpy(this_sample->hold_buf + this_sample->hold_len, data_ptr, data_len);
+	this_sample->hold_len += data_len;
+	memcpy(&record, this_sample->hold_buf + this_sample->record_pos, sizeof(record));
+	record.data_len += data_len;
+	memcpy(this_sample->hold_buf + this_sample->record_pos, &record, sizeof(record));
+	return 0;
+}
+
+// --------------------------------
+// ログサンプリング : 中止処理 ※COPY中継処理でメッセージの境界を見失った時に呼ばれる
+// --------------------------------
+// 以降は問い合わせサイクルが判らないので、保留していた受信データをキューに入れて、このセッションは全部解析する
+void API_sample_lost(struct EVS_ev_client_t *this_client, struct EVS_session_t *this_session)
+{
+	if (this_session->sample.hold_status == 1)
+	{
+		API_sample_flush(this_client, &this_session->sample);
+	}
+	this_session->sample.hold_status = 0;
+	this_session->sample.sample_flag = 1;
+}
+
+// --------------------------------
+// ログサンプリング終了処理 ※クライアント接続終了時に呼ばれる(セッション別解析情報解放依頼処理の前に)
+// --------------------------------
+// 保留中の問い合わせサイクルは、ErrorResponseが来ていたならキューに入れて、それ以外は捨てる
+void API_sample_close(struct EVS_ev_client_t *this_client)
+{
+	struct EVS_session_t            *this_session = (struct EVS_session_t *)this_client->session_info;
+
+	if (this_session == NULL)
+	{
+		return;
+	}
+	if (this_session->sample.hold_status == 1 && this_session->sample.hold_error == 1)
+	{
+		API_sample_flush(this_client, &this_session->sample);
+	}
+	this_session->sample.hold_status = 0;
+	this_session->sample.hold_len = 0;
+	free(this_session->sample.hold_buf);
+	this_session->sample.hold_buf = NULL;
+	this_session->sample.hold_size = 0;
+}
+
+// --------------------------------
+// ログサンプリング : 対象外のReadyForQuery処理 ※113:ログサンプリング対象外のReadyForQueryをアイドルイベントで処理する時に呼ばれる
+// --------------------------------
+void API_sample_ready(struct EVS_ev_message_t *message_info)
+{
+	struct EVS_pgmsg_t              pgmsg;                              // PostgreSQLメッセージ解析用構造体
+
+	memset(&pgmsg, 0, sizeof(pgmsg));
+	pgmsg.from_client = 0;
+	pgmsg.log_type = LOG_DIRECT;
+	pgmsg.log_tv = &(message_info->message_tv);
+	pgmsg.addr_str = message_info->client_addr_str;
+	pgmsg.session_info = (struct EVS_session_t *)message_info->session_info;
+	pgmsg.txn_status = *(char *)message_info->message_ptr;
+	pgmsg.sample_out = 1;
+	// セッション別トランザクション状態遷移処理
+	API_session_ready(&pgmsg);
+}
@@ -0,0 +1,345 @@
+// ----------------------------------------------------------------------
+// Protocol Analyzer for PostgreSQL -
+// Purpose:
+//     SCRAM-SHA-256 authentication toward PostgreSQL, with cached key derivation.
+//
+// Program:
+//     Takeshi Kaburagi/MyDNS.JP    https://www.fvg-on.net/
+//
+// Usage:
+//     ./evs_pganalyzer [./evserver.ini]
+// ----------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------
+// ヘッダ部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// インクルード宣言
+// --------------------------------
+
+// --------------------------------
+// 定数宣言
+// --------------------------------
+#define SCRAM_MECHANISM         "SCRAM-SHA-256"             // SASL認証メカニズム名(チャネルバインディングなしのみ対応)
+#define SCRAM_GS2_HEADER        "n,,"                       // GS2ヘッダ(チャネルバインディングなし、認可IDなし)
+#define SCRAM_GS2_HEADER_B64    "biws"                      // GS2ヘッダをBASE64エンコードしたもの(client-finalのc=)
+#define SCRAM_MAX_ITERATION     1000000                     // 受け付けるイテレーションの最大値(おかしな値でPBKDF2に時間をかけないように)
+
+// --------------------------------
+// 型宣言
+// --------------------------------
+
+// --------------------------------
+// 変数宣言
+// --------------------------------
+
+// ----------------------------------------------------------------------
+// コード部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// SCRAM-SHA-256認証について
+// --------------------------------
+// PostgreSQLからAuthenticationSASL(10)が来たら、RFC 5802/7677の手順で認証する(チャネルバインディングはしない)。
+//      PgAnalyzer -> SASLInitialResponse : "n,,n=,r=クライアントのナンス"
+//      PostgreSQL -> SASLContinue(11)    : "r=ナンス,s=ソルト,i=イテレーション"
+//      PgAnalyzer -> SASLResponse        : "c=biws,r=ナンス,p=ClientProof"
+//      PostgreSQL -> SASLFinal(12)       : "v=ServerSignature"(覚えておいた値と違えば、なりすましとして切断する)
+// SaltedPassword = PBKDF2(パスワード, ソルト, イテレーション)は、イテレーション(既定4096回)のHMACで重いので、
+// 求めたClientKey、StoredKey、ServerKeyを、データベース別設定毎に(ソルト、イテレーション)をキーにして覚えておく。
+// 二回目からの接続では、AuthMessageに対するHMACを二回計算するだけで済む。SaltedPassword自体は覚えない。
+// パスワードはSASLprepせずにそのまま使う(ASCIIのパスワードなら同じ結果になる)。
+// --------------------------------
+// SCRAMメッセージ送信処理(メッセージタイプ'p'と長さを付けて、PostgreSQLに送る)
+// --------------------------------
+static int API_scram_send(struct EVS_ev_pgsql_t *this_pgsql, char *message_buf, int message_len)
+{
+	message_buf[0] = 'p';
+	message_buf[1] = (char)((message_len - 1) >> 24);
+	message_buf[2] = (char)((message_len - 1) >> 16);
+	message_buf[3] = (char)((message_len - 1) >> 8);
+	message_buf[4] = (char)(message_len - 1);
+	return API_pgsql_server_send(this_pgsql, (unsigned char *)message_buf, message_len);
+}
+
+// --------------------------------
+// SCRAM属性取得処理(","区切りの"x=値"から、PgSQL_server_SASL_list[]の属性の値を取り出す。-1:ない)
+// --------------------------------
+static int API_scram_attribute(const char *data_ptr, int data_len, int sasl_param, const char **value_ptr)
+{
+	const char                      *target_ptr = data_ptr;
+	const char                      *end_ptr = data_ptr + data_len;
+	const char                      *comma_ptr;
+
+	while (target_ptr < end_ptr)
+	{
+		comma_ptr = memchr(target_ptr, ',', end_ptr - target_ptr);
+		if (comma_ptr == NULL)
+		{
+			comma_ptr = end_ptr;
+		}
+		if (comma_ptr - target_ptr >= 2 && memcmp(target_ptr, PgSQL_server_SASL_list[sasl_param], 2) == 0)
+		{
+			*value_ptr = target_ptr + 2;
+			return (int)(comma_ptr - target_ptr - 2);
+		}
+		target_ptr = comma_ptr + 1;
+	}
+	return -1;
+}
+
+// --------------------------------
+// BASE64デコード処理(デコードした長さを返す。-1:エラー)
+// --------------------------------
+static int API_scram_decode64(const char *value_ptr, int value_len, unsigned char *result_data, int result_size)
+{
+	int                             result_len;
+
+	if (value_len <= 0 || value_len % 4 != 0 || value_len / 4 * 3 > result_size)
+	{
+		return -1;
+	}
+	result_len = EVP_DecodeBlock(result_data, (const unsigned char *)value_ptr, value_len);
+	if (result_len < 0)
+	{
+		return -1;
+	}
+	// EVP_DecodeBlock()は"="の分も0で埋めて返すので、その分を引く
+	if (value_ptr[value_len - 1] == '=')
+	{
+		result_len --;
+	}
+	if (value_ptr[value_len - 2] == '=')
+	{
+		result_len --;
+	}
+	return result_len;
+}
+
+// --------------------------------
+// SCRAM鍵取得処理(覚えておいた鍵を探し、なければPBKDF2で求めて覚える。NULL:エラー)
+// --------------------------------
+static struct EVS_scram_t *API_scram_key(struct EVS_db_t *db_info, const unsigned char *salt_data, int salt_len, int iteration)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_scram_t              *this_scram;
+	unsigned char                   salted_password[SCRAM_KEY_LENGTH];  // SaltedPassword(鍵を求めたら消す)
+	unsigned int                    key_len;
+	int                             scram_num;
+	ev_tstamp                       start_time;
+
+	for (scram_num = 0; scram_num < MAX_DB_SCRAM_NUM; scram_num ++)
+	{
+		this_scram = &db_info->scram_list[scram_num];
+		if (this_scram->salt_len == salt_len && this_scram->iteration == iteration && memcmp(this_scram->salt, salt_data, salt_len) == 0)
+		{
+			return this_scram;
+		}
+	}
+
+	// 覚えていないなら、一番古いものと置き換える
+	this_scram = &db_info->scram_list[db_info->scram_next];
+	db_info->scram_next = (db_info->scram_next + 1) % MAX_DB_SCRAM_NUM;
+	memset(this_scram, 0, sizeof(struct EVS_scram_t));
+
+	ev_now_update(EVS_loop);                                            // イベントループの日時を現在の日時に更新
+	start_time = ev_now(EVS_loop);
+	if (PKCS5_PBKDF2_HMAC(db_info->password, strlen(db_info->password), salt_data, salt_len, iteration, EVP_sha256(), SCRAM_KEY_LENGTH, salted_password) != 1 ||
+		HMAC(EVP_sha256(), salted_password, SCRAM_KEY_LENGTH, (const unsigned char *)"Client Key", strlen("Client Key"), this_scram->client_key, &key_len) == NULL ||
+		HMAC(EVP_sha256(), salted_password, SCRAM_KEY_LENGTH, (const unsigned char *)"Server Key", strlen("Server Key"), this_scram->server_key, &key_len) == NULL)
+	{
+		OPENSSL_cleanse(salted_password, sizeof(salted_password));
+		memset(this_scram, 0, sizeof(struct EVS_scram_t));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot derive SCRAM-SHA-256 keys!? %s\n", __func__, ERR_reason_error_string(ERR_get_error()));
+		return NULL;
+	}
+	OPENSSL_cleanse(salted_password, sizeof(salted_password));
+	SHA256(this_scram->client_key, SCRAM_KEY_LENGTH, this_scram->stored_key);
+	memcpy(this_scram->salt, salt_data, salt_len);
+	this_scram->salt_len = salt_len;
+	this_scram->iteration = iteration;
+
+	ev_now_update(EVS_loop);                                            // イベントループの日時を現在の日時に更新
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "PostgreSQL(%s) SCRAM-SHA-256 keys derived and cached. (database=%s, username=%s, iteration=%d, %.3f sec)\n", db_info->hostname, db_info->database, db_info->username, iteration, ev_now(EVS_loop) - start_time);
+	return this_scram;
+}
+
+// --------------------------------
+// SCRAM-SHA-256認証開始処理 ※AuthenticationSASL(10)を受けた時に呼ばれる
+// --------------------------------
+// 認証メカニズム名の列にSCRAM-SHA-256があれば、SASLInitialResponse(client-first-message)を送る
+int API_scram_start(struct EVS_ev_pgsql_t *this_pgsql, struct EVS_pgmsg_t *pgmsg)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_pgsql->db_info;
+	char                            *mechanism_ptr = pgmsg->message_ptr + 9;    // 認証メカニズム名の列(\0終端の文字列が並び、空文字列で終わる)
+	char                            *end_ptr = pgmsg->message_ptr + 1 + pgmsg->message_len;
+	unsigned char                   nonce_data[SCRAM_NONCE_LENGTH / 4 * 3];
+	char                            message_buf[MAX_SIZE_1K];
+	int                             message_len;
+	int                             first_len;
+
+	while (mechanism_ptr < end_ptr && *mechanism_ptr != '\0' && strncmp(mechanism_ptr, SCRAM_MECHANISM, end_ptr - mechanism_ptr) != 0)
+	{
+		mechanism_ptr += strnlen(mechanism_ptr, end_ptr - mechanism_ptr) + 1;
+	}
+	if (mechanism_ptr >= end_ptr || *mechanism_ptr == '\0')
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): PostgreSQL does not offer %s!?\n", __func__, this_pgsql->socket_fd, SCRAM_MECHANISM);
+		return -1;
+	}
+
+	// クライアント側のナンス(18バイトの乱数をBASE64エンコードした24文字)
+	if (RAND_bytes(nonce_data, sizeof(nonce_data)) != 1)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): RAND_bytes() error!? %s\n", __func__, this_pgsql->socket_fd, ERR_reason_error_string(ERR_get_error()));
+		return -1;
+	}
+	EVP_EncodeBlock((unsigned char *)this_pgsql->scram_nonce, nonce_data, sizeof(nonce_data));
+
+	// SASLInitialResponse : 'p' + int32 長さ + メカニズム名(\0終端) + int32 client-first-messageの長さ + client-first-message
+	// (ユーザー名は開始メッセージで送っているので、PostgreSQLはn=を見ない)
+	message_len = 5;
+	message_len += snprintf(message_buf + message_len, sizeof(message_buf) - message_len, "%s", SCRAM_MECHANISM) + 1;
+	first_len = snprintf(message_buf + message_len + 4, sizeof(message_buf) - message_len - 4, "%sn=,r=%s", SCRAM_GS2_HEADER, this_pgsql->scram_nonce);
+	message_buf[message_len] = (char)(first_len >> 24);
+	message_buf[message_len + 1] = (char)(first_len >> 16);
+	message_buf[message_len + 2] = (char)(first_len >> 8);
+	message_buf[message_len + 3] = (char)first_len;
+	message_len += 4 + first_len;
+
+	if (API_scram_send(this_pgsql, message_buf, message_len) != 0)
+	{
+		return -1;
+	}
+	this_pgsql->scram_status = 1;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "PgAnalyzer -> PostgreSQL(%s) SASLInitialResponse(%s). (message size=%d)\n", db_info->hostname, SCRAM_MECHANISM, message_len);
+	return 0;
+}
+
+// --------------------------------
+// SCRAM-SHA-256認証継続処理 ※AuthenticationSASLContinue(11)を受けた時に呼ばれる
+// --------------------------------
+// server-first-messageのソルトとイテレーションから鍵を得て、ClientProofを付けたSASLResponse(client-final-message)を送る
+int API_scram_continue(struct EVS_ev_pgsql_t *this_pgsql, struct EVS_pgmsg_t *pgmsg)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_pgsql->db_info;
+	const char                      *server_first = pgmsg->message_ptr + 9;    // server-first-message
+	int                             server_len = (int)pgmsg->message_len - 8;
+	const char                      *value_ptr[SERVER_SASL_END];        // 属性の値
+	int                             value_len[SERVER_SASL_END];         // 属性の値の長さ
+	unsigned char                   salt_data[MAX_SCRAM_SALT_LENGTH];
+	int                             salt_len;
+	char                            iteration_str[16];
+	int                             iteration;
+	struct EVS_scram_t              *this_scram;
+	char                            auth_message[MAX_SIZE_1K];          // AuthMessage = client-first-message-bare + "," + server-first-message + "," + client-final-message-without-proof
+	int                             auth_len;
+	unsigned char                   client_proof[SCRAM_KEY_LENGTH];
+	unsigned int                    key_len;
+	char                            message_buf[MAX_SIZE_1K];
+	int                             message_len;
+	int                             final_len;
+	int                             key_num;
+	int                             sasl_param;
+
+	if (this_pgsql->scram_status != 1 || server_len <= 0)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): Unexpected AuthenticationSASLContinue!? (scram_status=%d)\n", __func__, this_pgsql->socket_fd, this_pgsql->scram_status);
+		return -1;
+	}
+	for (sasl_param = SERVER_SASL_NONCE; sasl_param <= SERVER_SASL_ITERATION; sasl_param ++)
+	{
+		value_len[sasl_param] = API_scram_attribute(server_first, server_len, sasl_param, &value_ptr[sasl_param]);
+		if (value_len[sasl_param] <= 0)
+		{
+			LOGGING(LOG_QUEUEING, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): server-first-message has no %s!?\n", __func__, this_pgsql->socket_fd, PgSQL_server_SASL_list[sasl_param]);
+			return -1;
+		}
+	}
+	// ナンスは、送ったクライアント側のナンスで始まっていないといけない
+	if (value_len[SERVER_SASL_NONCE] <= SCRAM_NONCE_LENGTH || memcmp(value_ptr[SERVER_SASL_NONCE], this_pgsql->scram_nonce, SCRAM_NONCE_LENGTH) != 0)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): SCRAM nonce mismatch!?\n", __func__, this_pgsql->socket_fd);
+		return -1;
+	}
+	salt_len = API_scram_decode64(value_ptr[SERVER_SASL_SALT], value_len[SERVER_SASL_SALT], salt_data, sizeof(salt_data));
+	snprintf(iteration_str, sizeof(iteration_str), "%.*s", value_len[SERVER_SASL_ITERATION], value_ptr[SERVER_SASL_ITERATION]);
+	iteration = atoi(iteration_str);
+	if (salt_len <= 0 || iteration <= 0 || iteration > SCRAM_MAX_ITERATION)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): Illegal SCRAM salt or iteration!? (salt_len=%d, iteration=%d)\n", __func__, this_pgsql->socket_fd, salt_len, iteration);
+		return -1;
+	}
+
+	// SCRAM鍵取得処理(同じソルトとイテレーションなら、覚えておいた鍵を使う)
+	this_scram = API_scram_key(db_info, salt_data, salt_len, iteration);
+	if (this_scram == NULL)
+	{
+		return -1;
+	}
+
+	// client-final-message-without-proof = "c=biws,r=ナンス"
+	message_len = 5;
+	final_len = snprintf(message_buf + message_len, sizeof(message_buf) - message_len, "c=%s,r=%.*s", SCRAM_GS2_HEADER_B64, value_len[SERVER_SASL_NONCE], value_ptr[SERVER_SASL_NONCE]);
+	auth_len = snprintf(auth_message, sizeof(auth_message), "n=,r=%s,%.*s,%.*s", this_pgsql->scram_nonce, server_len, server_first, final_len, message_buf + message_len);
+	if (auth_len >= (int)sizeof(auth_message) || message_len + final_len + 4 + (SCRAM_KEY_LENGTH + 2) / 3 * 4 >= (int)sizeof(message_buf))
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): server-first-message too long!? (len=%d)\n", __func__, this_pgsql->socket_fd, server_len);
+		return -1;
+	}
+	message_len += final_len;
+
+	// ClientProof = ClientKey XOR HMAC(StoredKey, AuthMessage)、ServerSignature = HMAC(ServerKey, AuthMessage)
+	HMAC(EVP_sha256(), this_scram->stored_key, SCRAM_KEY_LENGTH, (unsigned char *)auth_message, auth_len, client_proof, &key_len);
+	for (key_num = 0; key_num < SCRAM_KEY_LENGTH; key_num ++)
+	{
+		client_proof[key_num] ^= this_scram->client_key[key_num];
+	}
+	HMAC(EVP_sha256(), this_scram->server_key, SCRAM_KEY_LENGTH, (unsigned char *)auth_message, auth_len, this_pgsql->scram_signature, &key_len);
+
+	// SASLResponse : 'p' + int32 長さ + client-final-message("c=biws,r=ナンス,p=ClientProof")
+	message_len += snprintf(message_buf + message_len, sizeof(message_buf) - message_len, ",p=");
+	message_len += EVP_EncodeBlock((unsigned char *)message_buf + message_len, client_proof, SCRAM_KEY_LENGTH);
+	OPENSSL_cleanse(client_proof, sizeof(client_proof));
+
+	if (API_scram_send(this_pgsql, message_buf, message_len) != 0)
+	{
+		return -1;
+	}
+	this_pgsql->scram_status = 2;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "PgAnalyzer -> PostgreSQL(%s) SASLResponse(%s). (message size=%d)\n", db_info->hostname, SCRAM_MECHANISM, message_len);
+	return 0;
+}
+
+// --------------------------------
+// SCRAM-SHA-256認証完了処理 ※AuthenticationSASLFinal(12)を受けた時に呼ばれる
+// --------------------------------
+// server-final-messageのServerSignatureが、覚えておいた値と同じか確かめる(違えば、パスワードを知らない相手なので切断する)
+int API_scram_final(struct EVS_ev_pgsql_t *this_pgsql, struct EVS_pgmsg_t *pgmsg)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	const char                      *server_final = pgmsg->message_ptr + 9;    // server-final-message
+	int                             server_len = (int)pgmsg->message_len - 8;
+	const char                      *value_ptr;
+	int                             value_len;
+	unsigned char                   server_signature[SCRAM_KEY_LENGTH + 3];
+	int                             signature_len;
+
+	if (this_pgsql->scram_status != 2 || server_len <= 0)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): Unexpected AuthenticationSASLFinal!? (scram_status=%d)\n", __func__, this_pgsql->socket_fd, this_pgsql->scram_status);
+		return -1;
+	}
+	value_len = API_scram_attribute(server_final, server_len, SERVER_SASL_VERIFIER, &value_ptr);
+	signature_len = API_scram_decode64(value_ptr, value_len, server_signature, sizeof(server_signature));
+	if (signature_len != SCRAM_KEY_LENGTH || CRYPTO_memcmp(server_signature, this_pgsql->scram_signature, SCRAM_KEY_LENGTH) != 0)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): SCRAM server signature mismatch!?\n", __func__, this_pgsql->socket_fd);
+		return -1;
+	}
+	this_pgsql->scram_status = 3;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): SCRAM server signature verified.\n", __func__, this_pgsql->socket_fd);
+	return 0;
+}
@@ -0,0 +1,175 @@
+// ----------------------------------------------------------------------
+// Protocol Analyzer for PostgreSQL -
+// Purpose:
+//     Route read-only sessions and simple-query SELECTs to replica hosts.
+//
+// Program:
+//     Takeshi Kaburagi/MyDNS.JP    https://www.fvg-on.net/
+//
+// Usage:
+//     ./evs_pganalyzer [./evserver.ini]
+// ----------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------
+// ヘッダ部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// インクルード宣言
+// --------------------------------
+
+// --------------------------------
+// 定数宣言
+// --------------------------------
+
+// --------------------------------
+// 型宣言
+// --------------------------------
+
+// --------------------------------
+// 変数宣言
+// --------------------------------
+static ev_tstamp                EVS_split_stat_lasttime = 0.;               // 最後に読み書き分離の統計を出力した日時
+
+// ----------------------------------------------------------------------
+// コード部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// 読み書き分離について
+// --------------------------------
+// PostgreSQL設定に"Split"があれば、ホスト名の最初のホストをプライマリ、残りのホストをレプリカとして、接続を割り当てる時に振り分ける。
+// レプリカの中では、振り分け方法(Balance=)に従ってホストを選ぶ。
+//
+// 以下の場合だけレプリカに送り、それ以外(書き込み、判断できないもの)は全てプライマリに送る。
+//  ・開始メッセージでdefault_transaction_read_only=on(optionsの"-c default_transaction_read_only=on"も可)を指定したセッション
+//  ・トランザクション単位のプールで、接続を割り当てる時(トランザクションの外)に受信したのが、一つだけのQueryで、
+//    そのクエリがSELECT一文で、書き込みを伴うかもしれない単語(INTO、FOR UPDATE/SHARE、nextval()など)も、
+//    読み取り専用と分かっている関数(count()、lower()など)以外の関数呼び出しもない時
+// 判定には、フィンガープリント生成処理の字句解析結果を使う(クエリを別に解析し直さない)。
+// セッション単位のプールでは、セッションの途中で接続を替えられないので、読み取り専用のセッションだけがレプリカに行く。
+//
+// 接続を割り当てる度に、プライマリとレプリカのどちらの接続だったかを数えて、SplitStatInterval(秒)毎に出力する。
+// --------------------------------
+// 読み書き分離するデータベース別設定か(1:する, 0:しない)
+// --------------------------------
+static int API_split_enabled(struct EVS_db_t *db_info)
+{
+	return (db_info != NULL && db_info->split_mode != 0 && db_info->host_num > 1);
+}
+
+// --------------------------------
+// 読み取り専用指定判定処理(1:"on"、"true"など)
+// --------------------------------
+static int API_split_readonly_value(const char *value_str)
+{
+	return (strcasecmp(value_str, "on") == 0 || strcasecmp(value_str, "true") == 0 || strcasecmp(value_str, "yes") == 0 || strcmp(value_str, "1") == 0);
+}
+
+// --------------------------------
+// 読み書き分離セッション開始処理(1:読み取り専用のセッションなのでレプリカに送る, 0:プライマリに送る) ※サーバー接続開始処理から呼ばれる
+// --------------------------------
+// 開始メッセージのdefault_transaction_read_only、もしくはoptionsの"-c default_transaction_read_only=xxx"を見る
+int API_split_session(struct EVS_ev_client_t *this_client, struct EVS_db_t *db_info)
+{
+	char                            **param_info = this_client->param_info;
+	char                            *option_ptr;
+	char                            value_str[16];
+
+	this_client->route_readonly = 0;
+	if (API_split_enabled(db_info) == 0)
+	{
+		return 0;
+	}
+	if (param_info[CLIENT_READONLY] != NULL && API_split_readonly_value(param_info[CLIENT_READONLY]) != 0)
+	{
+		this_client->route_readonly = 1;
+	}
+	else if (param_info[CLIENT_OPTIONS] != NULL && (option_ptr = strstr(param_info[CLIENT_OPTIONS], "default_transaction_read_only=")) != NULL)
+	{
+		if (sscanf(option_ptr + strlen("default_transaction_read_only="), "%15[^ ]", value_str) == 1 && API_split_readonly_value(value_str) != 0)
+		{
+			this_client->route_readonly = 1;
+		}
+	}
+	return this_client->route_readonly;
+}
+
+// --------------------------------
+// 読み書き分離判定処理(1:レプリカに送る, 0:プライマリに送る) ※トランザクション単位のプールで、接続を割り当てる時に呼ばれる
+// --------------------------------
+int API_split_route(struct EVS_ev_client_t *this_client)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_client->db_info;
+	struct EVS_lexinfo_t            lexinfo;                            // クエリの字句解析結果
+	unsigned int                    fingerprint;
+	int                             replica_flag;
+
+	if (API_split_enabled(db_info) == 0)
+	{
+		return 0;
+	}
+	if (this_client->route_readonly != 0)
+	{
+		return 1;
+	}
+	// 受信データが、一つのQueryだけでないなら
+	if (this_client->recv_len < 6 || this_client->recv_buf[0] != 'Q' || API_pgsql_get_int32(this_client->recv_buf + 1) + 1 != (unsigned int)this_client->recv_len)
+	{
+		return 0;
+	}
+	fingerprint = API_pgsql_fingerprint_lex(this_client->recv_buf + 5, strnlen(this_client->recv_buf + 5, this_client->recv_len - 5), &lexinfo);
+	replica_flag = (strcmp(lexinfo.first_word, "select") == 0 && lexinfo.statement_num == 1 && lexinfo.write_flag == 0) ? 1 : 0;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): fingerprint=%08x, first=%s, statements=%d, write=%d -> %s\n", __func__, this_client->socket_fd, fingerprint, lexinfo.first_word, lexinfo.statement_num, lexinfo.write_flag, (replica_flag != 0) ? "replica" : "primary");
+	return replica_flag;
+}
+
+// --------------------------------
+// 読み書き分離計数処理 ※クライアントに接続を割り当てる度に呼ばれる
+// --------------------------------
+void API_split_count(struct EVS_ev_pgsql_t *this_pgsql)
+{
+	struct EVS_db_t                 *db_info = (struct EVS_db_t *)this_pgsql->db_info;
+
+	if (API_split_enabled(db_info) == 0)
+	{
+		return;
+	}
+	if (this_pgsql->host_index != 0)
+	{
+		db_info->split_replica_count ++;
+	}
+	else
+	{
+		db_info->split_primary_count ++;
+	}
+}
+
+// --------------------------------
+// 読み書き分離統計出力処理 ※タイマーイベントから呼ばれる
+// --------------------------------
+// SplitStatInterval(秒)毎に、データベース別設定毎のプライマリ、レプリカへの割り当て数を出力して、数え直す
+void API_split_report(ev_tstamp nowtime)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_db_t                 *db_list;                           // データベース別設定用構造体ポインタ
+	unsigned long                   total_count;
+
+	if (EVS_config.splitstat_intval <= 0. || nowtime < EVS_split_stat_lasttime + EVS_config.splitstat_intval)
+	{
+		return;
+	}
+	EVS_split_stat_lasttime = nowtime;
+
+	TAILQ_FOREACH (db_list, &EVS_db_tailq, entries)
+	{
+		total_count = db_list->split_primary_count + db_list->split_replica_count;
+		if (API_split_enabled(db_list) == 0 || total_count == 0)
+		{
+			continue;
+		}
+		LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "Split: PostgreSQL(%s) database=%s, user=%s, primary=%lu, replica=%lu (%.1f%% off primary)\n", db_list->hostname, db_list->database, db_list->username, db_list->split_primary_count, db_list->split_replica_count, 100. * db_list->split_replica_count / total_count);
+		db_list->split_primary_count = 0;
+		db_list->split_replica_count = 0;
+	}
+}
@@ -0,0 +1,354 @@
+// ----------------------------------------------------------------------
+// Protocol Analyzer for PostgreSQL -
+// Purpose:
+//     Spill the message queue to a memory-mapped spool file.
+//
+// Program:
+//     Takeshi Kaburagi/MyDNS.JP    https://www.fvg-on.net/
+//
+// Usage:
+//     ./evs_pganalyzer [./evserver.ini]
+// ----------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------
+// ヘッダ部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// インクルード宣言
+// --------------------------------
+
+// --------------------------------
+// 定数宣言
+// --------------------------------
+#define SPOOL_RECORD_ALIGN      8                           // スプールのレコード境界
+#define SPOOL_LOAD_NUM          1000                        // 一回のアイドルイベントでスプールからメッセージ用キューに読み込む最大メッセージ数
+
+// --------------------------------
+// 型宣言
+// --------------------------------
+
+// --------------------------------
+// 変数宣言
+// --------------------------------
+static int                      EVS_spool_fd = -1;                          // スプールファイルのファイルディスクリプタ
+static char                     *EVS_spool_map = NULL;                      // スプールファイルをmmap()した領域
+static size_t                   EVS_spool_write = 0;                        // スプールファイルに書いた位置
+static size_t                   EVS_spool_read = 0;                         // スプールファイルから読んだ位置
+static unsigned long            EVS_spool_num = 0;                          // スプールファイルに入っている(まだ読んでいない)メッセージ数
+static int                      EVS_spool_failed = 0;                       // スプールファイルが開けなかったか(1:以降はスプールしない)
+static size_t                   EVS_queue_bytes = 0;                        // メッセージ用キューに入っているメッセージのメモリ量(構造体＋メッセージ)
+static unsigned long            EVS_queue_num = 0;                          // メッセージ用キューに入っているメッセージ数
+static TAILQ_HEAD(EVS_spool_head, EVS_ev_message_t) EVS_spool_overflow_tailq = TAILQ_HEAD_INITIALIZER(EVS_spool_overflow_tailq);     // スプールファイルが一杯の時に、スプールの後ろに続けるメッセージ用TAILQ_HEAD構造体
+static unsigned long            EVS_spool_overflow_num = 0;                 // スプールファイルが一杯の時に、メモリに残したメッセージ数
+static ev_tstamp                EVS_spool_stat_lasttime = 0.;               // 最終スプール統計出力日時
+static struct {                                                             // スプール統計(SpoolStatの出力間隔毎にリセット)
+	unsigned long   spool_count;                                            // スプールファイルに書いたメッセージ数
+	unsigned long   load_count;                                             // スプールファイルから読み込んだメッセージ数
+	unsigned long   compact_count;                                          // スプールファイルを空にして先頭から使い直した回数
+	unsigned long   overflow_count;                                         // スプールファイルが一杯でメモリに残したメッセージ数
+	size_t          max_depth;                                              // スプールファイルに入っていた最大の長さ
+} EVS_spool_stat;
+
+// ----------------------------------------------------------------------
+// コード部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// スプールについて
+// --------------------------------
+// 解析が追いつかない時に、メッセージ用キューでメモリを使い切らないように、SpoolThresholdを超えたメッセージはスプールファイルに書き出す。
+// スプールファイルはSpoolSizeの大きさで先に確保してmmap()しておき、メッセージ用構造体とメッセージを続けてmemcpy()するだけにする。
+// (同じプロセスの中で読み戻すだけなので、構造体はそのまま書く。session_infoなどのポインタもそのまま使える)
+//
+//      メッセージ用キュー → スプールファイル → スプールファイルが一杯の時のメモリ上のキュー
+//
+// の順番に古いメッセージが並ぶので、スプールにメッセージが残っている間は、新しいメッセージは必ずスプールの後ろに入れる。
+// 解析側はメッセージ用キューが空になったら、スプールファイルの先頭からSPOOL_LOAD_NUMずつメッセージ用キューに読み込む。
+// スプールファイルを全部読んだら、先頭から使い直す(読んだ領域はmadvise()で解放する)。
+// --------------------------------
+// メッセージ用キューのメモリ量計算処理
+// --------------------------------
+static size_t API_spool_size(struct EVS_ev_message_t *message_info)
+{
+	return sizeof(struct EVS_ev_message_t) + message_info->message_len;
+}
+
+// --------------------------------
+// スプールファイルのレコード長計算処理(メッセージ用構造体＋メッセージを、SPOOL_RECORD_ALIGNの倍数にする)
+// --------------------------------
+static size_t API_spool_record_len(struct EVS_ev_message_t *message_info)
+{
+	return (API_spool_size(message_info) + SPOOL_RECORD_ALIGN - 1) & ~(size_t)(SPOOL_RECORD_ALIGN - 1);
+}
+
+// --------------------------------
+// スプールファイル開始処理(SpoolSizeの大きさで確保してmmap()する)
+// --------------------------------
+// ※メッセージ用キューに入れる処理から呼ばれるので、ログはLOG_DIRECTで出力する(LOG_QUEUEINGだと、またここに来てしまう)
+static int API_spool_open(void)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	int                             api_result;
+
+	EVS_spool_fd = open(EVS_config.spool_file, (O_RDWR | O_CREAT | O_TRUNC), (S_IRUSR | S_IWUSR));
+	if (EVS_spool_fd == -1)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot open spool file!? (%s) errno=%d (%s)\n", __func__, EVS_config.spool_file, errno, strerror(errno));
+		return -1;
+	}
+	// ディスクの領域も先に確保する(mmap()した領域への書き込みで、ディスクが一杯でSIGBUSにならないように)
+	api_result = posix_fallocate(EVS_spool_fd, 0, EVS_config.spool_size);
+	if (api_result != 0)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot allocate spool file!? (%s, size=%lu) errno=%d (%s)\n", __func__, EVS_config.spool_file, (unsigned long)EVS_config.spool_size, api_result, strerror(api_result));
+		close(EVS_spool_fd);
+		EVS_spool_fd = -1;
+		return -1;
+	}
+	EVS_spool_map = (char *)mmap(NULL, EVS_config.spool_size, (PROT_READ | PROT_WRITE), MAP_SHARED, EVS_spool_fd, 0);
+	if (EVS_spool_map == MAP_FAILED)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot mmap spool file!? (%s) errno=%d (%s)\n", __func__, EVS_config.spool_file, errno, strerror(errno));
+		EVS_spool_map = NULL;
+		close(EVS_spool_fd);
+		EVS_spool_fd = -1;
+		return -1;
+	}
+	EVS_spool_write = 0;
+	EVS_spool_read = 0;
+
+	LOGGING(LOG_DIRECT, LOGLEVEL_INFO, NULL, log_str, "%s(): Spool file opened. (%s, size=%lu)\n", __func__, EVS_config.spool_file, (unsigned long)EVS_config.spool_size);
+	return 0;
+}
+
+// --------------------------------
+// スプールファイル書き込み処理(0:書き込んだ, -1:一杯か、スプールファイルが使えない)
+// --------------------------------
+static int API_spool_write(struct EVS_ev_message_t *message_info)
+{
+	size_t                          record_len = API_spool_record_len(message_info);
+
+	// スプールファイルが開いていなければ、開く
+	if (EVS_spool_map == NULL)
+	{
+		if (EVS_spool_failed == 1 || API_spool_open() != 0)
+		{
+			EVS_spool_failed = 1;
+			return -1;
+		}
+	}
+	// 入りきらないなら
+	if (EVS_spool_write + record_len > EVS_config.spool_size)
+	{
+		return -1;
+	}
+
+	memcpy(EVS_spool_map + EVS_spool_write, message_info, sizeof(struct EVS_ev_message_t));
+	if (message_info->message_len > 0)
+	{
+		memcpy(EVS_spool_map + EVS_spool_write + sizeof(struct EVS_ev_message_t), message_info->message_ptr, message_info->message_len);
+	}
+	EVS_spool_write += record_len;
+	EVS_spool_num ++;
+
+	EVS_spool_stat.spool_count ++;
+	if (EVS_spool_write - EVS_spool_read > EVS_spool_stat.max_depth)
+	{
+		EVS_spool_stat.max_depth = EVS_spool_write - EVS_spool_read;
+	}
+	return 0;
+}
+
+// --------------------------------
+// メッセージ用キュー追加処理(SpoolThresholdを超えていたら、スプールファイルに書き出す)
+// --------------------------------
+void API_spool_insert(struct EVS_ev_message_t *message_info)
+{
+	// スプールしない設定か、スプールが空で、メッセージ用キューのメモリ量がSpoolThreshold以下なら
+	if (EVS_config.spool_file == NULL || EVS_spool_failed == 1 ||
+		(EVS_spool_num == 0 && EVS_spool_overflow_num == 0 && EVS_queue_bytes + API_spool_size(message_info) <= EVS_config.spool_threshold))
+	{
+		// テールキューの最後にこの接続の情報を追加する
+		TAILQ_INSERT_TAIL(&EVS_message_tailq, message_info, entries);
+		EVS_queue_bytes += API_spool_size(message_info);
+		EVS_queue_num ++;
+		return;
+	}
+
+	// スプールファイルが一杯の時のキューが空で、スプールファイルに書けたら
+	if (EVS_spool_overflow_num == 0 && API_spool_write(message_info) == 0)
+	{
+		free(message_info->message_ptr);
+		free(message_info);
+		return;
+	}
+	// スプールファイルが開けなかったなら(まだ何もスプールしていなければ、メッセージ用キューに入れるだけにする)
+	if (EVS_spool_failed == 1 && EVS_spool_num == 0 && EVS_spool_overflow_num == 0)
+	{
+		TAILQ_INSERT_TAIL(&EVS_message_tailq, message_info, entries);
+		EVS_queue_bytes += API_spool_size(message_info);
+		EVS_queue_num ++;
+		return;
+	}
+	// スプールファイルが一杯なら、捨てずにスプールの後ろに続くメモリ上のキューに入れる(スプールを読み終えたら、メッセージ用キューに移す)
+	TAILQ_INSERT_TAIL(&EVS_spool_overflow_tailq, message_info, entries);
+	EVS_spool_overflow_num ++;
+	EVS_spool_stat.overflow_count ++;
+}
+
+// --------------------------------
+// メッセージ用キュー削除処理
+// --------------------------------
+void API_spool_remove(struct EVS_ev_message_t *message_info)
+{
+	TAILQ_REMOVE(&EVS_message_tailq, message_info, entries);
+	EVS_queue_bytes -= API_spool_size(message_info);
+	EVS_queue_num --;
+}
+
+// --------------------------------
+// スプール読み込み処理(メッセージ用キューが空なら、スプールの先頭からメッセージ用キューに読み込む。読み込んだメッセージ数を返す)
+// --------------------------------
+int API_spool_load(void)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_ev_message_t         *message_info;                      // メッセージ用構造体ポインタ
+	int                             load_num = 0;
+
+	// メッセージ用キューにまだ古いメッセージが残っているなら
+	if (!TAILQ_EMPTY(&EVS_message_tailq))
+	{
+		return 0;
+	}
+
+	// スプールファイルから、SpoolThresholdまでかSPOOL_LOAD_NUMずつ読み込む
+	while (EVS_spool_num > 0 && load_num < SPOOL_LOAD_NUM && EVS_queue_bytes < EVS_config.spool_threshold)
+	{
+		message_info = (struct EVS_ev_message_t *)malloc(sizeof(struct EVS_ev_message_t));
+		if (message_info == NULL)
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot malloc message_info's memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
+			break;
+		}
+		memcpy(message_info, EVS_spool_map + EVS_spool_read, sizeof(struct EVS_ev_message_t));
+		message_info->message_ptr = NULL;
+		if (message_info->message_len > 0)
+		{
+			message_info->message_ptr = malloc(message_info->message_len);
+			if (message_info->message_ptr == NULL)
+			{
+				LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot malloc message_info->message_ptr's memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
+				free(message_info);
+				break;
+			}
+			memcpy(message_info->message_ptr, EVS_spool_map + EVS_spool_read + sizeof(struct EVS_ev_message_t), message_info->message_len);
+		}
+		EVS_spool_read += API_spool_record_len(message_info);
+		EVS_spool_num --;
+
+		TAILQ_INSERT_TAIL(&EVS_message_tailq, message_info, entries);
+		EVS_queue_bytes += API_spool_size(message_info);
+		EVS_queue_num ++;
+		load_num ++;
+	}
+	EVS_spool_stat.load_count += load_num;
+
+	// スプールファイルを全部読んだら
+	if (EVS_spool_num == 0 && EVS_spool_write > 0)
+	{
+		// 読んだ領域のページを解放して、先頭から使い直す
+		madvise(EVS_spool_map, EVS_spool_write, MADV_DONTNEED);
+		EVS_spool_write = 0;
+		EVS_spool_read = 0;
+		EVS_spool_stat.compact_count ++;
+	}
+	// スプールファイルが空になって、一杯の時にメモリに残したメッセージがあれば、メッセージ用キューに移す
+	if (EVS_spool_num == 0 && EVS_spool_overflow_num > 0)
+	{
+		while (!TAILQ_EMPTY(&EVS_spool_overflow_tailq))
+		{
+			message_info = TAILQ_FIRST(&EVS_spool_overflow_tailq);
+			TAILQ_REMOVE(&EVS_spool_overflow_tailq, message_info, entries);
+			TAILQ_INSERT_TAIL(&EVS_message_tailq, message_info, entries);
+			EVS_queue_bytes += API_spool_size(message_info);
+			EVS_queue_num ++;
+			load_num ++;
+		}
+		EVS_spool_overflow_num = 0;
+	}
+	return load_num;
+}
+
+// --------------------------------
+// スプール統計出力処理 ※タイマーイベントから呼ばれる
+// --------------------------------
+// スプールの深さ(バイト数、メッセージ数)と、解析待ちの一番古いメッセージの遅れ(秒)を出力する
+void API_spool_report(ev_tstamp nowtime)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_ev_message_t         oldest_info;                        // 解析待ちの一番古いメッセージ
+	struct timeval                  now_tv;
+	double                          lag_time = 0.;                      // 解析待ちの一番古いメッセージの遅れ(秒)
+	int                             report_flag;
+
+	// スプールしない設定か、統計を出力しない設定か、まだ出力間隔を経過していないなら
+	if (EVS_config.spool_file == NULL || EVS_config.spoolstat_intval <= 0. || nowtime < EVS_spool_stat_lasttime + EVS_config.spoolstat_intval)
+	{
+		return;
+	}
+	// 初回は基準の日時を設定するだけ
+	report_flag = (EVS_spool_stat_lasttime > 0.);
+	EVS_spool_stat_lasttime = nowtime;
+
+	if (report_flag != 0)
+	{
+		// 解析待ちの一番古いメッセージは、メッセージ用キューの先頭か、スプールファイルの先頭か、一杯の時のキューの先頭
+		memset(&oldest_info, 0, sizeof(oldest_info));
+		if (!TAILQ_EMPTY(&EVS_message_tailq))
+		{
+			oldest_info.message_tv = TAILQ_FIRST(&EVS_message_tailq)->message_tv;
+		}
+		else if (EVS_spool_num > 0)
+		{
+			memcpy(&oldest_info, EVS_spool_map + EVS_spool_read, sizeof(oldest_info));
+		}
+		else if (!TAILQ_EMPTY(&EVS_spool_overflow_tailq))
+		{
+			oldest_info.message_tv = TAILQ_FIRST(&EVS_spool_overflow_tailq)->message_tv;
+		}
+		if (oldest_info.message_tv.tv_sec > 0)
+		{
+			gettimeofday(&now_tv, NULL);
+			lag_time = (now_tv.tv_sec - oldest_info.message_tv.tv_sec) + (now_tv.tv_usec - oldest_info.message_tv.tv_usec) / 1000000.;
+		}
+
+		LOGGING(LOG_QUEUEING, (EVS_spool_stat.overflow_count > 0 || EVS_spool_overflow_num > 0) ? LOGLEVEL_WARN : LOGLEVEL_LOG, NULL, log_str,
+			"Spool: queue=%lu (%lu bytes), spool=%lu (%lu bytes, max=%lu), overflow=%lu, lag=%.3f, spooled=%lu, loaded=%lu, compactions=%lu\n",
+			EVS_queue_num, (unsigned long)EVS_queue_bytes, EVS_spool_num, (unsigned long)(EVS_spool_write - EVS_spool_read), (unsigned long)EVS_spool_stat.max_depth,
+			EVS_spool_overflow_num, lag_time, EVS_spool_stat.spool_count, EVS_spool_stat.load_count, EVS_spool_stat.compact_count);
+	}
+	memset(&EVS_spool_stat, 0, sizeof(EVS_spool_stat));
+	EVS_spool_stat.max_depth = EVS_spool_write - EVS_spool_read;
+}
+
+// --------------------------------
+// スプールファイル終了処理 ※プログラム終了時に呼ばれる
+// --------------------------------
+void API_spool_end(void)
+{
+	if (EVS_spool_map != NULL)
+	{
+		munmap(EVS_spool_map, EVS_config.spool_size);
+		EVS_spool_map = NULL;
+	}
+	if (EVS_spool_fd != -1)
+	{
+		close(EVS_spool_fd);
+		EVS_spool_fd = -1;
+		// 同じプロセスの中でしか読めないので、残しておいても仕方がない
+		unlink(EVS_config.spool_file);
+	}
+	EVS_spool_write = 0;
+	EVS_spool_read = 0;
+	EVS_spool_num = 0;
+}
@@ -0,0 +1,1211 @@
+// ----------------------------------------------------------------------
+// Protocol Analyzer for PostgreSQL -
+// Purpose:
+//     Session analysis and statistics processing.
+//
+// Program:
+//     Takeshi Kaburagi/MyDNS.JP    https://www.fvg-on.net/
+//
+// Usage:
+//     ./evs_pganalyzer [./evserver.ini]
+// ----------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------
+// ヘッダ部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// インクルード宣言
+// --------------------------------
+
+// --------------------------------
+// 定数宣言
+// --------------------------------
+
+// --------------------------------
+// 型宣言
+// --------------------------------
+
+// --------------------------------
+// 変数宣言
+// --------------------------------
+static struct EVS_errstat_t      EVS_errstat_list[MAX_ERRSTAT_NUM];          // エラー集計テーブル(固定長、オープンアドレス法)
+static unsigned long            EVS_errstat_overflow = 0;                   // エラー集計テーブルが満杯で集計できなかった件数
+static ev_tstamp                EVS_errstat_lasttime = 0.;                  // 最後にエラー集計を出力した日時
+static unsigned int             EVS_session_lastid = 0;                     // 最後に割り当てたセッションID
+
+// ----------------------------------------------------------------------
+// コード部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// 経過時間計算処理(秒)
+// --------------------------------
+static double API_stats_difftime(struct timeval *end_tv, struct timeval *start_tv)
+{
+	return (double)(end_tv->tv_sec - start_tv->tv_sec) + (double)(end_tv->tv_usec - start_tv->tv_usec) / 1000000.;
+}
+
+// --------------------------------
+// セッション別解析情報生成処理 ※StartupMessageを解析した後(param_infoが設定された後)に呼ぶこと
+// --------------------------------
+int API_session_start(struct EVS_ev_client_t *this_client)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	struct EVS_session_t            *this_session;                      // セッション別解析情報構造体ポインタ
+
+	// セッション別解析情報構造体のメモリ領域を確保
+	this_session = (struct EVS_session_t *)calloc(1, sizeof(struct EVS_session_t));
+	// メモリ領域が確保できなかったら
+	if (this_session == NULL)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): Cannot calloc this_session's memory? errno=%d (%s)\n", __func__, this_client->socket_fd, errno, strerror(errno));
+		return -1;
+	}
+
+	// ユーザー名を設定
+	if (this_client->param_info[CLIENT_USERNAME] != NULL)
+	{
+		strncpy(this_session->username, this_client->param_info[CLIENT_USERNAME], sizeof(this_session->username) - 1);
+	}
+	// データベース名を設定(指定がなければPostgreSQLと同じくユーザー名とする)
+	if (this_client->param_info[CLIENT_DATABASE] != NULL)
+	{
+		strncpy(this_session->database, this_client->param_info[CLIENT_DATABASE], sizeof(this_session->database) - 1);
+	}
+	else
+	{
+		strncpy(this_session->database, this_session->username, sizeof(this_session->database) - 1);
+	}
+
+	// トランザクション状態を、I:トランザクション外に設定
+	this_session->txn_status = 'I';
+
+	// セッションIDを割り当てて、バイナリイベントログならセッションの情報を出力しておく(以降のメッセージはセッションIDだけで出力する)
+	EVS_session_lastid ++;
+	if (EVS_session_lastid == 0)
+	{
+		EVS_session_lastid ++;
+	}
+	this_session->session_id = EVS_session_lastid;
+	event_session(this_session->session_id, this_client->addr_str, this_session->database, this_session->username);
+
+	// ログサンプリング開始処理(このセッションの全メッセージを解析するかを決める)
+	API_sample_start(this_session);
+
+	this_client->session_info = this_session;
+
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): OK. database=%s, username=%s\n", __func__, this_client->socket_fd, this_session->database, this_session->username);
+
+	return 0;
+}
+
+// --------------------------------
+// セッション別解析情報解放依頼処理
+// --------------------------------
+// ※メッセージ用キューにはまだこのセッションのメッセージが残っているかもしれないので、ここでは直接free()せずに、
+//   100:セッション終了のメッセージをキューの最後に積んで、アイドルイベントでの解析が追いついた時点で解放する
+void API_session_close(struct EVS_ev_client_t *this_client)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	struct EVS_ev_message_t         *message_info;                      // メッセージ用構造体ポインタ
+
+	// セッション別解析情報がないなら
+	if (this_client->session_info == NULL)
+	{
+		return;
+	}
+
+	// メッセージ用構造体ポインタのメモリ領域を確保
+	message_info = (struct EVS_ev_message_t *)calloc(1, sizeof(struct EVS_ev_message_t));
+	// メモリ領域が確保できなかったら
+	if (message_info == NULL)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): Cannot calloc message_info's memory? errno=%d (%s)\n", __func__, this_client->socket_fd, errno, strerror(errno));
+		// 後から参照されることはないとは言い切れないが、リークさせるよりは解放しておく
+		free(this_client->session_info);
+		this_client->session_info = NULL;
+		return;
+	}
+
+	// メッセージ情報にメッセージの各種情報をコピー
+	message_info->from_to = 100;                                        // メッセージの方向(100:セッション終了)
+	message_info->client_socket_fd = this_client->socket_fd;            // 接続してきたクライアントのファイルディスクリプタ
+	strcpy(message_info->client_addr_str, this_client->addr_str);       // クライアントのアドレス文字列
+	message_info->session_info = this_client->session_info;             // セッション別解析情報
+	gettimeofday(&message_info->message_tv, NULL);                      // 現在時刻を取得してmessage_info->message_tvに格納
+
+	this_client->session_info = NULL;
+
+	// テールキューの最後にこの接続の情報を追加する
+	API_spool_insert(message_info);
+
+	// アイドルイベント開始(メッセージ用キュー処理)
+	ev_idle_start(EVS_loop, &idle_message_watcher);
+}
+
+// --------------------------------
+// セッション別解析情報解放処理 ※100:セッション終了のメッセージを処理する時に呼び出される
+// --------------------------------
+void API_session_free(struct EVS_ev_message_t *message_info)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	struct EVS_session_t            *this_session = (struct EVS_session_t *)message_info->session_info;
+
+	// セッション別解析情報があるなら
+	if (this_session != NULL)
+	{
+		// トランザクション中に切断されたなら(PostgreSQL側でロールバックされる)
+		if (this_session->txn_status != 'I')
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), log_str, "Transaction: closed in transaction. (client=%s, database=%s, user=%s, status=%c, duration=%.6f, statements=%u, idle_in_transaction=%.6f)\n",
+				message_info->client_addr_str, this_session->database, this_session->username, this_session->txn_status,
+				API_stats_difftime(&message_info->message_tv, &this_session->txn_start_tv), this_session->txn_statements, this_session->txn_idle_time);
+		}
+		// セッションの統計を出力
+		LOGGING(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), log_str, "Session: end. (client=%s, database=%s, user=%s, statements=%lu, pipelined=%lu, max_depth=%u)\n",
+			message_info->client_addr_str, this_session->database, this_session->username, this_session->statement_count, this_session->pipelined_count, this_session->max_depth);
+		// 分断されたメッセージの組み立て用バッファを開放
+		free(this_session->stream[0].split_buf);
+		free(this_session->stream[1].split_buf);
+		free(message_info->session_info);
+		message_info->session_info = NULL;
+	}
+}
+
+// --------------------------------
+// セッション別クライアント問い合わせ開始処理 ※クライアントから来たメッセージを処理する時に呼び出される
+// --------------------------------
+// ReadyForQuery後の最初のクライアントメッセージを問い合わせサイクルの開始とみなし、
+// トランザクション中であれば、直前のReadyForQueryからここまでをアイドル(idle in transaction)の時間として加算する
+void API_session_activity(struct EVS_ev_message_t *message_info)
+{
+	struct EVS_session_t            *this_session = (struct EVS_session_t *)message_info->session_info;
+
+	// セッション別解析情報がないか、すでに問い合わせサイクル中なら
+	if (this_session == NULL || this_session->cycle_flag == 1)
+	{
+		return;
+	}
+	// トランザクション中なら、アイドルだった時間を加算
+	if (this_session->txn_status != 'I')
+	{
+		this_session->txn_idle_time += API_stats_difftime(&message_info->message_tv, &this_session->ready_tv);
+	}
+	this_session->query_tv = message_info->message_tv;
+	this_session->cycle_flag = 1;
+}
+
+// --------------------------------
+// セッション別トランザクション状態遷移処理 ※PostgreSQLから来たReadyForQueryを処理する時に呼び出される
+// --------------------------------
+// I→T/E : トランザクション開始(開始日時は、このReadyForQueryで終わった問い合わせサイクルの開始日時)
+// T→E   : トランザクション内でエラー発生
+// T/E→I : トランザクション終了(COMMITかROLLBACKかは区別しない)
+void API_session_ready(struct EVS_pgmsg_t *pgmsg)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	struct EVS_session_t            *this_session = pgmsg->session_info;
+	char                            txn_status = pgmsg->txn_status;     // 新しいトランザクション状態
+	struct timeval                  ready_tv;                           // ReadyForQueryを受信した日時
+	double                          txn_time;                           // トランザクションを開始してからの経過時間(秒)
+	int                             log_level;
+
+	// セッション別解析情報がないなら
+	if (this_session == NULL)
+	{
+		return;
+	}
+	// ReadyForQueryを受信した日時を取得(受信時の解析処理から呼ばれたなら現在日時)
+	if (pgmsg->log_tv != NULL)
+	{
+		ready_tv = *pgmsg->log_tv;
+	}
+	else
+	{
+		gettimeofday(&ready_tv, NULL);
+	}
+	// 問い合わせサイクルを開始せずにReadyForQueryが来た(アイドル中にクライアント以外の理由で来た)なら、この日時を開始日時とみなす
+	if (this_session->cycle_flag == 0)
+	{
+		this_session->query_tv = ready_tv;
+	}
+
+	// トランザクション外からトランザクション中になったなら
+	if (this_session->txn_status == 'I' && txn_status != 'I')
+	{
+		this_session->txn_start_tv = this_session->query_tv;
+		this_session->txn_statements = 0;
+		this_session->txn_idle_time = 0.;
+		this_session->txn_warned = 0;
+	}
+	// トランザクション中に関係するなら
+	if (this_session->txn_status != 'I' || txn_status != 'I')
+	{
+		this_session->txn_statements ++;
+		txn_time = API_stats_difftime(&ready_tv, &this_session->txn_start_tv);
+		// トランザクション内でエラーが発生したなら(ログサンプリングの対象外なら、エラーになった問い合わせ自体が出力されるので、ここでは出力しない)
+		if (this_session->txn_status == 'T' && txn_status == 'E' && pgmsg->sample_out == 0)
+		{
+			LOGGING(pgmsg->log_type, LOGLEVEL_LOG, pgmsg->log_tv, log_str, "Transaction: failed. (client=%s, database=%s, user=%s, duration=%.6f, statements=%u, fingerprint:%08x)\n",
+				pgmsg->addr_str, this_session->database, this_session->username, txn_time, this_session->txn_statements, this_session->fingerprint);
+		}
+		// トランザクションが終了したなら
+		if (txn_status == 'I')
+		{
+			// 警告時間以上だったならWARN、それ以外はLOGで出力(ログサンプリングの対象外なら、WARNだけ出力)
+			log_level = (EVS_config.transaction_warntime > 0. && txn_time >= EVS_config.transaction_warntime) ? LOGLEVEL_WARN : LOGLEVEL_LOG;
+			if (log_level == LOGLEVEL_LOG && pgmsg->sample_out == 1)
+			{
+				log_level = LOGLEVEL_DEBUG;
+			}
+			LOGGING(pgmsg->log_type, log_level, pgmsg->log_tv, log_str, "Transaction: end. (client=%s, database=%s, user=%s, status=%c, duration=%.6f, statements=%u, idle_in_transaction=%.6f)\n",
+				pgmsg->addr_str, this_session->database, this_session->username, this_session->txn_status,
+				txn_time, this_session->txn_statements, this_session->txn_idle_time);
+		}
+	}
+
+	this_session->txn_status = txn_status;
+	this_session->ready_tv = ready_tv;
+	this_session->cycle_flag = 0;
+}
+
+// --------------------------------
+// 長時間トランザクション確認処理 ※タイマーイベントから呼ばれる
+// --------------------------------
+// トランザクションを開いたまま放置されているセッションは、それ以降メッセージが来ないので、タイマーで確認する(警告はトランザクション毎に一回だけ)
+void API_session_check(ev_tstamp nowtime)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	struct EVS_ev_client_t          *client_watcher;                    // クライアント別設定用構造体ポインタ
+	struct EVS_session_t            *this_session;                      // セッション別解析情報構造体ポインタ
+	struct timeval                  now_tv;                             // 現在の日時
+	double                          txn_time;                           // トランザクションを開始してからの経過時間(秒)
+	double                          idle_time;                          // アイドルだった時間の合計(秒)
+
+	// 長時間トランザクションを警告しない設定なら
+	if (EVS_config.transaction_warntime <= 0.)
+	{
+		return;
+	}
+
+	now_tv.tv_sec = (time_t)nowtime;
+	now_tv.tv_usec = (suseconds_t)((nowtime - (ev_tstamp)now_tv.tv_sec) * 1000000.);
+
+	// クライアント用テールキューからクライアント情報を取得して全て確認
+	TAILQ_FOREACH (client_watcher, &EVS_client_tailq, entries)
+	{
+		this_session = (struct EVS_session_t *)client_watcher->session_info;
+		// セッション別解析情報がないか、トランザクション外か、すでに警告済みなら
+		if (this_session == NULL || this_session->txn_status == 'I' || this_session->txn_warned == 1)
+		{
+			continue;
+		}
+		txn_time = API_stats_difftime(&now_tv, &this_session->txn_start_tv);
+		// まだ警告時間を経過していないなら
+		if (txn_time < EVS_config.transaction_warntime)
+		{
+			continue;
+		}
+		// アイドル中なら、直前のReadyForQueryからの時間も加える
+		idle_time = this_session->txn_idle_time;
+		if (this_session->cycle_flag == 0)
+		{
+			idle_time += API_stats_difftime(&now_tv, &this_session->ready_tv);
+		}
+		LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "Transaction: open too long. (client=%s, database=%s, user=%s, status=%c, duration=%.6f, statements=%u, idle_in_transaction=%.6f, %s)\n",
+			client_watcher->addr_str, this_session->database, this_session->username, this_session->txn_status,
+			txn_time, this_session->txn_statements, idle_time, (this_session->cycle_flag == 0) ? "idle" : "active");
+		this_session->txn_warned = 1;
+	}
+}
+
+// --------------------------------
+// メッセージ受信日時取得処理(受信時の解析処理から呼ばれたなら現在日時)
+// --------------------------------
+static void API_stats_msgtime(struct EVS_pgmsg_t *pgmsg, struct timeval *message_tv)
+{
+	if (pgmsg->log_tv != NULL)
+	{
+		*message_tv = *pgmsg->log_tv;
+	}
+	else
+	{
+		gettimeofday(message_tv, NULL);
+	}
+}
+
+// --------------------------------
+// プリペアド文登録処理 ※クライアントから来たParseを処理する時に呼び出される
+// --------------------------------
+// 同じ名前のプリペアド文があれば上書きし、なければ古いものから順に上書きする(対応表は固定長)
+void API_request_parse(struct EVS_pgmsg_t *pgmsg, char *statement_name, unsigned int fingerprint)
+{
+	struct EVS_session_t            *this_session = pgmsg->session_info;
+	struct EVS_statement_t          *this_statement = NULL;
+	unsigned int                    list_num;
+
+	// セッション別解析情報がないなら
+	if (this_session == NULL)
+	{
+		return;
+	}
+	// 同じ名前のプリペアド文を探す
+	for (list_num = 0; list_num < MAX_STATEMENT_NUM; list_num++)
+	{
+		if (strncmp(this_session->statement_list[list_num].name, statement_name, sizeof(this_session->statement_list[list_num].name) - 1) == 0)
+		{
+			this_statement = &this_session->statement_list[list_num];
+			break;
+		}
+	}
+	// なければ、次の位置に登録する
+	if (this_statement == NULL)
+	{
+		this_statement = &this_session->statement_list[this_session->statement_next];
+		this_session->statement_next = (this_session->statement_next + 1) % MAX_STATEMENT_NUM;
+		memset(this_statement->name, 0, sizeof(this_statement->name));
+		strncpy(this_statement->name, statement_name, sizeof(this_statement->name) - 1);
+	}
+	this_statement->fingerprint = fingerprint;
+}
+
+// --------------------------------
+// プリペアド文選択処理 ※クライアントから来たBindを処理する時に呼び出される
+// --------------------------------
+void API_request_bind(struct EVS_pgmsg_t *pgmsg, char *statement_name)
+{
+	struct EVS_session_t            *this_session = pgmsg->session_info;
+	unsigned int                    list_num;
+
+	// セッション別解析情報がないなら
+	if (this_session == NULL)
+	{
+		return;
+	}
+	// プリペアド文が見つからなければ(Parseを見ていない)、フィンガープリントは0とする
+	this_session->bind_fingerprint = 0;
+	for (list_num = 0; list_num < MAX_STATEMENT_NUM; list_num++)
+	{
+		if (strncmp(this_session->statement_list[list_num].name, statement_name, sizeof(this_session->statement_list[list_num].name) - 1) == 0)
+		{
+			this_session->bind_fingerprint = this_session->statement_list[list_num].fingerprint;
+			break;
+		}
+	}
+}
+
+// --------------------------------
+// 応答待ちリクエスト登録処理 ※クライアントから来たQuery/Execute/Syncを処理する時に呼び出される
+// --------------------------------
+void API_request_push(struct EVS_pgmsg_t *pgmsg, int request_type, unsigned int fingerprint)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	struct EVS_session_t            *this_session = pgmsg->session_info;
+	struct EVS_request_t            *this_request;                      // 応答待ちリクエスト構造体ポインタ
+
+	// セッション別解析情報がないか、すでに対応付けができなくなっているなら
+	if (this_session == NULL || this_session->request_lost == 1)
+	{
+		return;
+	}
+	// 応答待ちリクエストのFIFOが満杯なら、次のReadyForQueryまで対応付けを諦める
+	if (this_session->request_num == MAX_REQUEST_NUM)
+	{
+		LOGGING(pgmsg->log_type, LOGLEVEL_WARN, pgmsg->log_tv, log_str, "%s(): Too many pipelined requests!? (client=%s, request_num=%u)\n", __func__, pgmsg->addr_str, this_session->request_num);
+		this_session->request_lost = 1;
+		return;
+	}
+
+	this_request = &this_session->request_list[(this_session->request_head + this_session->request_num) % MAX_REQUEST_NUM];
+	this_session->request_num ++;
+
+	this_request->request_type = request_type;
+	this_request->fingerprint = fingerprint;
+	this_request->row_count = 0;
+	API_stats_msgtime(pgmsg, &this_request->request_tv);
+	// QueryかExecuteなら、パイプラインの深さを更新
+	if (request_type != 'S')
+	{
+		this_session->statement_num ++;
+		if (this_session->statement_num > this_session->max_depth)
+		{
+			this_session->max_depth = this_session->statement_num;
+		}
+	}
+	this_request->depth = this_session->statement_num;
+}
+
+// --------------------------------
+// 応答待ちリクエストの先頭取得処理(QueryかExecuteでなければNULL)
+// --------------------------------
+static struct EVS_request_t *API_request_head(struct EVS_session_t *this_session)
+{
+	struct EVS_request_t            *this_request;
+
+	// セッション別解析情報がないか、対応付けができなくなっているか、応答待ちリクエストがないなら
+	if (this_session == NULL || this_session->request_lost == 1 || this_session->request_num == 0)
+	{
+		return NULL;
+	}
+	this_request = &this_session->request_list[this_session->request_head];
+	if (this_request->request_type == 'S')
+	{
+		return NULL;
+	}
+	return this_request;
+}
+
+// --------------------------------
+// 応答待ちリクエストの先頭削除処理
+// --------------------------------
+static void API_request_pop(struct EVS_session_t *this_session)
+{
+	if (this_session->request_list[this_session->request_head].request_type != 'S')
+	{
+		this_session->statement_num --;
+	}
+	this_session->request_head = (this_session->request_head + 1) % MAX_REQUEST_NUM;
+	this_session->request_num --;
+}
+
+// --------------------------------
+// ステートメント完了ログ出力処理
+// --------------------------------
+static void API_request_log(struct EVS_pgmsg_t *pgmsg, struct EVS_request_t *this_request, unsigned long row_count, const char *result_str)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	struct EVS_session_t            *this_session = pgmsg->session_info;
+	struct timeval                  response_tv;                        // 応答を受信した日時
+
+	API_stats_msgtime(pgmsg, &response_tv);
+
+	this_session->statement_count ++;
+	if (this_request->depth > 1)
+	{
+		this_session->pipelined_count ++;
+	}
+
+	LOGGING(pgmsg->log_type, LOGLEVEL_LOG, pgmsg->log_tv, log_str, "Statement: %s. (client=%s, database=%s, user=%s, type=%s, fingerprint:%08x, latency=%.6f, rows=%lu, depth=%u)\n",
+		result_str, pgmsg->addr_str, this_session->database, this_session->username, (this_request->request_type == 'Q') ? "Query" : "Execute",
+		this_request->fingerprint, API_stats_difftime(&response_tv, &this_request->request_tv), row_count, this_request->depth);
+}
+
+// --------------------------------
+// 応答待ちリクエストの行数加算処理 ※PostgreSQLから来たDataRowを処理する時に呼び出される
+// --------------------------------
+void API_request_datarow(struct EVS_pgmsg_t *pgmsg)
+{
+	struct EVS_request_t            *this_request = API_request_head(pgmsg->session_info);
+
+	if (this_request != NULL)
+	{
+		this_request->row_count ++;
+	}
+}
+
+// --------------------------------
+// 応答待ちリクエスト完了処理 ※PostgreSQLから来たCommandComplete/EmptyQueryResponse/PortalSuspendedを処理する時に呼び出される
+// --------------------------------
+// 行数は、コマンドタグの最後の数値("SELECT 5", "INSERT 0 5"など)があればそれを、なければDataRowの数を使う。
+// Queryは一つのメッセージに複数の文を含むことがあるので、ここでは削除せずにReadyForQueryで削除する。
+void API_request_complete(struct EVS_pgmsg_t *pgmsg, char *tag_str)
+{
+	struct EVS_request_t            *this_request = API_request_head(pgmsg->session_info);
+	unsigned long                   row_count;
+	char                            *number_ptr;
+
+	// 対応する応答待ちリクエストがないなら
+	if (this_request == NULL)
+	{
+		return;
+	}
+
+	row_count = this_request->row_count;
+	// コマンドタグの最後が数値なら
+	if (tag_str != NULL)
+	{
+		number_ptr = strrchr(tag_str, ' ');
+		if (number_ptr != NULL && isdigit((unsigned char)number_ptr[1]))
+		{
+			row_count = strtoul(number_ptr + 1, NULL, 10);
+		}
+	}
+	// ステートメント完了ログ出力処理
+	API_request_log(pgmsg, this_request, row_count, (tag_str != NULL) ? tag_str : PgSQL_message_backend_str[pgmsg->message_type]);
+
+	// Executeなら削除、Queryなら次の文のために行数をクリア
+	if (this_request->request_type == 'E')
+	{
+		API_request_pop(pgmsg->session_info);
+	}
+	else
+	{
+		this_request->row_count = 0;
+	}
+}
+
+// --------------------------------
+// 応答待ちリクエストエラー処理 ※PostgreSQLから来たErrorResponseを処理する時に呼び出される
+// --------------------------------
+// エラーになったExecuteを削除する。拡張問い合わせでは、エラー後はSyncまでのメッセージが無視されるので、残りのExecuteはReadyForQueryで削除する。
+// エラー集計で使えるように、エラーになったリクエストのフィンガープリントを、セッションのフィンガープリントとして設定する。
+void API_request_error(struct EVS_pgmsg_t *pgmsg)
+{
+	struct EVS_request_t            *this_request = API_request_head(pgmsg->session_info);
+
+	// 対応する応答待ちリクエストがないなら
+	if (this_request == NULL)
+	{
+		return;
+	}
+	pgmsg->session_info->fingerprint = this_request->fingerprint;
+	// ステートメント完了ログ出力処理
+	API_request_log(pgmsg, this_request, this_request->row_count, "ERROR");
+
+	// Executeなら削除(QueryはReadyForQueryで削除)
+	if (this_request->request_type == 'E')
+	{
+		API_request_pop(pgmsg->session_info);
+	}
+}
+
+// --------------------------------
+// 応答待ちリクエスト同期処理 ※PostgreSQLから来たReadyForQueryを処理する時に呼び出される
+// --------------------------------
+// 先頭から、最初のSyncかQueryまでを削除する(それまでに残っているExecuteは、エラーのため実行されなかったもの)
+void API_request_ready(struct EVS_pgmsg_t *pgmsg)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	struct EVS_session_t            *this_session = pgmsg->session_info;
+	int                             request_type;
+	unsigned int                    skip_num = 0;                       // 実行されなかったExecuteの数
+
+	// セッション別解析情報がないなら
+	if (this_session == NULL)
+	{
+		return;
+	}
+	// 対応付けができなくなっていたなら、ここで全てクリアしてやり直す
+	if (this_session->request_lost == 1)
+	{
+		this_session->request_head = 0;
+		this_session->request_num = 0;
+		this_session->statement_num = 0;
+		this_session->request_lost = 0;
+		return;
+	}
+
+	while (this_session->request_num > 0)
+	{
+		request_type = this_session->request_list[this_session->request_head].request_type;
+		if (request_type == 'E')
+		{
+			skip_num ++;
+		}
+		API_request_pop(this_session);
+		if (request_type != 'E')
+		{
+			break;
+		}
+	}
+	// 実行されなかったExecuteがあれば
+	if (skip_num > 0)
+	{
+		LOGGING(pgmsg->log_type, LOGLEVEL_LOG, pgmsg->log_tv, log_str, "Statement: skipped. (client=%s, database=%s, user=%s, count=%u)\n", pgmsg->addr_str, this_session->database, this_session->username, skip_num);
+	}
+}
+
+// --------------------------------
+// 集計キー用ハッシュ値生成処理(FNV-1a)
+// --------------------------------
+static unsigned int API_stats_hash(unsigned int hash, const void *target_data, int target_len)
+{
+	const unsigned char             *target_ptr = (const unsigned char *)target_data;
+
+	while (target_len-- > 0)
+	{
+		hash ^= *target_ptr++;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+// --------------------------------
+// 書き込みを伴うかもしれない単語(読み書き分離で、プライマリに送る。"_"で終わるものは前方一致)
+// --------------------------------
+static const char *EVS_lex_write_words[] = {
+	"into", "update", "share", "nextval", "setval", "set_config", "txid_current", "pg_current_xact_id",
+	"pg_advisory_", "pg_try_advisory_", "lo_", NULL,
+};
+
+// --------------------------------
+// 直後に"("が続いても書き込みを伴わない単語(括弧を取るキーワード・型名と、読み取り専用の関数)
+// --------------------------------
+// 読み書き分離で、これ以外の関数呼び出し(ユーザー定義関数など、中で書き込むかもしれない)はプライマリに送る
+static const char *EVS_lex_read_calls[] = {
+	"select", "from", "where", "and", "or", "not", "in", "exists", "any", "some", "all", "as", "on", "using", "join", "values",
+	"over", "filter", "within", "by", "with", "union", "intersect", "except", "lateral", "case", "when", "then", "else", "is",
+	"between", "like", "ilike", "similar", "distinct", "array", "row", "cast", "left", "right",
+	"numeric", "decimal", "varchar", "char", "character", "varying", "bit", "timestamp", "time", "interval", "float",
+	"count", "sum", "avg", "min", "max", "coalesce", "nullif", "greatest", "least", "abs", "round", "trunc", "floor", "ceil", "ceiling",
+	"mod", "power", "sqrt", "lower", "upper", "length", "char_length", "octet_length", "substr", "substring", "position", "strpos",
+	"trim", "btrim", "ltrim", "rtrim", "replace", "concat", "concat_ws", "lpad", "rpad", "split_part", "format", "md5",
+	"encode", "decode", "regexp_replace", "regexp_match", "regexp_matches", "to_char", "to_date", "to_timestamp", "to_number",
+	"date_trunc", "date_part", "extract", "age", "now", "array_agg", "string_agg", "array_length", "unnest", "generate_series",
+	"json_agg", "jsonb_agg", "json_build_object", "jsonb_build_object", "json_build_array", "jsonb_build_array", "to_json", "to_jsonb",
+	"row_to_json", "bool_and", "bool_or", "every", "row_number", "rank", "dense_rank", "lag", "lead", "first_value", "last_value",
+	"ntile", "percentile_cont", "percentile_disc", NULL,
+};
+
+// --------------------------------
+// 字句解析単語判定処理(単語が一つ終わる度に呼ばれる)
+// --------------------------------
+static void API_stats_lexword(struct EVS_lexinfo_t *lexinfo, const char *word_str, int word_len)
+{
+	int                             list_num;
+	size_t                          list_len;
+
+	if (word_len <= 0)
+	{
+		return;
+	}
+	// 最初の単語なら
+	if (lexinfo->first_word[0] == '\0')
+	{
+		snprintf(lexinfo->first_word, sizeof(lexinfo->first_word), "%.*s", word_len, word_str);
+	}
+	for (list_num = 0; EVS_lex_write_words[list_num] != NULL; list_num ++)
+	{
+		list_len = strlen(EVS_lex_write_words[list_num]);
+		if (EVS_lex_write_words[list_num][list_len - 1] == '_' ? (word_len >= (int)list_len && memcmp(word_str, EVS_lex_write_words[list_num], list_len) == 0) : (word_len == (int)list_len && memcmp(word_str, EVS_lex_write_words[list_num], list_len) == 0))
+		{
+			lexinfo->write_flag = 1;
+			return;
+		}
+	}
+}
+
+// --------------------------------
+// 字句解析関数呼び出し判定処理(単語の直後に"("が来たら呼ばれる。word_lenが0未満なら、引用符付きか修飾された名前)
+// --------------------------------
+static void API_stats_lexcall(struct EVS_lexinfo_t *lexinfo, const char *word_str, int word_len)
+{
+	int                             list_num;
+
+	for (list_num = 0; word_len > 0 && EVS_lex_read_calls[list_num] != NULL; list_num ++)
+	{
+		if (word_len == (int)strlen(EVS_lex_read_calls[list_num]) && memcmp(word_str, EVS_lex_read_calls[list_num], word_len) == 0)
+		{
+			return;
+		}
+	}
+	// 読み取り専用と分かっている単語でなければ、書き込みを伴うかもしれない
+	lexinfo->write_flag = 1;
+}
+
+// --------------------------------
+// クエリのフィンガープリント生成処理
+// --------------------------------
+unsigned int API_pgsql_fingerprint(char *query_ptr, int query_len)
+{
+	return API_pgsql_fingerprint_lex(query_ptr, query_len, NULL);
+}
+
+// --------------------------------
+// クエリのフィンガープリント生成処理(字句解析結果も返す)
+// --------------------------------
+// クエリ文字列を、以下のように正規化しながらハッシュ値(FNV-1a)を計算する。
+//  ・連続する空白文字や改行、コメント(-- や /* */)は空白一つとみなす
+//  ・文字列定数('...'、E'...'、$$...$$、$tag$...$tag$)、数値定数、プレースホルダ($1など)は'?'に置き換える
+//  ・英字は小文字に揃える
+// つまり、"SELECT * FROM t WHERE id = 1" と "select *  from t where id=2" はほぼ同じフィンガープリントになる(演算子前後の空白の有無は区別する)
+// lexinfoがNULLでなければ、同じ走査で最初の単語、文の数、書き込みを伴うかもしれない単語の有無も求める(読み書き分離用。クエリを別に解析し直さない)
+// 関数呼び出し(単語の直後の"(")は、EVS_lex_read_callsにない限り、書き込みを伴うかもしれないとする。
+unsigned int API_pgsql_fingerprint_lex(char *query_ptr, int query_len, struct EVS_lexinfo_t *lexinfo)
+{
+	unsigned int                    hash = 2166136261U;                 // FNV-1aの初期値
+	char                            *target_ptr = query_ptr;
+	char                            *end_ptr = query_ptr + query_len;
+	unsigned char                   target_char;
+	unsigned char                   prev_char = ' ';                    // 直前にハッシュした文字
+	int                             space_flag = 0;                     // 直前が空白(コメント含む)かどうか
+	char                            word_str[32];                       // 字句解析中の単語(小文字、長い単語は先頭だけ)
+	int                             word_len = 0;                       // 字句解析中の単語の長さ(0:単語の外)
+	int                             word_dot = 0;                       // 字句解析中の単語が"."の直後から始まったか(修飾された名前)
+	char                            call_str[32];                       // 直前に終わった単語(次が"("なら関数呼び出し)
+	int                             call_len = 0;                       // 直前に終わった単語の長さ(0:直前は単語ではない, -1:引用符付きか修飾された名前)
+	int                             quote_flag = 0;                     // 引用符付き識別子("...")の中かどうか
+	int                             semicolon_flag = 0;                 // 直前の文が";"で終わったか
+	int                             escape_flag;                        // 文字列定数の中で、"\"をエスケープとして扱うか(E'...')
+	char                            *tag_ptr;                           // ドル引用符の開始位置
+	int                             tag_len;                            // ドル引用符の長さ($tag$)
+
+	if (lexinfo != NULL)
+	{
+		memset(lexinfo, 0, sizeof(struct EVS_lexinfo_t));
+	}
+
+	while (target_ptr < end_ptr && *target_ptr != '\0')
+	{
+		target_char = (unsigned char)*target_ptr;
+
+		// 単語の終わりなら、字句解析単語判定
+		if (lexinfo != NULL && word_len > 0 && !(isalnum(target_char) || target_char == '_'))
+		{
+			API_stats_lexword(lexinfo, word_str, word_len);
+			memcpy(call_str, word_str, word_len);
+			call_len = (word_dot == 0) ? word_len : -1;
+			word_len = 0;
+		}
+
+		// 空白文字なら
+		if (isspace(target_char))
+		{
+			space_flag = 1;
+			target_ptr ++;
+			continue;
+		}
+		// 行コメント(--)なら、改行までスキップ
+		if (target_char == '-' && target_ptr + 1 < end_ptr && target_ptr[1] == '-')
+		{
+			while (target_ptr < end_ptr && *target_ptr != '\0' && *target_ptr != '\n')
+			{
+				target_ptr ++;
+			}
+			space_flag = 1;
+			continue;
+		}
+		// ブロックコメント(/* */)なら、コメントの終わりまでスキップ
+		if (target_char == '/' && target_ptr + 1 < end_ptr && target_ptr[1] == '*')
+		{
+			target_ptr += 2;
+			while (target_ptr + 1 < end_ptr && *target_ptr != '\0' && !(target_ptr[0] == '*' && target_ptr[1] == '/'))
+			{
+				target_ptr ++;
+			}
+			target_ptr += 2;
+			space_flag = 1;
+			continue;
+		}
+		// 直前に空白があったなら、空白一つとしてハッシュする(先頭の空白は無視する)
+		if (space_flag == 1 && prev_char != ' ')
+		{
+			hash = API_stats_hash(hash, " ", 1);
+			prev_char = ' ';
+		}
+		space_flag = 0;
+
+		// 単語の直後の"("(関数呼び出し)なら、読み取り専用と分かっている単語以外は、書き込みを伴うかもしれないとする
+		if (lexinfo != NULL && call_len != 0)
+		{
+			if (target_char == '(')
+			{
+				API_stats_lexcall(lexinfo, call_str, call_len);
+			}
+			call_len = 0;
+		}
+
+		// 文字列定数なら、文字列の終わりまでスキップして'?'とする(''はエスケープされた'として扱う。E'...'なら\'も)
+		if (target_char == '\'')
+		{
+			escape_flag = (target_ptr > query_ptr && (target_ptr[-1] == 'E' || target_ptr[-1] == 'e') &&
+				(target_ptr - 1 == query_ptr || !(isalnum((unsigned char)target_ptr[-2]) || target_ptr[-2] == '_'))) ? 1 : 0;
+			target_ptr ++;
+			while (target_ptr < end_ptr && *target_ptr != '\0')
+			{
+				if (escape_flag != 0 && *target_ptr == '\\' && target_ptr + 1 < end_ptr)
+				{
+					target_ptr += 2;
+					continue;
+				}
+				if (*target_ptr == '\'')
+				{
+					if (target_ptr + 1 < end_ptr && target_ptr[1] == '\'')
+					{
+						target_ptr += 2;
+						continue;
+					}
+					break;
+				}
+				target_ptr ++;
+			}
+			target_ptr ++;
+			hash = API_stats_hash(hash, "?", 1);
+			prev_char = '?';
+			continue;
+		}
+		// ドル引用符の文字列定数($$...$$、$tag$...$tag$)なら、同じドル引用符までスキップして'?'とする(識別子の途中の"$"は除く)
+		if (target_char == '$' && (target_ptr == query_ptr || !(isalnum((unsigned char)target_ptr[-1]) || target_ptr[-1] == '_' || target_ptr[-1] == '$')))
+		{
+			for (tag_len = 1; target_ptr + tag_len < end_ptr && (isalpha((unsigned char)target_ptr[tag_len]) || target_ptr[tag_len] == '_' || (unsigned char)target_ptr[tag_len] >= 0x80 || (tag_len > 1 && isdigit((unsigned char)target_ptr[tag_len]))); tag_len ++)
+			{
+				;
+			}
+			if (target_ptr + tag_len < end_ptr && target_ptr[tag_len] == '$')
+			{
+				tag_len ++;
+				tag_ptr = target_ptr;
+				target_ptr += tag_len;
+				while (target_ptr < end_ptr && *target_ptr != '\0' && !(end_ptr - target_ptr >= tag_len && memcmp(target_ptr, tag_ptr, tag_len) == 0))
+				{
+					target_ptr ++;
+				}
+				// 閉じるドル引用符がなければ、クエリの最後まで文字列定数
+				if (target_ptr < end_ptr && *target_ptr != '\0')
+				{
+					target_ptr += tag_len;
+				}
+				hash = API_stats_hash(hash, "?", 1);
+				prev_char = '?';
+				continue;
+			}
+		}
+		// 文の区切りを数える(最初の文と、";"の後に空白やコメント以外が続いたら、文が一つ増える)
+		if (lexinfo != NULL)
+		{
+			if (target_char == ';')
+			{
+				semicolon_flag = 1;
+			}
+			else if (lexinfo->statement_num == 0 || semicolon_flag != 0)
+			{
+				semicolon_flag = 0;
+				lexinfo->statement_num ++;
+			}
+		}
+		// 数値定数(識別子の途中ではない数字)、もしくはプレースホルダ($1など)なら、'?'とする
+		if ((isdigit(target_char) && !isalnum(prev_char) && prev_char != '_') ||
+			(target_char == '$' && target_ptr + 1 < end_ptr && isdigit((unsigned char)target_ptr[1])))
+		{
+			target_ptr ++;
+			while (target_ptr < end_ptr && (isdigit((unsigned char)*target_ptr) || *target_ptr == '.'))
+			{
+				target_ptr ++;
+			}
+			hash = API_stats_hash(hash, "?", 1);
+			prev_char = '?';
+			continue;
+		}
+		// それ以外は小文字にしてハッシュする
+		target_char = tolower(target_char);
+		hash = API_stats_hash(hash, &target_char, 1);
+		// 単語の途中なら、覚えておく
+		if (lexinfo != NULL && (isalnum(target_char) || target_char == '_') && word_len < (int)sizeof(word_str))
+		{
+			word_dot = (word_len == 0) ? ((prev_char == '.') ? 1 : 0) : word_dot;
+			word_str[word_len ++] = target_char;
+		}
+		// 引用符付き識別子の終わりなら、次が"("なら関数呼び出し
+		if (target_char == '"')
+		{
+			quote_flag ^= 1;
+			call_len = (quote_flag == 0) ? -1 : 0;
+		}
+		prev_char = target_char;
+		target_ptr ++;
+	}
+	if (lexinfo != NULL)
+	{
+		API_stats_lexword(lexinfo, word_str, word_len);
+	}
+
+	return hash;
+}
+
+// --------------------------------
+// ErrorResponse/NoticeResponseのフィールド分解処理
+// --------------------------------
+// メッセージ内の各フィールド(フィールド種別1バイト＋\0終端文字列)を、フィールド種別の1バイトを添字として field_list[] に設定する。
+// field_list[]はメッセージ内を直接指すだけ(コピーしない)なので、メッセージを解放した後は参照しないこと。
+// 戻り値はフィールド数(エラーなら-1)
+int API_pgsql_decode_errorfields(char *message_ptr, unsigned int message_len, struct EVS_value_t *field_list)
+{
+	char                            *field_ptr = message_ptr + 5;       // フィールドポインタ(メッセージタイプ1バイトとメッセージ長4バイトの次から)
+	char                            *end_ptr = message_ptr + 1 + message_len;
+	char                            *value_end;                         // フィールド値の終端(\0)
+	unsigned char                   field_type;                         // フィールド種別
+	int                             field_num = 0;
+
+	memset(field_list, 0, sizeof(struct EVS_value_t) * MAX_ERRFIELD_NUM);
+
+	// フィールド種別が\0(=終端)になるまでループ
+	while (field_ptr < end_ptr && *field_ptr != '\0')
+	{
+		field_type = (unsigned char)*field_ptr;
+		// フィールド値の終端を探す
+		value_end = memchr(field_ptr + 1, '\0', end_ptr - (field_ptr + 1));
+		// 終端が見つからないならメッセージがおかしいので
+		if (value_end == NULL)
+		{
+			return -1;
+		}
+		// 既知の範囲のフィールド種別なら(未知のフィールド種別は無視してよいことになっている)
+		if (field_type < MAX_ERRFIELD_NUM)
+		{
+			field_list[field_type].value_ptr = field_ptr + 1;
+			field_list[field_type].value_len = value_end - (field_ptr + 1);
+		}
+		field_num ++;
+		// 次のフィールドへ
+		field_ptr = value_end + 1;
+	}
+
+	return field_num;
+}
+
+// --------------------------------
+// フィールド値取得処理(フィールドがなければ空文字列を返す)
+// --------------------------------
+static char *API_errfield_str(struct EVS_value_t *field_list, unsigned char field_type)
+{
+	if (field_list[field_type].value_ptr == NULL)
+	{
+		return "";
+	}
+	return field_list[field_type].value_ptr;
+}
+
+// --------------------------------
+// エラー集計処理
+// --------------------------------
+static void API_errstat_count(struct EVS_session_t *this_session, struct EVS_value_t *field_list, time_t last_time)
+{
+	struct EVS_errstat_t            *errstat;                           // エラー集計用構造体ポインタ
+	char                            *sqlstate = API_errfield_str(field_list, 'C');
+	char                            *severity = API_errfield_str(field_list, 'V');
+	char                            *database = "";
+	char                            *username = "";
+	unsigned int                    fingerprint = 0;
+	unsigned int                    hash;
+	unsigned int                    list_num;
+	unsigned int                    probe_num;
+
+	// 非ローカライズの重要度(V)がなければ、重要度(S)を使う
+	if (*severity == '\0')
+	{
+		severity = API_errfield_str(field_list, 'S');
+	}
+	// セッション別解析情報があるなら
+	if (this_session != NULL)
+	{
+		database = this_session->database;
+		username = this_session->username;
+		fingerprint = this_session->fingerprint;
+	}
+
+	// 集計キーのハッシュ値を計算(0は未使用を示すので避ける)
+	hash = API_stats_hash(2166136261U, sqlstate, strlen(sqlstate) + 1);
+	hash = API_stats_hash(hash, database, strlen(database) + 1);
+	hash = API_stats_hash(hash, username, strlen(username) + 1);
+	hash = API_stats_hash(hash, &fingerprint, sizeof(fingerprint));
+	if (hash == 0)
+	{
+		hash = 1;
+	}
+
+	// 線形探索で該当するエントリか空きエントリを探す
+	list_num = hash % MAX_ERRSTAT_NUM;
+	for (probe_num = 0; probe_num < MAX_ERRSTAT_NUM; probe_num++)
+	{
+		errstat = &EVS_errstat_list[list_num];
+		// 空きエントリなら、新しく登録する
+		if (errstat->hash == 0)
+		{
+			errstat->hash = hash;
+			snprintf(errstat->sqlstate, sizeof(errstat->sqlstate), "%s", sqlstate);
+			snprintf(errstat->severity, sizeof(errstat->severity), "%s", severity);
+			snprintf(errstat->database, sizeof(errstat->database), "%s", database);
+			snprintf(errstat->username, sizeof(errstat->username), "%s", username);
+			errstat->fingerprint = fingerprint;
+			break;
+		}
+		// 該当するエントリなら
+		if (errstat->hash == hash &&
+			errstat->fingerprint == fingerprint &&
+			strncmp(errstat->sqlstate, sqlstate, sizeof(errstat->sqlstate) - 1) == 0 &&
+			strncmp(errstat->database, database, sizeof(errstat->database) - 1) == 0 &&
+			strncmp(errstat->username, username, sizeof(errstat->username) - 1) == 0)
+		{
+			break;
+		}
+		list_num = (list_num + 1) % MAX_ERRSTAT_NUM;
+	}
+	// エラー集計テーブルが満杯なら
+	if (probe_num == MAX_ERRSTAT_NUM)
+	{
+		EVS_errstat_overflow ++;
+		return;
+	}
+
+	errstat->total_count ++;
+	errstat->interval_count ++;
+	errstat->last_time = last_time;
+}
+
+// --------------------------------
+// ErrorResponse/NoticeResponse解析処理(ログ出力＆エラー集計)
+// --------------------------------
+int API_pgsql_errorresponse(int log_type, struct timeval *log_tv, struct EVS_session_t *this_session, char *message_ptr, unsigned int message_len)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	unsigned char                   message_type = message_ptr[0];
+	struct EVS_value_t              field_list[MAX_ERRFIELD_NUM];       // フィールド種別別のフィールド値(メッセージ内を直接指す)
+	int                             field_num;
+	struct timeval                  system_tv;
+	char                            reason_str[64];                     // フライトレコーダーをダンプする理由
+
+	// フィールド分解
+	field_num = API_pgsql_decode_errorfields(message_ptr, message_len, field_list);
+	// フィールドが分解できなかったら
+	if (field_num < 0)
+	{
+		LOGGING(log_type, LOGLEVEL_ERROR, log_tv, log_str, "%s(): Illegal %s field!? (message size=%d, len=0x%02x)\n", __func__, PgSQL_message_backend_str[message_type], 1 + message_len, message_len);
+		return -1;
+	}
+
+	// 標準ログに出力
+	LOGGING(log_type, LOGLEVEL_LOG, log_tv, log_str, "PostgreSQL -> %s. (message size=%d, len=0x%02x, severity:%s, sqlstate:%s, message:%s, detail:%s, hint:%s, position:%s, where:%s)\n",
+		PgSQL_message_backend_str[message_type], 1 + message_len, message_len,
+		API_errfield_str(field_list, 'S'),
+		API_errfield_str(field_list, 'C'),
+		API_errfield_str(field_list, 'M'),
+		API_errfield_str(field_list, 'D'),
+		API_errfield_str(field_list, 'H'),
+		API_errfield_str(field_list, 'P'),
+		API_errfield_str(field_list, 'W'));
+
+	// ErrorResponseなら集計する(NoticeResponseは集計しない)
+	if (message_type == 'E')
+	{
+		// ログ日時の指定がNULLなら
+		if (log_tv == NULL)
+		{
+			gettimeofday(&system_tv, NULL);
+			log_tv = &system_tv;
+		}
+		// エラー集計処理
+		API_errstat_count(this_session, field_list, log_tv->tv_sec);
+		// FlightSQLStateに指定したSQLSTATEなら、直前のイベントを調べられるようにフライトレコーダーをダンプする
+		if (flight_sqlstate(API_errfield_str(field_list, 'C')) == 1)
+		{
+			snprintf(reason_str, sizeof(reason_str), "ErrorResponse(sqlstate:%s)", API_errfield_str(field_list, 'C'));
+			flight_dump(reason_str, 0);
+		}
+	}
+
+	return 0;
+}
+
+// --------------------------------
+// エラー集計エントリ削除処理(後続のエントリを詰めて、線形探索が途切れないようにする)
+// --------------------------------
+static void API_errstat_evict(unsigned int list_num)
+{
+	unsigned int                    next_num;                           // 後続のエントリ番号
+	unsigned int                    home_num;                           // 後続のエントリが本来入るエントリ番号
+	unsigned int                    probe_num;
+
+	next_num = list_num;
+	for (probe_num = 1; probe_num < MAX_ERRSTAT_NUM; probe_num++)
+	{
+		next_num = (next_num + 1) % MAX_ERRSTAT_NUM;
+		// 空きエントリまで来たら終わり(満杯なら一周で終わり)
+		if (EVS_errstat_list[next_num].hash == 0)
+		{
+			break;
+		}
+		// 本来の位置が削除位置より後(巡回して)にあるエントリは、動かすと探索できなくなるのでそのまま
+		home_num = EVS_errstat_list[next_num].hash % MAX_ERRSTAT_NUM;
+		if ((list_num <= next_num) ? (list_num < home_num && home_num <= next_num) : (list_num < home_num || home_num <= next_num))
+		{
+			continue;
+		}
+		// 削除位置に詰めて、今度は移動元を削除位置にする
+		EVS_errstat_list[list_num] = EVS_errstat_list[next_num];
+		list_num = next_num;
+	}
+	memset(&EVS_errstat_list[list_num], 0, sizeof(struct EVS_errstat_t));
+}
+
+// --------------------------------
+// エラー集計出力処理 ※タイマーイベントから呼ばれる
+// --------------------------------
+void API_errstat_report(ev_tstamp nowtime)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	struct EVS_errstat_t            *errstat;                           // エラー集計用構造体ポインタ
+	ev_tstamp                       interval_time;                      // 前回の出力からの経過時間(秒)
+	unsigned int                    list_num;
+	int                             log_level;
+
+	// エラー集計を出力しない設定なら
+	if (EVS_config.errorstat_intval <= 0.)
+	{
+		return;
+	}
+	// 初回なら、起点の日時を設定するだけ
+	if (EVS_errstat_lasttime == 0.)
+	{
+		EVS_errstat_lasttime = nowtime;
+		return;
+	}
+	// まだ出力間隔が経過していないなら
+	interval_time = nowtime - EVS_errstat_lasttime;
+	if (interval_time < EVS_config.errorstat_intval)
+	{
+		return;
+	}
+	EVS_errstat_lasttime = nowtime;
+
+	// 前回から発生していないエントリは、テーブルが埋まらないように削除する
+	list_num = 0;
+	while (list_num < MAX_ERRSTAT_NUM)
+	{
+		errstat = &EVS_errstat_list[list_num];
+		if (errstat->hash != 0 && errstat->interval_count == 0)
+		{
+			// 後続のエントリが詰められてくるので、同じ位置をもう一度確認する
+			API_errstat_evict(list_num);
+			continue;
+		}
+		list_num ++;
+	}
+
+	// エラー集計テーブルを全て確認
+	for (list_num = 0; list_num < MAX_ERRSTAT_NUM; list_num++)
+	{
+		errstat = &EVS_errstat_list[list_num];
+		// 未使用なら
+		if (errstat->hash == 0)
+		{
+			continue;
+		}
+		// 発生件数が警告件数以上ならWARN、それ以外はLOGで出力
+		log_level = LOGLEVEL_LOG;
+		if (EVS_config.errorstat_warncount > 0 && errstat->interval_count >= (unsigned long)EVS_config.errorstat_warncount)
+		{
+			log_level = LOGLEVEL_WARN;
+		}
+		LOGGING(LOG_QUEUEING, log_level, NULL, log_str, "ErrorStat: sqlstate=%s, severity=%s, database=%s, user=%s, fingerprint=%08x, count=%lu, rate=%.2f/s, total=%lu\n",
+			errstat->sqlstate, errstat->severity, errstat->database, errstat->username, errstat->fingerprint,
+			errstat->interval_count, (double)errstat->interval_count / interval_time, errstat->total_count);
+		// 出力間隔内の発生件数をクリア
+		errstat->interval_count = 0;
+	}
+	// エラー集計テーブルが満杯で集計できなかったものがあれば
+	if (EVS_errstat_overflow > 0)
+	{
+		LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "ErrorStat: table full, %lu errors not aggregated.\n", EVS_errstat_overflow);
+		EVS_errstat_overflow = 0;
+	}
+}
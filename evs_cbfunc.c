@@ -48,13 +48,14 @@ static void CB_sighup(struct ev_loop* loop, struct ev_signal *watcher, int reven
 	// イベントにエラーフラグが含まれていたら
 	if (EV_ERROR & revents)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Invalid event!?\n", __func__);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Invalid event!?\n", __func__);
 		return;
 	}
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): Catch SIGHUP!\n", __func__);
-	logging(LOG_DIRECT, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_DIRECT, LOGLEVEL_INFO, NULL, log_str, "%s(): Catch SIGHUP!\n", __func__);
+
+	// 設定再読み込み処理(PostgreSQL設定を読み直して、経路表を差し替える)
+	INIT_config_reload();
 
 	ev_break(loop, EVBREAK_CANCEL);                                     // わざわざこう書いてもいいけど、書かなくてもループは続けてくれる
 }
@@ -69,13 +70,11 @@ static void CB_sigint(struct ev_loop* loop, struct ev_signal *watcher, int reven
 	// イベントにエラーフラグが含まれていたら
 	if (EV_ERROR & revents)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Invalid event!?\n", __func__);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Invalid event!?\n", __func__);
 		return;
 	}
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): Catch SIGINT!\n", __func__);
-	logging(LOG_DIRECT, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_DIRECT, LOGLEVEL_INFO, NULL, log_str, "%s(): Catch SIGINT!\n", __func__);
 
 	ev_break(loop, EVBREAK_ALL);
 }
@@ -90,17 +89,65 @@ static void CB_sigterm(struct ev_loop* loop, struct ev_signal *watcher, int reve
 	// イベントにエラーフラグが含まれていたら
 	if (EV_ERROR & revents)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Invalid event!?\n", __func__);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Invalid event!?\n", __func__);
 		return;
 	}
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): Catch SIGTERM!\n", __func__);
-	logging(LOG_DIRECT, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_DIRECT, LOGLEVEL_INFO, NULL, log_str, "%s(): Catch SIGTERM!\n", __func__);
 
 	ev_break(loop, EVBREAK_ALL);
 }
 
+// --------------------------------
+// シグナル処理(SIGUSR1)のコールバック処理
+// --------------------------------
+// 外部でログファイルをローテーションした後に送ってもらい、ログファイルを開き直す(開き直しはログ書き出しスレッドで行うので、ここでは待たない)
+static void CB_sigusr1(struct ev_loop* loop, struct ev_signal *watcher, int revents)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	(void)loop;                                                         // ログの開き直しはループを使わない
+	(void)watcher;
+
+	// イベントにエラーフラグが含まれていたら
+	if (EV_ERROR & revents)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Invalid event!?\n", __func__);
+		return;
+	}
+
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): Catch SIGUSR1! Reopen log file.\n", __func__);
+
+	// ログファイル開き直し処理
+	log_reopen();
+	// ダンプファイル開き直し処理
+	dump_reopen();
+}
+
+// --------------------------------
+// シグナル処理(SIGUSR2)のコールバック処理
+// --------------------------------
+// フライトレコーダーに記録している直近のイベントを、FlightDumpに出力する(調査したい時に外部から送ってもらう)
+static void CB_sigusr2(struct ev_loop* loop, struct ev_signal *watcher, int revents)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+
+	(void)loop;                                                         // ダンプはループを使わない
+	(void)watcher;
+
+	// イベントにエラーフラグが含まれていたら
+	if (EV_ERROR & revents)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Invalid event!?\n", __func__);
+		return;
+	}
+
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): Catch SIGUSR2! Dump flight recorder.\n", __func__);
+
+	// フライトレコーダーダンプ処理
+	flight_dump("SIGUSR2", 1);
+}
+
 // --------------------------------
 // アイドルイベント(メッセージ用キュー処理)のコールバック処理
 // --------------------------------
@@ -128,13 +175,23 @@ static void CB_idle_message(struct ev_loop* loop, struct ev_idle *watcher, int r
 			// メッセージの方向がLOGLEVEL_MAX以下なら
 			if (message_info->from_to <= LOGLEVEL_MAX)
 			{
-				// そのままログに出力(from_toはログレベル)
+				// そのままログに出力(from_toはログレベル。キューに入れた時のログ種別で振り分ける)
+				EVS_log_event = message_info->log_event;
 				logging(LOG_DIRECT, message_info->from_to, &(message_info->message_tv), NULL, NULL, message_info->message_ptr, strlen(message_info->message_ptr));
+				EVS_log_event = LOG_EVENT_SYSTEM;
 			}
-			// 上記以外は、システム全体のログレベルがLOGLEVEL_LOG以下なら
-			else if (EVS_config.log_level <= LOGLEVEL_LOG)
+			// メッセージの方向が100:セッション終了なら(ログレベルに関係なく処理する)
+			else if (message_info->from_to == 100)
 			{
-				// メッセージの方向(LOGLEVEL_MAX以下:そのままログに出力, 101:Client->PgAnalyzer, 102:PgAnalyzer->Client, 111:PgAnalyzer->PostgreSQL, 112:PostgreSQL->PgAnalyzer)
+				// セッション別解析情報解放処理
+				API_session_free(message_info);
+			}
+			// 上記以外は、問い合わせ毎のログをLOGLEVEL_LOGで出力するログ出力先があるか、エラー集計か長時間トランザクションの警告をするなら
+			else if (EVS_log_route[LOG_EVENT_QUERY][LOGLEVEL_LOG] != 0 || EVS_config.errorstat_intval > 0. || EVS_config.transaction_warntime > 0.)
+			{
+				// ここで出力するログは、問い合わせ毎のログとして振り分ける
+				EVS_log_event = LOG_EVENT_QUERY;
+				// メッセージの方向(LOGLEVEL_MAX以下:そのままログに出力, 101:Client->PgAnalyzer, 102:PgAnalyzer->Client, 111:PgAnalyzer->PostgreSQL, 112:PostgreSQL->PgAnalyzer, 113:ログサンプリング対象外のReadyForQuery)
 				switch (message_info->from_to)
 				{
 					case 101:
@@ -144,12 +201,10 @@ static void CB_idle_message(struct ev_loop* loop, struct ev_idle *watcher, int r
 						API_pgsql_client_message(message_info);
 						break;
 					case 102:
-						snprintf(log_str, MAX_LOG_LENGTH, "%s(): =%ld\n", __func__, message_info->message_tv.tv_sec);
-						logging(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
+						LOGGING(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), log_str, "%s(): =%ld\n", __func__, message_info->message_tv.tv_sec);
 						break;
 					case 111:
-						snprintf(log_str, MAX_LOG_LENGTH, "%s(): _sec=%ld\n", __func__, message_info->message_tv.tv_sec);
-						logging(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
+						LOGGING(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), log_str, "%s(): _sec=%ld\n", __func__, message_info->message_tv.tv_sec);
 						break;
 					case 112:
 ////                        snprintf(log_str, MAX_LOG_LENGTH, "%s(): Message Found!! PostgreSQL->PgAnalyzer, message_tv.tv_sec=%ld\n", __func__, message_info->message_tv.tv_sec);
@@ -157,16 +212,22 @@ static void CB_idle_message(struct ev_loop* loop, struct ev_idle *watcher, int r
 						// PostgreSQL側メッセージ処理 ※この処理はアイドルイベント時にのみ、溜まっているメッセージ用キューのログへの出力として呼び出される。なので、PostgreSQLの状態は2より大きいはず。
 						API_pgsql_server_message(message_info);
 						break;
+					case 113:
+						// ログサンプリング : 対象外のReadyForQuery処理(トランザクションの状態遷移だけを追いかける)
+						API_sample_ready(message_info);
+						break;
 					default:
-						snprintf(log_str, MAX_LOG_LENGTH, "%s(): Message Found!! from_to=%02d!? message_tv.tv_sec=%ld\n", __func__, message_info->from_to, message_info->message_tv.tv_sec);
-						logging(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), NULL, NULL, log_str, strlen(log_str));
+						LOGGING(LOG_DIRECT, LOGLEVEL_LOG, &(message_info->message_tv), log_str, "%s(): Message Found!! from_to=%02d!? message_tv.tv_sec=%ld\n", __func__, message_info->from_to, message_info->message_tv.tv_sec);
 				}
+				EVS_log_event = LOG_EVENT_SYSTEM;
 			}
 			// メッセージ用キューを削除
-			TAILQ_REMOVE(&EVS_message_tailq, message_info, entries);
+			API_spool_remove(message_info);
 			free(message_info->message_ptr);
 			free(message_info);
 		}
+		// スプールに溜まっているメッセージがあれば、メッセージ用キューに読み込む(I/Oを待たせないように、解析は次のアイドルイベントで行う)
+		API_spool_load();
 		// イベントループの日時を現在の日時に更新
 		ev_now_update(loop);
 		// 最終アイドルチェック日時を更新
@@ -198,8 +259,7 @@ static void CB_timeout(struct ev_loop* loop, struct ev_timer *watcher, int reven
 	ev_now_update(loop);
 	nowtime = ev_now(loop);
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): Timeout check start! ev_now=%.0f\n", __func__, nowtime);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): Timeout check start! ev_now=%.0f\n", __func__, nowtime);
 
 	// --------------------------------
 	// タイマー別処理
@@ -210,13 +270,11 @@ static void CB_timeout(struct ev_loop* loop, struct ev_timer *watcher, int reven
 		// 該当タイマーがすでにタイムアウトしていたら
 		if (ev_now(loop) > this_timeout->timeout)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Timeout!!!\n", __func__);
-			logging(LOG_QUEUEING, LOGLEVEL_WARN, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(fd=%d): Timeout!!!\n", __func__);
 		}
 		else
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Not Timeout!?\n", __func__);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): Not Timeout!?\n", __func__);
 		}
 	}
 	// ----------------
@@ -233,8 +291,7 @@ static void CB_timeout(struct ev_loop* loop, struct ev_timer *watcher, int reven
 			// 無通信タイマーの経過時間がすでにタイムアウトしていたら
 			if ((client_watcher->last_activity + EVS_config.nocommunication_timeout) < nowtime)
 			{
-				snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Client Timeout!!!\n", __func__, client_watcher->socket_fd);
-				logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+				LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(fd=%d): Client Timeout!!!\n", __func__, client_watcher->socket_fd);
 				// ----------------
 				// クライアント接続終了処理(イベントの停止、クライアントキューからの削除、SSL接続情報開放、ソケットクローズ、クライアント情報開放)
 				// ----------------
@@ -247,11 +304,10 @@ static void CB_timeout(struct ev_loop* loop, struct ev_timer *watcher, int reven
 		// PostgreSQL用テールキューからポート情報を取得して全て処理
 		TAILQ_FOREACH (pgsql_watcher, &EVS_pgsql_tailq, entries)
 		{
-			// 無通信タイマーの経過時間がすでにタイムアウトしていたら
-			if ((pgsql_watcher->last_activity + EVS_config.nocommunication_timeout) < nowtime)
+			// 無通信タイマーの経過時間がすでにタイムアウトしていたら(20:プール待機中なら、PoolIdleTimeoutで閉じる)
+			if (pgsql_watcher->pgsql_status != 20 && (pgsql_watcher->last_activity + EVS_config.nocommunication_timeout) < nowtime)
 			{
-				snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): PostgreSQL Timeout!!!\n", __func__, pgsql_watcher->socket_fd);
-				logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+				LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(fd=%d): PostgreSQL Timeout!!!\n", __func__, pgsql_watcher->socket_fd);
 				// ----------------
 				// PostgreSQL接続終了処理(イベントの停止、PostgreSQLキューからの削除、SSL接続情報開放、ソケットクローズ、PostgreSQL情報開放)
 				// ----------------
@@ -259,6 +315,50 @@ static void CB_timeout(struct ev_loop* loop, struct ev_timer *watcher, int reven
 			}
 		}
 	}
+	// --------------------------------
+	// エラー集計出力処理
+	// --------------------------------
+	API_errstat_report(nowtime);
+	// --------------------------------
+	// 長時間トランザクション確認処理
+	// --------------------------------
+	API_session_check(nowtime);
+	// --------------------------------
+	// COPY途中経過出力処理
+	// --------------------------------
+	API_copy_check(nowtime);
+	// --------------------------------
+	// プール接続タイムアウト確認処理
+	// --------------------------------
+	API_pool_check(nowtime);
+	// --------------------------------
+	// 接続先ホスト死活確認処理
+	// --------------------------------
+	API_balance_check(nowtime);
+	// --------------------------------
+	// 読み書き分離統計出力処理
+	// --------------------------------
+	API_split_report(nowtime);
+	// --------------------------------
+	// 接続受け入れ制御統計出力処理
+	// --------------------------------
+	API_admit_report(nowtime);
+	// --------------------------------
+	// CancelRequest転送タイムアウト確認処理
+	// --------------------------------
+	API_cancel_check(nowtime);
+	// --------------------------------
+	// 経路表確認処理(使われなくなったワイルドカードの設定、経路表から外した設定を開放する)
+	// --------------------------------
+	API_route_check(nowtime);
+	// --------------------------------
+	// ログ書き出し統計出力処理、ログバッファ書き出し処理、ダンプファイル書き出し処理
+	// --------------------------------
+	log_report(nowtime);
+	API_spool_report(nowtime);
+	log_flush();
+	dump_flush();
+
 	// イベントループの日時を現在の日時に更新
 	ev_now_update(loop);
 	// 最終アイドルチェック日時を更新
@@ -284,13 +384,11 @@ static void CB_recv(struct ev_loop* loop, struct ev_io *watcher, int revents)
 	// イベントにエラーフラグが含まれていたら
 	if (EV_ERROR & revents)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Invalid event!?\n", __func__);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Invalid event!?\n", __func__);
 		return;
 	}
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): OK. ssl_status=%d\n", __func__, this_client->socket_fd, this_client->ssl_status);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): OK. ssl_status=%d\n", __func__, this_client->socket_fd, this_client->ssl_status);
 
 	// ----------------
 	// 無通信タイムアウトチェックをする(=1:有効)なら
@@ -299,8 +397,7 @@ static void CB_recv(struct ev_loop* loop, struct ev_io *watcher, int revents)
 	{
 		ev_now_update(loop);                                            // イベントループの日時を現在の日時に更新
 		this_client->last_activity = ev_now(loop);                      // 最終アクティブ日時(監視対象が最後にアクティブとなった日時)を設定する
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): last_activity=%.0f\n", __func__, this_client->socket_fd, this_client->last_activity);
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): last_activity=%.0f\n", __func__, this_client->socket_fd, this_client->last_activity);
 	}
 
 	// ----------------
@@ -319,8 +416,9 @@ static void CB_recv(struct ev_loop* loop, struct ev_io *watcher, int revents)
 		// 読み込めたメッセージ量が負(<0)だったら(エラーです)
 		if (socket_result < 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot recv message? errno=%d (%s)\n", __func__, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot recv message? errno=%d (%s)\n", __func__, errno, strerror(errno));
+			// 直前のイベントを調べられるように、フライトレコーダーをダンプする
+			flight_dump("CB_recv(): recv() error", 0);
 			// ----------------
 			// クライアント接続終了処理(各種API関連情報解放、SSL接続情報開放、ソケットクローズ、クライアントキューからの削除、イベントの停止)
 			// ----------------
@@ -330,8 +428,7 @@ static void CB_recv(struct ev_loop* loop, struct ev_io *watcher, int revents)
 		// 読み込めたメッセージ量が0だったら(切断処理をする)
 		else if (socket_result == 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): socket_result == 0.\n", __func__, this_client->socket_fd);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): socket_result == 0.\n", __func__, this_client->socket_fd);
 			// ----------------
 			// クライアント接続終了処理(イベントの停止、クライアントキューからの削除、SSL接続情報開放、ソケットクローズ、クライアント情報開放)
 			// ----------------
@@ -345,8 +442,7 @@ static void CB_recv(struct ev_loop* loop, struct ev_io *watcher, int revents)
 			// メッセージ長を設定する(メッセージの終端に'\0'(!=NULL)を設定してはっきりとさせておく)
 			this_client->recv_len = socket_result;
 			this_client->recv_buf[this_client->recv_len] = '\0';
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Recieved %d bytes, recv_len=%d. A\n", __func__, this_client->socket_fd, socket_result, this_client->recv_len);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): Recieved %d bytes, recv_len=%d. A\n", __func__, this_client->socket_fd, socket_result, this_client->recv_len);
 		}
 		// クライアント毎の状態が、3:クエリデータ待ちなら
 		else
@@ -354,8 +450,7 @@ static void CB_recv(struct ev_loop* loop, struct ev_io *watcher, int revents)
 			// メッセージ長を設定する(メッセージの終端に'\0'(!=NULL)を設定してはっきりとさせておく)
 			this_client->recv_len += socket_result;
 			this_client->recv_buf[this_client->recv_len] = '\0';
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Recieved %d bytes, recv_len=%d. B\n", __func__, this_client->socket_fd, socket_result, this_client->recv_len);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): Recieved %d bytes, recv_len=%d. B\n", __func__, this_client->socket_fd, socket_result, this_client->recv_len);
 		}
 	}
 	// ----------------
@@ -363,20 +458,17 @@ static void CB_recv(struct ev_loop* loop, struct ev_io *watcher, int revents)
 	// ----------------
 	else if (this_client->ssl_status == 1)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): SSL/TLS handshake START!\n", __func__, this_client->socket_fd);
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): SSL/TLS handshake START!\n", __func__, this_client->socket_fd);
 
 		// ----------------
 		// OpenSSL(SSL_accept : SSL/TLSハンドシェイクを開始)
 		// ----------------
 		socket_result = SSL_accept(this_client->ssl);
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): SSL_accept(): socket_result=%d.\n", __func__, this_client->socket_fd, socket_result);
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): SSL_accept(): socket_result=%d.\n", __func__, this_client->socket_fd, socket_result);
 
 		// SSL/TLSハンドシェイクの結果コードを取得
 		socket_result = SSL_get_error(this_client->ssl, socket_result);
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): SSL_get_error(): socket_result=%d.\n", __func__, this_client->socket_fd, socket_result);
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): SSL_get_error(): socket_result=%d.\n", __func__, this_client->socket_fd, socket_result);
 
 		// SSL/TLSハンドシェイクの結果コード別処理分岐
 		switch (socket_result)
@@ -385,14 +477,12 @@ static void CB_recv(struct ev_loop* loop, struct ev_io *watcher, int revents)
 				// エラーなし(ハンドシェイク成功)
 				// SSL接続中に設定
 				this_client->ssl_status = 2;
-				snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): SSL/TLS handshake OK.\n", __func__, this_client->socket_fd);
-				logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+				LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): SSL/TLS handshake OK.\n", __func__, this_client->socket_fd);
 				break;
 			case SSL_ERROR_SSL :
 			case SSL_ERROR_SYSCALL :
 				// SSL/TLSハンドシェイクがエラー
-				snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Cannot SSL/TLS handshake!? %s\n", __func__, this_client->socket_fd, ERR_reason_error_string(ERR_get_error()));
-				logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+				LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): Cannot SSL/TLS handshake!? %s\n", __func__, this_client->socket_fd, ERR_reason_error_string(ERR_get_error()));
 				// ----------------
 				// クライアント接続終了処理(イベントの停止、クライアントキューからの削除、SSL接続情報開放、ソケットクローズ、クライアント情報開放)
 				// ----------------
@@ -422,8 +512,9 @@ static void CB_recv(struct ev_loop* loop, struct ev_io *watcher, int revents)
 		// 読み込めたメッセージ量が負(<0)だったら(エラーです)
 		if (socket_result < 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): SSL_read(): Cannot read decrypted message!?\n", __func__, this_client->socket_fd, ERR_reason_error_string(ERR_get_error()));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): SSL_read(): Cannot read decrypted message!?\n", __func__, this_client->socket_fd, ERR_reason_error_string(ERR_get_error()));
+			// 直前のイベントを調べられるように、フライトレコーダーをダンプする
+			flight_dump("CB_recv(): SSL_read() error", 0);
 			// ----------------
 			// クライアント接続終了処理(イベントの停止、クライアントキューからの削除、SSL接続情報開放、ソケットクローズ、クライアント情報開放)
 			// ----------------
@@ -433,8 +524,7 @@ static void CB_recv(struct ev_loop* loop, struct ev_io *watcher, int revents)
 		// 読み込めたメッセージ量が0だったら(切断処理をする)
 		if (socket_result == 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): socket_result == 0.\n", __func__, this_client->socket_fd);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): socket_result == 0.\n", __func__, this_client->socket_fd);
 			// ----------------
 			// クライアント接続終了処理(イベントの停止、クライアントキューからの削除、SSL接続情報開放、ソケットクローズ、クライアント情報開放)
 			// ----------------
@@ -448,8 +538,7 @@ static void CB_recv(struct ev_loop* loop, struct ev_io *watcher, int revents)
 			// メッセージ長を設定する(メッセージの終端に'\0'(!=NULL)を設定してはっきりとさせておく)
 			this_client->recv_len = socket_result;
 			this_client->recv_buf[this_client->recv_len] = '\0';
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Recieved %d bytes, recv_len=%d. C\n", __func__, this_client->socket_fd, socket_result, this_client->recv_len);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): Recieved %d bytes, recv_len=%d. C\n", __func__, this_client->socket_fd, socket_result, this_client->recv_len);
 		}
 		// クライアント毎の状態が、3:クエリデータ待ちなら
 		else
@@ -457,8 +546,7 @@ static void CB_recv(struct ev_loop* loop, struct ev_io *watcher, int revents)
 			// メッセージ長を設定する(メッセージの終端に'\0'(!=NULL)を設定してはっきりとさせておく)
 			this_client->recv_len += socket_result;
 			this_client->recv_buf[this_client->recv_len] = '\0';
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Recieved %d bytes, recv_len=%d. D\n", __func__, this_client->socket_fd, socket_result, this_client->recv_len);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): Recieved %d bytes, recv_len=%d. D\n", __func__, this_client->socket_fd, socket_result, this_client->recv_len);
 		}
 	}
 
@@ -471,8 +559,7 @@ static void CB_recv(struct ev_loop* loop, struct ev_io *watcher, int revents)
 	// APIの処理結果がエラー(!=0)だったら(切断処理をする)
 	if (socket_result != 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): API ERROR!? socket_result=%d\n", __func__, this_client->socket_fd, socket_result);
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): API ERROR!? socket_result=%d\n", __func__, this_client->socket_fd, socket_result);
 		// ----------------
 		// クライアント接続終了処理(イベントの停止、クライアントキューからの削除、SSL接続情報開放、ソケットクローズ、クライアント情報開放)
 		// ----------------
@@ -503,13 +590,11 @@ void CB_accept_SSL(struct EVS_ev_client_t * client_watcher)
 	// SSL設定情報を元に、SSL接続情報を生成がエラーだったら
 	if (client_watcher->ssl == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(client fd=%d): SSL_new(): Cannot get new SSL structure!? %s\n", __func__, client_watcher->socket_fd, ERR_reason_error_string(ERR_get_error()));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(client fd=%d): SSL_new(): Cannot get new SSL structure!? %s\n", __func__, client_watcher->socket_fd, ERR_reason_error_string(ERR_get_error()));
 		free(client_watcher);
 		return;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(client fd=%d): SSL_new(): OK.\n", __func__, client_watcher->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(client fd=%d): SSL_new(): OK.\n", __func__, client_watcher->socket_fd);
 
 	// ----------------
 	// OpenSSL(SSL_set_fd : 接続してきたソケットファイルディスクリプタを、SSL_set_fd()でSSL接続情報に紐づけ)
@@ -518,13 +603,11 @@ void CB_accept_SSL(struct EVS_ev_client_t * client_watcher)
 	if (SSL_set_fd(client_watcher->ssl, client_watcher->socket_fd) == 0)
 	{
 		// ここでもソケットをクローズをしたほうがいいかな？それともソケットを再設定したほうがいいかな？
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(client fd=%d): SSL_set_fd(): Cannot SSL socket binding!? %s\n", __func__, client_watcher->socket_fd, ERR_reason_error_string(ERR_get_error()));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(client fd=%d): SSL_set_fd(): Cannot SSL socket binding!? %s\n", __func__, client_watcher->socket_fd, ERR_reason_error_string(ERR_get_error()));
 		free(client_watcher);
 		return;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(client fd=%d): SSL_set_fd(): OK.\n", __func__, client_watcher->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(client fd=%d): SSL_set_fd(): OK.\n", __func__, client_watcher->socket_fd);
 }
 
 // --------------------------------
@@ -549,22 +632,19 @@ static void CB_accept_ipv6(struct ev_loop* loop, struct EVS_ev_server_t * server
 	if (socket_result < 0)
 	{
 		// ここでもソケットをクローズをしたほうがいいかな？それともソケットを再設定したほうがいいかな？
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Cannot socket accepting? Total=%d, errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_connect_num, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): Cannot socket accepting? Total=%d, errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_connect_num, errno, strerror(errno));
 		return;
 	}
 	// クライアント接続数を設定
 	EVS_connect_num ++;
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): OK. client fd=%d, Total=%d\n", __func__, server_watcher->socket_fd, socket_result, EVS_connect_num);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(fd=%d): OK. client fd=%d, Total=%d\n", __func__, server_watcher->socket_fd, socket_result, EVS_connect_num);
 
 	// クライアント別設定用構造体ポインタのメモリ領域を確保
 	client_watcher = (struct EVS_ev_client_t *)calloc(1, sizeof(struct EVS_ev_client_t));
 	// メモリ領域が確保できなかったら
 	if (client_watcher == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Cannot calloc client_watcher's memory? errno=%d (%s)\n", __func__, server_watcher->socket_fd, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): Cannot calloc client_watcher's memory? errno=%d (%s)\n", __func__, server_watcher->socket_fd, errno, strerror(errno));
 		return;
 	}
 
@@ -574,8 +654,7 @@ static void CB_accept_ipv6(struct ev_loop* loop, struct EVS_ev_server_t * server
 
 	// クライアントのアドレスを文字列として格納
 	inet_ntop(PF_INET6, (void *)&client_sockaddr_in6.sin6_addr, client_watcher->addr_str, sizeof(client_watcher->addr_str));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): inet_ntop(PF_INET6): Client address=%s\n", __func__, client_watcher->addr_str);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): inet_ntop(PF_INET6): Client address=%s\n", __func__, client_watcher->addr_str);
 
 
 	// PostgreSQLプロトコルの場合には、STARTTLS的な感じで、平文から暗号化通信になるので、ここまではまだ何かをすることはない
@@ -588,8 +667,7 @@ static void CB_accept_ipv6(struct ev_loop* loop, struct EVS_ev_server_t * server
 	// 設定ができなかったら
 	if (socket_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): ioctl(): Cannot set Non-Blocking mode!? errno=%d (%s)\n", __func__, client_watcher->socket_fd, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): ioctl(): Cannot set Non-Blocking mode!? errno=%d (%s)\n", __func__, client_watcher->socket_fd, errno, strerror(errno));
 		free(client_watcher);
 		return;
 	}
@@ -601,8 +679,7 @@ static void CB_accept_ipv6(struct ev_loop* loop, struct EVS_ev_server_t * server
 	{
 		ev_now_update(loop);                                                // イベントループの日時を現在の日時に更新
 		client_watcher->last_activity = ev_now(loop);                       // 最終アクティブ日時(監視対象が最後にアクティブとなった日時)を設定する
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): last_activity=%.0f\n", __func__, client_watcher->socket_fd, client_watcher->last_activity);
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): last_activity=%.0f\n", __func__, client_watcher->socket_fd, client_watcher->last_activity);
 	}
 
 	// --------------------------------
@@ -615,22 +692,18 @@ static void CB_accept_ipv6(struct ev_loop* loop, struct EVS_ev_server_t * server
 
 	// テールキューの最後にこの接続の情報を追加する
 	TAILQ_INSERT_TAIL(&EVS_client_tailq, client_watcher, entries);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INSERT_TAIL(client fd=%d): OK.\n", __func__, client_watcher->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): TAILQ_INSERT_TAIL(client fd=%d): OK.\n", __func__, client_watcher->socket_fd);
 
 	// ----------------
 	// クライアント別設定用構造体ポインタのI/O監視オブジェクトに対して、コールバック処理とソケットファイルディスクリプタ、そしてイベントのタイプを設定する
 	// ----------------
 	ev_io_init(&client_watcher->io_watcher, CB_recv, client_watcher->socket_fd, EV_READ);
 	ev_io_start(loop, &client_watcher->io_watcher);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_io_init(CB_recv, client fd=%d, EV_READ): OK.\n", __func__, client_watcher->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_io_start(): OK. Priority=%d\n", __func__, ev_priority(&client_watcher->io_watcher));
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): ev_io_init(CB_recv, client fd=%d, EV_READ): OK.\n", __func__, client_watcher->socket_fd);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): ev_io_start(): OK. Priority=%d\n", __func__, ev_priority(&client_watcher->io_watcher));
 
 	// 標準ログに出力
-	snprintf(log_str, MAX_LOG_LENGTH, "Client %s Connected.\n", client_watcher->addr_str);
-	logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "Client %s Connected.\n", client_watcher->addr_str);
 
 	// 戻る
 	return;
@@ -658,22 +731,19 @@ static void CB_accept_ipv4(struct ev_loop* loop, struct EVS_ev_server_t * server
 	if (socket_result < 0)
 	{
 		// ここでもソケットをクローズをしたほうがいいかな？それともソケットを再設定したほうがいいかな？
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Cannot socket accepting? Total=%d, errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_connect_num, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): Cannot socket accepting? Total=%d, errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_connect_num, errno, strerror(errno));
 		return;
 	}
 	// クライアント接続数を設定
 	EVS_connect_num ++;
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): OK. client fd=%d, Total=%d\n", __func__, server_watcher->socket_fd, socket_result, EVS_connect_num);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(fd=%d): OK. client fd=%d, Total=%d\n", __func__, server_watcher->socket_fd, socket_result, EVS_connect_num);
 
 	// クライアント別設定用構造体ポインタのメモリ領域を確保
 	client_watcher = (struct EVS_ev_client_t *)calloc(1, sizeof(struct EVS_ev_client_t));
 	// メモリ領域が確保できなかったら
 	if (client_watcher == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Cannot calloc client_watcher's memory? errno=%d (%s)\n", __func__, server_watcher->socket_fd, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): Cannot calloc client_watcher's memory? errno=%d (%s)\n", __func__, server_watcher->socket_fd, errno, strerror(errno));
 		return;
 	}
 
@@ -683,8 +753,7 @@ static void CB_accept_ipv4(struct ev_loop* loop, struct EVS_ev_server_t * server
 
 	// クライアントのアドレスを文字列として格納
 	inet_ntop(PF_INET, (void *)&client_sockaddr_in.sin_addr, client_watcher->addr_str, sizeof(client_watcher->addr_str));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): inet_ntop(PF_INET): Client address=%s\n", __func__, client_watcher->addr_str);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): inet_ntop(PF_INET): Client address=%s\n", __func__, client_watcher->addr_str);
 
 
 	// PostgreSQLプロトコルの場合には、STARTTLS的な感じで、平文から暗号化通信になるので、ここまではまだ何かをすることはない
@@ -697,8 +766,7 @@ static void CB_accept_ipv4(struct ev_loop* loop, struct EVS_ev_server_t * server
 	// 設定ができなかったら
 	if (socket_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): ioctl(): Cannot set Non-Blocking mode!? errno=%d (%s)\n", __func__, client_watcher->socket_fd, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): ioctl(): Cannot set Non-Blocking mode!? errno=%d (%s)\n", __func__, client_watcher->socket_fd, errno, strerror(errno));
 		free(client_watcher);
 		return;
 	}
@@ -710,8 +778,7 @@ static void CB_accept_ipv4(struct ev_loop* loop, struct EVS_ev_server_t * server
 	{
 		ev_now_update(loop);                                                // イベントループの日時を現在の日時に更新
 		client_watcher->last_activity = ev_now(loop);                       // 最終アクティブ日時(監視対象が最後にアクティブとなった日時)を設定する
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): last_activity=%.0f\n", __func__, client_watcher->socket_fd, client_watcher->last_activity);
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): last_activity=%.0f\n", __func__, client_watcher->socket_fd, client_watcher->last_activity);
 	}
 
 	// --------------------------------
@@ -724,22 +791,18 @@ static void CB_accept_ipv4(struct ev_loop* loop, struct EVS_ev_server_t * server
 
 	// テールキューの最後にこの接続の情報を追加する
 	TAILQ_INSERT_TAIL(&EVS_client_tailq, client_watcher, entries);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INSERT_TAIL(client fd=%d): OK.\n", __func__, client_watcher->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): TAILQ_INSERT_TAIL(client fd=%d): OK.\n", __func__, client_watcher->socket_fd);
 
 	// ----------------
 	// クライアント別設定用構造体ポインタのI/O監視オブジェクトに対して、コールバック処理とソケットファイルディスクリプタ、そしてイベントのタイプを設定する
 	// ----------------
 	ev_io_init(&client_watcher->io_watcher, CB_recv, client_watcher->socket_fd, EV_READ);
 	ev_io_start(loop, &client_watcher->io_watcher);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_io_init(CB_recv, client fd=%d, EV_READ): OK.\n", __func__, client_watcher->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_io_start(): OK. Priority=%d\n", __func__, ev_priority(&client_watcher->io_watcher));
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): ev_io_init(CB_recv, client fd=%d, EV_READ): OK.\n", __func__, client_watcher->socket_fd);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): ev_io_start(): OK. Priority=%d\n", __func__, ev_priority(&client_watcher->io_watcher));
 
 	// 標準ログに出力
-	snprintf(log_str, MAX_LOG_LENGTH, "Client %s Connected.\n", client_watcher->addr_str);
-	logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "Client %s Connected.\n", client_watcher->addr_str);
 
 	// 戻る
 	return;
@@ -765,22 +828,19 @@ static void CB_accept_unix(struct ev_loop* loop, struct EVS_ev_server_t * server
 	if (socket_result < 0)
 	{
 		// ここでもソケットをクローズをしたほうがいいかな？それともソケットを再設定したほうがいいかな？
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Cannot socket accepting? Total=%d, errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_connect_num, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): Cannot socket accepting? Total=%d, errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_connect_num, errno, strerror(errno));
 		return;
 	}
 	// クライアント接続数を設定
 	EVS_connect_num ++;
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): OK. client fd=%d, Total=%d\n", __func__, server_watcher->socket_fd, socket_result, EVS_connect_num);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(fd=%d): OK. client fd=%d, Total=%d\n", __func__, server_watcher->socket_fd, socket_result, EVS_connect_num);
 
 	// クライアント別設定用構造体ポインタのメモリ領域を確保
 	client_watcher = (struct EVS_ev_client_t *)calloc(1, sizeof(struct EVS_ev_client_t));
 	// メモリ領域が確保できなかったら
 	if (client_watcher == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): Cannot calloc client_watcher's memory? errno=%d (%s)\n", __func__, server_watcher->socket_fd, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): Cannot calloc client_watcher's memory? errno=%d (%s)\n", __func__, server_watcher->socket_fd, errno, strerror(errno));
 		return;
 	}
 
@@ -789,8 +849,7 @@ static void CB_accept_unix(struct ev_loop* loop, struct EVS_ev_server_t * server
 
 	// アドレスを文字列として格納
 	strcpy(client_watcher->addr_str, "UNIX DOMAIN SOCKET");
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): inet_ntop(PF_UNIX): Client address=%s\n", __func__, client_watcher->addr_str);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): inet_ntop(PF_UNIX): Client address=%s\n", __func__, client_watcher->addr_str);
 
 	// ----------------
 	// 無通信タイムアウトチェックをする(=1:有効)なら
@@ -799,8 +858,7 @@ static void CB_accept_unix(struct ev_loop* loop, struct EVS_ev_server_t * server
 	{
 		ev_now_update(loop);                                                // イベントループの日時を現在の日時に更新
 		client_watcher->last_activity = ev_now(loop);                       // 最終アクティブ日時(監視対象が最後にアクティブとなった=タイマー更新した日時)を設定する
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): last_activity=%.0f\n", __func__, client_watcher->socket_fd, client_watcher->last_activity);
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): last_activity=%.0f\n", __func__, client_watcher->socket_fd, client_watcher->last_activity);
 	}
 
 	// --------------------------------
@@ -813,22 +871,18 @@ static void CB_accept_unix(struct ev_loop* loop, struct EVS_ev_server_t * server
 
 	// テールキューの最後にこの接続の情報を追加する
 	TAILQ_INSERT_TAIL(&EVS_client_tailq, client_watcher, entries);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INSERT_TAIL(client fd=%d): OK.\n", __func__, client_watcher->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): TAILQ_INSERT_TAIL(client fd=%d): OK.\n", __func__, client_watcher->socket_fd);
 
 	// ----------------
 	// クライアント別設定用構造体ポインタのI/O監視オブジェクトに対して、コールバック処理とソケットファイルディスクリプタ、そしてイベントのタイプを設定する
 	// ----------------
 	ev_io_init(&client_watcher->io_watcher, CB_recv, client_watcher->socket_fd, EV_READ);
 	ev_io_start(loop, &client_watcher->io_watcher);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_io_init(CB_recv, client fd=%d, EV_READ): OK.\n", __func__, client_watcher->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_io_start(): OK. Priority=%d\n", __func__, ev_priority(&client_watcher->io_watcher));
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): ev_io_init(CB_recv, client fd=%d, EV_READ): OK.\n", __func__, client_watcher->socket_fd);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): ev_io_start(): OK. Priority=%d\n", __func__, ev_priority(&client_watcher->io_watcher));
 
 	// 標準ログに出力
-	snprintf(log_str, MAX_LOG_LENGTH, "Client %s Connected.\n", client_watcher->addr_str);
-	logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "Client %s Connected.\n", client_watcher->addr_str);
 
 	// 戻る
 	return;
@@ -845,8 +899,7 @@ static void CB_accept(struct ev_loop* loop, struct ev_io *watcher, int revents)
 	// イベントにエラーフラグが含まれていたら
 	if (EV_ERROR & revents)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Invalid event!?\n", __func__);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Invalid event!?\n", __func__);
 		// アイドルイベント開始(メッセージ用キュー処理)
 		ev_idle_start(loop, &idle_message_watcher);
 		// 戻る
@@ -862,8 +915,7 @@ static void CB_accept(struct ev_loop* loop, struct ev_io *watcher, int revents)
 		// ----------------
 		// IPv6ソケットの初期化
 		// ----------------
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): CB_accept_ipv6(): Go!\n", __func__);              // 呼ぶ前にログを出力
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): CB_accept_ipv6(): Go!\n", __func__);              // 呼ぶ前にログを出力
 		CB_accept_ipv6(loop, server_watcher, revents);                          // IPv6ソケットのアクセプト処理
 
 		// アイドルイベント開始(メッセージ用キュー処理)
@@ -877,8 +929,7 @@ static void CB_accept(struct ev_loop* loop, struct ev_io *watcher, int revents)
 		// ----------------
 		// IPv4ソケットの初期化
 		// ----------------
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): CB_accept_ipv4(): Go!\n", __func__);              // 呼ぶ前にログを出力
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): CB_accept_ipv4(): Go!\n", __func__);              // 呼ぶ前にログを出力
 		CB_accept_ipv4(loop, server_watcher, revents);                          // IPv4ソケットのアクセプト処理
 
 		// アイドルイベント開始(メッセージ用キュー処理)
@@ -892,8 +943,7 @@ static void CB_accept(struct ev_loop* loop, struct ev_io *watcher, int revents)
 		// ----------------
 		// UNIXドメインソケットの初期化
 		// ----------------
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): CB_accept_unix(): Go!\n", __func__);              // 呼ぶ前にログを出力
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): CB_accept_unix(): Go!\n", __func__);              // 呼ぶ前にログを出力
 		CB_accept_unix(loop, server_watcher, revents);                          // UNIXドメインソケットのアクセプト処理
 
 		// アイドルイベント開始(メッセージ用キュー処理)
@@ -902,8 +952,7 @@ static void CB_accept(struct ev_loop* loop, struct ev_io *watcher, int revents)
 		return;
 	}
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot support protocol family!? 2\n", __func__);
-	logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot support protocol family!? 2\n", __func__);
 
 	// アイドルイベント開始(メッセージ用キュー処理)
 	ev_idle_start(loop, &idle_message_watcher);
@@ -52,34 +52,34 @@ void CLOSE_pgsql(struct ev_loop* loop, struct ev_io *watcher, int revents)
 	struct timeval                  system_tv;
 	struct tm                       *system_tm;
 
+	// 接続先ホスト接続終了処理(応答待ちのまま閉じたなら、応答待ちの問い合わせ数を戻す)
+	API_balance_close(this_pgsql);
+	// プール接続終了処理(プールからの削除と、クライアントとの紐づけの解除)
+	API_pool_close(this_pgsql);
+
 	// この接続のソケットを閉じる
 	socket_result = close(this_pgsql->socket_fd);
 	// ソケットのクローズ結果がエラーだったら
 	if (socket_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): close(): Cannot socket close? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(pgsql=%d): close(): Cannot socket close? errno=%d (%s)\n", __func__, this_pgsql->socket_fd, errno, strerror(errno));
 		return;
 	}
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): close(): OK.\n", __func__, this_pgsql->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(pgsql=%d): close(): OK.\n", __func__, this_pgsql->socket_fd);
 
 	// PostgreSQL用テールキューからこの接続の情報を削除する
 	TAILQ_REMOVE(&EVS_pgsql_tailq, this_pgsql, entries);
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): TAILQ_REMOVE(EVS_client_tailq): OK.\n", __func__, this_pgsql->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): TAILQ_REMOVE(EVS_client_tailq): OK.\n", __func__, this_pgsql->socket_fd);
 
 	// この接続のイベントを停止する
 	ev_io_stop(loop, &this_pgsql->io_watcher);
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(pgsql=%d): ev_io_stop(): OK.\n", __func__, this_pgsql->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(pgsql=%d): ev_io_stop(): OK.\n", __func__, this_pgsql->socket_fd);
 
 	// 標準ログに出力
-	snprintf(log_str, MAX_LOG_LENGTH, "PostgreSQL(%s) Close.\n", db_info->hostname);
-	logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "PostgreSQL(%s) Close.\n", db_info->hostname);
 
 	// この接続のPostgreSQL用拡張構造体のメモリ領域を開放する
 	free(this_pgsql);
@@ -103,6 +103,21 @@ void CLOSE_client(struct ev_loop* loop, struct ev_io *watcher, int revents)
 	// --------------------------------
 	// 各種API関連
 	// --------------------------------
+	// COPY中継終了処理(COPYの途中で切れたなら、そこまでの結果を出力する)
+	API_copy_close(this_client);
+	// キャプチャ終了処理
+	API_capture_close(this_client);
+	// ログサンプリング終了処理(保留中の問い合わせサイクルは、エラーならキューに入れて、それ以外は捨てる)
+	API_sample_close(this_client);
+	// セッション別解析情報解放依頼処理(メッセージ用キューの解析が追いついたら解放される)
+	API_session_close(this_client);
+	// プール接続返却処理(PostgreSQLとの接続は、リセットしてプールに戻すか閉じる)
+	API_pool_release(this_client);
+	// CancelRequest用キー索引削除処理
+	API_cancel_close(this_client);
+	// 経路表クライアント終了処理(ワイルドカードの設定から作った設定を、使われなくなったら開放するため)
+	API_route_leave(this_client);
+
 	// SSLハンドシェイク中、もしくはSSL接続中なら
 	if (this_client->ssl_status != 0)
 	{
@@ -110,8 +125,7 @@ void CLOSE_client(struct ev_loop* loop, struct ev_io *watcher, int revents)
 		// OpenSSL(SSL_free : SSL接続情報のメモリ領域を開放)
 		// ----------------
 		SSL_free(this_client->ssl);
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): SSL_free(): OK.\n", __func__, this_client->socket_fd);
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): SSL_free(): OK.\n", __func__, this_client->socket_fd);
 	}
 
 	// この接続のソケットを閉じる
@@ -119,28 +133,23 @@ void CLOSE_client(struct ev_loop* loop, struct ev_io *watcher, int revents)
 	// ソケットのクローズ結果がエラーだったら
 	if (socket_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): close(): Cannot socket close? errno=%d (%s)\n", __func__, this_client->socket_fd, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(fd=%d): close(): Cannot socket close? errno=%d (%s)\n", __func__, this_client->socket_fd, errno, strerror(errno));
 		return;
 	}
 	// クライアント接続数を設定
 	EVS_connect_num --;
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): close(): OK. Total=%d\n", __func__, this_client->socket_fd, EVS_connect_num);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(fd=%d): close(): OK. Total=%d\n", __func__, this_client->socket_fd, EVS_connect_num);
 
 	// クライアント用テールキューからこの接続の情報を削除する
 	TAILQ_REMOVE(&EVS_client_tailq, this_client, entries);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): TAILQ_REMOVE(EVS_client_tailq): OK.\n", __func__, this_client->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): TAILQ_REMOVE(EVS_client_tailq): OK.\n", __func__, this_client->socket_fd);
 
 	// この接続のイベントを停止する
 	ev_io_stop(loop, &this_client->io_watcher);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(fd=%d): ev_io_stop(): OK.\n", __func__, this_client->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(fd=%d): ev_io_stop(): OK.\n", __func__, this_client->socket_fd);
 
 	// 標準ログに出力
-	snprintf(log_str, MAX_LOG_LENGTH, "Client(%s) Close.\n", this_client->addr_str);
-	logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "Client(%s) Close.\n", this_client->addr_str);
 
 	// この接続のクライアント用拡張構造体のメモリ領域を開放する
 	free(this_client);
@@ -186,8 +195,7 @@ int CLOSE_all(void)
 		TAILQ_REMOVE(&EVS_pgsql_tailq, pgsql_watcher, entries);
 		free(pgsql_watcher);
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_REMOVE(EVS_pgsql_tailq): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): TAILQ_REMOVE(EVS_pgsql_tailq): OK.\n", __func__);
 
 	// --------------------------------
 	// クライアント別クローズ処理
@@ -208,14 +216,14 @@ int CLOSE_all(void)
 		TAILQ_REMOVE(&EVS_client_tailq, client_watcher, entries);
 		free(client_watcher);
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_REMOVE(EVS_client_tailq): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): TAILQ_REMOVE(EVS_client_tailq): OK.\n", __func__);
 
 	// --------------------------------
 	// メッセージ別クローズ処理
 	// --------------------------------
 	// メッセージ用テールキューをすべて削除
-	while (!TAILQ_EMPTY(&EVS_message_tailq))
+	// (スプールに残っているメッセージも読み込んで、セッション別解析情報を解放する)
+	while (!TAILQ_EMPTY(&EVS_message_tailq) || API_spool_load() > 0)
 	{
 		// メッセージ情報を取得
 		message_info = TAILQ_FIRST(&EVS_message_tailq);
@@ -224,14 +232,19 @@ int CLOSE_all(void)
 		{
 			// メッセージ解析処理
 		
+			// メッセージの方向が100:セッション終了なら
+			if (message_info->from_to == 100)
+			{
+				// セッション別解析情報解放処理
+				API_session_free(message_info);
+			}
 			// メッセージ用キューを削除
-			TAILQ_REMOVE(&EVS_message_tailq, message_info, entries);
+			API_spool_remove(message_info);
 			free(message_info->message_ptr);
 			free(message_info);
 		}
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_REMOVE(EVS_message_tailq): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): TAILQ_REMOVE(EVS_message_tailq): OK.\n", __func__);
 
 	// --------------------------------
 	// サーバー別クローズ処理
@@ -246,8 +259,7 @@ int CLOSE_all(void)
 		// ソケットが閉じれなかったら
 		if (close_result < 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): close(fd=%d): Cannot socket close? errno=%d (%s)\n", __func__, server_watcher->socket_fd, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): close(fd=%d): Cannot socket close? errno=%d (%s)\n", __func__, server_watcher->socket_fd, errno, strerror(errno));
 			return -1;
 		}
 		// 該当ソケットのプロトコルファミリーがPF_UNIX(=UNIXドメインソケットなら
@@ -258,15 +270,12 @@ int CLOSE_all(void)
 			// UNIXドメインソケットアドレスが削除できなかったら
 			if (close_result < 0)
 			{
-				snprintf(log_str, MAX_LOG_LENGTH, "%s(): unlink(%s): Cannot unlink? errno=%d (%s)\n", __func__, server_watcher->socket_address.sa_un.sun_path, errno, strerror(errno));
-				logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+				LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): unlink(%s): Cannot unlink? errno=%d (%s)\n", __func__, server_watcher->socket_address.sa_un.sun_path, errno, strerror(errno));
 				return -1;
 			}
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): unlink(%s): OK.\n", __func__, server_watcher->socket_address.sa_un.sun_path);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): unlink(%s): OK.\n", __func__, server_watcher->socket_address.sa_un.sun_path);
 		}
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): close(fd=%d): OK.\n", __func__, server_watcher->socket_fd);
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): close(fd=%d): OK.\n", __func__, server_watcher->socket_fd);
 	}
 	// サーバー用テールキューをすべて削除
 	while (!TAILQ_EMPTY(&EVS_server_tailq))
@@ -275,12 +284,17 @@ int CLOSE_all(void)
 		TAILQ_REMOVE(&EVS_server_tailq, server_watcher, entries);
 		free(server_watcher);
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_REMOVE(EVS_server_tailq): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): TAILQ_REMOVE(EVS_server_tailq): OK.\n", __func__);
 
 	// --------------------------------
 	// データベース別クローズ処理
 	// --------------------------------
+	// 接続先ホスト終了処理、経路表終了処理(データベース別設定を開放する前に)
+	API_balance_end();
+	API_pgsql_end();
+	API_admit_end();
+	API_cancel_end();
+	API_route_close();
 	// データベース用テールキューをすべて削除
 	while (!TAILQ_EMPTY(&EVS_db_tailq))
 	{
@@ -288,8 +302,7 @@ int CLOSE_all(void)
 		TAILQ_REMOVE(&EVS_db_tailq, db_list, entries);
 		free(db_list);
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_REMOVE(EVS_db_tailq): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): TAILQ_REMOVE(EVS_db_tailq): OK.\n", __func__);
 
 	// --------------------------------
 	// ポート別クローズ処理
@@ -301,8 +314,7 @@ int CLOSE_all(void)
 		TAILQ_REMOVE(&EVS_port_tailq, listen_port, entries);
 		free(listen_port);
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_REMOVE(EVS_port_tailq): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): TAILQ_REMOVE(EVS_port_tailq): OK.\n", __func__);
 
 	// --------------------------------
 	// libev関連終了処理 ※タイマー用に確保したメモリ領域のfree()を忘れずに
@@ -314,8 +326,7 @@ int CLOSE_all(void)
 		TAILQ_REMOVE(&EVS_timer_tailq, timeout_watcher, entries);
 		free(timeout_watcher);
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_REMOVE(EVS_timer_tailq): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): TAILQ_REMOVE(EVS_timer_tailq): OK.\n", __func__);
 
 	// --------------------------------
 	// 各種設定関連終了処理 ※設定用に確保した文字列のメモリ領域のfree()を忘れずに
@@ -336,6 +347,10 @@ int CLOSE_all(void)
 	{
 		free(EVS_config.ssl_key_file);
 	}
+	if (EVS_config.config_file != NULL)
+	{
+		free(EVS_config.config_file);
+	}
 
 	// --------------------------------
 	// PIDファイル処理
@@ -345,13 +360,11 @@ int CLOSE_all(void)
 	// PIDファイルが削除できなかったら
 	if (close_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): unlink(%s): Cannot unlink? errno=%d (%s)\n", __func__, EVS_config.pid_file, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): unlink(%s): Cannot unlink? errno=%d (%s)\n", __func__, EVS_config.pid_file, errno, strerror(errno));
 		free(EVS_config.pid_file);
 		return -1;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): unlink(%s): OK.\n", __func__, EVS_config.pid_file);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): unlink(%s): OK.\n", __func__, EVS_config.pid_file);
 	free(EVS_config.pid_file);
 
 	// 戻る
@@ -51,8 +51,7 @@ char *config_str_cleaner(char *target, int target_len)
 	// メモリ領域が確保できなかったら
 	if (dest_pos == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 		return dest_pos;
 	}
 
@@ -98,6 +97,160 @@ char *config_str_cleaner(char *target, int target_len)
 	return dest_pos;
 }
 
+// --------------------------------
+// ログ種別文字列の変換("SYSTEM|QUERY"や"ALL"を、ログ種別のビットマスクにする。-1:知らないログ種別がある)
+// --------------------------------
+static int config_log_events(char *value_str)
+{
+	char                            *event_str;
+	char                            *save_ptr;
+	int                             log_event;
+	int                             log_events = 0;
+
+	for (event_str = strtok_r(value_str, "|", &save_ptr); event_str != NULL; event_str = strtok_r(NULL, "|", &save_ptr))
+	{
+		if (strcasecmp(event_str, "ALL") == 0)
+		{
+			log_events |= (1 << LOG_EVENT_MAX) - 1;
+			continue;
+		}
+		for (log_event = 0; log_event < LOG_EVENT_MAX; log_event ++)
+		{
+			if (strcasecmp(event_str, logevent_list[log_event]) == 0)
+			{
+				log_events |= (1 << log_event);
+				break;
+			}
+		}
+		if (log_event == LOG_EVENT_MAX)
+		{
+			return -1;
+		}
+	}
+	return log_events;
+}
+
+// --------------------------------
+// 設定値文字列の取得(ブランク文字を削除しない。SQL文など、空白に意味がある設定値用)
+// --------------------------------
+// 「=」の後ろから、前後のブランク文字だけを取り除いてvalue_strにコピーする(value_strは、targetと同じ長さを確保しておくこと)
+static void config_str_rawvalue(const char *target, char *value_str)
+{
+	const char                      *src_pos = strchr(target, '=');
+	size_t                          value_len;
+
+	if (src_pos == NULL)
+	{
+		value_str[0] = '\0';
+		return;
+	}
+	for (src_pos += 1; *src_pos != '\0' && (isspace(*src_pos) || isblank(*src_pos)); src_pos ++)
+	{
+	}
+	value_len = strlen(src_pos);
+	while (value_len > 0 && (isspace(src_pos[value_len - 1]) || isblank(src_pos[value_len - 1])))
+	{
+		value_len --;
+	}
+	memcpy(value_str, src_pos, value_len);
+	value_str[value_len] = '\0';
+}
+
+// --------------------------------
+// PostgreSQL設定のプール設定、振り分け設定の変換("Session"、"Transaction"、"MinIdle=N"、"MaxSize=N"、"Balance=xxx"、"Split"。-1:プール設定、振り分け設定ではない)
+// --------------------------------
+static int config_db_option(struct EVS_db_t *db_list, const char *option_str)
+{
+	if (strcasecmp(option_str, "SESSION") == 0)
+	{
+		db_list->pool_mode = 0;                                         // セッション単位
+	}
+	else if (strcasecmp(option_str, "TRANSACTION") == 0)
+	{
+		db_list->pool_mode = 1;                                         // トランザクション単位
+	}
+	else if (strncasecmp(option_str, "MINIDLE=", 8) == 0 && atoi(option_str + 8) >= 0)
+	{
+		db_list->pool_min = atoi(option_str + 8);
+	}
+	else if (strncasecmp(option_str, "MAXSIZE=", 8) == 0 && atoi(option_str + 8) >= 0)
+	{
+		db_list->pool_max = atoi(option_str + 8);
+	}
+	else if (strcasecmp(option_str, "BALANCE=ROUNDROBIN") == 0)
+	{
+		db_list->balance_mode = 0;                                      // ラウンドロビン
+	}
+	else if (strcasecmp(option_str, "BALANCE=LEASTREQUESTS") == 0)
+	{
+		db_list->balance_mode = 1;                                      // 応答待ちの問い合わせ数が最少
+	}
+	else if (strcasecmp(option_str, "BALANCE=LATENCY") == 0)
+	{
+		db_list->balance_mode = 2;                                      // 応答時間が最短
+	}
+	else if (strcasecmp(option_str, "SPLIT") == 0)
+	{
+		db_list->split_mode = 1;                                        // 読み書き分離(最初のホストがプライマリ、残りがレプリカ)
+	}
+	else
+	{
+		return -1;
+	}
+	return 0;
+}
+
+// --------------------------------
+// PostgreSQL設定のホスト名の変換("|"区切りで複数のホスト。それぞれ"ホスト名:ポート番号"でもよい。-1:ホストがない、多すぎる)
+// --------------------------------
+// ":"が二つ以上あればIPv6アドレスとみなして、ポート番号は付いていないことにする
+static int config_db_hosts(struct EVS_db_t *db_list, const char *host_str, const char *service_str)
+{
+	const char                      *host_ptr;                          // ホストの先頭ポインタ
+	const char                      *end_ptr;                           // ホストの終わり("|"か'\0')のポインタ
+	const char                      *port_ptr;                          // ":"のポインタ
+	char                            hostname[128];                      // ホスト名
+	char                            servicename[16];                    // サービス名(ポート番号)
+	struct EVS_host_t               *this_host;
+
+	db_list->host_num = 0;
+	for (host_ptr = host_str; *host_ptr != '\0'; host_ptr = (*end_ptr == '|') ? end_ptr + 1 : end_ptr)
+	{
+		end_ptr = strchr(host_ptr, '|');
+		if (end_ptr == NULL)
+		{
+			end_ptr = host_ptr + strlen(host_ptr);
+		}
+		if (end_ptr == host_ptr)
+		{
+			continue;
+		}
+		if (db_list->host_num >= MAX_DB_HOST_NUM)
+		{
+			return -1;
+		}
+		port_ptr = memchr(host_ptr, ':', end_ptr - host_ptr);
+		if (port_ptr != NULL && memchr(port_ptr + 1, ':', end_ptr - port_ptr - 1) == NULL)
+		{
+			snprintf(hostname, sizeof(hostname), "%.*s", (int)(port_ptr - host_ptr), host_ptr);
+			snprintf(servicename, sizeof(servicename), "%.*s", (int)(end_ptr - port_ptr - 1), port_ptr + 1);
+		}
+		else
+		{
+			snprintf(hostname, sizeof(hostname), "%.*s", (int)(end_ptr - host_ptr), host_ptr);
+			snprintf(servicename, sizeof(servicename), "%s", service_str);
+		}
+		// 接続先ホスト別構造体取得処理(同じホストの設定があれば、状態を共有する)
+		this_host = API_balance_host(hostname, servicename);
+		if (this_host == NULL)
+		{
+			return -1;
+		}
+		db_list->host_list[db_list->host_num ++] = this_host;
+	}
+	return (db_list->host_num > 0) ? 0 : -1;
+}
+
 // --------------------------------
 // 設定用文字列の変換(パラメータ名別に設定値の取得。変換後の文字列は不要になったら破棄:free()すること)
 // --------------------------------
@@ -118,8 +271,7 @@ int config_str_convert(char *target, int target_len)
 	// メモリ領域が確保できなかったら
 	if (key_str == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 		return -1;
 	}
 
@@ -128,8 +280,7 @@ int config_str_convert(char *target, int target_len)
 	// メモリ領域が確保できなかったら
 	if (value_str == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 		// 設定値名のメモリ領域は不要になったので破棄
 		free(key_str);
 		return -1;
@@ -140,16 +291,14 @@ int config_str_convert(char *target, int target_len)
 	// 文字列変換ができなかったら
 	if (changed_str == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot clearning string!?\n", __func__);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot clearning string!?\n", __func__);
 		// 設定値名のメモリ領域は不要になったので破棄
 		free(key_str);
 		// 設定値のメモリ領域は不要になったので破棄
 		free(value_str);
 		return -1;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): OK %s\n", __func__, changed_str); 
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): OK %s\n", __func__, changed_str);
 	
 	// 整理出来たら、設定値名と設定値に変換、その1
 	init_result = sscanf(changed_str, "%[^=]=%s", key_str, value_str);
@@ -158,8 +307,7 @@ int config_str_convert(char *target, int target_len)
 	// 変換数が2ではないなら
 	if (init_result != 2)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot get key_str and value_str!? %d %s\n", __func__, init_result, key_str);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot get key_str and value_str!? %d %s\n", __func__, init_result, key_str);
 		// 設定値名のメモリ領域は不要になったので破棄
 		free(key_str);
 		// 設定値のメモリ領域は不要になったので破棄
@@ -180,15 +328,13 @@ int config_str_convert(char *target, int target_len)
 		{
 			// デーモンモードを1:ONに設定
 			EVS_config.daemon = 1;
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): DAEMON=%d\n", __func__, EVS_config.daemon);
-			logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): DAEMON=%d\n", __func__, EVS_config.daemon);
 			}
 		else
 		{
 			// デーモンモードを0:OFFに設定
 			EVS_config.daemon = 0;
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): DAEMON=%d\n", __func__, EVS_config.daemon);
-			logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): DAEMON=%d\n", __func__, EVS_config.daemon);
 		}
 	}
 	// ----------------
@@ -201,8 +347,7 @@ int config_str_convert(char *target, int target_len)
 		// メモリ領域が確保できなかったら
 		if (EVS_config.pid_file == NULL)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot realloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot realloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 			// 設定値名のメモリ領域は不要になったので破棄
 			free(key_str);
 			// 設定値のメモリ領域は不要になったので破棄
@@ -211,8 +356,7 @@ int config_str_convert(char *target, int target_len)
 		}
 		// PIDファイルを設定
 		memcpy((void *)EVS_config.pid_file, (void *)value_str, strlen(value_str));
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): PidFile=%s\n", __func__, EVS_config.pid_file);
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): PidFile=%s\n", __func__, EVS_config.pid_file);
 	}
 	// ----------------
 	// ログファイル設定なら
@@ -224,27 +368,41 @@ int config_str_convert(char *target, int target_len)
 		// メモリ領域が確保できなかったら
 		if (EVS_config.log_file == NULL)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot realloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot realloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 			// 設定値名のメモリ領域は不要になったので破棄
 			free(key_str);
 			// 設定値のメモリ領域は不要になったので破棄
 			free(value_str);
 			return -1;
 		}
-		// ログファイルが開いていたら(この時点ではスタートアップログファイルが開いているはず)
-		if (EVS_log_fd != 0)
-		{
-			// 既存のログファイルへバッファをフラッシュする
-			fsync(EVS_log_fd);
-			// 既存のログファイルを閉じる
-			EVS_log_fd = close(EVS_log_fd);
-			// ここでもしclose()の返り値が0以外なら、エラーとしてプログラムを終了するべきか？
-		}
+		// ログファイルが開いていたら(この時点ではスタートアップログファイルが開いているはず)、ログバッファに残っているログを既存のログファイルへ書き出して閉じる
+		log_close();
 		// ログファイルを設定
 		memcpy((void *)EVS_config.log_file, (void *)value_str, strlen(value_str));
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): LogFile=%s\n", __func__, EVS_config.log_file);
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): LogFile=%s\n", __func__, EVS_config.log_file);
+	}
+	// ----------------
+	// ダンプファイル設定なら
+	// ----------------
+	else if (strcmp("DUMPFILE", key_str) == 0)
+	{
+		// 設定値文字列のメモリ領域を確保(+ 1バイトを忘れずに!!)
+		EVS_config.dump_file = (char *)realloc((void *)EVS_config.dump_file, strlen(value_str) + 1);
+		// メモリ領域が確保できなかったら
+		if (EVS_config.dump_file == NULL)
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot realloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
+			// 設定値名のメモリ領域は不要になったので破棄
+			free(key_str);
+			// 設定値のメモリ領域は不要になったので破棄
+			free(value_str);
+			return -1;
+		}
+		// ダンプファイルが開いていたら、閉じる(次のダンプ出力で新しいダンプファイルを開く)
+		dump_reopen();
+		// ダンプファイルを設定
+		memcpy((void *)EVS_config.dump_file, (void *)value_str, strlen(value_str) + 1);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): DumpFile=%s\n", __func__, EVS_config.dump_file);
 	}
 	// ----------------
 	// ログレベル設定なら
@@ -253,8 +411,62 @@ int config_str_convert(char *target, int target_len)
 	{
 		// ログレベルを設定(0:DEBUG, 1:INFO, 2:WARN, 3:ERROR)
 		EVS_config.log_level = atoi(value_str);
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): log_level=%d\n", __func__, atoi(value_str));
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): log_level=%d\n", __func__, atoi(value_str));
+	}
+	// ----------------
+	// ログ書き出し統計の出力間隔設定なら
+	// ----------------
+	else if (strcmp("LOGSTAT_INTERVAL", key_str) == 0)
+	{
+		// ログ書き出し統計の出力間隔(秒)を設定
+		EVS_config.logstat_intval = (ev_tstamp)atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): LogStat Interval=%f\n", __func__, (ev_tstamp)atoi(value_str));
+	}
+	// ----------------
+	// ログファイルの形式設定なら
+	// ----------------
+	else if (strcmp("LOGFORMAT", key_str) == 0)
+	{
+		// ログファイルの形式を設定(0:テキスト, 1:バイナリイベントログ)
+		EVS_config.log_format = atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): LogFormat=%d\n", __func__, atoi(value_str));
+	}
+	// ----------------
+	// ログファイルに出力するログ種別設定なら
+	// ----------------
+	else if (strcmp("LOGTYPE", key_str) == 0)
+	{
+		// ログファイルに出力するログ種別を設定(SYSTEM, QUERY, DUMPを"|"で区切る。ALL:全部)
+		EVS_config.log_events = config_log_events(value_str);
+		if (EVS_config.log_events == -1)
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Unknown LogType!? %s\n", __func__, value_str);
+			// 設定値名のメモリ領域は不要になったので破棄
+			free(key_str);
+			// 設定値のメモリ領域は不要になったので破棄
+			free(value_str);
+			return -1;
+		}
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): LogType=0x%x\n", __func__, EVS_config.log_events);
+	}
+	// ----------------
+	// ログ出力先の追加なら
+	// ----------------
+	else if (strcmp("LOGSINK", key_str) == 0)
+	{
+		// 設定値を個別に変換(名前, ログレベル, ログ種別, ログファイル名)
+		init_result = sscanf(value_str, "%[^,],%[^,],%[^,],%s", value[0], value[1], value[2], value[3]);
+		// 変換数が4ではないか、ログ種別が変換できないか、ログ出力先が追加できないなら
+		if (init_result != 4 || (init_result = config_log_events(value[2])) == -1 || log_sink_add(value[0], atoi(value[1]), init_result, value[3]) != 0)
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot add LogSink!? %s\n", __func__, value_str);
+			// 設定値名のメモリ領域は不要になったので破棄
+			free(key_str);
+			// 設定値のメモリ領域は不要になったので破棄
+			free(value_str);
+			return -1;
+		}
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): LogSink=%.32s, level=%d, type=0x%x, file=%.256s\n", __func__, value[0], atoi(value[1]), init_result, value[3]);
 	}
 	// ----------------
 	// UNIXドメインソケットファイル設定なら
@@ -266,8 +478,7 @@ int config_str_convert(char *target, int target_len)
 		// メモリ領域が確保できなかったら
 		if (EVS_config.domain_socketfile == NULL)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot realloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot realloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 			// 設定値名のメモリ領域は不要になったので破棄
 			free(key_str);
 			// 設定値のメモリ領域は不要になったので破棄
@@ -276,8 +487,7 @@ int config_str_convert(char *target, int target_len)
 		}
 		// UNIXドメインソケットファイルを設定
 		memcpy((void *)EVS_config.domain_socketfile, (void *)value_str, strlen(value_str));
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): SocketFile=%s\n", __func__, EVS_config.domain_socketfile);
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): SocketFile=%s\n", __func__, EVS_config.domain_socketfile);
 	}
 	// ----------------
 	// SSL/TLS対応設定なら
@@ -289,15 +499,13 @@ int config_str_convert(char *target, int target_len)
 		{
 			// SSL/TLS対応を1:ONに設定
 			EVS_config.ssl_support = 1;
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): SSL/TLS=%d\n", __func__, EVS_config.ssl_support);
-			logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): SSL/TLS=%d\n", __func__, EVS_config.ssl_support);
 		}
 		else
 		{
 			// SSL/TLS対応を0:OFFに設定
 			EVS_config.ssl_support = 0;
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): SSL/TLS=%d\n", __func__, EVS_config.ssl_support);
-			logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): SSL/TLS=%d\n", __func__, EVS_config.ssl_support);
 		}
 	}
 	// ----------------
@@ -310,8 +518,7 @@ int config_str_convert(char *target, int target_len)
 		// メモリ領域が確保できなかったら
 		if (EVS_config.ssl_ca_file == NULL)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 			// 設定値名のメモリ領域は不要になったので破棄
 			free(key_str);
 			// 設定値のメモリ領域は不要になったので破棄
@@ -319,8 +526,7 @@ int config_str_convert(char *target, int target_len)
 			return -1;
 		}
 		memcpy((void *)EVS_config.ssl_ca_file, (void *)value_str, strlen(value_str));
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): SSL/TLS CA_FILE=%s\n", __func__, EVS_config.ssl_ca_file); 
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): SSL/TLS CA_FILE=%s\n", __func__, EVS_config.ssl_ca_file);
 	}
 	// ----------------
 	// SSL/TLS CERTファイル設定なら
@@ -332,8 +538,7 @@ int config_str_convert(char *target, int target_len)
 		// メモリ領域が確保できなかったら
 		if (EVS_config.ssl_cert_file == NULL)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 			// 設定値名のメモリ領域は不要になったので破棄
 			free(key_str);
 			// 設定値のメモリ領域は不要になったので破棄
@@ -341,8 +546,7 @@ int config_str_convert(char *target, int target_len)
 			return -1;
 		}
 		memcpy((void *)EVS_config.ssl_cert_file, (void *)value_str, strlen(value_str));
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): SSL/TLS CERT_FILE=%s\n", __func__, EVS_config.ssl_cert_file); 
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): SSL/TLS CERT_FILE=%s\n", __func__, EVS_config.ssl_cert_file);
 	}
 	// ----------------
 	// SSL/TLS KEYファイル設定なら
@@ -354,8 +558,7 @@ int config_str_convert(char *target, int target_len)
 		// メモリ領域が確保できなかったら
 		if (EVS_config.ssl_key_file == NULL)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 			// 設定値名のメモリ領域は不要になったので破棄
 			free(key_str);
 			// 設定値のメモリ領域は不要になったので破棄
@@ -363,8 +566,7 @@ int config_str_convert(char *target, int target_len)
 			return -1;
 		}
 		memcpy((void *)EVS_config.ssl_key_file, (void *)value_str, strlen(value_str));
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): SSL/TLS KEY_FILE=%s\n", __func__, EVS_config.ssl_key_file); 
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): SSL/TLS KEY_FILE=%s\n", __func__, EVS_config.ssl_key_file);
 	}
 	// ----------------
 	// 無通信タイムアウトチェック(0:無効、1:有効)設定なら
@@ -376,15 +578,13 @@ int config_str_convert(char *target, int target_len)
 		{
 			// 無通信タイムアウトチェックを1:ONに設定
 			EVS_config.nocommunication_check = 1;
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): No-Communication Check=%d\n", __func__, EVS_config.nocommunication_check);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): No-Communication Check=%d\n", __func__, EVS_config.nocommunication_check);
 		}
 		else
 		{
 			// 無通信タイムアウトチェックを0:OFFに設定
 			EVS_config.nocommunication_check = 0;
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): No-Communication Check=%d\n", __func__, EVS_config.nocommunication_check);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): No-Communication Check=%d\n", __func__, EVS_config.nocommunication_check);
 		}
 	}
 	// ----------------
@@ -394,8 +594,7 @@ int config_str_convert(char *target, int target_len)
 	{
 		// 無通信タイムアウト(秒)を設定
 		EVS_config.nocommunication_timeout = (ev_tstamp)atoi(value_str);
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): No-Communication Timeout=%f\n", __func__, (ev_tstamp)atoi(value_str));
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): No-Communication Timeout=%f\n", __func__, (ev_tstamp)atoi(value_str));
 	}
 	// ----------------
 	// タイマーイベント確認間隔(秒)設定なら
@@ -404,8 +603,7 @@ int config_str_convert(char *target, int target_len)
 	{
 		// タイマーイベント確認間隔(秒)を設定
 		EVS_config.timer_checkintval = (ev_tstamp)atoi(value_str);
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Timer Check Interval=%f\n", __func__, (ev_tstamp)atoi(value_str));
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): Timer Check Interval=%f\n", __func__, (ev_tstamp)atoi(value_str));
 	}
 	// ----------------
 	// TCP KeepAlive設定なら
@@ -417,15 +615,13 @@ int config_str_convert(char *target, int target_len)
 		{
 			// KeepAliveを1:ONに設定
 			EVS_config.keepalive = 1;
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): KeepAlive=%d\n", __func__, EVS_config.keepalive);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): KeepAlive=%d\n", __func__, EVS_config.keepalive);
 		}
 		else
 		{
 			// KeepAliveを1:ONに設定
 			EVS_config.keepalive = 0;
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): KeepAlive=%d\n", __func__, EVS_config.keepalive);
-			logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): KeepAlive=%d\n", __func__, EVS_config.keepalive);
 		}
 	}
 	// ----------------
@@ -435,8 +631,7 @@ int config_str_convert(char *target, int target_len)
 	{
 		// Keepalive Idletimeを設定
 		EVS_config.keepalive_idletime = atoi(value_str);
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Keepalive IdleTime=%d\n", __func__, atoi(value_str));
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): Keepalive IdleTime=%d\n", __func__, atoi(value_str));
 	}
 	// ----------------
 	// TCP KeepAlive Interval設定なら
@@ -445,8 +640,7 @@ int config_str_convert(char *target, int target_len)
 	{
 		// Keepalive Intervalを設定
 		EVS_config.keepalive_intval = atoi(value_str);
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Keepalive Interval=%d\n", __func__, atoi(value_str));
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): Keepalive Interval=%d\n", __func__, atoi(value_str));
 	}
 	// ----------------
 	// TCP KeepAlive Probes設定なら
@@ -455,8 +649,369 @@ int config_str_convert(char *target, int target_len)
 	{
 		// Keepalive Probesを設定
 		EVS_config.keepalive_probes = atoi(value_str);
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Keepalive Probes=%d\n", __func__, atoi(value_str));
-		logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): Keepalive Probes=%d\n", __func__, atoi(value_str));
+	}
+	// ----------------
+	// エラー集計の出力間隔(秒)設定なら
+	// ----------------
+	else if (strcmp("ERRORSTAT_INTERVAL", key_str) == 0)
+	{
+		// エラー集計の出力間隔(秒)を設定
+		EVS_config.errorstat_intval = (ev_tstamp)atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): ErrorStat Interval=%f\n", __func__, (ev_tstamp)atoi(value_str));
+	}
+	// ----------------
+	// エラー集計の警告件数設定なら
+	// ----------------
+	else if (strcmp("ERRORSTAT_WARNCOUNT", key_str) == 0)
+	{
+		// エラー集計の警告件数を設定
+		EVS_config.errorstat_warncount = atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): ErrorStat WarnCount=%d\n", __func__, atoi(value_str));
+	}
+	// ----------------
+	// 長時間トランザクションの警告時間設定なら
+	// ----------------
+	else if (strcmp("TRANSACTION_WARNTIME", key_str) == 0)
+	{
+		// 長時間トランザクションの警告時間(秒)を設定
+		EVS_config.transaction_warntime = (ev_tstamp)atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): Transaction WarnTime=%f\n", __func__, (ev_tstamp)atoi(value_str));
+	}
+	// ----------------
+	// COPY途中経過の出力間隔設定なら
+	// ----------------
+	else if (strcmp("COPYSTAT_INTERVAL", key_str) == 0)
+	{
+		// COPY途中経過の出力間隔(秒)を設定
+		EVS_config.copystat_intval = (ev_tstamp)atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): CopyStat Interval=%f\n", __func__, (ev_tstamp)atoi(value_str));
+	}
+	// ----------------
+	// キャプチャファイル設定なら
+	// ----------------
+	else if (strcmp("CAPTUREFILE", key_str) == 0)
+	{
+		// 設定値文字列のメモリ領域を確保(+ 1バイトを忘れずに!!)
+		EVS_config.capture_file = (char *)realloc((void *)EVS_config.capture_file, strlen(value_str) + 1);
+		// メモリ領域が確保できなかったら
+		if (EVS_config.capture_file == NULL)
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot realloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
+			// 設定値名のメモリ領域は不要になったので破棄
+			free(key_str);
+			// 設定値のメモリ領域は不要になったので破棄
+			free(value_str);
+			return -1;
+		}
+		// キャプチャファイルを設定
+		memcpy((void *)EVS_config.capture_file, (void *)value_str, strlen(value_str) + 1);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): CaptureFile=%s\n", __func__, EVS_config.capture_file);
+	}
+	// ----------------
+	// キャプチャファイルの大きさ設定なら
+	// ----------------
+	else if (strcmp("CAPTURESIZE", key_str) == 0)
+	{
+		// キャプチャファイルの大きさ(MB)を設定
+		EVS_config.capture_size = (size_t)atoi(value_str) * 1024 * 1024;
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): CaptureSize=%dMB\n", __func__, atoi(value_str));
+	}
+	// ----------------
+	// キャプチャするセッションの間隔設定なら
+	// ----------------
+	else if (strcmp("CAPTURESAMPLE", key_str) == 0)
+	{
+		// キャプチャするセッションの間隔を設定(1:全セッション, N:N個に一つ)
+		EVS_config.capture_sample = atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): CaptureSample=%d\n", __func__, atoi(value_str));
+	}
+	// ----------------
+	// スプールファイル設定なら
+	// ----------------
+	else if (strcmp("SPOOLFILE", key_str) == 0)
+	{
+		// 設定値文字列のメモリ領域を確保(+ 1バイトを忘れずに!!)
+		EVS_config.spool_file = (char *)realloc((void *)EVS_config.spool_file, strlen(value_str) + 1);
+		// メモリ領域が確保できなかったら
+		if (EVS_config.spool_file == NULL)
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot realloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
+			// 設定値名のメモリ領域は不要になったので破棄
+			free(key_str);
+			// 設定値のメモリ領域は不要になったので破棄
+			free(value_str);
+			return -1;
+		}
+		// スプールファイルを設定
+		memcpy((void *)EVS_config.spool_file, (void *)value_str, strlen(value_str) + 1);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): SpoolFile=%s\n", __func__, EVS_config.spool_file);
+	}
+	// ----------------
+	// スプールファイルの大きさ設定なら
+	// ----------------
+	else if (strcmp("SPOOLSIZE", key_str) == 0)
+	{
+		// スプールファイルの大きさ(MB)を設定
+		EVS_config.spool_size = (size_t)atoi(value_str) * 1024 * 1024;
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): SpoolSize=%dMB\n", __func__, atoi(value_str));
+	}
+	// ----------------
+	// スプールを始めるメッセージ用キューのメモリ量設定なら
+	// ----------------
+	else if (strcmp("SPOOLTHRESHOLD", key_str) == 0)
+	{
+		// スプールを始めるメッセージ用キューのメモリ量(MB)を設定
+		EVS_config.spool_threshold = (size_t)atoi(value_str) * 1024 * 1024;
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): SpoolThreshold=%dMB\n", __func__, atoi(value_str));
+	}
+	// ----------------
+	// スプール統計の出力間隔設定なら
+	// ----------------
+	else if (strcmp("SPOOLSTAT_INTERVAL", key_str) == 0)
+	{
+		// スプール統計の出力間隔(秒)を設定
+		EVS_config.spoolstat_intval = (ev_tstamp)atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): SpoolStat Interval=%f\n", __func__, (ev_tstamp)atoi(value_str));
+	}
+	// ----------------
+	// データベース別設定毎にプールする接続数設定なら
+	// ----------------
+	else if (strcmp("POOLSIZE", key_str) == 0)
+	{
+		// プールする接続の最大数を設定(0:プールしない)
+		EVS_config.pool_size = atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): PoolSize=%d\n", __func__, EVS_config.pool_size);
+	}
+	// ----------------
+	// プールに戻す時のリセット用の問い合わせ設定なら
+	// ----------------
+	else if (strcmp("POOLRESETQUERY", key_str) == 0)
+	{
+		// SQL文なので、ブランク文字を削除していない設定値を取得し直す
+		config_str_rawvalue(target, value_str);
+		// 設定値文字列のメモリ領域を確保(+ 1バイトを忘れずに!!)
+		EVS_config.pool_reset_query = (char *)realloc((void *)EVS_config.pool_reset_query, strlen(value_str) + 1);
+		// メモリ領域が確保できなかったら
+		if (EVS_config.pool_reset_query == NULL)
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot realloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
+			// 設定値名のメモリ領域は不要になったので破棄
+			free(key_str);
+			// 設定値のメモリ領域は不要になったので破棄
+			free(value_str);
+			return -1;
+		}
+		// リセット用の問い合わせを設定
+		memcpy((void *)EVS_config.pool_reset_query, (void *)value_str, strlen(value_str) + 1);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): PoolResetQuery=%s\n", __func__, EVS_config.pool_reset_query);
+	}
+	// ----------------
+	// プールで待機中の接続を閉じるまでの時間設定なら
+	// ----------------
+	else if (strcmp("POOLIDLETIMEOUT", key_str) == 0)
+	{
+		// プールで待機中の接続を閉じるまでの時間(秒)を設定(0:閉じない)
+		EVS_config.pool_idle_timeout = (ev_tstamp)atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): PoolIdleTimeout=%f\n", __func__, (ev_tstamp)atoi(value_str));
+	}
+	// ----------------
+	// プールの接続を待つクライアントを切断するまでの時間設定なら
+	// ----------------
+	else if (strcmp("POOLWAITTIMEOUT", key_str) == 0)
+	{
+		// プールの接続を待つクライアントを切断するまでの時間(秒)を設定(0:切断しない)
+		EVS_config.pool_wait_timeout = (ev_tstamp)atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): PoolWaitTimeout=%f\n", __func__, (ev_tstamp)atoi(value_str));
+	}
+	// ----------------
+	// 事前接続の間隔設定なら
+	// ----------------
+	else if (strcmp("POOLWARMJITTER", key_str) == 0)
+	{
+		// 事前接続の間隔の最大値(ミリ秒)を設定
+		EVS_config.pool_warm_jitter = (ev_tstamp)atoi(value_str) / 1000.;
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): PoolWarmJitter=%f\n", __func__, EVS_config.pool_warm_jitter);
+	}
+	// ----------------
+	// 接続先ホストの死活確認の間隔設定なら
+	// ----------------
+	else if (strcmp("HOSTPROBEINTERVAL", key_str) == 0)
+	{
+		// 接続先ホストの死活確認の間隔(秒)を設定(0:確認しない)
+		EVS_config.host_probe_intval = (ev_tstamp)atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): HostProbeInterval=%f\n", __func__, EVS_config.host_probe_intval);
+	}
+	// ----------------
+	// 接続先ホストの切り離し時間設定なら
+	// ----------------
+	else if (strcmp("HOSTEJECTTIME", key_str) == 0)
+	{
+		// 接続できなくなったホストを切り離す時間(秒)を設定
+		EVS_config.host_eject_time = (ev_tstamp)atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): HostEjectTime=%f\n", __func__, EVS_config.host_eject_time);
+	}
+	// ----------------
+	// 接続先ホストの戻し時間設定なら
+	// ----------------
+	else if (strcmp("HOSTRAMPTIME", key_str) == 0)
+	{
+		// 戻したホストへの割り振りを元に戻すまでの時間(秒)を設定(0:すぐに戻す)
+		EVS_config.host_ramp_time = (ev_tstamp)atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): HostRampTime=%f\n", __func__, EVS_config.host_ramp_time);
+	}
+	// ----------------
+	// 読み書き分離の統計の出力間隔設定なら
+	// ----------------
+	else if (strcmp("SPLITSTATINTERVAL", key_str) == 0)
+	{
+		// 読み書き分離の統計を出力する間隔(秒)を設定(0:出力しない)
+		EVS_config.splitstat_intval = (ev_tstamp)atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): SplitStatInterval=%f\n", __func__, EVS_config.splitstat_intval);
+	}
+	// ----------------
+	// PostgreSQLとの接続数の全体の上限設定なら
+	// ----------------
+	else if (strcmp("MAXBACKENDCONNECTIONS", key_str) == 0)
+	{
+		// PostgreSQLとの接続数の全体の上限を設定(0:無制限)
+		EVS_config.max_backend_conn = atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): MaxBackendConnections=%d\n", __func__, EVS_config.max_backend_conn);
+	}
+	// ----------------
+	// ワイルドカードの設定から作る設定の数の上限設定なら
+	// ----------------
+	else if (strcmp("MAXWILDCARDENTRIES", key_str) == 0)
+	{
+		// ワイルドカードの設定から作る設定の数の上限を設定(0:無制限)
+		EVS_config.max_wildcard_entries = atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): MaxWildcardEntries=%d\n", __func__, EVS_config.max_wildcard_entries);
+	}
+	// ----------------
+	// データベース名毎のPostgreSQLとの接続数の上限設定なら
+	// ----------------
+	else if (strcmp("MAXDATABASECONNECTIONS", key_str) == 0)
+	{
+		// データベース名毎のPostgreSQLとの接続数の上限を設定(0:無制限)
+		EVS_config.max_database_conn = atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): MaxDatabaseConnections=%d\n", __func__, EVS_config.max_database_conn);
+	}
+	// ----------------
+	// 接続の空きを待てるクライアント数の上限設定なら
+	// ----------------
+	else if (strcmp("ADMITQUEUELENGTH", key_str) == 0)
+	{
+		// 接続の空きを待てるクライアント数の全体の上限を設定(0:無制限)
+		EVS_config.admit_queue_length = atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): AdmitQueueLength=%d\n", __func__, EVS_config.admit_queue_length);
+	}
+	// ----------------
+	// 接続の受け入れ制御の統計の出力間隔設定なら
+	// ----------------
+	else if (strcmp("ADMITSTATINTERVAL", key_str) == 0)
+	{
+		// 接続の受け入れ制御の統計を出力する間隔(秒)を設定(0:出力しない)
+		EVS_config.admitstat_intval = (ev_tstamp)atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): AdmitStatInterval=%f\n", __func__, EVS_config.admitstat_intval);
+	}
+	// ----------------
+	// 全メッセージを解析するセッションの間隔設定なら
+	// ----------------
+	else if (strcmp("LOGSAMPLE_SESSION", key_str) == 0)
+	{
+		// 全メッセージを解析するセッションの間隔を設定(1:全セッション, N:N個に一つ)
+		EVS_config.logsample_session = atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): LogSample Session=%d\n", __func__, atoi(value_str));
+	}
+	// ----------------
+	// フィンガープリント別に解析する問い合わせの間隔設定なら
+	// ----------------
+	else if (strcmp("LOGSAMPLE_STATEMENT", key_str) == 0)
+	{
+		// フィンガープリント別に解析する問い合わせの間隔を設定(0:しない, N:N回に一回)
+		EVS_config.logsample_statement = atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): LogSample Statement=%d\n", __func__, atoi(value_str));
+	}
+	// ----------------
+	// 常に解析する遅い問い合わせの時間設定なら
+	// ----------------
+	else if (strcmp("LOGSAMPLE_SLOWTIME", key_str) == 0)
+	{
+		// 常に解析する遅い問い合わせの時間(秒)を設定(0:しない)
+		EVS_config.logsample_slowtime = (ev_tstamp)atof(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): LogSample SlowTime=%f\n", __func__, EVS_config.logsample_slowtime);
+	}
+	// ----------------
+	// フライトレコーダーのスロット数設定なら
+	// ----------------
+	else if (strcmp("FLIGHTRECORDER", key_str) == 0)
+	{
+		// フライトレコーダーのスロット数を設定(0:記録しない)
+		EVS_config.flight_recorder = atoi(value_str);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): FlightRecorder=%d\n", __func__, atoi(value_str));
+	}
+	// ----------------
+	// フライトレコーダーファイル設定なら
+	// ----------------
+	else if (strcmp("FLIGHTFILE", key_str) == 0)
+	{
+		// 設定値文字列のメモリ領域を確保(+ 1バイトを忘れずに!!)
+		EVS_config.flight_file = (char *)realloc((void *)EVS_config.flight_file, strlen(value_str) + 1);
+		// メモリ領域が確保できなかったら
+		if (EVS_config.flight_file == NULL)
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot realloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
+			// 設定値名のメモリ領域は不要になったので破棄
+			free(key_str);
+			// 設定値のメモリ領域は不要になったので破棄
+			free(value_str);
+			return -1;
+		}
+		// フライトレコーダーファイルを設定
+		memcpy((void *)EVS_config.flight_file, (void *)value_str, strlen(value_str) + 1);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): FlightFile=%s\n", __func__, EVS_config.flight_file);
+	}
+	// ----------------
+	// フライトレコーダーのダンプ先ファイル設定なら
+	// ----------------
+	else if (strcmp("FLIGHTDUMP", key_str) == 0)
+	{
+		// 設定値文字列のメモリ領域を確保(+ 1バイトを忘れずに!!)
+		EVS_config.flight_dump = (char *)realloc((void *)EVS_config.flight_dump, strlen(value_str) + 1);
+		// メモリ領域が確保できなかったら
+		if (EVS_config.flight_dump == NULL)
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot realloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
+			// 設定値名のメモリ領域は不要になったので破棄
+			free(key_str);
+			// 設定値のメモリ領域は不要になったので破棄
+			free(value_str);
+			return -1;
+		}
+		// フライトレコーダーのダンプ先ファイルを設定
+		memcpy((void *)EVS_config.flight_dump, (void *)value_str, strlen(value_str) + 1);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): FlightDump=%s\n", __func__, EVS_config.flight_dump);
+	}
+	// ----------------
+	// フライトレコーダーをダンプするSQLSTATE設定なら
+	// ----------------
+	else if (strcmp("FLIGHTSQLSTATE", key_str) == 0)
+	{
+		// 設定値文字列のメモリ領域を確保(+ 1バイトを忘れずに!!)
+		EVS_config.flight_sqlstate = (char *)realloc((void *)EVS_config.flight_sqlstate, strlen(value_str) + 1);
+		// メモリ領域が確保できなかったら
+		if (EVS_config.flight_sqlstate == NULL)
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot realloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
+			// 設定値名のメモリ領域は不要になったので破棄
+			free(key_str);
+			// 設定値のメモリ領域は不要になったので破棄
+			free(value_str);
+			return -1;
+		}
+		// フライトレコーダーをダンプするSQLSTATEを設定
+		memcpy((void *)EVS_config.flight_sqlstate, (void *)value_str, strlen(value_str) + 1);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): FlightSQLState=%s\n", __func__, EVS_config.flight_sqlstate);
 	}
 	// ----------------
 	// 待ち受けポート設定なら
@@ -468,8 +1023,7 @@ int config_str_convert(char *target, int target_len)
 		// メモリ領域が確保できなかったら
 		if (listen_port == NULL)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 			// 設定値名のメモリ領域は不要になったので破棄
 			free(key_str);
 			// 設定値のメモリ領域は不要になったので破棄
@@ -481,8 +1035,7 @@ int config_str_convert(char *target, int target_len)
 		// 変換数が3ではないなら
 		if (init_result != 3)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): sscanf(): Cannot get value[]!? %d %s\n", __func__, init_result, value_str);
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): sscanf(): Cannot get value[]!? %d %s\n", __func__, init_result, value_str);
 			// 設定値名のメモリ領域は不要になったので破棄
 			free(key_str);
 			// 設定値のメモリ領域は不要になったので破棄
@@ -493,13 +1046,11 @@ int config_str_convert(char *target, int target_len)
 		if (atoi(value[0]) >= 1 && atoi(value[0]) <=65535)
 		{
 			listen_port->port = atoi(value[0]);                             // ポート番号を設定する
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): LISTEN port=%d\n", __func__, listen_port->port); 
-			logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): LISTEN port=%d\n", __func__, listen_port->port);
 		}
 		else
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot read LISTEN PORT=%s!?\n", __func__, value[0]);
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot read LISTEN PORT=%.31s!?\n", __func__, value[0]);
 			// 設定値名のメモリ領域は不要になったので破棄
 			free(key_str);
 			// 設定値のメモリ領域は不要になったので破棄
@@ -510,45 +1061,38 @@ int config_str_convert(char *target, int target_len)
 		if (strchr(value[1], '4') != NULL)
 		{
 			listen_port->ipv4 = 1;                                          // IPv4フラグ(0:OFF、1:ON)に1(=ON)を設定する
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): LISTEN IPv4=%d\n", __func__, listen_port->ipv4); 
-			logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): LISTEN IPv4=%d\n", __func__, listen_port->ipv4);
 		}
 		else
 		{
 			listen_port->ipv4 = 0;                                          // IPv4フラグ(0:OFF、1:ON)に0(=OFF)を設定する
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): LISTEN IPv4=%d\n", __func__, listen_port->ipv4); 
-			logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): LISTEN IPv4=%d\n", __func__, listen_port->ipv4);
 		}
 		// 設定値2の中に'6'があれば
 		if (strchr(value[1], '6') != NULL)
 		{
 			listen_port->ipv6 = 1;                                          // IPv6フラグ(0:OFF、1:ON)に1(=ON)を設定する
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): LISTEN IPv6=%d\n", __func__, listen_port->ipv6); 
-			logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): LISTEN IPv6=%d\n", __func__, listen_port->ipv6);
 		}
 		else
 		{
 			listen_port->ipv6 = 0;                                          // IPv6フラグ(0:OFF、1:ON)に0(=OFF)を設定する
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): LISTEN IPv6=%d\n", __func__, listen_port->ipv6); 
-			logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): LISTEN IPv6=%d\n", __func__, listen_port->ipv6);
 		}
 		// 設定値3の中に"ON"か'1'があれば
 		if (strstr(value[2], "ON") != NULL || strstr(value[2], "On") != NULL || strstr(value[2], "on") != NULL || strchr(value[2], '1') != NULL)
 		{
 			listen_port->ssl = 1;                                           // SSL/TLSフラグ(0:OFF、1:ON)に1を設定する
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): LISTEN SSL/TLS Support=%d\n", __func__, listen_port->ssl); 
-			logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): LISTEN SSL/TLS Support=%d\n", __func__, listen_port->ssl);
 		}
 		else
 		{
 			listen_port->ssl = 0;                                           // SSL/TLSフラグ(0:OFF、1:ON)に0を設定する
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): LISTEN SSL/TLS Support=%d\n", __func__, listen_port->ssl); 
-			logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): LISTEN SSL/TLS Support=%d\n", __func__, listen_port->ssl);
 		}
 		// テールキューの最後に待ち受けポートの情報を追加する
 		TAILQ_INSERT_TAIL(&EVS_port_tailq, listen_port, entries);
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INSERT_TAIL(listen_port): OK.\n", __func__);
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): TAILQ_INSERT_TAIL(listen_port): OK.\n", __func__);
 	}
 	// ----------------
 	// PostgreSQL設定なら
@@ -560,8 +1104,7 @@ int config_str_convert(char *target, int target_len)
 		// メモリ領域が確保できなかったら
 		if (db_list == NULL)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 			// 設定値名のメモリ領域は不要になったので破棄
 			free(key_str);
 			// 設定値のメモリ領域は不要になったので破棄
@@ -569,12 +1112,18 @@ int config_str_convert(char *target, int target_len)
 			return -1;
 		}
 		// 設定値を個別に変換、その2 ※パラメータが取得できた数がinit_resultに設定される
-		init_result = sscanf(value_str, "%[^,],%[^,],%[^,],%[^,],%[^,]", value[0], value[1], value[2], value[3], value[4]);
+		init_result = sscanf(value_str, "%[^,],%[^,],%[^,],%[^,],%[^,],%[^,],%[^,],%[^,]", value[0], value[1], value[2], value[3], value[4], value[5], value[6], value[7]);
+		// 後ろのパラメータがプールの設定("Session"、"Transaction"、"MinIdle=N"、"MaxSize=N")、振り分けの設定("Balance=xxx")なら、取り除く
+		while (init_result >= 4 && config_db_option(db_list, value[init_result - 1]) == 0)
+		{
+			init_result --;
+		}
 		// 変換数が3未満なら
 		if (init_result < 3)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): Not enough PostgreSQL's parameters!? %d %s\n", __func__, init_result, value_str);
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Not enough PostgreSQL's parameters!? %d %s\n", __func__, init_result, value_str);
+			// データベース別設定のメモリ領域は不要になったので破棄
+			free(db_list);
 			// 設定値名のメモリ領域は不要になったので破棄
 			free(key_str);
 			// 設定値のメモリ領域は不要になったので破棄
@@ -622,17 +1171,41 @@ int config_str_convert(char *target, int target_len)
 				db_list->port = 5432;                                           // ポート番号を設定する(実際にはservicenameを使うのでポート番号は使わない)
 			}
 		}
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): PostgreSQL's database=%s, username=%s, password=%s, hostname=%s, port=%d\n", __func__, db_list->database, db_list->username, db_list->password, db_list->hostname, db_list->port); 
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		// ホスト名が"|"区切りなら、複数の接続先ホストとして分ける(UNIXドメインソケットなら分けない)
+		if (init_result >= 4 && config_db_hosts(db_list, value[3], db_list->servicename) != 0)
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Invalid PostgreSQL's hostname!? (max %d hosts) %s\n", __func__, MAX_DB_HOST_NUM, db_list->hostname);
+			// データベース別設定のメモリ領域は不要になったので破棄
+			free(db_list);
+			// 設定値名のメモリ領域は不要になったので破棄
+			free(key_str);
+			// 設定値のメモリ領域は不要になったので破棄
+			free(value_str);
+			return -1;
+		}
+		// 読み書き分離なのに、レプリカのホストがないなら
+		if (db_list->split_mode != 0 && db_list->host_num < 2)
+		{
+			LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(): PostgreSQL's Split needs primary|replica hosts, ignored. (database=%s, username=%s)\n", __func__, db_list->database, db_list->username);
+			db_list->split_mode = 0;
+		}
+		// 接続先ホスト状態初期化処理
+		API_balance_init(db_list);
+		// PostgreSQL接続用データ事前生成処理(StartupMessage、md5(パスワード+ユーザー名)は接続毎に作らない)
+		API_pgsql_prepare(db_list);
+		// 接続受け入れ制御初期化処理(同じデータベース名の設定と、接続数をまとめて数える)
+		API_admit_init(db_list);
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): PostgreSQL's database=%s, username=%s, password=%s, hostname=%s, port=%d, pool_mode=%s, min_idle=%d, max_size=%d, hosts=%d, balance=%d, split=%d\n", __func__, db_list->database, db_list->username, db_list->password, db_list->hostname, db_list->port, (db_list->pool_mode == 1) ? "Transaction" : "Session", db_list->pool_min, db_list->pool_max, db_list->host_num, db_list->balance_mode, db_list->split_mode);
+		// プールで待機中の接続用テールキュー、接続を待つクライアント用テールキューを初期化
+		TAILQ_INIT(&db_list->pool_tailq);
+		TAILQ_INIT(&db_list->wait_tailq);
 		// テールキューの最後にデータベースの情報を追加する
 		TAILQ_INSERT_TAIL(&EVS_db_tailq, db_list, entries);
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INSERT_TAIL(db_list): OK.\n", __func__);
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): TAILQ_INSERT_TAIL(db_list): OK.\n", __func__);
 	}
 	else
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Not support parameter!? '%s'\n", __func__, target);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Not support parameter!? '%s'\n", __func__, target);
 		// 設定値名のメモリ領域は不要になったので破棄
 		free(key_str);
 		// 設定値のメモリ領域は不要になったので破棄
@@ -658,8 +1231,7 @@ int INIT_config_default(void)
 	// デーモンモードを1:ONに設定
 	// ----------------
 	EVS_config.daemon = 1;
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): DAEMON=%d\n", __func__, EVS_config.daemon);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): DAEMON=%d\n", __func__, EVS_config.daemon);
 
 	// ----------------
 	// PIDファイルを設定
@@ -670,14 +1242,12 @@ int INIT_config_default(void)
 	// メモリ領域が確保できなかったら
 	if (EVS_config.pid_file == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 		return -1;
 	}
 	// PIDファイルを設定
 	memcpy((void *)EVS_config.pid_file, (void *)pid_file, strlen(pid_file));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): PidFile=%s\n", __func__, EVS_config.pid_file);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): PidFile=%s\n", __func__, EVS_config.pid_file);
 
 	// ----------------
 	// ログファイルを設定
@@ -688,21 +1258,36 @@ int INIT_config_default(void)
 	// メモリ領域が確保できなかったら
 	if (EVS_config.log_file == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 		return -1;
 	}
 	// ログファイルを設定
 	memcpy((void *)EVS_config.log_file, (void *)log_file, strlen(log_file));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): LogFile=%s\n", __func__, EVS_config.log_file);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): LogFile=%s\n", __func__, EVS_config.log_file);
 
 	// ----------------
 	// ログレベルを2:LOGLEVEL_INFOに設定
 	// ----------------
 	EVS_config.log_level = LOGLEVEL_INFO;
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): Log Level=%d\n", __func__, EVS_config.log_level);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): Log Level=%d\n", __func__, EVS_config.log_level);
+
+	// ----------------
+	// ログ書き出し統計の出力間隔を60秒に設定
+	// ----------------
+	EVS_config.logstat_intval = 60.;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): LogStat Interval=%f\n", __func__, EVS_config.logstat_intval);
+
+	// ----------------
+	// ログファイルの形式を0:テキストに設定
+	// ----------------
+	EVS_config.log_format = 0;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): LogFormat=%d\n", __func__, EVS_config.log_format);
+
+	// ----------------
+	// ログファイルには、全ログ種別を出力する
+	// ----------------
+	EVS_config.log_events = (1 << LOG_EVENT_MAX) - 1;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): LogType=0x%x\n", __func__, EVS_config.log_events);
 
 	// ----------------
 	// UNIXドメインソケットファイルを設定
@@ -713,53 +1298,140 @@ int INIT_config_default(void)
 	// メモリ領域が確保できなかったら
 	if (EVS_config.domain_socketfile == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 		return -1;
 	}
 	// UNIXドメインソケットファイルを設定
 	memcpy((void *)EVS_config.domain_socketfile, (void *)domain_socketfile, strlen(domain_socketfile));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): SocketFile=%s\n", __func__, EVS_config.domain_socketfile);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): SocketFile=%s\n", __func__, EVS_config.domain_socketfile);
 
 	// ----------------
 	// SSL/TLS対応を0:OFFに設定
 	// ----------------
 	EVS_config.ssl_support = 0;
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): SSL/TLS=%d\n", __func__, EVS_config.ssl_support);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): SSL/TLS=%d\n", __func__, EVS_config.ssl_support);
 
 	// ----------------
 	// タイマーイベント確認間隔(秒)を1秒に設定
 	// ----------------
 	EVS_config.timer_checkintval = 1.;
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): Timeout Check Interval=%f\n", __func__, EVS_config.timer_checkintval);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): Timeout Check Interval=%f\n", __func__, EVS_config.timer_checkintval);
 
 	// ----------------
 	// KeepAliveを1:ONに設定
 	// ----------------
 	EVS_config.keepalive = 1;
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): KeepAlive=%d\n", __func__, EVS_config.keepalive);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): KeepAlive=%d\n", __func__, EVS_config.keepalive);
 
 	// Keepalive Idletimeを設定
 	EVS_config.keepalive_idletime = 180;
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): Keepalive IdleTime=%d\n", __func__, EVS_config.keepalive_idletime);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): Keepalive IdleTime=%d\n", __func__, EVS_config.keepalive_idletime);
 
 	// Keepalive Intervalを設定
 	EVS_config.keepalive_intval = 30;
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): Keepalive Interval=%d\n", __func__, EVS_config.keepalive_intval);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): Keepalive Interval=%d\n", __func__, EVS_config.keepalive_intval);
 
 	// Keepalive Probesを設定
 	EVS_config.keepalive_probes = 5;
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): Keepalive Probes=%d\n", __func__, EVS_config.keepalive_probes);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): Keepalive Probes=%d\n", __func__, EVS_config.keepalive_probes);
+
+	// ----------------
+	// エラー集計の出力間隔(秒)を60秒、警告件数を100件に設定
+	// ----------------
+	EVS_config.errorstat_intval = 60.;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): ErrorStat Interval=%f\n", __func__, EVS_config.errorstat_intval);
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	EVS_config.errorstat_warncount = 100;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): ErrorStat WarnCount=%d\n", __func__, EVS_config.errorstat_warncount);
+
+	EVS_config.transaction_warntime = 60.;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): Transaction WarnTime=%f\n", __func__, EVS_config.transaction_warntime);
+
+	EVS_config.copystat_intval = 10.;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): CopyStat Interval=%f\n", __func__, EVS_config.copystat_intval);
+
+	// ----------------
+	// キャプチャファイルの大きさを64MB、キャプチャするセッションを全セッションに設定(キャプチャファイルの指定がなければキャプチャしない)
+	// ----------------
+	EVS_config.capture_size = 64 * 1024 * 1024;
+	EVS_config.capture_sample = 1;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): CaptureSize=%lu, CaptureSample=%d\n", __func__, (unsigned long)EVS_config.capture_size, EVS_config.capture_sample);
+
+	// ----------------
+	// スプールファイルの大きさを1024MB、スプールを始めるメッセージ用キューのメモリ量を256MB、統計の出力間隔を60秒に設定(スプールファイルの指定がなければスプールしない)
+	// ----------------
+	EVS_config.spool_size = (size_t)1024 * 1024 * 1024;
+	EVS_config.spool_threshold = (size_t)256 * 1024 * 1024;
+	EVS_config.spoolstat_intval = 60.;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): SpoolSize=%lu, SpoolThreshold=%lu, SpoolStat Interval=%f\n", __func__, (unsigned long)EVS_config.spool_size, (unsigned long)EVS_config.spool_threshold, EVS_config.spoolstat_intval);
+
+	// ----------------
+	// 接続はプールしない、リセット用の問い合わせを"DISCARD ALL"、プールで待機中の接続を閉じるまでの時間を600秒、接続を待つクライアントを切断するまでの時間を30秒、事前接続の間隔を最大200ミリ秒に設定
+	// ----------------
+	EVS_config.pool_size = 0;
+	EVS_config.pool_reset_query = strdup("DISCARD ALL");
+	EVS_config.pool_idle_timeout = 600.;
+	EVS_config.pool_wait_timeout = 30.;
+	EVS_config.pool_warm_jitter = 0.2;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): PoolSize=%d, PoolResetQuery=%s, PoolIdleTimeout=%f, PoolWaitTimeout=%f, PoolWarmJitter=%f\n", __func__, EVS_config.pool_size, EVS_config.pool_reset_query, EVS_config.pool_idle_timeout, EVS_config.pool_wait_timeout, EVS_config.pool_warm_jitter);
+
+	// ----------------
+	// 接続先ホストの死活確認の間隔を5秒、切り離し時間を10秒、戻したホストへの割り振りを元に戻すまでの時間を30秒に設定
+	// ----------------
+	EVS_config.host_probe_intval = 5.;
+	EVS_config.host_eject_time = 10.;
+	EVS_config.host_ramp_time = 30.;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): HostProbeInterval=%f, HostEjectTime=%f, HostRampTime=%f\n", __func__, EVS_config.host_probe_intval, EVS_config.host_eject_time, EVS_config.host_ramp_time);
+
+	// ----------------
+	// 読み書き分離の統計は、60秒毎に出力する
+	// ----------------
+	EVS_config.splitstat_intval = 60.;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): SplitStatInterval=%f\n", __func__, EVS_config.splitstat_intval);
+
+	// ----------------
+	// PostgreSQLとの接続数は全体もデータベース名毎も無制限、待てるクライアント数も無制限、接続の受け入れ制御の統計は60秒毎に出力する
+	// ----------------
+	EVS_config.max_backend_conn = 0;
+	EVS_config.max_database_conn = 0;
+	EVS_config.admit_queue_length = 0;
+	EVS_config.admitstat_intval = 60.;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): MaxBackendConnections=%d, MaxDatabaseConnections=%d, AdmitQueueLength=%d, AdmitStatInterval=%f\n", __func__, EVS_config.max_backend_conn, EVS_config.max_database_conn, EVS_config.admit_queue_length, EVS_config.admitstat_intval);
+
+	// ----------------
+	// ワイルドカードの設定から作る設定は、1000個まで
+	// ----------------
+	EVS_config.max_wildcard_entries = 1000;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): MaxWildcardEntries=%d\n", __func__, EVS_config.max_wildcard_entries);
+
+	// ----------------
+	// ログサンプリングは、全セッションの全メッセージを解析する設定にする(対象外のセッションでは、文のサンプリングはせず、1秒以上かかった問い合わせは解析する)
+	// ----------------
+	EVS_config.logsample_session = 1;
+	EVS_config.logsample_statement = 0;
+	EVS_config.logsample_slowtime = 1.;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): LogSample Session=%d, Statement=%d, SlowTime=%f\n", __func__, EVS_config.logsample_session, EVS_config.logsample_statement, EVS_config.logsample_slowtime);
+
+	// ----------------
+	// フライトレコーダーのスロット数を8192に設定(フライトレコーダーファイルの指定がなければメモリ上だけ、SQLSTATEの指定がなければErrorResponseではダンプしない)
+	// ----------------
+	EVS_config.flight_recorder = 8192;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): FlightRecorder=%d\n", __func__, EVS_config.flight_recorder);
+
+	// フライトレコーダーのダンプ先ファイルを設定
+	char                            *flight_dump = "/var/log/EvServer/EvServer.flight";
+	// 設定値文字列のメモリ領域を確保(+ 1バイトを忘れずに!!)
+	EVS_config.flight_dump = (char *)calloc(1, strlen(flight_dump) + 1);
+	// メモリ領域が確保できなかったら
+	if (EVS_config.flight_dump == NULL)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
+		return -1;
+	}
+	memcpy((void *)EVS_config.flight_dump, (void *)flight_dump, strlen(flight_dump));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): FlightDump=%s\n", __func__, EVS_config.flight_dump);
+
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): OK.\n", __func__);
 
 	return 0;
 }
@@ -778,13 +1450,13 @@ int INIT_config(int argc, char *argv[])
 	// システム設定値を0クリア
 	// ----------------
 	memset((void *)&EVS_config, 0, sizeof(struct EVS_config_t));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): Clear config OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): Clear config OK.\n", __func__);
 
 	// 各種設定値デフォルト初期化処理
 	init_result = INIT_config_default();
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): Load default config OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	// ログ振り分け表生成処理(既定のログレベルにする)
+	log_route_init();
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): Load default config OK.\n", __func__);
 
 	// ----------------
 	// 引数が設定ファイルとして存在しているかどうか確認
@@ -792,12 +1464,12 @@ int INIT_config(int argc, char *argv[])
 	config_fp = fopen(argv[1], "r");
 	if (config_fp == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): fopen(%s): Cannot open config file!? use default settings.\n", __func__, argv[1]);
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): fopen(%s): Cannot open config file!? use default settings.\n", __func__, argv[1]);
 		return init_result;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): fopen(%s): OK.\n", __func__, argv[1]);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	// SIGHUPで読み直すために、設定ファイルの絶対パスを覚えておく(デーモン化でカレントディレクトリが変わるので)
+	EVS_config.config_file = realpath(argv[1], NULL);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): fopen(%s): OK.\n", __func__, argv[1]);
 
 	// ----------------
 	// 設定ファイルからパラメータ読み込み
@@ -812,8 +1484,7 @@ int INIT_config(int argc, char *argv[])
 			init_result = config_str_convert(config_data, strlen(config_data));
 			if (init_result < 0)
 			{
-				snprintf(log_str, MAX_LOG_LENGTH, "%s(): config_str_convert(): Cannot convert string to parameter!?\n", __func__);
-				logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+				LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): config_str_convert(): Cannot convert string to parameter!?\n", __func__);
 				// コンフィグファイルポインタを閉じる
 				fclose(config_fp);
 				return init_result;
@@ -824,5 +1495,75 @@ int INIT_config(int argc, char *argv[])
 	// コンフィグファイルポインタを閉じる
 	fclose(config_fp);
 
+	// ログ振り分け表生成処理(LogLevel、LogType、LogSinkを反映する)
+	log_route_init();
+
 	return 0;
 }
+
+// --------------------------------
+// 設定再読み込み処理 ※SIGHUPで呼ばれる
+// --------------------------------
+// 設定ファイルのPostgreSQL設定だけを読み直して、経路表を差し替える(他の設定は、再起動しないと変わらない)
+// 設定ファイルに誤りがあれば、読み直した設定を全て捨てて、今の設定のままにする
+int INIT_config_reload(void)
+{
+	int                             init_result = 0;
+	FILE                            *config_fp;                         // コンフィグファイルポインタ
+	char                            config_data[MAX_STRING_LENGTH];     // コンフィグファイル読み込みデータ
+	char                            log_str[MAX_LOG_LENGTH];
+	char                            *changed_str;                       // 整理後の文字列ポインタ
+	struct EVS_db_t                 *last_info;                         // 読み直す前の最後のデータベース別設定
+
+	if (EVS_config.config_file == NULL)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_WARN, NULL, log_str, "%s(): No config file to reload!?\n", __func__);
+		return -1;
+	}
+	config_fp = fopen(EVS_config.config_file, "r");
+	if (config_fp == NULL)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): fopen(%s): Cannot open config file!? errno=%d (%s)\n", __func__, EVS_config.config_file, errno, strerror(errno));
+		return -1;
+	}
+	// 接続先ホスト再読み込み処理(死活確認の接続先を名前解決し直す)
+	API_balance_reload();
+
+	// 読み直した設定は、今の設定の後ろに追加される
+	last_info = TAILQ_LAST(&EVS_db_tailq, EVS_db_tailq_head);
+	while (fgets(config_data, sizeof(config_data), config_fp) != NULL)
+	{
+		// データの先頭が'#'や' 'ではないなら
+		if (config_data[0] != '#' && config_data[0] != ';' && config_data[0] != '/' && config_data[0] != ' ' && strlen(config_data) >= 3)
+		{
+			// PostgreSQL設定の行だけ読み直す
+			changed_str = config_str_cleaner(config_data, strlen(config_data));
+			if (changed_str == NULL)
+			{
+				init_result = -1;
+				break;
+			}
+			if (strncmp(changed_str, "POSTGRESQL=", 11) == 0)
+			{
+				init_result = config_str_convert(config_data, strlen(config_data));
+			}
+			free(changed_str);
+			if (init_result < 0)
+			{
+				break;
+			}
+		}
+	}
+	// コンフィグファイルポインタを閉じる
+	fclose(config_fp);
+
+	if (init_result < 0)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): config_str_convert(): Cannot convert string to parameter!? keep current PostgreSQL settings.\n", __func__);
+		// 経路表再読み込み処理(読み直した設定を全て捨てる)
+		API_route_reload(last_info, -1);
+		return init_result;
+	}
+	// 経路表再読み込み処理(変わっていない設定はそのまま使い、変わった設定は使われなくなったら開放する)
+	return API_route_reload(last_info, 0);
+}
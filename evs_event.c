@@ -0,0 +1,305 @@
+// ----------------------------------------------------------------------
+// Protocol Analyzer for PostgreSQL -
+// Purpose:
+//     Pack printf-style arguments without formatting, and render them later.
+//     (Shared by the binary event log, the flight recorder and evs_logcat.)
+//
+// Program:
+//     Takeshi Kaburagi/MyDNS.JP    https://www.fvg-on.net/
+//
+// Usage:
+//     #include "evs_event.c"
+// ----------------------------------------------------------------------
+
+
+// ----------------------------------------------------------------------
+// ヘッダ部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// インクルード宣言
+// --------------------------------
+// evs_main.c、evs_logcat.cからincludeされることを想定しているので、ヘッダファイルはincludeしていない。
+// (stdio.h、string.h、stdarg.h、evs_event.hは、include元で済ませておくこと)
+
+// ----------------------------------------------------------------------
+// コード部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// 引数格納処理(書式文字列の変換指定子の順番に、引数をarg_bufに並べる。並べた長さを返す)
+// --------------------------------
+// 数値を文字列にする処理はせずに、値をそのまま並べる(形式はevs_event.hを参照)。
+// 文字列はstr_maxバイトまで。strref_funcがあれば、MIN_EVENT_STRREF_LENGTH以上の文字列は文字列テーブルの参照にする(0が返れば、そのまま並べる)
+// 格納する余裕がなくなったら、以降の引数は捨てる(event_render()では空になる)
+unsigned int event_pack(char *arg_buf, unsigned int arg_max, const char *format_ptr, va_list *args, unsigned int str_max, uint32_t (*strref_func)(const char *, unsigned int))
+{
+	unsigned int                    arg_len = 0;
+	int                             long_count;                         // 長さ修飾子(0:なし, 1:l, 2:ll, z, j)
+	int64_t                         int_arg;                            // 整数の引数
+	double                          double_arg;                         // 浮動小数点数の引数
+	const char                      *str_arg;                           // 文字列の引数
+	unsigned int                    str_len;
+	uint16_t                        str_head;                           // 文字列の引数の長さ(EVS_EVENT_STRREFなら文字列テーブルの参照)
+	uint32_t                        string_id;
+
+	for (; format_ptr != NULL && *format_ptr != '\0'; format_ptr ++)
+	{
+		if (*format_ptr != '%')
+		{
+			continue;
+		}
+		format_ptr ++;
+		// "%%"なら
+		if (*format_ptr == '%')
+		{
+			continue;
+		}
+		// フラグ、最小幅、精度を読み飛ばす
+		while (*format_ptr != '\0' && strchr("-+ #0123456789.", *format_ptr) != NULL)
+		{
+			format_ptr ++;
+		}
+		// 長さ修飾子
+		long_count = 0;
+		while (*format_ptr != '\0' && strchr("hlzjt", *format_ptr) != NULL)
+		{
+			long_count += (*format_ptr == 'h') ? 0 : (*format_ptr == 'l') ? 1 : 2;
+			format_ptr ++;
+		}
+		// 引数を格納する余裕がないなら、以降は捨てる
+		if (*format_ptr == '\0' || arg_len + sizeof(int64_t) > arg_max)
+		{
+			break;
+		}
+		switch (*format_ptr)
+		{
+			case 'd':
+			case 'i':
+				int_arg = (long_count == 0) ? va_arg(*args, int) : (long_count == 1) ? va_arg(*args, long) : va_arg(*args, long long);
+				memcpy(arg_buf + arg_len, &int_arg, sizeof(int_arg));
+				arg_len += sizeof(int_arg);
+				break;
+			case 'u':
+			case 'x':
+			case 'X':
+			case 'o':
+				int_arg = (long_count == 0) ? va_arg(*args, unsigned int) : (long_count == 1) ? va_arg(*args, unsigned long) : va_arg(*args, unsigned long long);
+				memcpy(arg_buf + arg_len, &int_arg, sizeof(int_arg));
+				arg_len += sizeof(int_arg);
+				break;
+			case 'c':
+				int_arg = va_arg(*args, int);
+				memcpy(arg_buf + arg_len, &int_arg, sizeof(int_arg));
+				arg_len += sizeof(int_arg);
+				break;
+			case 'p':
+				int_arg = (intptr_t)va_arg(*args, void *);
+				memcpy(arg_buf + arg_len, &int_arg, sizeof(int_arg));
+				arg_len += sizeof(int_arg);
+				break;
+			case 'f':
+			case 'e':
+			case 'g':
+			case 'a':
+				double_arg = va_arg(*args, double);
+				memcpy(arg_buf + arg_len, &double_arg, sizeof(double_arg));
+				arg_len += sizeof(double_arg);
+				break;
+			case 's':
+				str_arg = va_arg(*args, const char *);
+				if (str_arg == NULL)
+				{
+					str_arg = "(null)";
+				}
+				str_len = strnlen(str_arg, str_max);
+				string_id = 0;
+				// 長い文字列(SQL文など)は、文字列テーブルに登録して参照する
+				if (strref_func != NULL && str_len >= MIN_EVENT_STRREF_LENGTH)
+				{
+					string_id = strref_func(str_arg, str_len);
+				}
+				if (string_id != 0)
+				{
+					str_head = EVS_EVENT_STRREF;
+					memcpy(arg_buf + arg_len, &str_head, sizeof(str_head));
+					memcpy(arg_buf + arg_len + sizeof(str_head), &string_id, sizeof(string_id));
+					arg_len += sizeof(str_head) + sizeof(string_id);
+				}
+				else
+				{
+					if (arg_len + sizeof(str_head) + str_len > arg_max)
+					{
+						str_len = arg_max - arg_len - sizeof(str_head);
+					}
+					str_head = str_len;
+					memcpy(arg_buf + arg_len, &str_head, sizeof(str_head));
+					memcpy(arg_buf + arg_len + sizeof(str_head), str_arg, str_len);
+					arg_len += sizeof(str_head) + str_len;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+	return arg_len;
+}
+
+// --------------------------------
+// 出力文字列追加処理(out_maxを超える分は捨てる)
+// --------------------------------
+static void event_render_append(char *out_str, size_t *out_len, size_t out_max, const char *add_ptr, size_t add_len)
+{
+	if (*out_len + add_len >= out_max)
+	{
+		add_len = out_max - 1 - *out_len;
+	}
+	memcpy(out_str + *out_len, add_ptr, add_len);
+	*out_len += add_len;
+	out_str[*out_len] = '\0';
+}
+
+// --------------------------------
+// 引数書式化処理(event_pack()で並べた引数を、書式文字列に従ってout_strの後ろに追加する)
+// --------------------------------
+// string_funcは文字列テーブルの参照を引く関数(NULLなら、参照は"<unknown string>"になる)
+void event_render(char *out_str, size_t *out_len, size_t out_max, const char *format_ptr, const char *arg_ptr, const char *arg_end, const char *(*string_func)(uint32_t))
+{
+	char                            spec_str[32];                       // 変換指定(長さ修飾子は付け直す)
+	size_t                          spec_len;
+	char                            value_str[MAX_EVENT_LENGTH];
+	int                             value_len;
+	int64_t                         int_arg;
+	double                          double_arg;
+	uint16_t                        str_head;
+	uint32_t                        string_id;
+	const char                      *str_ptr;
+	char                            str_copy[MAX_EVENT_LENGTH];         // NUL終端した文字列の引数
+
+	for (; *format_ptr != '\0'; format_ptr ++)
+	{
+		if (*format_ptr != '%')
+		{
+			event_render_append(out_str, out_len, out_max, format_ptr, 1);
+			continue;
+		}
+		// "%%"なら
+		if (format_ptr[1] == '%')
+		{
+			event_render_append(out_str, out_len, out_max, "%", 1);
+			format_ptr ++;
+			continue;
+		}
+		// フラグ、最小幅、精度はそのまま使う
+		spec_len = 0;
+		spec_str[spec_len ++] = *format_ptr ++;
+		while (*format_ptr != '\0' && strchr("-+ #0123456789.", *format_ptr) != NULL && spec_len < sizeof(spec_str) - 4)
+		{
+			spec_str[spec_len ++] = *format_ptr ++;
+		}
+		// 長さ修飾子は読み飛ばす(整数は全部int64_tで格納されている)
+		while (*format_ptr != '\0' && strchr("hlzjt", *format_ptr) != NULL)
+		{
+			format_ptr ++;
+		}
+		if (*format_ptr == '\0')
+		{
+			break;
+		}
+
+		value_len = 0;
+		switch (*format_ptr)
+		{
+			case 'd':
+			case 'i':
+			case 'u':
+			case 'x':
+			case 'X':
+			case 'o':
+			case 'c':
+			case 'p':
+				if (arg_ptr + sizeof(int_arg) > arg_end)
+				{
+					break;
+				}
+				memcpy(&int_arg, arg_ptr, sizeof(int_arg));
+				arg_ptr += sizeof(int_arg);
+				if (*format_ptr == 'c')
+				{
+					spec_str[spec_len ++] = 'c';
+					spec_str[spec_len] = '\0';
+					value_len = snprintf(value_str, sizeof(value_str), spec_str, (int)int_arg);
+				}
+				else if (*format_ptr == 'p')
+				{
+					spec_str[spec_len ++] = 'p';
+					spec_str[spec_len] = '\0';
+					value_len = snprintf(value_str, sizeof(value_str), spec_str, (void *)(intptr_t)int_arg);
+				}
+				else
+				{
+					spec_str[spec_len ++] = 'l';
+					spec_str[spec_len ++] = 'l';
+					spec_str[spec_len ++] = *format_ptr;
+					spec_str[spec_len] = '\0';
+					value_len = snprintf(value_str, sizeof(value_str), spec_str, (long long)int_arg);
+				}
+				break;
+			case 'f':
+			case 'e':
+			case 'g':
+			case 'a':
+				if (arg_ptr + sizeof(double_arg) > arg_end)
+				{
+					break;
+				}
+				memcpy(&double_arg, arg_ptr, sizeof(double_arg));
+				arg_ptr += sizeof(double_arg);
+				spec_str[spec_len ++] = *format_ptr;
+				spec_str[spec_len] = '\0';
+				value_len = snprintf(value_str, sizeof(value_str), spec_str, double_arg);
+				break;
+			case 's':
+				if (arg_ptr + sizeof(str_head) > arg_end)
+				{
+					break;
+				}
+				memcpy(&str_head, arg_ptr, sizeof(str_head));
+				arg_ptr += sizeof(str_head);
+				// 文字列テーブルの参照なら
+				if (str_head == EVS_EVENT_STRREF)
+				{
+					if (arg_ptr + sizeof(string_id) > arg_end)
+					{
+						break;
+					}
+					memcpy(&string_id, arg_ptr, sizeof(string_id));
+					arg_ptr += sizeof(string_id);
+					str_ptr = (string_func != NULL) ? string_func(string_id) : NULL;
+					snprintf(str_copy, sizeof(str_copy), "%s", (str_ptr != NULL) ? str_ptr : "<unknown string>");
+				}
+				else
+				{
+					if (arg_ptr + str_head > arg_end)
+					{
+						str_head = arg_end - arg_ptr;
+					}
+					if (str_head >= sizeof(str_copy))
+					{
+						str_head = sizeof(str_copy) - 1;
+					}
+					memcpy(str_copy, arg_ptr, str_head);
+					str_copy[str_head] = '\0';
+					arg_ptr += str_head;
+				}
+				spec_str[spec_len ++] = 's';
+				spec_str[spec_len] = '\0';
+				value_len = snprintf(value_str, sizeof(value_str), spec_str, str_copy);
+				break;
+			default:
+				break;
+		}
+		if (value_len > 0)
+		{
+			event_render_append(out_str, out_len, out_max, value_str, ((size_t)value_len < sizeof(value_str)) ? (size_t)value_len : sizeof(value_str) - 1);
+		}
+	}
+}
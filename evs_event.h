@@ -0,0 +1,68 @@
+// ----------------------------------------------------------------------
+// Protocol Analyzer for PostgreSQL -
+// Purpose:
+//     Binary event log record format (shared with evs_logcat).
+//
+// Program:
+//     Takeshi Kaburagi/MyDNS.JP    https://www.fvg-on.net/
+//
+// Usage:
+//     #include "evs_event.h"
+// ----------------------------------------------------------------------
+#ifndef EVS_EVENT_H
+#define EVS_EVENT_H
+
+// --------------------------------
+// インクルード宣言
+// --------------------------------
+#include <stdint.h>                                         // 固定長整数型関連
+
+// --------------------------------
+// 定数宣言
+// --------------------------------
+// バイナリイベントログ(LogFormat = 1)は、以下のレコードを並べただけのファイル。バイトオーダーは出力したマシンのもの。
+// 数値を文字列にする処理(snprintf)は出力時にはせずに、evs_logcatで後から行う。
+//
+//   レコード = struct EVS_event_t(レコードヘッダ) ＋ レコードタイプ別の本文
+//
+//   EVS_EVENT_TEXT    : 本文 = ログの文字列(改行まで含む)
+//   EVS_EVENT_STRING  : 本文 = uint32_t 文字列ID ＋ 文字列(書式文字列、メッセージ名称、長いSQL文などの文字列テーブル)
+//   EVS_EVENT_SESSION : 本文 = クライアントのアドレス文字列'\0' データベース名'\0' ユーザー名'\0'
+//   EVS_EVENT_MESSAGE : 本文 = struct EVS_event_message_t ＋ 書式文字列に対応する引数の並び
+//
+// 引数の並びは、書式文字列の変換指定子の順番に以下の形式で格納する。
+//   整数(d, i, u, x, X, o, c)、ポインタ(p) : int64_t
+//   浮動小数点数(f, e, g, a)               : double
+//   文字列(s)                              : uint16_t 長さ ＋ 文字列(長さがEVS_EVENT_STRREFなら、続くuint32_tが文字列ID)
+#define EVS_EVENT_TEXT          1                           // レコードタイプ : テキストのログ
+#define EVS_EVENT_STRING        2                           // レコードタイプ : 文字列テーブルへの登録
+#define EVS_EVENT_SESSION       3                           // レコードタイプ : セッション開始
+#define EVS_EVENT_MESSAGE       4                           // レコードタイプ : メッセージのデコード結果
+
+#define EVS_EVENT_STRREF        0xFFFF                      // 文字列引数の長さがこの値なら、文字列テーブルの参照
+
+#define MAX_EVENT_LENGTH        8192                        // 一レコード当たりの最大長
+#define MIN_EVENT_STRREF_LENGTH 64                          // この長さ以上の文字列の引数は文字列テーブルに登録して参照する
+
+// --------------------------------
+// 型宣言
+// --------------------------------
+struct EVS_event_t {                                        // バイナリイベントログのレコードヘッダ
+	uint16_t        record_len;                             // レコード長(このヘッダを含む)
+	uint8_t         record_type;                            // レコードタイプ(EVS_EVENT_TEXTなど)
+	uint8_t         log_level;                              // ログレベル
+	uint32_t        tv_sec;                                 // ログ日時(秒)
+	uint32_t        tv_usec;                                // ログ日時(マイクロ秒)
+	uint32_t        session_id;                             // セッションID(0:セッションなし)
+};
+
+struct EVS_event_message_t {                                // EVS_EVENT_MESSAGEの本文の先頭
+	uint8_t         from_client;                            // メッセージの方向(1:クライアント→PostgreSQL, 0:PostgreSQL→クライアント)
+	uint8_t         message_type;                           // メッセージタイプ
+	uint16_t        reserved;                               // 予約
+	uint32_t        message_len;                            // メッセージ長(メッセージタイプの1バイトは含まない)
+	uint32_t        name_id;                                // メッセージ名称の文字列ID
+	uint32_t        format_id;                              // 詳細の書式文字列の文字列ID(0:詳細なし)
+};
+
+#endif
@@ -49,6 +49,8 @@ ev_timer                        timeout_watcher;                // タイマー
 ev_signal                       signal_watcher_sighup;          // シグナルオブジェクト(シグナルごとにウォッチャーを分けないといけない)
 ev_signal                       signal_watcher_sigint;          // シグナルオブジェクト(シグナルごとにウォッチャーを分けないといけない)
 ev_signal                       signal_watcher_sigterm;         // シグナルオブジェクト(シグナルごとにウォッチャーを分けないといけない)
+ev_signal                       signal_watcher_sigusr1;         // シグナルオブジェクト(シグナルごとにウォッチャーを分けないといけない)
+ev_signal                       signal_watcher_sigusr2;         // シグナルオブジェクト(シグナルごとにウォッチャーを分けないといけない)
 
 struct ev_loop                  *EVS_loop;                      // イベントループ
 
@@ -93,8 +95,19 @@ const char                      *loglevel_list[] = {            // ログレベ
 									"ERROR",
 									"MAX!? ",
 };
-int                             EVS_log_fd = 0;                 // ログファイルディスクリプタ
+const char                      *logevent_list[] = {            // ログ種別文字列テーブル(LogType、LogSinkの設定値)
+									"SYSTEM",
+									"QUERY",
+									"DUMP",
+};
 int                             EVS_log_mode = 0;               // ログモード(0:直接出力、1:キューイング)
+int                             EVS_log_event = LOG_EVENT_SYSTEM;   // 今のログ種別(LOG_EVENT_xxx)
+unsigned int                    EVS_log_route[LOG_EVENT_MAX][LOGLEVEL_MAX + 1] = {  // ログ振り分け表(設定ファイルを読み込むまでは、全部を標準ログに出力する)
+									{1, 1, 1, 1, 1, 1, 1},
+									{1, 1, 1, 1, 1, 1, 1},
+									{1, 1, 1, 1, 1, 1, 1},
+};
+struct EVS_flight_t             *EVS_flight_ring = NULL;        // フライトレコーダー(NULLなら記録しない)
 
 // ----------------
 // 以下、個別のAPI関連
@@ -138,8 +151,7 @@ int INIT_libev(void)
 	// イベントループの生成ができなかったら
 	if (!EVS_loop)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_loop_new(EVFLAG_AUTO): Cannot make new loop!?\n", __func__);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): ev_loop_new(EVFLAG_AUTO): Cannot make new loop!?\n", __func__);
 		return -1;
 	}
 
@@ -149,34 +161,36 @@ int INIT_libev(void)
 	// メッセージ用キュー処理
 	ev_idle_init(&idle_message_watcher, CB_idle_message);
 	ev_idle_start(EVS_loop, &idle_message_watcher);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_idle_init(CB_idle_message): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_idle_start(idle_message_watcher): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): ev_idle_init(CB_idle_message): OK.\n", __func__);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): ev_idle_start(idle_message_watcher): OK.\n", __func__);
 
 	// ----------------
 	// シグナル系イベント初期化処理
 	// ----------------
 	ev_signal_init(&signal_watcher_sighup, CB_sighup, SIGHUP);
 	ev_signal_start(EVS_loop, &signal_watcher_sighup);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_signal_init(CB_sighup): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_signal_start(signal_watcher_sighup): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): ev_signal_init(CB_sighup): OK.\n", __func__);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): ev_signal_start(signal_watcher_sighup): OK.\n", __func__);
 
 	ev_signal_init(&signal_watcher_sigint, CB_sigint, SIGINT);
 	ev_signal_start(EVS_loop, &signal_watcher_sigint);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_signal_init(CB_sigint): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_signal_start(signal_watcher_sigint): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): ev_signal_init(CB_sigint): OK.\n", __func__);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): ev_signal_start(signal_watcher_sigint): OK.\n", __func__);
 
 	ev_signal_init(&signal_watcher_sigterm, CB_sigterm, SIGTERM);
 	ev_signal_start(EVS_loop, &signal_watcher_sigterm);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_signal_init(CB_sigterm): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_signal_start(signal_watcher_sigterm): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): ev_signal_init(CB_sigterm): OK.\n", __func__);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): ev_signal_start(signal_watcher_sigterm): OK.\n", __func__);
+
+	ev_signal_init(&signal_watcher_sigusr1, CB_sigusr1, SIGUSR1);
+	ev_signal_start(EVS_loop, &signal_watcher_sigusr1);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): ev_signal_init(CB_sigusr1): OK.\n", __func__);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): ev_signal_start(signal_watcher_sigusr1): OK.\n", __func__);
+
+	ev_signal_init(&signal_watcher_sigusr2, CB_sigusr2, SIGUSR2);
+	ev_signal_start(EVS_loop, &signal_watcher_sigusr2);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): ev_signal_init(CB_sigusr2): OK.\n", __func__);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): ev_signal_start(signal_watcher_sigusr2): OK.\n", __func__);
 
 	return 0;
 }
@@ -195,22 +209,19 @@ int INIT_openssl(void)
 	// サーバー証明書(PEM)CAファイルがNULLなら
 	if (EVS_config.ssl_ca_file == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot open SSL/TLS CA file!? %s\n", __func__, EVS_config.ssl_ca_file);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot open SSL/TLS CA file!? %s\n", __func__, EVS_config.ssl_ca_file);
 		return 0;
 	}
 	// サーバー証明書(PEM)CERTファイルがNULLなら
 	if (EVS_config.ssl_cert_file == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot open SSL/TLS CERT file!? %s\n", __func__, EVS_config.ssl_cert_file);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot open SSL/TLS CERT file!? %s\n", __func__, EVS_config.ssl_cert_file);
 		return 0;
 	}
 	// サーバー証明書(PEM)KEYファイルがNULLなら
 	if (EVS_config.ssl_key_file == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot open SSL/TLS KEY file!? %s\n", __func__, EVS_config.ssl_key_file);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot open SSL/TLS KEY file!? %s\n", __func__, EVS_config.ssl_key_file);
 		return 0;
 	}
 
@@ -222,12 +233,10 @@ int INIT_openssl(void)
 	EVS_ctx = SSL_CTX_new(TLS_server_method());
 	if (EVS_ctx == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): SSL_CTX_new(): Cannot initialize SSL_CTX!? %s\n", __func__, ERR_reason_error_string(ERR_get_error()));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): SSL_CTX_new(): Cannot initialize SSL_CTX!? %s\n", __func__, ERR_reason_error_string(ERR_get_error()));
 		return init_result;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): SSL_CTX_new(): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): SSL_CTX_new(): OK.\n", __func__);
 
 	// SSL設定でTLSv1.2以上しか許可しない(1.1.0以降はSSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION)、でいい)
 	SSL_CTX_set_min_proto_version(EVS_ctx, TLS1_2_VERSION);
@@ -239,45 +248,37 @@ int INIT_openssl(void)
 	init_result = SSL_CTX_load_verify_locations(EVS_ctx, EVS_config.ssl_ca_file, NULL);
 	if (init_result != 1)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): SSL_CTX_load_verify_locations(%s): %s\n", __func__, EVS_config.ssl_ca_file, ERR_reason_error_string(ERR_get_error()));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): SSL_CTX_load_verify_locations(%s): %s\n", __func__, EVS_config.ssl_ca_file, ERR_reason_error_string(ERR_get_error()));
 		return 0;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "SSL_CTX_load_verify_locations(%s): OK.\n", EVS_config.ssl_ca_file);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "SSL_CTX_load_verify_locations(%s): OK.\n", EVS_config.ssl_ca_file);
 
 	// サーバー証明書(PEM)CERTファイルの設定
 	init_result = SSL_CTX_use_certificate_file(EVS_ctx, EVS_config.ssl_cert_file, SSL_FILETYPE_PEM);
 	if (init_result != 1)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): SSL_CTX_use_certificate_file(%s): %s\n", __func__, EVS_config.ssl_cert_file, ERR_reason_error_string(ERR_get_error()));
-	   logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): SSL_CTX_use_certificate_file(%s): %s\n", __func__, EVS_config.ssl_cert_file, ERR_reason_error_string(ERR_get_error()));
 		return 0;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "SSL_CTX_use_certificate_file(%s): OK.\n", EVS_config.ssl_cert_file);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "SSL_CTX_use_certificate_file(%s): OK.\n", EVS_config.ssl_cert_file);
 
 	// サーバー証明書(PEM)KEYファイルの設定
 	init_result = SSL_CTX_use_PrivateKey_file(EVS_ctx, EVS_config.ssl_key_file, SSL_FILETYPE_PEM);
 	if (init_result != 1)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): SSL_CTX_use_PrivateKey_file(%s): %s\n", __func__, EVS_config.ssl_key_file, ERR_reason_error_string(ERR_get_error()));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): SSL_CTX_use_PrivateKey_file(%s): %s\n", __func__, EVS_config.ssl_key_file, ERR_reason_error_string(ERR_get_error()));
 		return 0;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "SSL_CTX_use_PrivateKey_file(%s): OK.\n", EVS_config.ssl_key_file);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "SSL_CTX_use_PrivateKey_file(%s): OK.\n", EVS_config.ssl_key_file);
 
 	// CERTとKEYとの整合性をチェック
 	init_result = SSL_CTX_check_private_key(EVS_ctx);
 	if (init_result != 1)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): SSL_CTX_check_private_key(): %s\n", __func__, ERR_reason_error_string(ERR_get_error()));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): SSL_CTX_check_private_key(): %s\n", __func__, ERR_reason_error_string(ERR_get_error()));
 		return 0;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "SSL_CTX_check_private_key(): OK.\n");
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "SSL_CTX_check_private_key(): OK.\n");
 
 	return 1;
 }
@@ -305,12 +306,10 @@ int INIT_keepalive(struct EVS_ev_server_t * server_watcher)
 	// ソケットのオプション設定が出来なかったら
 	if (socket_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): setsockopt(fd=%d, SOL_SOCKET, SO_KEEPALIVE, keepalive=%d): Cannot set socket option!? errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_config.keepalive, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): setsockopt(fd=%d, SOL_SOCKET, SO_KEEPALIVE, keepalive=%d): Cannot set socket option!? errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_config.keepalive, errno, strerror(errno));
 		return -1;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): setsockopt(socket_fd=%d, SOL_SOCKET, SO_KEEPALIVE, keepalive=%d): OK.\n", __func__, server_watcher->socket_fd, EVS_config.keepalive);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): setsockopt(socket_fd=%d, SOL_SOCKET, SO_KEEPALIVE, keepalive=%d): OK.\n", __func__, server_watcher->socket_fd, EVS_config.keepalive);
 
 	// KeepAliveのパラメータは 
 	// ・TCP_KEEPIDLE       → /proc/sys/net/ipv6/tcp_keepalive_time     (デフォルト7200秒)
@@ -326,36 +325,30 @@ int INIT_keepalive(struct EVS_ev_server_t * server_watcher)
 		// ソケットのオプション設定が出来なかったら
 		if (socket_result < 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): setsockopt(fd=%d, IPPROTO_TCP, TCP_KEEPIDLE, idletime=%d): Cannot set socket option!? errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_config.keepalive_idletime, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): setsockopt(fd=%d, IPPROTO_TCP, TCP_KEEPIDLE, idletime=%d): Cannot set socket option!? errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_config.keepalive_idletime, errno, strerror(errno));
 			return -1;
 		}
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): setsockopt(fd=%d, IPPROTO_TCP, TCP_KEEPIDLE, idletime=%d): OK.\n", __func__, server_watcher->socket_fd, EVS_config.keepalive_idletime);
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): setsockopt(fd=%d, IPPROTO_TCP, TCP_KEEPIDLE, idletime=%d): OK.\n", __func__, server_watcher->socket_fd, EVS_config.keepalive_idletime);
 
 		// TCP_KEEPINTVLを設定 → https://linuxjm.osdn.jp/html/LDP_man-pages/man7/tcp.7.html
 		socket_result = setsockopt(server_watcher->socket_fd, IPPROTO_TCP, TCP_KEEPINTVL, &EVS_config.keepalive_intval, sizeof(EVS_config.keepalive_intval));
 		// ソケットのオプション設定が出来なかったら
 		if (socket_result < 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): setsockopt(fd=%d, IPPROTO_TCP, TCP_KEEPINTVL, intval=%d): Cannot set socket option!? errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_config.keepalive_intval, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): setsockopt(fd=%d, IPPROTO_TCP, TCP_KEEPINTVL, intval=%d): Cannot set socket option!? errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_config.keepalive_intval, errno, strerror(errno));
 			return -1;
 		}
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): setsockopt(fd=%d, IPPROTO_TCP, TCP_KEEPINTVL, intval=%d): OK.\n", __func__, server_watcher->socket_fd, EVS_config.keepalive_intval);
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): setsockopt(fd=%d, IPPROTO_TCP, TCP_KEEPINTVL, intval=%d): OK.\n", __func__, server_watcher->socket_fd, EVS_config.keepalive_intval);
 
 		// TCP_KEEPCNTを設定 → https://linuxjm.osdn.jp/html/LDP_man-pages/man7/tcp.7.html
 		socket_result = setsockopt(server_watcher->socket_fd, IPPROTO_TCP, TCP_KEEPCNT, &EVS_config.keepalive_probes, sizeof(EVS_config.keepalive_probes));
 		// ソケットのオプション設定が出来なかったら
 		if (socket_result < 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): setsockopt(fd=%d, IPPROTO_TCP, TCP_KEEPCNT, probes=%d): Cannot set socket option!? errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_config.keepalive_probes, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): setsockopt(fd=%d, IPPROTO_TCP, TCP_KEEPCNT, probes=%d): Cannot set socket option!? errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_config.keepalive_probes, errno, strerror(errno));
 			return -1;
 		}
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): setsockopt(fd=%d, IPPROTO_TCP, TCP_KEEPCNT, probes=%d): OK.\n", __func__, server_watcher->socket_fd, EVS_config.keepalive_probes);
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): setsockopt(fd=%d, IPPROTO_TCP, TCP_KEEPCNT, probes=%d): OK.\n", __func__, server_watcher->socket_fd, EVS_config.keepalive_probes);
 	}
 
 	return 0;
@@ -376,8 +369,7 @@ int INIT_pf_inet6(struct EVS_ev_server_t * server_watcher)
 	// プロトコルファミリーがPF_INET6でなければ
 	if (server_watcher->socket_address.sa_ipv6.sin6_family != PF_INET6)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(%d): Cannot support protocol family!?\n", __func__, server_watcher->socket_address.sa_ipv6.sin6_family);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(%d): Cannot support protocol family!?\n", __func__, server_watcher->socket_address.sa_ipv6.sin6_family);
 		return -1;
 	}
 
@@ -388,12 +380,10 @@ int INIT_pf_inet6(struct EVS_ev_server_t * server_watcher)
 	// ソケット生成が出来なかったら
 	if (socket_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): socket(%s, SOCK_STREAM, 0): Cannot create new socket? errno=%d (%s)\n", __func__, pf_name_list[server_watcher->socket_address.sa_ipv6.sin6_family], errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): socket(%s, SOCK_STREAM, 0): Cannot create new socket? errno=%d (%s)\n", __func__, pf_name_list[server_watcher->socket_address.sa_ipv6.sin6_family], errno, strerror(errno));
 		return -1;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): socket(%s, SOCK_STREAM, 0): Create new socket. fd=%d\n", __func__, pf_name_list[server_watcher->socket_address.sa_ipv6.sin6_family], socket_result);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): socket(%s, SOCK_STREAM, 0): Create new socket. fd=%d\n", __func__, pf_name_list[server_watcher->socket_address.sa_ipv6.sin6_family], socket_result);
 	// ソケットディスクリプタを設定
 	server_watcher->socket_fd = socket_result;
 
@@ -409,12 +399,10 @@ int INIT_pf_inet6(struct EVS_ev_server_t * server_watcher)
 	// ソケットのオプション設定が出来なかったら
 	if (socket_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): setsockopt(fd=%d, IPPROTO_IPV6, IPV6_V6ONLY, ipv6=%d): Cannot set socket option!? errno=%d (%s)\n", __func__, server_watcher->socket_fd, ipv6only_flag, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): setsockopt(fd=%d, IPPROTO_IPV6, IPV6_V6ONLY, ipv6=%d): Cannot set socket option!? errno=%d (%s)\n", __func__, server_watcher->socket_fd, ipv6only_flag, errno, strerror(errno));
 		return -1;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): setsockopt(fd=%d, IPPROTO_IPV6, IPV6_V6ONLY, ipv6=%d): OK.\n", __func__, server_watcher->socket_fd, ipv6only_flag);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): setsockopt(fd=%d, IPPROTO_IPV6, IPV6_V6ONLY, ipv6=%d): OK.\n", __func__, server_watcher->socket_fd, ipv6only_flag);
 
 	// ----------------
 	// ソケット紐づけ(bind : ソケットのファイルディスクリプタとIPv6ソケットソケットアドレスを紐づけ)
@@ -423,12 +411,10 @@ int INIT_pf_inet6(struct EVS_ev_server_t * server_watcher)
 	// ソケットアドレスの紐づけが出来なかったら
 	if (socket_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): bind(fd=%d, in6addr_any): Cannot socket binding? errno=%d (%s)\n", __func__, server_watcher->socket_fd, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): bind(fd=%d, in6addr_any): Cannot socket binding? errno=%d (%s)\n", __func__, server_watcher->socket_fd, errno, strerror(errno));
 		return -1;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): bind(fd=%d, in6addr_any): OK.\n", __func__, server_watcher->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): bind(fd=%d, in6addr_any): OK.\n", __func__, server_watcher->socket_fd);
 
 	// ----------------
 	// KeepAliveの初期化
@@ -437,12 +423,10 @@ int INIT_pf_inet6(struct EVS_ev_server_t * server_watcher)
 	// ソケットのKeepAlive設定が出来なかったら
 	if (socket_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): INIT_keepalive(fd=%d, keepalive=%d): Cannot set socket option!? errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_config.keepalive, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): INIT_keepalive(fd=%d, keepalive=%d): Cannot set socket option!? errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_config.keepalive, errno, strerror(errno));
 		return -1;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): INIT_keepalive(fd=%d, keepalive=%d): OK.\n", __func__, server_watcher->socket_fd, EVS_config.keepalive);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): INIT_keepalive(fd=%d, keepalive=%d): OK.\n", __func__, server_watcher->socket_fd, EVS_config.keepalive);
 
 	// ----------------
 	// ソケットリッスン(listen : SOMAXCONN = /proc/sys/net/core/somaxconnの値を接続最大数としてリッスン開始)
@@ -451,20 +435,17 @@ int INIT_pf_inet6(struct EVS_ev_server_t * server_watcher)
 	// ソケットアドレスの紐づけが出来なかったら
 	if (socket_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): listen(fd=%d, %d): Cannot socket listen? errno=%d (%s)\n", __func__, server_watcher->socket_fd, SOMAXCONN, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): listen(fd=%d, %d): Cannot socket listen? errno=%d (%s)\n", __func__, server_watcher->socket_fd, SOMAXCONN, errno, strerror(errno));
 		return -1;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): listen(fd=%d, %d): OK.\n", __func__, server_watcher->socket_fd, SOMAXCONN);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): listen(fd=%d, %d): OK.\n", __func__, server_watcher->socket_fd, SOMAXCONN);
 
 	// --------------------------------
 	// テールキュー処理
 	// --------------------------------
 	// テールキューの最後にこの接続の情報を追加する
 	TAILQ_INSERT_TAIL(&EVS_server_tailq, server_watcher, entries);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INSERT_TAIL(server fd=%d): OK.\n", __func__, server_watcher->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): TAILQ_INSERT_TAIL(server fd=%d): OK.\n", __func__, server_watcher->socket_fd);
 
 	// --------------------------------
 	// libev 処理
@@ -472,10 +453,8 @@ int INIT_pf_inet6(struct EVS_ev_server_t * server_watcher)
 	// サーバー別設定用構造体ポインタのI/O監視オブジェクトに対して、コールバック処理とソケットファイルディスクリプタ、そしてイベントのタイプを設定する
 	ev_io_init(&server_watcher->io_watcher, CB_accept, server_watcher->socket_fd, EV_READ);
 	ev_io_start(EVS_loop, &server_watcher->io_watcher);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_io_init(CB_accept, server fd=%d, EV_READ): OK.\n", __func__, server_watcher->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_io_start(): OK. Priority=%d\n", __func__, ev_priority(&server_watcher->io_watcher));
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): ev_io_init(CB_accept, server fd=%d, EV_READ): OK.\n", __func__, server_watcher->socket_fd);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): ev_io_start(): OK. Priority=%d\n", __func__, ev_priority(&server_watcher->io_watcher));
 
 	return socket_result;
 }
@@ -494,8 +473,7 @@ int INIT_pf_inet(struct EVS_ev_server_t * server_watcher)
 	// プロトコルファミリーがPF_INETでなければ
 	if (server_watcher->socket_address.sa_ipv4.sin_family != PF_INET)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(%d): Cannot support protocol family!?\n", __func__, server_watcher->socket_address.sa_ipv4.sin_family);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(%d): Cannot support protocol family!?\n", __func__, server_watcher->socket_address.sa_ipv4.sin_family);
 		return -1;
 	}
 
@@ -506,12 +484,10 @@ int INIT_pf_inet(struct EVS_ev_server_t * server_watcher)
 	// ソケット生成が出来なかったら
 	if (socket_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): socket(%s, SOCK_STREAM, 0): Cannot create new socket? errno=%d (%s)\n", __func__, pf_name_list[server_watcher->socket_address.sa_ipv4.sin_family], errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): socket(%s, SOCK_STREAM, 0): Cannot create new socket? errno=%d (%s)\n", __func__, pf_name_list[server_watcher->socket_address.sa_ipv4.sin_family], errno, strerror(errno));
 		return -1;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): socket(%s, SOCK_STREAM, 0): Create new socket. fd=%d\n", __func__, pf_name_list[server_watcher->socket_address.sa_ipv4.sin_family], socket_result);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): socket(%s, SOCK_STREAM, 0): Create new socket. fd=%d\n", __func__, pf_name_list[server_watcher->socket_address.sa_ipv4.sin_family], socket_result);
 	// ソケットディスクリプタを設定
 	server_watcher->socket_fd = socket_result;
 
@@ -527,12 +503,10 @@ int INIT_pf_inet(struct EVS_ev_server_t * server_watcher)
 	// ソケットアドレスの紐づけが出来なかったら
 	if (socket_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): bind(fd=%d, INADDR_ANY): Cannot socket binding? errno=%d (%s)\n", __func__, server_watcher->socket_fd, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): bind(fd=%d, INADDR_ANY): Cannot socket binding? errno=%d (%s)\n", __func__, server_watcher->socket_fd, errno, strerror(errno));
 		return -1;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): bind(fd=%d, INADDR_ANY): OK.\n", __func__, server_watcher->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): bind(fd=%d, INADDR_ANY): OK.\n", __func__, server_watcher->socket_fd);
 
 	// ----------------
 	// KeepAliveの初期化
@@ -541,12 +515,10 @@ int INIT_pf_inet(struct EVS_ev_server_t * server_watcher)
 	// ソケットのKeepAlive設定が出来なかったら
 	if (socket_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): INIT_keepalive(fd=%d, keepalive=%d): Cannot set socket option!? errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_config.keepalive, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): INIT_keepalive(fd=%d, keepalive=%d): Cannot set socket option!? errno=%d (%s)\n", __func__, server_watcher->socket_fd, EVS_config.keepalive, errno, strerror(errno));
 		return -1;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): INIT_keepalive(fd=%d, keepalive=%d): OK.\n", __func__, server_watcher->socket_fd, EVS_config.keepalive);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): INIT_keepalive(fd=%d, keepalive=%d): OK.\n", __func__, server_watcher->socket_fd, EVS_config.keepalive);
 
 	// ----------------
 	// ソケットリッスン(listen : SOMAXCONN = /proc/sys/net/core/somaxconnの値を接続最大数としてリッスン開始)
@@ -555,20 +527,17 @@ int INIT_pf_inet(struct EVS_ev_server_t * server_watcher)
 	// ソケットアドレスの紐づけが出来なかったら
 	if (socket_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): listen(fd=%d, %d): Cannot socket listen? errno=%d (%s)\n", __func__, server_watcher->socket_fd, SOMAXCONN, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): listen(fd=%d, %d): Cannot socket listen? errno=%d (%s)\n", __func__, server_watcher->socket_fd, SOMAXCONN, errno, strerror(errno));
 		return -1;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): listen(fd=%d, %d): OK.\n", __func__, server_watcher->socket_fd, SOMAXCONN);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): listen(fd=%d, %d): OK.\n", __func__, server_watcher->socket_fd, SOMAXCONN);
 
 	// --------------------------------
 	// テールキュー処理
 	// --------------------------------
 	// テールキューの最後にこの接続の情報を追加する
 	TAILQ_INSERT_TAIL(&EVS_server_tailq, server_watcher, entries);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INSERT_TAIL(server fd=%d): OK.\n", __func__, server_watcher->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): TAILQ_INSERT_TAIL(server fd=%d): OK.\n", __func__, server_watcher->socket_fd);
 
 	// --------------------------------
 	// libev 処理
@@ -576,10 +545,8 @@ int INIT_pf_inet(struct EVS_ev_server_t * server_watcher)
 	// サーバー別設定用構造体ポインタのI/O監視オブジェクトに対して、コールバック処理とソケットファイルディスクリプタ、そしてイベントのタイプを設定する
 	ev_io_init(&server_watcher->io_watcher, CB_accept, server_watcher->socket_fd, EV_READ);
 	ev_io_start(EVS_loop, &server_watcher->io_watcher);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_io_init(CB_accept, server fd=%d, EV_READ): OK.\n", __func__, server_watcher->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_io_start(): OK. Priority=%d\n", __func__, ev_priority(&server_watcher->io_watcher));
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): ev_io_init(CB_accept, server fd=%d, EV_READ): OK.\n", __func__, server_watcher->socket_fd);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): ev_io_start(): OK. Priority=%d\n", __func__, ev_priority(&server_watcher->io_watcher));
 
 	return socket_result;
 }
@@ -598,8 +565,7 @@ int INIT_pf_unix(struct EVS_ev_server_t * server_watcher)
 	// プロトコルファミリーがPF_UNIXでなければ
 	if (server_watcher->socket_address.sa_un.sun_family != PF_UNIX)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(%d): Cannot support protocol family!?\n", __func__, server_watcher->socket_address.sa_un.sun_family);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(%d): Cannot support protocol family!?\n", __func__, server_watcher->socket_address.sa_un.sun_family);
 		return -1;
 	}
 
@@ -610,12 +576,10 @@ int INIT_pf_unix(struct EVS_ev_server_t * server_watcher)
 	// ソケット生成が出来なかったら
 	if (socket_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): socket(%s, SOCK_STREAM): Cannot create new socket? errno=%d (%s)\n", __func__, pf_name_list[server_watcher->socket_address.sa_un.sun_family], errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): socket(%s, SOCK_STREAM): Cannot create new socket? errno=%d (%s)\n", __func__, pf_name_list[server_watcher->socket_address.sa_un.sun_family], errno, strerror(errno));
 		return -1;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): socket(%s, SOCK_STREAM): Create new socket. fd=%d\n", __func__, pf_name_list[server_watcher->socket_address.sa_un.sun_family], socket_result);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): socket(%s, SOCK_STREAM): Create new socket. fd=%d\n", __func__, pf_name_list[server_watcher->socket_address.sa_un.sun_family], socket_result);
 	// ソケットディスクリプタを設定
 	server_watcher->socket_fd = socket_result;
 
@@ -631,12 +595,10 @@ int INIT_pf_unix(struct EVS_ev_server_t * server_watcher)
 	// ソケットアドレスの紐づけが出来なかったら
 	if (socket_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): bind(fd=%d, %s): Cannot socket binding? errno=%d (%s)\n", __func__, server_watcher->socket_fd, server_watcher->socket_address.sa_un.sun_path, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): bind(fd=%d, %s): Cannot socket binding? errno=%d (%s)\n", __func__, server_watcher->socket_fd, server_watcher->socket_address.sa_un.sun_path, errno, strerror(errno));
 		return -1;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): bind(fd=%d, %s): OK.\n", __func__, server_watcher->socket_fd, server_watcher->socket_address.sa_un.sun_path);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): bind(fd=%d, %s): OK.\n", __func__, server_watcher->socket_fd, server_watcher->socket_address.sa_un.sun_path);
 
 	// ----------------
 	// UNIXドメイン以外のソケット(!= PF_UNIX)なら、ソケットのその他のパラメータを設定(KeepAlive、Timeout、バッファサイズ、バッファリングOFF、etc...)
@@ -650,20 +612,17 @@ int INIT_pf_unix(struct EVS_ev_server_t * server_watcher)
 	// ソケットアドレスの紐づけが出来なかったら
 	if (socket_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): listen(fd=%d, %d):Cannot socket listen? errno=%d (%s)\n", __func__, server_watcher->socket_fd, SOMAXCONN, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): listen(fd=%d, %d):Cannot socket listen? errno=%d (%s)\n", __func__, server_watcher->socket_fd, SOMAXCONN, errno, strerror(errno));
 		return -1;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): listen(fd=%d, %d): OK.\n", __func__, server_watcher->socket_fd, SOMAXCONN);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): listen(fd=%d, %d): OK.\n", __func__, server_watcher->socket_fd, SOMAXCONN);
 
 	// --------------------------------
 	// テールキュー処理
 	// --------------------------------
 	// テールキューの最後にこの接続の情報を追加する
 	TAILQ_INSERT_TAIL(&EVS_server_tailq, server_watcher, entries);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INSERT_TAIL(server fd=%d): OK.\n", __func__, server_watcher->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): TAILQ_INSERT_TAIL(server fd=%d): OK.\n", __func__, server_watcher->socket_fd);
 
 	// --------------------------------
 	// libev 処理
@@ -671,10 +630,8 @@ int INIT_pf_unix(struct EVS_ev_server_t * server_watcher)
 	// サーバー別設定用構造体ポインタのI/O監視オブジェクトに対して、コールバック処理とソケットファイルディスクリプタ、そしてイベントのタイプを設定する
 	ev_io_init(&server_watcher->io_watcher, CB_accept, server_watcher->socket_fd, EV_READ);
 	ev_io_start(EVS_loop, &server_watcher->io_watcher);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_io_init(CB_accept, server fd=%d, EV_READ): OK.\n", __func__, server_watcher->socket_fd);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_io_start(): OK. Priority=%d\n", __func__, ev_priority(&server_watcher->io_watcher));
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): ev_io_init(CB_accept, server fd=%d, EV_READ): OK.\n", __func__, server_watcher->socket_fd);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): ev_io_start(): OK. Priority=%d\n", __func__, ev_priority(&server_watcher->io_watcher));
 
 	return socket_result;
 }
@@ -704,8 +661,7 @@ int INIT_socket(struct EVS_port_t *listen_port)
 		// メモリ領域が確保できなかったら
 		if (server_watcher == NULL)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot calloc server_watcher's memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc server_watcher's memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 			return -1;
 		}
 		// ----------------
@@ -729,8 +685,7 @@ int INIT_socket(struct EVS_port_t *listen_port)
 			// メモリ領域が確保できなかったら
 			if (server_watcher == NULL)
 			{
-				snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot calloc server_watcher's memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-				logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+				LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc server_watcher's memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 				return -1;
 			}
 			// ----------------
@@ -752,8 +707,7 @@ int INIT_socket(struct EVS_port_t *listen_port)
 			// メモリ領域が確保できなかったら
 			if (server_watcher == NULL)
 			{
-				snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot calloc server_watcher's memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-				logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+				LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc server_watcher's memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 				return -1;
 			}
 			// ----------------
@@ -769,8 +723,7 @@ int INIT_socket(struct EVS_port_t *listen_port)
 	// 上記以外場合には
 	else
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot support port number!? %d\n", listen_port->port);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot support port number!? %d\n", listen_port->port);
 		init_result = -1;
 	}
 
@@ -795,38 +748,31 @@ int INIT_all(int argc, char *argv[])
 	// --------------------------------
 	// ポート用テールキューの初期化
 	TAILQ_INIT(&EVS_port_tailq);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INIT(&EVS_port_tailq): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): TAILQ_INIT(&EVS_port_tailq): OK.\n", __func__);
 
 	// データベース用テールキューの初期化
 	TAILQ_INIT(&EVS_db_tailq);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INIT(&EVS_db_tailq): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): TAILQ_INIT(&EVS_db_tailq): OK.\n", __func__);
 
 	// サーバー用テールキューの初期化
 	TAILQ_INIT(&EVS_server_tailq);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INIT(&EVS_server_tailq): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): TAILQ_INIT(&EVS_server_tailq): OK.\n", __func__);
 
 	// クライアント用テールキューの初期化
 	TAILQ_INIT(&EVS_client_tailq);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INIT(&EVS_client_tailq): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): TAILQ_INIT(&EVS_client_tailq): OK.\n", __func__);
 
 	// PostgreSQL用テールキューの初期化
 	TAILQ_INIT(&EVS_pgsql_tailq);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INIT(&EVS_pgsql_tailq): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): TAILQ_INIT(&EVS_pgsql_tailq): OK.\n", __func__);
 
 	// メッセージ用テールキューの初期化
 	TAILQ_INIT(&EVS_message_tailq);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INIT(&EVS_message_tailq): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): TAILQ_INIT(&EVS_message_tailq): OK.\n", __func__);
 
 	// タイマー用テールキューの初期化
 	TAILQ_INIT(&EVS_timer_tailq);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INIT(&EVS_timer_tailq): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): TAILQ_INIT(&EVS_timer_tailq): OK.\n", __func__);
 
 	// --------------------------------
 	// 各種設定値初期化処理
@@ -834,18 +780,23 @@ int INIT_all(int argc, char *argv[])
 	init_result = INIT_config(argc, argv);
 	if (init_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): INIT_config(): Cannot initialize config!?\n", __func__);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): INIT_config(): Cannot initialize config!?\n", __func__);
+		return init_result;
+	}
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): INIT_config(): OK.\n", __func__);
+
+	// 経路表作成処理(データベース名・ユーザー名から、データベース別設定を引けるようにする)
+	init_result = API_route_build();
+	if (init_result < 0)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): API_route_build(): Cannot build routing table!?\n", __func__);
 		return init_result;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): INIT_config(): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
 
 	// pidファイルの設定がないなら
 	if (EVS_config.pid_file == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot find PID filename!?\n", __func__);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot find PID filename!?\n", __func__);
 		return -1;
 	}
 	// pidファイルを読み込みで開いてみる
@@ -853,8 +804,7 @@ int INIT_all(int argc, char *argv[])
 	// pidファイルが開けてしまうなら
 	if (pidfile_fd != -1)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Found other process PID file!? errno=%d (%s)\n", __func__, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Found other process PID file!? errno=%d (%s)\n", __func__, errno, strerror(errno));
 		// PIDファイルを閉じる
 		close(pidfile_fd);
 		return -1;
@@ -866,24 +816,21 @@ int INIT_all(int argc, char *argv[])
 	// // デーモンモードが1:ONなら
 	if (EVS_config.daemon == 1)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): daemon(): Go!\n", __func__);               // daemon(): を呼ぶ前にログを出力
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): daemon(): Go!\n", __func__);               // daemon(): を呼ぶ前にログを出力
 	
 		// プロセスをdaemon()で子プロセスを生成する
 		init_result = daemon(0, 1);
 		// 子プロセスが生成できなかったら
 		if (init_result == -1)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot daemonized new process!? errno=%d (%s)\n", __func__, errno, strerror(errno));
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot daemonized new process!? errno=%d (%s)\n", __func__, errno, strerror(errno));
 			return -1;
 		}
 		// 子プロセスが生成できたら
 		else if (init_result != 0)
 		{
 			// 親プロセスはここで終わり(実際にはここには来ないけど念のためexit(0)しといて、あとはデーモン化したプロセスに任せる)
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): daemonized OK!!\n", __func__);
-			logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): daemonized OK!!\n", __func__);
 			exit(0);
 		}
 	}
@@ -896,8 +843,7 @@ int INIT_all(int argc, char *argv[])
 	// PIDファイルが開けなかったら
 	if (pidfile_fd == -1)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot create PID file!? errno=%d (%s)\n", __func__, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot create PID file!? errno=%d (%s)\n", __func__, errno, strerror(errno));
 		return -1;
 	}
 	// プロセスIDを取得
@@ -909,8 +855,7 @@ int INIT_all(int argc, char *argv[])
 	// PIDファイルにプロセスIDを書き出せなかったら
 	if (init_result != strlen(log_str))
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot write PID file!? init_result=%d!=%d errno=%d (%s)\n", __func__, init_result, strlen(log_str) + 1,errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot write PID file!? init_result=%d!=%d errno=%d (%s)\n", __func__, init_result, strlen(log_str) + 1,errno, strerror(errno));
 		// PIDファイルを閉じる
 		close(pidfile_fd);
 		return -1;
@@ -926,20 +871,17 @@ int INIT_all(int argc, char *argv[])
 	// メモリ領域が確保できなかったら
 	if (listen_port == NULL)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot calloc memory? errno=%d (%s)\n", __func__, errno, strerror(errno));
 		return -1;
 	}
 	listen_port->port = 0;                              // ポート番号を設定する(以下、念のため同様に)
 	listen_port->ipv4 = 0;                              // IPv4フラグ(0:OFF、1:ON)に0(=OFF)を設定する
 	listen_port->ipv6 = 0;                              // IPv6フラグ(0:OFF、1:ON)に0(=OFF)を設定する
 	listen_port->ssl = 0;                               // SSL/TLSフラグ(0:OFF、1:ON)に1を設定する
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): UNIX Domain socket preparation.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): UNIX Domain socket preparation.\n", __func__);
 	// テールキューの最後にこの接続の情報を追加する
 	TAILQ_INSERT_TAIL(&EVS_port_tailq, listen_port, entries);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): TAILQ_INSERT_TAIL(listen_port): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): TAILQ_INSERT_TAIL(listen_port): OK.\n", __func__);
 
 	// --------------------------------
 	// OpenSSL関連初期化処理
@@ -947,8 +889,7 @@ int INIT_all(int argc, char *argv[])
 	// SSL/TLS対応しないなら
 	if (EVS_config.ssl_support == 0)
 	{
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): SSL/TLS not support by config.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): SSL/TLS not support by config.\n", __func__);
 	}
 	// SSL/TLS対応するなら
 	else
@@ -957,12 +898,10 @@ int INIT_all(int argc, char *argv[])
 		init_result = INIT_openssl();
 		if (init_result == 0)                                // OpenSSL関連は、戻り値が0だとエラーなのでこの判定条件になる
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): INIT_openssl(): Cannot initialize openssl etc...!?\n", __func__);
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): INIT_openssl(): Cannot initialize openssl etc...!?\n", __func__);
 			return -1;                                        // なので、ここでは0を返さず-1を返すのがいいだろう
 		}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): INIT_openssl(): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): INIT_openssl(): OK.\n", __func__);
 	}
 	// あとはポート毎に、SSL/TLS対応するかどうかを設定する
 
@@ -972,12 +911,10 @@ int INIT_all(int argc, char *argv[])
 	init_result = INIT_libev();
 	if (init_result < 0)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): INIT_libev(): Cannot initialize libev etc...!?\n", __func__);
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): INIT_libev(): Cannot initialize libev etc...!?\n", __func__);
 		return init_result;
 	}
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): INIT_libev(): OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): INIT_libev(): OK.\n", __func__);
 
 	// --------------------------------
 	// ポート別初期化処理 (getaddrinfo()を使う方法もあるが、どうせPF_UNIXは別処理しないといけないし、結局今回はポート別にsocket→bind→listenする)
@@ -989,12 +926,10 @@ int INIT_all(int argc, char *argv[])
 		init_result = INIT_socket(listen_port);
 		if (init_result < 0)
 		{
-			snprintf(log_str, MAX_LOG_LENGTH, "%s(): INIT_socket(): Cannot initialize socket!?\n", __func__);
-			logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): INIT_socket(): Cannot initialize socket!?\n", __func__);
 			return init_result;
 		}
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): INIT_socket(port=%d): OK.\n", __func__, listen_port->port);
-		logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): INIT_socket(port=%d): OK.\n", __func__, listen_port->port);
 	}
 
 	// --------------------------------
@@ -1007,14 +942,17 @@ int INIT_all(int argc, char *argv[])
 	// ----------------------------------------------------------------
 	// 以下、個別のAPI関連の初期化処理
 	// ----------------------------------------------------------------
+	// ログ書き出しスレッドを開始(デーモン化の後でないといけない。開始できなければイベントループで直接書き出す)
+	log_writer_start();
+	// フライトレコーダーを開始(前回が異常終了なら、残っていた記録をダンプしてから記録し直す。開始できなければ記録しない)
+	flight_start();
+
 	// ログモードを、1:キューイングに設定
 	EVS_log_mode = 1;
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): EVS_log_mode = 1(Queueing mode) OK.\n", __func__);
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): EVS_log_mode = 1(Queueing mode) OK.\n", __func__);
 
 	// 標準ログに出力
-	snprintf(log_str, MAX_LOG_LENGTH, "Initialized.\n");
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "Initialized.\n");
 
 	// 戻る
 	return init_result;
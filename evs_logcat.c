@@ -0,0 +1,409 @@
+// ----------------------------------------------------------------------
+// Protocol Analyzer for PostgreSQL -
+// Purpose:
+//     Render the binary event log (LogFormat = 1) as text or JSON.
+//
+// Program:
+//     Takeshi Kaburagi/MyDNS.JP    https://www.fvg-on.net/
+//
+// Usage:
+//     ./evs_logcat [-j] [logfile]
+//     (-j : JSON Lines, logfile : stdin if omitted)
+// ----------------------------------------------------------------------
+
+// ----------------------------------------------------------------------
+// ヘッダ部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// インクルード宣言
+// --------------------------------
+// autoconf用宣言
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdio.h>                                          // 標準入出力関連
+#include <stdarg.h>                                         // 可変長引数関連
+#include <stdlib.h>                                         // 標準処理関連
+#include <string.h>                                         // 文字列関連
+#include <time.h>                                           // 日時関連
+#include <unistd.h>                                         // getopt()関連
+
+#include "evs_event.h"                                      // バイナリイベントログのレコード形式
+
+// --------------------------------
+// 定数宣言
+// --------------------------------
+#define MAX_RENDER_LENGTH       8192                        // 一行の最大長(evs_pganalyzerのテキストのログより長ければよい)
+#define MAX_LOGCAT_ID           (16 * 1024 * 1024)          // 受け付ける文字列ID、セッションIDの最大値(壊れたファイルで巨大なメモリを確保しないように)
+
+// --------------------------------
+// 型宣言
+// --------------------------------
+struct LOGCAT_session_t {                                   // セッションの情報
+	char            *addr_str;                              // クライアントのアドレス文字列
+	char            *database;                              // データベース名
+	char            *username;                              // ユーザー名
+};
+
+// --------------------------------
+// 変数宣言
+// --------------------------------
+static const char               *loglevel_list[] = {        // ログレベル文字列テーブル(evs_init.cと同じ)
+									"DEBUG",
+									"INFO ",
+									"DUMP ",
+									"LOG  ",
+									"WARN ",
+									"ERROR",
+									"MAX!? ",
+};
+#define LOGCAT_LOGLEVEL_NUM     (int)(sizeof(loglevel_list) / sizeof(loglevel_list[0]))
+
+static char                     **LOGCAT_string_list = NULL;                // 文字列テーブル(文字列IDで引く)
+static unsigned int             LOGCAT_string_num = 0;                      // 文字列テーブルの大きさ
+static struct LOGCAT_session_t  *LOGCAT_session_list = NULL;                // セッションの情報(セッションIDで引く)
+static unsigned int             LOGCAT_session_num = 0;                     // セッションの情報の大きさ
+static int                      LOGCAT_json = 0;                            // 出力形式(0:テキスト, 1:JSON Lines)
+
+// ----------------------------------------------------------------------
+// コード部分
+// ----------------------------------------------------------------------
+// --------------------------------
+// 引数格納・書式化関数
+// --------------------------------
+// evs_event.c はevs_pganalyzerのevs_main.cと共用している(引数を並べる側と、書式化する側を同じ決まりにするため)
+#include "evs_event.c"
+
+// --------------------------------
+// 配列拡張処理(item_idが入る大きさまで拡張して、増えた分は0にする。0:OK, -1:NG)
+// --------------------------------
+static int logcat_grow(void **list_ptr, unsigned int *list_num, size_t item_size, unsigned int item_id)
+{
+	void                            *new_list;
+	unsigned int                    new_num;
+
+	if (item_id < *list_num)
+	{
+		return 0;
+	}
+	if (item_id >= MAX_LOGCAT_ID)
+	{
+		return -1;
+	}
+	new_num = (*list_num > 0) ? *list_num : 256;
+	while (new_num <= item_id)
+	{
+		new_num *= 2;
+	}
+	new_list = realloc(*list_ptr, new_num * item_size);
+	if (new_list == NULL)
+	{
+		return -1;
+	}
+	memset((char *)new_list + *list_num * item_size, 0, (new_num - *list_num) * item_size);
+	*list_ptr = new_list;
+	*list_num = new_num;
+	return 0;
+}
+
+// --------------------------------
+// 文字列複製処理(長さ指定)
+// --------------------------------
+static char *logcat_strndup(const char *str_ptr, size_t str_len)
+{
+	char                            *new_str;
+
+	new_str = (char *)malloc(str_len + 1);
+	if (new_str != NULL)
+	{
+		memcpy(new_str, str_ptr, str_len);
+		new_str[str_len] = '\0';
+	}
+	return new_str;
+}
+
+// --------------------------------
+// 文字列ID参照処理(未登録ならNULL)
+// --------------------------------
+static const char *logcat_string(uint32_t string_id)
+{
+	if (string_id >= LOGCAT_string_num)
+	{
+		return NULL;
+	}
+	return LOGCAT_string_list[string_id];
+}
+
+// --------------------------------
+// JSON文字列出力処理
+// --------------------------------
+static void logcat_json_str(const char *key_str, const char *value_ptr, size_t value_len)
+{
+	size_t                          value_pos;
+	unsigned char                   value_char;
+
+	printf(",\"%s\":\"", key_str);
+	for (value_pos = 0; value_pos < value_len; value_pos ++)
+	{
+		value_char = (unsigned char)value_ptr[value_pos];
+		if (value_char == '"' || value_char == '\\')
+		{
+			printf("\\%c", value_char);
+		}
+		else if (value_char == '\n')
+		{
+			printf("\\n");
+		}
+		else if (value_char == '\t')
+		{
+			printf("\\t");
+		}
+		else if (value_char < 0x20)
+		{
+			printf("\\u%04x", value_char);
+		}
+		else
+		{
+			putchar(value_char);
+		}
+	}
+	putchar('"');
+}
+
+// --------------------------------
+// レコード共通部分出力処理(テキストなら"[YYYY/MM/DD hh:mm:ss.uuuuuu] LEVEL:  "、JSONなら"{"time":..."の途中まで)
+// --------------------------------
+static void logcat_head(struct EVS_event_t *event_head, const char *event_str)
+{
+	time_t                          log_time = event_head->tv_sec;
+	struct tm                       *log_tm;
+	const char                      *level_str;
+
+	log_tm = localtime(&log_time);
+	level_str = (event_head->log_level < LOGCAT_LOGLEVEL_NUM) ? loglevel_list[event_head->log_level] : "?????";
+	if (LOGCAT_json == 0)
+	{
+		printf("[%d/%02d/%02d %02d:%02d:%02d.%06u] %s:  ", log_tm->tm_year+1900, log_tm->tm_mon+1, log_tm->tm_mday, log_tm->tm_hour, log_tm->tm_min, log_tm->tm_sec, event_head->tv_usec, level_str);
+	}
+	else
+	{
+		printf("{\"time\":\"%d-%02d-%02dT%02d:%02d:%02d.%06u\",\"level\":\"%.*s\",\"event\":\"%s\",\"session\":%u",
+			log_tm->tm_year+1900, log_tm->tm_mon+1, log_tm->tm_mday, log_tm->tm_hour, log_tm->tm_min, log_tm->tm_sec, event_head->tv_usec,
+			(int)strcspn(level_str, " "), level_str, event_str, event_head->session_id);
+	}
+}
+
+// --------------------------------
+// セッションの情報のJSON出力処理
+// --------------------------------
+static void logcat_json_session(uint32_t session_id)
+{
+	struct LOGCAT_session_t         *this_session;
+
+	if (session_id == 0 || session_id >= LOGCAT_session_num || LOGCAT_session_list[session_id].addr_str == NULL)
+	{
+		return;
+	}
+	this_session = &LOGCAT_session_list[session_id];
+	logcat_json_str("client", this_session->addr_str, strlen(this_session->addr_str));
+	logcat_json_str("database", this_session->database, strlen(this_session->database));
+	logcat_json_str("user", this_session->username, strlen(this_session->username));
+}
+
+// --------------------------------
+// レコード出力処理
+// --------------------------------
+static void logcat_record(struct EVS_event_t *event_head, const char *body_ptr, size_t body_len)
+{
+	struct EVS_event_message_t      event_msg;
+	uint32_t                        string_id;
+	const char                      *addr_str = "?";
+	const char                      *name_str;
+	const char                      *format_str;
+	const char                      *field_ptr[3];                      // セッションの情報("アドレス\0データベース名\0ユーザー名\0")
+	const char                      *read_ptr;
+	int                             field_num;
+	char                            detail_str[MAX_RENDER_LENGTH];
+	size_t                          detail_len = 0;
+	char                            line_str[MAX_RENDER_LENGTH];
+	size_t                          line_len;
+
+	switch (event_head->record_type)
+	{
+		// テキストのログ
+		case EVS_EVENT_TEXT:
+			logcat_head(event_head, "text");
+			if (LOGCAT_json == 0)
+			{
+				fwrite(body_ptr, 1, body_len, stdout);
+			}
+			else
+			{
+				// 末尾の改行は取り除く
+				while (body_len > 0 && body_ptr[body_len - 1] == '\n')
+				{
+					body_len --;
+				}
+				logcat_json_str("text", body_ptr, body_len);
+				printf("}\n");
+			}
+			break;
+		// 文字列テーブルへの登録
+		case EVS_EVENT_STRING:
+			if (body_len < sizeof(string_id))
+			{
+				break;
+			}
+			memcpy(&string_id, body_ptr, sizeof(string_id));
+			if (logcat_grow((void **)&LOGCAT_string_list, &LOGCAT_string_num, sizeof(char *), string_id) != 0)
+			{
+				break;
+			}
+			free(LOGCAT_string_list[string_id]);
+			LOGCAT_string_list[string_id] = logcat_strndup(body_ptr + sizeof(string_id), body_len - sizeof(string_id));
+			break;
+		// セッション開始
+		case EVS_EVENT_SESSION:
+			read_ptr = body_ptr;
+			for (field_num = 0; field_num < 3; field_num ++)
+			{
+				field_ptr[field_num] = read_ptr;
+				read_ptr = memchr(read_ptr, '\0', body_ptr + body_len - read_ptr);
+				if (read_ptr == NULL)
+				{
+					return;
+				}
+				read_ptr ++;
+			}
+			if (logcat_grow((void **)&LOGCAT_session_list, &LOGCAT_session_num, sizeof(struct LOGCAT_session_t), event_head->session_id) != 0)
+			{
+				break;
+			}
+			free(LOGCAT_session_list[event_head->session_id].addr_str);
+			free(LOGCAT_session_list[event_head->session_id].database);
+			free(LOGCAT_session_list[event_head->session_id].username);
+			LOGCAT_session_list[event_head->session_id].addr_str = strdup(field_ptr[0]);
+			LOGCAT_session_list[event_head->session_id].database = strdup(field_ptr[1]);
+			LOGCAT_session_list[event_head->session_id].username = strdup(field_ptr[2]);
+			// テキストではログの行ではないので出力しない(JSONなら出力する)
+			if (LOGCAT_json == 1)
+			{
+				logcat_head(event_head, "session");
+				logcat_json_session(event_head->session_id);
+				printf("}\n");
+			}
+			break;
+		// メッセージのデコード結果
+		case EVS_EVENT_MESSAGE:
+			if (body_len < sizeof(event_msg))
+			{
+				break;
+			}
+			memcpy(&event_msg, body_ptr, sizeof(event_msg));
+			name_str = logcat_string(event_msg.name_id);
+			if (name_str == NULL)
+			{
+				name_str = "<unknown message>";
+			}
+			detail_str[0] = '\0';
+			if (event_msg.format_id != 0)
+			{
+				format_str = logcat_string(event_msg.format_id);
+				event_render(detail_str, &detail_len, sizeof(detail_str), (format_str != NULL) ? format_str : "<unknown format>", body_ptr + sizeof(event_msg), body_ptr + body_len, logcat_string);
+			}
+			if (event_head->session_id < LOGCAT_session_num && LOGCAT_session_list[event_head->session_id].addr_str != NULL)
+			{
+				addr_str = LOGCAT_session_list[event_head->session_id].addr_str;
+			}
+
+			logcat_head(event_head, "message");
+			// evs_pganalyzerのAPI_decode_log()と同じ形にする
+			if (LOGCAT_json == 0)
+			{
+				if (event_msg.from_client == 1)
+				{
+					printf("Client %s -> %s. (message size=%u, len=0x%02x%s%s)\n", addr_str, name_str, 1 + event_msg.message_len, event_msg.message_len, (event_msg.format_id != 0) ? ", " : "", detail_str);
+				}
+				else
+				{
+					printf("PostgreSQL -> %s. (message size=%u, len=0x%02x%s%s)\n", name_str, 1 + event_msg.message_len, event_msg.message_len, (event_msg.format_id != 0) ? ", " : "", detail_str);
+				}
+			}
+			else
+			{
+				logcat_json_session(event_head->session_id);
+				printf(",\"direction\":\"%s\"", (event_msg.from_client == 1) ? "frontend" : "backend");
+				line_len = snprintf(line_str, sizeof(line_str), "%c", (event_msg.message_type >= 0x20 && event_msg.message_type < 0x7F) ? event_msg.message_type : '?');
+				logcat_json_str("type", line_str, line_len);
+				logcat_json_str("name", name_str, strlen(name_str));
+				printf(",\"size\":%u", 1 + event_msg.message_len);
+				if (event_msg.format_id != 0)
+				{
+					logcat_json_str("detail", detail_str, detail_len);
+				}
+				printf("}\n");
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+// --------------------------------
+// メイン処理
+// --------------------------------
+int main(int argc, char *argv[])
+{
+	FILE                            *log_fp = stdin;
+	struct EVS_event_t              event_head;
+	char                            body_buf[MAX_EVENT_LENGTH];
+	size_t                          body_len;
+	int                             opt_char;
+
+	while ((opt_char = getopt(argc, argv, "j")) != -1)
+	{
+		switch (opt_char)
+		{
+			case 'j':
+				LOGCAT_json = 1;
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-j] [logfile]\n", argv[0]);
+				return 1;
+		}
+	}
+	if (optind < argc)
+	{
+		log_fp = fopen(argv[optind], "rb");
+		if (log_fp == NULL)
+		{
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+
+	// レコードを順番に読んで出力
+	while (fread(&event_head, sizeof(event_head), 1, log_fp) == 1)
+	{
+		// レコード長が壊れているなら(以降は読めない)
+		if (event_head.record_len < sizeof(event_head) || event_head.record_len > MAX_EVENT_LENGTH)
+		{
+			fprintf(stderr, "%s: broken record (record_len=%u)\n", argv[0], event_head.record_len);
+			return 1;
+		}
+		body_len = event_head.record_len - sizeof(event_head);
+		if (body_len > 0 && fread(body_buf, body_len, 1, log_fp) != 1)
+		{
+			fprintf(stderr, "%s: truncated record\n", argv[0]);
+			return 1;
+		}
+		logcat_record(&event_head, body_buf, body_len);
+	}
+
+	if (log_fp != stdin)
+	{
+		fclose(log_fp);
+	}
+	return 0;
+}
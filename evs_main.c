@@ -35,10 +35,70 @@
 // --------------------------------
 // 型宣言
 // --------------------------------
+struct EVS_logsink_t {                                      // ログ出力先構造体(ログファイル毎に、ログバッファとログ書き出しスレッドを持つ)
+	char            sink_name[32];                          // ログ出力先の名前(ログ書き出し統計に出力する)
+	char            *log_file;                              // ログファイル名のフルパス(0番の標準ログはEVS_config.log_fileを使う)
+	int             log_level;                              // 出力する最小のログレベル
+	int             log_events;                             // 出力するログ種別のビットマスク(1 << LOG_EVENT_xxx)
+	int             log_fd;                                 // ログファイルディスクリプタ(0:未オープン, -1:開けなかった)
+	char            *logbuf[2];                             // ログバッファ(ダブルバッファ。イベントループが追加する側と、ログ書き出しスレッドが書き出す側を入れ替える。最初に追加する時に確保する)
+	unsigned int    logbuf_len[2];                          // ログバッファに溜まっている長さ
+	int             logbuf_active;                          // イベントループがログを追加するログバッファ(もう一方はログ書き出しスレッドが書き出し中)
+	pthread_t       writer_thread;                          // ログ書き出しスレッド
+	pthread_mutex_t writer_mutex;                           // ログ書き出しスレッドとの排他制御(以下の変数とstat、log_fdを保護)
+	pthread_cond_t  writer_cond;                            // ログ書き出しスレッドとの通知用
+	int             writer_status;                          // ログ書き出しスレッドの状態(0:未起動=イベントループで直接書き出す, 1:動作中, 2:終了依頼中)
+	int             writer_busy;                            // ログ書き出しスレッドが書き出し中のログバッファがあるか(1:あり)
+	int             writer_reopen;                          // ログファイルを開き直す依頼があるか(1:あり。渡したログバッファを書き出した後で開き直す)
+	int             reopen_pending;                         // ログファイルの開き直しを、次にログバッファを渡す時に依頼するか(1:あり。イベントループだけが参照)
+	struct {                                                // ログ書き出し統計
+		unsigned long long  write_bytes;                    // 書き出したバイト数
+		unsigned long       flush_count;                    // 書き出した回数
+		double              flush_time;                     // 書き出しにかかった時間の合計(秒)
+		double              max_flush_time;                 // 書き出しにかかった時間の最大値(秒)
+		unsigned long       drop_count;                     // ログバッファが一杯で捨てた行数
+	} stat;
+};
 
 // --------------------------------
 // 変数宣言
 // --------------------------------
+static struct EVS_logsink_t     EVS_logsink_list[MAX_LOGSINK_NUM] = {       // ログ出力先(0:LogFileの標準ログ, 1～:LogSinkで追加したログ)
+	[0] = {.sink_name = "main", .writer_mutex = PTHREAD_MUTEX_INITIALIZER, .writer_cond = PTHREAD_COND_INITIALIZER},
+};
+static int                      EVS_logsink_num = 1;                        // ログ出力先の数
+static unsigned int             EVS_log_skipmask = 0;                       // 次のlog_output()で出力しないログ出力先のビットマスク(バイナリイベントログに出力済みの標準ログ)
+static ev_tstamp                EVS_logstat_lasttime = 0.;                  // 前回ログ書き出し統計を出力した日時
+static time_t                   EVS_logtime_sec = -1;                       // ログ日時文字列を生成した日時(秒)
+static char                     EVS_logtime_str[32];                        // ログ日時文字列("[YYYY/MM/DD hh:mm:ss."まで、マイクロ秒は毎回埋める)
+static int                      EVS_logtime_len = 0;                        // ログ日時文字列の長さ
+
+static struct {                                                             // バイナリイベントログの文字列テーブル(書式文字列、メッセージ名称など、ポインタで識別する静的な文字列)
+	const char                  *str_ptr;                                   // 文字列へのポインタ
+	uint32_t                    string_id;                                  // 文字列ID
+} EVS_event_ptrtable[MAX_EVENT_STRING_NUM];
+static struct {                                                             // バイナリイベントログの文字列テーブル(SQL文など、内容で識別する長い文字列)
+	uint64_t                    hash;                                       // 文字列のハッシュ値
+	uint32_t                    str_len;                                    // 文字列長
+	uint32_t                    string_id;                                  // 文字列ID
+} EVS_event_strtable[MAX_EVENT_STRING_NUM];
+static char                     EVS_dump_hex[256][2];                       // ダンプ文字列の変換表(バイト値→HEX二文字)
+static char                     EVS_dump_char[256];                         // ダンプ文字列の変換表(バイト値→表示文字、表示できなければ'.')
+static int                      EVS_dump_table = 0;                         // ダンプ文字列の変換表を作成済みか(1:作成済み)
+static char                     *EVS_dump_buf = NULL;                       // ダンプ文字列バッファ(使い回す)
+static size_t                   EVS_dump_size = 0;                          // ダンプ文字列バッファの大きさ
+static FILE                     *EVS_dump_fp = NULL;                        // ダンプファイル
+
+static uint32_t                 EVS_event_string_last = 0;                  // 最後に割り当てた文字列ID
+static struct timeval           *EVS_event_tv = NULL;                       // 組み立て中のメッセージのレコードの日時(event_string_strref()用)
+static int                      EVS_event_building = 0;                     // メッセージのレコードを組み立て中か(1:組み立て中。文字列テーブルとレコードが別のログファイルに分かれないように、開き直しを待たせる)
+
+static size_t                   EVS_flight_size = 0;                        // フライトレコーダーの大きさ(ヘッダ＋スロット)
+static time_t                   EVS_flight_dumptime = 0;                    // 直前にエラーでフライトレコーダーをダンプした日時
+
+extern char                     __executable_start[];                       // 実行ファイルの先頭(リンカが定義する。書式文字列の位置の基準)
+extern char                     _end[];                                     // 実行ファイルの末尾(リンカが定義する)
+
 static const char _base64[] =
 "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
@@ -57,219 +117,484 @@ static const char b64lookup[128] = {
 // コード部分
 // ----------------------------------------------------------------------
 // --------------------------------
-// ダンプ文字列生成処理(dump_strに対して、targetdataからtagetlenバイトのダンプ文字列を設定して返す)
+// 引数格納・書式化関数
+// --------------------------------
+// evs_event.c はバイナリイベントログの引数の並べ方と書式化だけをまとめたファイルで、evs_logcat.cと共用している。
+// evs_main.c からincludeされることを想定しているので、evs_main.hなどのヘッダファイルはincludeしていない。
+#include "evs_event.c"
+
+// --------------------------------
+// ダンプ文字列生成処理(targetdataからtargetlenバイトのダンプ文字列を生成して返す。dump_lenには文字列長を設定する)
 // --------------------------------
-char *getdumpstr(void *targetdata, int targetlen)
+// 一行(DUMP_LINE_LENGTH=70文字)は "xx xx xx xx xx xx xx xx  xx xx xx xx xx xx xx xx    ........ ........\n" の形。
+// 一文字ずつ分岐して組み立てずに、バイト値→HEX二文字と表示文字の変換表から写すだけにする。
+// 返すのは使い回しのバッファなので、free()しないこと(イベントループからだけ呼ばれる)
+char *getdumpstr(void *targetdata, int targetlen, int *dump_len)
 {
-	char                        *dump_str = NULL;                       // ダンプ結果文字列ポインタ
-	char                        *dump_hex_pos;                          // ダンプ結果HEX文字位置
-	char                        *dump_char_pos;                         // ダンプ結果CHAR文字位置
+	static const unsigned char      hex_pos[16] = {0, 3, 6, 9, 12, 15, 18, 21, 25, 28, 31, 34, 37, 40, 43, 46};        // 各バイトのHEX文字位置
+	static const unsigned char      char_pos[16] = {52, 53, 54, 55, 56, 57, 58, 59, 61, 62, 63, 64, 65, 66, 67, 68};   // 各バイトのCHAR文字位置
+
+	unsigned char                   *target_ptr = (unsigned char *)targetdata;      // 対象データポインタ
+	char                            *line_ptr;                          // 出力中の行の先頭
+	int                             line_num;                           // 行数
+	int                             line_bytes;                         // 出力中の行のバイト数
+	int                             target_column;                      // 対象表示文字位置
+	size_t                          need_size;                          // 必要なダンプ文字列バッファの大きさ
+	char                            *new_buf;
+	int                             table_index;
+
+	*dump_len = 0;
+	if (targetlen <= 0)
+	{
+		return NULL;
+	}
 
-	unsigned char               *target_ptr;                            // 対象データポインタ
-	int                         target_column;                          // 対象表示文字位置
+	// 変換表がまだなら作成
+	if (EVS_dump_table == 0)
+	{
+		for (table_index = 0; table_index < 256; table_index ++)
+		{
+			EVS_dump_hex[table_index][0] = "0123456789abcdef"[table_index >> 4];
+			EVS_dump_hex[table_index][1] = "0123456789abcdef"[table_index & 0x0F];
+			EVS_dump_char[table_index] = (table_index >= 0x20 && table_index <= 0x7e) ? table_index : '.';
+		}
+		EVS_dump_table = 1;
+	}
 
-	// ダンプ結果文字列は最低でも16バイト分の文字列＝70文字(\n\0含む)になる
-	dump_str = (char *)calloc(1, ((targetlen + 16 - 1) / 16) * 70);
-	if (dump_str == NULL)
+	// 出力する長さを先に計算して、ダンプ文字列バッファが足りなければ広げる(最後の行も一行分あれば足りる)
+	line_num = (targetlen + 16 - 1) / 16;
+	need_size = (size_t)line_num * DUMP_LINE_LENGTH + 1;
+	if (need_size > EVS_dump_size)
 	{
-		return dump_str;
+		new_buf = (char *)realloc(EVS_dump_buf, need_size);
+		if (new_buf == NULL)
+		{
+			return NULL;
+		}
+		EVS_dump_buf = new_buf;
+		EVS_dump_size = need_size;
 	}
-	
-	// ダンプ結果HEX文字位置を設定
-	dump_hex_pos = dump_str;
-	// ダンプ結果CHAR文字位置を設定
-	dump_char_pos = dump_hex_pos + 52;
-
-	// 対象データポインタに、対象データの最初のバイトポインタを設定して、長さ分だけループ
-	for (target_ptr = (unsigned char *)targetdata; target_ptr < (unsigned char *)targetdata + targetlen; )
-	{
-		// 8バイト分ループ
-		for (target_column = 0; target_column < 8; target_column++)
-		{
-			// まずは上位4ビットを一文字分設定
-			*dump_hex_pos = *target_ptr;    // 0xb6
-			*dump_hex_pos >>= 4;            // 0x0b
-			*dump_hex_pos &= 0x0F;          // 0x0b
-			if (*dump_hex_pos >= 0x00 && *dump_hex_pos <= 0x09)
-			{
-				*dump_hex_pos += 0x30;      // 0x30..0x39
-			}
-			else
-			{
-				*dump_hex_pos += 0x57;      // 0x61..0x66
-			}
-			// ダンプ結果HEX文字位置を+1進める
-			dump_hex_pos += 1;
 
-			// 次に下位4ビットを一文字分設定
-			*dump_hex_pos = *target_ptr;    // 0x4a
-			*dump_hex_pos &= 0x0F;          // 0x0a
-			if (*dump_hex_pos >= 0x00 && *dump_hex_pos <= 0x09)
-			{
-				*dump_hex_pos += 0x30;      // 0x30..0x39
-			}
-			else
-			{
-				*dump_hex_pos += 0x57;      // 0x61..0x66
-			}
-			// ダンプ結果HEX文字位置を+1進める
-			dump_hex_pos += 1;
+	line_ptr = EVS_dump_buf;
+	// 一行(16バイト)ずつ
+	while (targetlen > 0)
+	{
+		line_bytes = (targetlen < 16) ? targetlen : 16;
+		// HEX部分とCHAR部分の間の空白(最後の行の足りない分も空白で埋める)
+		memset(line_ptr, ' ', DUMP_HEX_LENGTH + 9);
+		for (target_column = 0; target_column < line_bytes; target_column ++)
+		{
+			memcpy(line_ptr + hex_pos[target_column], EVS_dump_hex[target_ptr[target_column]], 2);
+			line_ptr[char_pos[target_column]] = EVS_dump_char[target_ptr[target_column]];
+		}
+		// CHAR部分の後に改行
+		line_ptr += char_pos[line_bytes - 1] + 1;
+		*line_ptr ++ = '\n';
 
-			// スペース一つあけて
-			*dump_hex_pos = ' ';
-			// ダンプ結果HEX文字位置を+1進める
-			dump_hex_pos += 1;
+		target_ptr += line_bytes;
+		targetlen -= line_bytes;
+	}
+	*line_ptr = '\0';
 
-			if (*target_ptr >= 0x20 && *target_ptr <= 0x7e)
-			{
-				*dump_char_pos = *target_ptr;
-			}
-			else
-			{
-				*dump_char_pos = '.';
-			}
-			// ダンプ結果CHAR文字位置を+1進める
-			dump_char_pos += 1;
-			// 対象データポインタを+1進める
-			target_ptr++;
-		}
-
-		// スペース一つあける
-		*dump_hex_pos = ' ';
-		*dump_char_pos = ' ';
-		// ダンプ結果HEX文字位置を+1進める
-		dump_hex_pos += 1;
-		// ダンプ結果CHAR文字位置を+1進める
-		dump_char_pos += 1;
-
-		// 8バイト分ループ
-		for (target_column = 0; target_column < 8; target_column++)
-		{
-			// まずは上位4ビットを一文字分設定
-			*dump_hex_pos = *target_ptr;    // 0x30
-			*dump_hex_pos >>= 4;            // 0x03
-			*dump_hex_pos &= 0x0F;          // 0x03
-			if (*dump_hex_pos >= 0x00 && *dump_hex_pos <= 0x09)
-			{
-				*dump_hex_pos += 0x30;      // 0x30..0x39
-			}
-			else
-			{
-				*dump_hex_pos += 0x57;      // 0x61..0x66
-			}
-			// ダンプ結果HEX文字位置を+1進める
-			dump_hex_pos += 1;
+	*dump_len = line_ptr - EVS_dump_buf;
+	return EVS_dump_buf;
+}
 
-			// 次に下位4ビットを一文字分設定
-			*dump_hex_pos = *target_ptr;    // 0x30
-			*dump_hex_pos &= 0x0F;          // 0x00
-			if (*dump_hex_pos >= 0x00 && *dump_hex_pos <= 0x09)
-			{
-				*dump_hex_pos += 0x30;      // 0x30..0x39
-			}
-			else
-			{
-				*dump_hex_pos += 0x57;      // 0x61..0x66
-			}
-			// ダンプ結果HEX文字位置を+1進める
-			dump_hex_pos += 1;
+// --------------------------------
+// ダンプファイル出力処理(ログには収まらないので、ダンプを全部ダンプファイルに出力する)
+// --------------------------------
+static void dump2file(int log_level, struct timeval *log_tv, void *target_data, int target_len)
+{
+	struct timeval                  system_tv;
+	struct tm                       *system_tm;
+	char                            *dump_str;
+	int                             dump_len;
+
+	// ダンプファイルが開いていなければ、開く(まとめて書き出すように、ログバッファと同じ大きさのバッファを付ける)
+	if (EVS_dump_fp == NULL)
+	{
+		EVS_dump_fp = fopen(EVS_config.dump_file, "a");
+		if (EVS_dump_fp == NULL)
+		{
+			return;
+		}
+		setvbuf(EVS_dump_fp, NULL, _IOFBF, MAX_LOGBUF_LENGTH);
+	}
 
-			// スペース一つあけて
-			*dump_hex_pos = ' ';
-			// ダンプ結果HEX文字位置を+1進める
-			dump_hex_pos += 1;
+	// ログ日時の指定がNULLなら
+	if (log_tv == NULL)
+	{
+		gettimeofday(&system_tv, NULL);
+	}
+	else
+	{
+		memcpy(&system_tv, log_tv, sizeof(struct timeval));
+	}
+	system_tm = localtime(&system_tv.tv_sec);
+	fprintf(EVS_dump_fp, "[%d/%02d/%02d %02d:%02d:%02d.%06ld] %s:  -------------------------------- (len=%d)\n",
+		system_tm->tm_year+1900, system_tm->tm_mon+1, system_tm->tm_mday, system_tm->tm_hour, system_tm->tm_min, system_tm->tm_sec, (long)system_tv.tv_usec,
+		loglevel_list[log_level], target_len);
 
-			if (*target_ptr >= 0x20 && *target_ptr <= 0x7e)
-			{
-				*dump_char_pos = *target_ptr;
-			}
-			else
+	dump_str = getdumpstr(target_data, target_len, &dump_len);
+	if (dump_str != NULL)
+	{
+		fwrite(dump_str, 1, dump_len, EVS_dump_fp);
+	}
+}
+
+// --------------------------------
+// ダンプファイル書き出し処理 ※タイマーイベント、終了時に呼ばれる
+// --------------------------------
+void dump_flush(void)
+{
+	if (EVS_dump_fp != NULL)
+	{
+		fflush(EVS_dump_fp);
+	}
+}
+
+// --------------------------------
+// ダンプファイル開き直し処理 ※SIGUSR1(外部でのログローテーション後)に呼ばれる(次のダンプ出力で開き直す)
+// --------------------------------
+void dump_reopen(void)
+{
+	if (EVS_dump_fp != NULL)
+	{
+		fclose(EVS_dump_fp);
+		EVS_dump_fp = NULL;
+	}
+}
+
+// --------------------------------
+// フライトレコーダー : スロット並び出力処理(古い順に書式化して出力する)
+// --------------------------------
+// 書式文字列は実行ファイルの先頭からのオフセットで記録しているので、同じ実行ファイルの記録でなければならない(呼び出し側で確認済み)
+static void flight_write(FILE *dump_fp, struct EVS_flight_t *flight_ring)
+{
+	uint32_t                        end_seq = flight_ring->next_seq;
+	uint32_t                        slot_seq;
+	struct EVS_flight_slot_t        *flight_slot;
+	const char                      *format_ptr;
+	size_t                          format_max = _end - __executable_start;
+	char                            line_str[MAX_LOG_LENGTH];
+	size_t                          line_len;
+	time_t                          slot_sec;
+	struct tm                       *slot_tm;
+	int                             level;
+
+	// 一周していなければ通し番号0から、一周していれば一番古いスロットから
+	slot_seq = (end_seq > flight_ring->slot_num) ? end_seq - flight_ring->slot_num : 0;
+	for (; slot_seq != end_seq; slot_seq ++)
+	{
+		flight_slot = &flight_ring->slot[slot_seq & (flight_ring->slot_num - 1)];
+		// 書き込み中か、もう上書きされていたら
+		if (__atomic_load_n(&flight_slot->seq, __ATOMIC_ACQUIRE) != slot_seq + 1)
+		{
+			continue;
+		}
+		// 書式文字列の位置が実行ファイルの外なら(壊れた記録)
+		if (flight_slot->format_off < 0 || (size_t)flight_slot->format_off >= format_max || memchr(__executable_start + flight_slot->format_off, '\0', format_max - flight_slot->format_off) == NULL)
+		{
+			continue;
+		}
+		format_ptr = __executable_start + flight_slot->format_off;
+
+		slot_sec = flight_slot->tv_sec;
+		slot_tm = localtime(&slot_sec);
+		level = (flight_slot->log_level < LOGLEVEL_MAX) ? flight_slot->log_level : LOGLEVEL_MAX;
+		line_len = snprintf(line_str, sizeof(line_str), "[%d/%02d/%02d %02d:%02d:%02d.%06ld] %s:  ",
+			slot_tm->tm_year+1900, slot_tm->tm_mon+1, slot_tm->tm_mday, slot_tm->tm_hour, slot_tm->tm_min, slot_tm->tm_sec, (long)flight_slot->tv_usec,
+			loglevel_list[level]);
+		event_render(line_str, &line_len, sizeof(line_str) - 1, format_ptr, flight_slot->args, flight_slot->args + flight_slot->args_len, NULL);
+		// 改行で終わっていなければ(一行に収まらなかった)
+		if (line_len == 0 || line_str[line_len - 1] != '\n')
+		{
+			line_str[line_len ++] = '\n';
+		}
+		fwrite(line_str, 1, line_len, dump_fp);
+	}
+}
+
+// --------------------------------
+// フライトレコーダー : ダンプファイル出力処理
+// --------------------------------
+static void flight_output(struct EVS_flight_t *flight_ring, const char *reason_str)
+{
+	FILE                            *dump_fp;
+	time_t                          now_time = time(NULL);
+	char                            time_str[32];
+
+	if (EVS_config.flight_dump == NULL)
+	{
+		return;
+	}
+	dump_fp = fopen(EVS_config.flight_dump, "a");
+	if (dump_fp == NULL)
+	{
+		return;
+	}
+	setvbuf(dump_fp, NULL, _IOFBF, MAX_LOGBUF_LENGTH);
+	strftime(time_str, sizeof(time_str), "%Y/%m/%d %H:%M:%S", localtime(&now_time));
+	fprintf(dump_fp, "-------------------------------- [%s] pid=%d, %s, events=%u\n", time_str, (int)getpid(), reason_str, flight_ring->next_seq);
+	flight_write(dump_fp, flight_ring);
+	fclose(dump_fp);
+}
+
+// --------------------------------
+// フライトレコーダー開始処理 ※初期化の最後に呼ばれる(0:開始した, -1:開始しない)
+// --------------------------------
+// FlightFileがあれば、ファイルをそのままmmapして記録する(異常終了しても、記録はファイルに残る)
+int flight_start(void)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct stat                     exe_stat;
+	struct stat                     file_stat;
+	uint32_t                        slot_num;
+	size_t                          flight_size;
+	struct EVS_flight_t             *flight_ring;
+	int                             flight_fd;
+
+	if (EVS_config.flight_recorder <= 0)
+	{
+		return -1;
+	}
+	// スロット数は2のべき乗にする(通し番号が一周しても、スロットの位置がずれないように)
+	for (slot_num = 1; slot_num < (uint32_t)EVS_config.flight_recorder && slot_num < 0x40000000; slot_num <<= 1);
+	flight_size = sizeof(struct EVS_flight_t) + (size_t)slot_num * sizeof(struct EVS_flight_slot_t);
+	// 記録した実行ファイルを識別する(書式文字列の位置は、同じ実行ファイルでなければ意味がない)
+	memset(&exe_stat, 0, sizeof(exe_stat));
+	stat("/proc/self/exe", &exe_stat);
+
+	// フライトレコーダーファイルがないなら、メモリ上だけ
+	if (EVS_config.flight_file == NULL)
+	{
+		flight_ring = (struct EVS_flight_t *)mmap(NULL, flight_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	}
+	else
+	{
+		flight_fd = open(EVS_config.flight_file, O_RDWR | O_CREAT, 0600);
+		if (flight_fd < 0)
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot open flight recorder file(%s)!? errno=%d (%s)\n", __func__, EVS_config.flight_file, errno, strerror(errno));
+			return -1;
+		}
+		// 前回の記録が残っていれば(同じ大きさで、同じ実行ファイルの記録で、異常終了していたら)、先にダンプしておく
+		if (fstat(flight_fd, &file_stat) == 0 && (size_t)file_stat.st_size == flight_size)
+		{
+			flight_ring = (struct EVS_flight_t *)mmap(NULL, flight_size, PROT_READ, MAP_SHARED, flight_fd, 0);
+			if (flight_ring != MAP_FAILED)
 			{
-				*dump_char_pos = '.';
+				if (memcmp(flight_ring->magic, FLIGHT_MAGIC, sizeof(flight_ring->magic)) == 0 &&
+					flight_ring->slot_num == slot_num && flight_ring->slot_size == sizeof(struct EVS_flight_slot_t) &&
+					flight_ring->exe_size == (int64_t)exe_stat.st_size && flight_ring->exe_mtime == (int64_t)exe_stat.st_mtime &&
+					flight_ring->running == 1)
+				{
+					flight_output(flight_ring, "previous run (not stopped normally)");
+					LOGGING(LOG_QUEUEING, LOGLEVEL_WARN, NULL, log_str, "%s(): Previous run was not stopped normally. Dumped flight recorder to %s.\n", __func__, EVS_config.flight_dump);
+				}
+				munmap(flight_ring, flight_size);
 			}
-			// ダンプ結果CHAR文字位置を+1進める
-			dump_char_pos += 1;
-			// 対象データポインタを+1進める
-			target_ptr++;
 		}
+		// ファイルの領域を先に確保しておく(mmapした領域への書き込みで、ディスクフルによるSIGBUSにならないように)
+		if (ftruncate(flight_fd, 0) != 0 || posix_fallocate(flight_fd, 0, flight_size) != 0)
+		{
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot allocate flight recorder file(%s)!?\n", __func__, EVS_config.flight_file);
+			close(flight_fd);
+			return -1;
+		}
+		flight_ring = (struct EVS_flight_t *)mmap(NULL, flight_size, PROT_READ | PROT_WRITE, MAP_SHARED, flight_fd, 0);
+		close(flight_fd);
+	}
+	if (flight_ring == MAP_FAILED)
+	{
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot mmap flight recorder!? errno=%d (%s)\n", __func__, errno, strerror(errno));
+		return -1;
+	}
 
-		// 3バイト分ループ
-		for (target_column = 0; target_column < 3; target_column++)
+	memcpy(flight_ring->magic, FLIGHT_MAGIC, sizeof(flight_ring->magic));
+	flight_ring->exe_size = exe_stat.st_size;
+	flight_ring->exe_mtime = exe_stat.st_mtime;
+	flight_ring->slot_num = slot_num;
+	flight_ring->slot_size = sizeof(struct EVS_flight_slot_t);
+	flight_ring->next_seq = 0;
+	flight_ring->running = 1;
+
+	EVS_flight_size = flight_size;
+	EVS_flight_ring = flight_ring;
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): FlightRecorder=%u slots(%lu bytes): OK.\n", __func__, slot_num, (unsigned long)flight_size);
+	return 0;
+}
+
+// --------------------------------
+// フライトレコーダー終了処理 ※終了時に呼ばれる(正常に終了したことを記録する)
+// --------------------------------
+void flight_end(void)
+{
+	struct EVS_flight_t             *flight_ring = EVS_flight_ring;
+
+	if (flight_ring == NULL)
+	{
+		return;
+	}
+	EVS_flight_ring = NULL;
+	flight_ring->running = 0;
+	munmap(flight_ring, EVS_flight_size);
+}
+
+// --------------------------------
+// フライトレコーダー記録処理 ※LOGGINGマクロから、ログに出力するかどうかに関係なく呼ばれる
+// --------------------------------
+// 書式化はせずに、書式文字列の位置と引数の値だけをスロットに書き込む。
+// スロットは通し番号をアトミックに進めて確保するのでロックは要らない(ログ書き出しスレッドから呼ばれても大丈夫)。
+void flight_record(int log_level, const char *format_ptr, ...)
+{
+	struct EVS_flight_t             *flight_ring = EVS_flight_ring;
+	struct EVS_flight_slot_t        *flight_slot;
+	uint32_t                        slot_seq;
+	struct timeval                  now_tv;
+	va_list                         args;
+
+	if (flight_ring == NULL)
+	{
+		return;
+	}
+	slot_seq = __atomic_fetch_add(&flight_ring->next_seq, 1, __ATOMIC_RELAXED);
+	flight_slot = &flight_ring->slot[slot_seq & (flight_ring->slot_num - 1)];
+	// 書き込み中にする
+	__atomic_store_n(&flight_slot->seq, 0, __ATOMIC_RELAXED);
+
+	gettimeofday(&now_tv, NULL);
+	flight_slot->log_level = log_level;
+	flight_slot->tv_sec = now_tv.tv_sec;
+	flight_slot->tv_usec = now_tv.tv_usec;
+	flight_slot->format_off = format_ptr - __executable_start;
+	va_start(args, format_ptr);
+	flight_slot->args_len = event_pack(flight_slot->args, FLIGHT_ARGS_LENGTH, format_ptr, &args, FLIGHT_STRING_LENGTH, NULL);
+	va_end(args);
+
+	// 最後に通し番号を書いて、書き込み完了にする
+	__atomic_store_n(&flight_slot->seq, slot_seq + 1, __ATOMIC_RELEASE);
+}
+
+// --------------------------------
+// フライトレコーダーダンプ処理 ※SIGUSR2、受信エラー、指定したSQLSTATEのErrorResponseで呼ばれる
+// --------------------------------
+// エラーでのダンプは、エラーが続いてもFLIGHT_DUMP_INTERVAL秒に一回だけにする(force_flagが1ならいつでもダンプする)
+void flight_dump(const char *reason_str, int force_flag)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	time_t                          now_time;
+
+	if (EVS_flight_ring == NULL)
+	{
+		return;
+	}
+	now_time = time(NULL);
+	if (force_flag == 0)
+	{
+		if (now_time - EVS_flight_dumptime < FLIGHT_DUMP_INTERVAL)
 		{
-			// スペース一つあけて
-			*dump_hex_pos = ' ';
-			// ダンプ結果HEX文字位置を+1進める
-			dump_hex_pos += 1;
+			return;
 		}
+		EVS_flight_dumptime = now_time;
+	}
+
+	flight_output(EVS_flight_ring, reason_str);
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "%s(): Dumped flight recorder to %s. (%s)\n", __func__, EVS_config.flight_dump, reason_str);
+}
+
+// --------------------------------
+// フライトレコーダーダンプ対象SQLSTATE判定処理(1:ダンプ対象, 0:対象外)
+// --------------------------------
+// FlightSQLStateは","区切りで、5文字ならSQLSTATEそのもの、2文字ならクラス(先頭2文字)と比較する
+int flight_sqlstate(const char *sqlstate)
+{
+	const char                      *list_ptr = EVS_config.flight_sqlstate;
+	size_t                          code_len;
 
-		// まだデータがあるなら
-		if (target_ptr < (unsigned char *)targetdata + targetlen)
+	if (list_ptr == NULL || sqlstate == NULL || EVS_flight_ring == NULL)
+	{
+		return 0;
+	}
+	while (*list_ptr != '\0')
+	{
+		code_len = strcspn(list_ptr, ",");
+		if ((code_len == 5 || code_len == 2) && strncmp(list_ptr, sqlstate, code_len) == 0 && (code_len == 2 || sqlstate[5] == '\0'))
 		{
-			// 改行(=0x0a)をつける
-			*dump_char_pos = 0x0A;
+			return 1;
 		}
-		// そうではないなら
-		else
+		list_ptr += code_len;
+		if (*list_ptr == ',')
 		{
-			// 文字列の終わり(=0x00)を設定する
-			*dump_char_pos = 0x00;            
+			list_ptr ++;
 		}
-		// ダンプ結果HEX文字位置を改行の次(+1)に進める
-		dump_hex_pos = dump_char_pos + 1;
-		// ダンプ結果CHAR文字位置を+52進める
-		dump_char_pos = dump_hex_pos + 52;
 	}
-	return dump_str;
+	return 0;
 }
 
 // --------------------------------
 // ダンプ出力
 // --------------------------------
-void dump2log(int log_type, int log_level, struct timeval *log_tv, void *target_data, int taget_len)
+// ダンプファイルの指定があれば、全部ダンプファイルに出力する。なければ、ログの一行(MAX_LOG_LENGTH)に収まる行数だけダンプ文字列を生成して出力する
+void dump2log(int log_type, int log_level, struct timeval *log_tv, void *target_data, int target_len)
 {
-	int                             api_result = 0;
 	char                            log_str[MAX_LOG_LENGTH];
 
 	char                            *dump_str;
+	int                             dump_len;
+	int                             dump_bytes;                         // ログに出力するバイト数
 	char                            *null_str = {"Cannot DUMP!?\n"};
+	int                             log_event = EVS_log_event;          // 呼び出し元のログ種別(終わったら戻す)
 
-	// ログレベル(log_level)が設定値未満なら
-	if (log_level < EVS_config.log_level)
+	// ダンプはログ種別DUMPとして振り分ける
+	EVS_log_event = LOG_EVENT_DUMP;
+	// ログレベル(log_level)が、DUMPを出力するどのログ出力先の設定値(もしくはコンパイル時の最小値)よりも低いなら
+	if (!LOGLEVEL_ENABLED(log_level))
 	{
 		// ログ出力しない
+		EVS_log_event = log_event;
+		return;
+	}
+
+	// ダンプファイルの指定があるなら
+	if (EVS_config.dump_file != NULL)
+	{
+		dump2file(log_level, log_tv, target_data, target_len);
+		EVS_log_event = log_event;
 		return;
 	}
 
+	// ログに収まらない分は、最初からダンプ文字列にしない
+	dump_bytes = target_len;
+	if (dump_bytes > DUMP_LOG_BYTES)
+	{
+		dump_bytes = DUMP_LOG_BYTES;
+	}
 	// 指定されたデータをダンプした文字列を取得
-	dump_str = getdumpstr(target_data, taget_len);
+	dump_str = getdumpstr(target_data, dump_bytes, &dump_len);
 	// ダンプデータが取得できなかったら
 	if (dump_str == NULL)
 	{
 		// ダンプ出来なかった旨の文字列をダンプ文字列として設定
 		dump_str = null_str;
+		dump_len = strlen(null_str);
 	}
 
-	snprintf(log_str, MAX_LOG_LENGTH, "--------------------------------\n");
-	logging(log_type, log_level, log_tv, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(log_type, log_level, log_tv, log_str, "--------------------------------\n");
 
-	// ダンプした文字列がMAX_LOG_LENGTH以上なら
-	if (strlen(dump_str) >= MAX_LOG_LENGTH)
-	{
-		snprintf(log_str, MAX_LOG_LENGTH - 5, "%s", dump_str);
-		sprintf(log_str + strlen(log_str), "...\n");
-	}
-	else
+	memcpy(log_str, dump_str, dump_len);
+	// 収まらなかった分があるなら
+	if (dump_bytes < target_len)
 	{
-		snprintf(log_str, MAX_LOG_LENGTH, "%s\n", dump_str);    // MAX_LOG_LENGTHを変えるな!!
+		memcpy(log_str + dump_len, "...\n", 4);
+		dump_len += 4;
 	}
-	logging(log_type, log_level, log_tv, NULL, NULL, log_str, strlen(log_str));
+	log_str[dump_len] = '\0';
+	logging(log_type, log_level, log_tv, NULL, NULL, log_str, dump_len);
 
-	snprintf(log_str, MAX_LOG_LENGTH, "--------------------------------\n");
-	logging(log_type, log_level, log_tv, NULL, NULL, log_str, strlen(log_str));
-
-	// ダンプ文字列領域を破棄
-	free(dump_str);
+	LOGGING(log_type, log_level, log_tv, log_str, "--------------------------------\n");
 
+	EVS_log_event = log_event;
 	// 戻る
 	return;
 }
@@ -295,6 +620,7 @@ void log_queueing(int from_to, struct EVS_ev_client_t *this_client, struct EVS_e
 
 	// メッセージ情報にメッセージの各種情報をコピー
 	message_info->from_to = from_to;                                // メッセージの方向
+	message_info->log_event = EVS_log_event;                        // ログ種別(キューから取り出して出力する時に、同じ出力先に振り分ける)
 
 	// メッセージの方向がLOGLEVEL_MAX以上で、クライアント構造体ポインタとPostgreSQl構造体ポインタがNULLではないなら
 	if (from_to > LOGLEVEL_MAX && this_client != NULL && this_pgsql != NULL)
@@ -323,12 +649,13 @@ void log_queueing(int from_to, struct EVS_ev_client_t *this_client, struct EVS_e
 	}
 	// 受信したデータをコピー
 	memcpy(message_info->message_ptr, target_buf, target_len);
+	message_info->message_len = target_len + 1;                     // スプールファイルに書き出す時のために、'\0'まで含めた長さ
 
 	// --------------------------------
 	// テールキュー処理
 	// --------------------------------
-	// テールキューの最後にこの接続の情報を追加する
-	TAILQ_INSERT_TAIL(&EVS_message_tailq, message_info, entries);
+	// テールキューの最後にこの接続の情報を追加する(SpoolThresholdを超えていたら、スプールファイルに書き出す)
+	API_spool_insert(message_info);
 
 	// アイドルイベント開始(メッセージ用キュー処理)
 	ev_idle_start(EVS_loop, &idle_message_watcher);
@@ -337,14 +664,765 @@ void log_queueing(int from_to, struct EVS_ev_client_t *this_client, struct EVS_e
 	return;
 }
 
+// --------------------------------
+// ログ出力先のログファイル名取得処理(0番の標準ログはEVS_config.log_file)
+// --------------------------------
+static const char *log_sink_file(struct EVS_logsink_t *this_sink)
+{
+	return (this_sink == &EVS_logsink_list[0]) ? EVS_config.log_file : this_sink->log_file;
+}
+
+// --------------------------------
+// ログファイル書き込み処理(ログバッファの内容をログファイルに書き込んで、書き出し統計を更新する)
+// --------------------------------
+// ログ書き出しスレッドの動作中は、そのログ出力先のログ書き出しスレッドからだけ呼ばれる
+static void log_write(struct EVS_logsink_t *this_sink, char *buf_ptr, unsigned int buf_len)
+{
+	struct timeval                  start_tv;                           // 書き出し開始日時
+	struct timeval                  end_tv;                             // 書き出し終了日時
+	ssize_t                         write_result;
+	unsigned int                    write_pos = 0;                      // 書き出し済みの位置
+	double                          flush_time;                         // 書き出しにかかった時間(秒)
+
+	// ログファイル名の指定があるのにログファイルが開いていなければ
+	if (log_sink_file(this_sink) != NULL && this_sink->log_fd == 0)
+	{
+		// ログファイルを書き込みで開く
+		this_sink->log_fd = open(log_sink_file(this_sink), (O_WRONLY | O_CREAT | O_APPEND), (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH));
+	}
+	// ログファイルが開けていないなら(諦める)
+	if (this_sink->log_fd == 0 || this_sink->log_fd == -1)
+	{
+		return;
+	}
+
+	gettimeofday(&start_tv, NULL);
+	// ログバッファが全部書けるまで(書けなかったら諦める)
+	while (write_pos < buf_len)
+	{
+		write_result = write(this_sink->log_fd, buf_ptr + write_pos, buf_len - write_pos);
+		if (write_result <= 0)
+		{
+			break;
+		}
+		write_pos += write_result;
+	}
+	// ログ書き出しスレッドなら、ディスクへの書き込みまで待つ(イベントループは待たない)
+	if (this_sink->writer_status != 0)
+	{
+		fdatasync(this_sink->log_fd);
+	}
+	gettimeofday(&end_tv, NULL);
+
+	// 書き出し統計を更新
+	flush_time = (double)(end_tv.tv_sec - start_tv.tv_sec) + (double)(end_tv.tv_usec - start_tv.tv_usec) / 1000000.;
+	pthread_mutex_lock(&this_sink->writer_mutex);
+	this_sink->stat.flush_count ++;
+	this_sink->stat.write_bytes += write_pos;
+	this_sink->stat.flush_time += flush_time;
+	if (flush_time > this_sink->stat.max_flush_time)
+	{
+		this_sink->stat.max_flush_time = flush_time;
+	}
+	pthread_mutex_unlock(&this_sink->writer_mutex);
+}
+
+// --------------------------------
+// ログ書き出しスレッド処理
+// --------------------------------
+// イベントループから渡されたログバッファを書き出す。ログファイルの開き直しもここで行うので、遅いディスクやローテーションでイベントループが止まることはない
+// (ログ出力先毎に一つずつ動かすので、遅いディスクのログ出力先が、他のログ出力先の書き出しを待たせることもない)
+static void *log_writer(void *arg)
+{
+	struct EVS_logsink_t            *this_sink = (struct EVS_logsink_t *)arg;
+	int                             write_index;                        // 書き出すログバッファ
+	int                             write_flag;                         // 書き出すログバッファがあるかどうか
+	int                             reopen_flag;                        // ログファイルを開き直すかどうか
+
+	pthread_mutex_lock(&this_sink->writer_mutex);
+	// 終了依頼が来て、書き出すものがなくなるまで、ループ
+	while (this_sink->writer_status == 1 || this_sink->writer_busy == 1 || this_sink->writer_reopen == 1)
+	{
+		// 書き出すものも開き直す依頼もないなら、通知を待つ
+		if (this_sink->writer_busy == 0 && this_sink->writer_reopen == 0)
+		{
+			pthread_cond_wait(&this_sink->writer_cond, &this_sink->writer_mutex);
+			continue;
+		}
+		write_index = 1 - this_sink->logbuf_active;
+		write_flag = this_sink->writer_busy;
+		reopen_flag = this_sink->writer_reopen;
+		this_sink->writer_reopen = 0;
+		pthread_mutex_unlock(&this_sink->writer_mutex);
+
+		// 書き出すログバッファがあるなら(書き出し中はイベントループがログバッファを入れ替えないので、write_indexは変わらない)
+		if (write_flag == 1)
+		{
+			log_write(this_sink, this_sink->logbuf[write_index], this_sink->logbuf_len[write_index]);
+		}
+		// ログファイルを開き直す依頼があるなら(外部のローテーション後に、新しいログファイルを開く。依頼と一緒に渡されたログバッファまでは古いログファイルに書く)
+		if (reopen_flag == 1 && this_sink->log_fd != 0 && this_sink->log_fd != -1)
+		{
+			close(this_sink->log_fd);
+			this_sink->log_fd = 0;
+		}
+
+		pthread_mutex_lock(&this_sink->writer_mutex);
+		if (write_flag == 1)
+		{
+			this_sink->logbuf_len[write_index] = 0;
+			this_sink->writer_busy = 0;
+		}
+	}
+	pthread_mutex_unlock(&this_sink->writer_mutex);
+
+	return NULL;
+}
+
+// --------------------------------
+// ログ出力先追加処理 ※設定ファイルのLogSinkから呼ばれる(0:追加した, -1:追加できない)
+// --------------------------------
+int log_sink_add(const char *sink_name, int log_level, int log_events, const char *log_file)
+{
+	struct EVS_logsink_t            *this_sink;
+
+	// ログ出力先が一杯なら
+	if (EVS_logsink_num >= MAX_LOGSINK_NUM)
+	{
+		return -1;
+	}
+	this_sink = &EVS_logsink_list[EVS_logsink_num];
+	memset(this_sink, 0, sizeof(struct EVS_logsink_t));
+	this_sink->log_file = strdup(log_file);
+	// メモリ領域が確保できなかったら
+	if (this_sink->log_file == NULL)
+	{
+		return -1;
+	}
+	snprintf(this_sink->sink_name, sizeof(this_sink->sink_name), "%s", sink_name);
+	this_sink->log_level = log_level;
+	this_sink->log_events = log_events;
+	pthread_mutex_init(&this_sink->writer_mutex, NULL);
+	pthread_cond_init(&this_sink->writer_cond, NULL);
+	EVS_logsink_num ++;
+
+	return 0;
+}
+
+// --------------------------------
+// ログ振り分け表生成処理 ※設定ファイルを読み込んだ後に呼ばれる
+// --------------------------------
+// ログ種別とログレベルの組み合わせ毎に、出力するログ出力先のビットマスクを先に作っておく(LOGLEVEL_ENABLED()とlog_output()は表を引くだけにする)
+void log_route_init(void)
+{
+	struct EVS_logsink_t            *this_sink;
+	int                             sink_index;
+	int                             log_event;
+	int                             log_level;
+
+	// 0番の標準ログは、LogLevelとLogTypeに従う
+	EVS_logsink_list[0].log_level = EVS_config.log_level;
+	EVS_logsink_list[0].log_events = EVS_config.log_events;
+
+	memset(EVS_log_route, 0, sizeof(EVS_log_route));
+	for (sink_index = 0; sink_index < EVS_logsink_num; sink_index ++)
+	{
+		this_sink = &EVS_logsink_list[sink_index];
+		for (log_event = 0; log_event < LOG_EVENT_MAX; log_event ++)
+		{
+			if ((this_sink->log_events & (1 << log_event)) == 0)
+			{
+				continue;
+			}
+			for (log_level = this_sink->log_level; log_level <= LOGLEVEL_MAX; log_level ++)
+			{
+				EVS_log_route[log_event][log_level] |= (1 << sink_index);
+			}
+		}
+	}
+}
+
+// --------------------------------
+// ログ書き出しスレッド開始処理 ※デーモン化の後に呼ぶこと(fork()でスレッドは引き継がれないので)
+// --------------------------------
+int log_writer_start(void)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_logsink_t            *this_sink;
+	int                             sink_index;
+	int                             thread_result;
+	int                             start_result = 0;
+
+	// デーモンモードではないなら(ログファイルに出力しないので)、ログ書き出しスレッドは不要
+	if (EVS_config.daemon != 1)
+	{
+		return 0;
+	}
+
+	for (sink_index = 0; sink_index < EVS_logsink_num; sink_index ++)
+	{
+		this_sink = &EVS_logsink_list[sink_index];
+		// ログファイルに出力しないなら
+		if (log_sink_file(this_sink) == NULL)
+		{
+			continue;
+		}
+		this_sink->writer_status = 1;
+		thread_result = pthread_create(&this_sink->writer_thread, NULL, log_writer, this_sink);
+		// スレッドが生成できなかったら(イベントループで直接書き出す)
+		if (thread_result != 0)
+		{
+			this_sink->writer_status = 0;
+			LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot create log writer thread(%.31s)!? errno=%d (%s)\n", __func__, this_sink->sink_name, thread_result, strerror(thread_result));
+			start_result = -1;
+			continue;
+		}
+		LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): pthread_create(log_writer, %.31s): OK.\n", __func__, this_sink->sink_name);
+	}
+
+	return start_result;
+}
+
+// --------------------------------
+// ログ書き出しスレッド終了処理 ※終了時に呼ばれる。残っているログは全部書き出す
+// --------------------------------
+void log_writer_stop(void)
+{
+	struct EVS_logsink_t            *this_sink;
+	int                             sink_index;
+
+	// 追加中のログバッファを渡してから
+	log_flush();
+	for (sink_index = 0; sink_index < EVS_logsink_num; sink_index ++)
+	{
+		this_sink = &EVS_logsink_list[sink_index];
+		// ログ書き出しスレッドが動作中でないなら
+		if (this_sink->writer_status != 1)
+		{
+			continue;
+		}
+		// 終了を依頼して、終わるのを待つ
+		pthread_mutex_lock(&this_sink->writer_mutex);
+		this_sink->writer_status = 2;
+		pthread_cond_broadcast(&this_sink->writer_cond);
+		pthread_mutex_unlock(&this_sink->writer_mutex);
+		pthread_join(this_sink->writer_thread, NULL);
+
+		// 以降はイベントループで直接書き出す
+		this_sink->writer_status = 0;
+	}
+	log_flush();
+}
+
+// --------------------------------
+// ログ出力先別ログバッファ書き出し処理
+// --------------------------------
+// ログファイルへは一行ずつwrite()せずにログバッファに溜めておいて、バッファが一杯になった時、タイマーイベント、終了時などにまとめて書き出す。
+// ログ書き出しスレッドの動作中は、ログバッファを入れ替えて渡すだけで、書き出しは待たない(前のログバッファがまだ書き出し中なら、次の機会に渡す)
+static void log_sink_flush(struct EVS_logsink_t *this_sink)
+{
+	int                             reopen_ready;                       // ログファイルを開き直してよいか(バイナリイベントログのレコードを組み立て中なら待つ)
+
+	// ログバッファが空で、ログファイルの開き直しもないなら
+	if (this_sink->logbuf_len[this_sink->logbuf_active] == 0 && this_sink->reopen_pending == 0)
+	{
+		return;
+	}
+	reopen_ready = (this_sink->reopen_pending == 1 && (this_sink != &EVS_logsink_list[0] || EVS_event_building == 0));
+
+	// ログ書き出しスレッドが動作中でないなら、直接書き出す
+	if (this_sink->writer_status == 0)
+	{
+		if (this_sink->logbuf_len[this_sink->logbuf_active] > 0)
+		{
+			log_write(this_sink, this_sink->logbuf[this_sink->logbuf_active], this_sink->logbuf_len[this_sink->logbuf_active]);
+			this_sink->logbuf_len[this_sink->logbuf_active] = 0;
+		}
+		// ログファイルの開き直しがあるなら、閉じる(次のログ出力で開き直す)
+		if (reopen_ready == 1)
+		{
+			if (this_sink->log_fd != 0 && this_sink->log_fd != -1)
+			{
+				close(this_sink->log_fd);
+			}
+			this_sink->log_fd = 0;
+			this_sink->reopen_pending = 0;
+			// 標準ログなら、文字列テーブルも最初から出力し直す
+			if (this_sink == &EVS_logsink_list[0])
+			{
+				event_reset();
+			}
+		}
+		return;
+	}
+
+	pthread_mutex_lock(&this_sink->writer_mutex);
+	// ログ書き出しスレッドが書き出し中でも開き直し中でもないなら、ログバッファを入れ替えて渡す(開き直し中に渡すと、古いログファイルに書かれてしまう)
+	if (this_sink->writer_busy == 0 && this_sink->writer_reopen == 0)
+	{
+		this_sink->writer_busy = (this_sink->logbuf_len[this_sink->logbuf_active] > 0) ? 1 : 0;
+		this_sink->logbuf_active = 1 - this_sink->logbuf_active;
+		// ログファイルの開き直しがあるなら、渡したログバッファを書き出した後で開き直すように依頼する
+		if (reopen_ready == 1)
+		{
+			this_sink->writer_reopen = 1;
+			this_sink->reopen_pending = 0;
+			// 以降のログバッファは新しいログファイルに書かれるので、標準ログなら文字列テーブルも最初から出力し直す
+			if (this_sink == &EVS_logsink_list[0])
+			{
+				event_reset();
+			}
+		}
+		pthread_cond_broadcast(&this_sink->writer_cond);
+	}
+	pthread_mutex_unlock(&this_sink->writer_mutex);
+}
+
+// --------------------------------
+// ログバッファ書き出し処理(全ログ出力先)
+// --------------------------------
+void log_flush(void)
+{
+	int                             sink_index;
+
+	for (sink_index = 0; sink_index < EVS_logsink_num; sink_index ++)
+	{
+		log_sink_flush(&EVS_logsink_list[sink_index]);
+	}
+}
+
+// --------------------------------
+// ログファイル開き直し処理 ※SIGUSR1(外部でのログローテーション後)に呼ばれる
+// --------------------------------
+// それまでのログバッファは古いログファイルに書いてから開き直す(ログ書き出しスレッドの動作中は依頼するだけで、イベントループは待たない)
+void log_reopen(void)
+{
+	int                             sink_index;
+
+	for (sink_index = 0; sink_index < EVS_logsink_num; sink_index ++)
+	{
+		EVS_logsink_list[sink_index].reopen_pending = 1;
+	}
+	log_flush();
+}
+
+// --------------------------------
+// 標準ログのログファイル終了処理 ※設定ファイルでログファイル名が変わった時に呼ばれる(ログ書き出しスレッドの開始前)
+// --------------------------------
+// ログバッファに残っているログを今のログファイルに書き出して閉じる(次のログ出力で、新しいログファイルを開く)
+void log_close(void)
+{
+	struct EVS_logsink_t            *this_sink = &EVS_logsink_list[0];
+
+	if (this_sink->log_fd == 0)
+	{
+		return;
+	}
+	log_sink_flush(this_sink);
+	if (this_sink->log_fd != -1)
+	{
+		fsync(this_sink->log_fd);
+		close(this_sink->log_fd);
+	}
+	this_sink->log_fd = 0;
+}
+
+// --------------------------------
+// ログ書き出し統計出力処理 ※タイマーイベントから呼ばれる
+// --------------------------------
+void log_report(ev_tstamp nowtime)
+{
+	char                            log_str[MAX_LOG_LENGTH];
+	struct EVS_logsink_t            *this_sink;
+	int                             sink_index;
+	unsigned long long              write_bytes;
+	unsigned long                   flush_count;
+	double                          flush_time;
+	double                          max_flush_time;
+	unsigned long                   drop_count;
+	int                             report_flag;
+
+	// 書き出し統計を出力しない設定か、まだ出力間隔を経過していないなら
+	if (EVS_config.logstat_intval <= 0. || nowtime < EVS_logstat_lasttime + EVS_config.logstat_intval)
+	{
+		return;
+	}
+	// 初回は基準の日時を設定するだけ
+	report_flag = (EVS_logstat_lasttime > 0.);
+	EVS_logstat_lasttime = nowtime;
+
+	for (sink_index = 0; sink_index < EVS_logsink_num; sink_index ++)
+	{
+		this_sink = &EVS_logsink_list[sink_index];
+		// ログ書き出しスレッドと共有している統計を取り出してリセット
+		pthread_mutex_lock(&this_sink->writer_mutex);
+		write_bytes = this_sink->stat.write_bytes;
+		flush_count = this_sink->stat.flush_count;
+		flush_time = this_sink->stat.flush_time;
+		max_flush_time = this_sink->stat.max_flush_time;
+		drop_count = this_sink->stat.drop_count;
+		memset(&this_sink->stat, 0, sizeof(this_sink->stat));
+		pthread_mutex_unlock(&this_sink->writer_mutex);
+
+		if (report_flag == 0 || log_sink_file(this_sink) == NULL)
+		{
+			continue;
+		}
+		LOGGING(LOG_QUEUEING, (drop_count > 0) ? LOGLEVEL_WARN : LOGLEVEL_LOG, NULL, log_str, "Log: flushed. (sink=%.31s, bytes=%llu, flushes=%lu, avg_latency=%.6f, max_latency=%.6f, dropped=%lu)\n",
+			this_sink->sink_name, write_bytes, flush_count, (flush_count > 0) ? flush_time / flush_count : 0., max_flush_time, drop_count);
+	}
+}
+
+// --------------------------------
+// ログファイル出力可否判定処理(ログファイルが開いていなければ開く。1:ログバッファ経由でログファイルに出力できる, 0:できない)
+// --------------------------------
+static int log_sink_ready(struct EVS_logsink_t *this_sink)
+{
+	// デーモンモードではないか、ログファイル名の指定がないなら
+	if (EVS_config.daemon != 1 || log_sink_file(this_sink) == NULL)
+	{
+		return 0;
+	}
+	// ログ書き出しスレッドが動作中なら(ログファイルはログ書き出しスレッドが開く)
+	if (this_sink->writer_status != 0)
+	{
+		return 1;
+	}
+	// ログファイルが開いていなければ
+	if (this_sink->log_fd == 0)
+	{
+		// ログファイルを書き込みで開く(ノンブロッキングにするなら「 | O_NONBLOCK」を追加)
+		this_sink->log_fd = open(log_sink_file(this_sink), (O_WRONLY | O_CREAT | O_APPEND), (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH));
+	}
+	// ログファイルが開けていないなら
+	if (this_sink->log_fd == 0 || this_sink->log_fd == -1)
+	{
+		return 0;
+	}
+	return 1;
+}
+
+// --------------------------------
+// ログバッファ追加処理(head_ptrとbody_ptrを続けて追加する。0:追加した, -1:ログバッファが一杯で捨てた)
+// --------------------------------
+static int log_append(struct EVS_logsink_t *this_sink, int log_level, const char *head_ptr, int head_len, const char *body_ptr, int body_len)
+{
+	// ログバッファがまだないなら、二つ分をまとめて確保する(確保できなければ、捨てて数える)
+	if (this_sink->logbuf[0] == NULL)
+	{
+		this_sink->logbuf[0] = (char *)malloc(MAX_LOGBUF_LENGTH * 2);
+		if (this_sink->logbuf[0] == NULL)
+		{
+			pthread_mutex_lock(&this_sink->writer_mutex);
+			this_sink->stat.drop_count ++;
+			pthread_mutex_unlock(&this_sink->writer_mutex);
+			return -1;
+		}
+		this_sink->logbuf[1] = this_sink->logbuf[0] + MAX_LOGBUF_LENGTH;
+	}
+	// ログバッファに入りきらないなら、先に書き出す(ログ書き出しスレッドの動作中なら、入れ替えて渡す)
+	if (this_sink->logbuf_len[this_sink->logbuf_active] + head_len + body_len > MAX_LOGBUF_LENGTH)
+	{
+		log_sink_flush(this_sink);
+	}
+	// それでも入りきらないなら(ログ書き出しスレッドが前のログバッファを書き出し中)、捨てて数える
+	// ※ここはイベントループのスレッドなので、ログ書き出しスレッドを待たない(遅いディスクで全ての中継が止まる)
+	if (this_sink->logbuf_len[this_sink->logbuf_active] + head_len + body_len > MAX_LOGBUF_LENGTH)
+	{
+		pthread_mutex_lock(&this_sink->writer_mutex);
+		this_sink->stat.drop_count ++;
+		pthread_mutex_unlock(&this_sink->writer_mutex);
+		return -1;
+	}
+	// それでも入りきらない(一行がログバッファより長い)なら、切り詰める
+	if (head_len + body_len > MAX_LOGBUF_LENGTH)
+	{
+		body_len = MAX_LOGBUF_LENGTH - head_len;
+	}
+	// ログバッファに追加
+	memcpy(this_sink->logbuf[this_sink->logbuf_active] + this_sink->logbuf_len[this_sink->logbuf_active], head_ptr, head_len);
+	memcpy(this_sink->logbuf[this_sink->logbuf_active] + this_sink->logbuf_len[this_sink->logbuf_active] + head_len, body_ptr, body_len);
+	this_sink->logbuf_len[this_sink->logbuf_active] += head_len + body_len;
+	// エラーは落ちる前に残しておきたいので、すぐに書き出す
+	if (log_level >= LOGLEVEL_ERROR)
+	{
+		log_sink_flush(this_sink);
+	}
+	return 0;
+}
+
+// --------------------------------
+// バイナリイベントログ : レコード追加処理(0:追加した, -1:捨てた) ※バイナリイベントログは0番の標準ログだけ
+// --------------------------------
+static int event_append(int record_type, int log_level, struct timeval *log_tv, unsigned int session_id, const char *body_ptr, unsigned int body_len)
+{
+	struct EVS_event_t              event_head;                         // レコードヘッダ
+
+	// 一レコードの最大長を超えるなら、切り詰める
+	if (sizeof(event_head) + body_len > MAX_EVENT_LENGTH)
+	{
+		body_len = MAX_EVENT_LENGTH - sizeof(event_head);
+	}
+	event_head.record_len = sizeof(event_head) + body_len;
+	event_head.record_type = record_type;
+	event_head.log_level = log_level;
+	event_head.tv_sec = log_tv->tv_sec;
+	event_head.tv_usec = log_tv->tv_usec;
+	event_head.session_id = session_id;
+
+	return log_append(&EVS_logsink_list[0], log_level, (char *)&event_head, sizeof(event_head), body_ptr, body_len);
+}
+
+// --------------------------------
+// バイナリイベントログ : 文字列テーブル登録処理(0:登録できなかった, 1以上:文字列ID)
+// --------------------------------
+static uint32_t event_string_add(struct timeval *log_tv, const char *str_ptr, unsigned int str_len)
+{
+	char                            event_buf[MAX_EVENT_LENGTH];
+	uint32_t                        string_id;
+
+	if (sizeof(struct EVS_event_t) + sizeof(string_id) + str_len > MAX_EVENT_LENGTH)
+	{
+		str_len = MAX_EVENT_LENGTH - sizeof(struct EVS_event_t) - sizeof(string_id);
+	}
+	string_id = EVS_event_string_last + 1;
+	memcpy(event_buf, &string_id, sizeof(string_id));
+	memcpy(event_buf + sizeof(string_id), str_ptr, str_len);
+	// 捨てられたら(ログバッファが一杯)、登録しない(次に出てきた時に登録し直す)
+	if (event_append(EVS_EVENT_STRING, LOGLEVEL_DEBUG, log_tv, 0, event_buf, sizeof(string_id) + str_len) != 0)
+	{
+		return 0;
+	}
+	EVS_event_string_last = string_id;
+	return string_id;
+}
+
+// --------------------------------
+// バイナリイベントログ : 静的な文字列の文字列ID取得処理(ポインタで識別する。0:取得できなかった)
+// --------------------------------
+static uint32_t event_string_static(struct timeval *log_tv, const char *str_ptr)
+{
+	unsigned int                    table_pos;
+	int                             probe_count;
+
+	table_pos = ((uintptr_t)str_ptr >> 3) % MAX_EVENT_STRING_NUM;
+	for (probe_count = 0; probe_count < MAX_EVENT_STRING_PROBE; probe_count ++, table_pos = (table_pos + 1) % MAX_EVENT_STRING_NUM)
+	{
+		// 登録済みなら
+		if (EVS_event_ptrtable[table_pos].str_ptr == str_ptr)
+		{
+			return EVS_event_ptrtable[table_pos].string_id;
+		}
+		// 空きなら、登録する
+		if (EVS_event_ptrtable[table_pos].str_ptr == NULL)
+		{
+			EVS_event_ptrtable[table_pos].string_id = event_string_add(log_tv, str_ptr, strlen(str_ptr));
+			if (EVS_event_ptrtable[table_pos].string_id != 0)
+			{
+				EVS_event_ptrtable[table_pos].str_ptr = str_ptr;
+			}
+			return EVS_event_ptrtable[table_pos].string_id;
+		}
+	}
+	return 0;
+}
+
+// --------------------------------
+// バイナリイベントログ : 長い文字列の文字列ID取得処理(内容で識別する。0:取得できなかった)
+// --------------------------------
+static uint32_t event_string_content(struct timeval *log_tv, const char *str_ptr, unsigned int str_len)
+{
+	uint64_t                        hash = 14695981039346656037ULL;     // FNV-1a(64bit)のオフセット基底
+	unsigned int                    str_pos;
+	unsigned int                    table_pos;
+	int                             probe_count;
+
+	for (str_pos = 0; str_pos < str_len; str_pos ++)
+	{
+		hash = (hash ^ (unsigned char)str_ptr[str_pos]) * 1099511628211ULL;
+	}
+
+	table_pos = hash % MAX_EVENT_STRING_NUM;
+	for (probe_count = 0; probe_count < MAX_EVENT_STRING_PROBE; probe_count ++, table_pos = (table_pos + 1) % MAX_EVENT_STRING_NUM)
+	{
+		// 登録済みなら
+		if (EVS_event_strtable[table_pos].string_id != 0 && EVS_event_strtable[table_pos].hash == hash && EVS_event_strtable[table_pos].str_len == str_len)
+		{
+			return EVS_event_strtable[table_pos].string_id;
+		}
+		// 空きなら、登録する
+		if (EVS_event_strtable[table_pos].string_id == 0)
+		{
+			EVS_event_strtable[table_pos].string_id = event_string_add(log_tv, str_ptr, str_len);
+			EVS_event_strtable[table_pos].hash = hash;
+			EVS_event_strtable[table_pos].str_len = str_len;
+			return EVS_event_strtable[table_pos].string_id;
+		}
+	}
+	return 0;
+}
+
+// --------------------------------
+// バイナリイベントログ : 文字列テーブル参照処理(event_pack()から呼ばれる。日時はEVS_event_tv)
+// --------------------------------
+static uint32_t event_string_strref(const char *str_ptr, unsigned int str_len)
+{
+	return event_string_content(EVS_event_tv, str_ptr, str_len);
+}
+
+// --------------------------------
+// バイナリイベントログ : 文字列テーブル初期化処理 ※新しいログファイルに切り替える時に呼ばれる
+// --------------------------------
+void event_reset(void)
+{
+	memset(EVS_event_ptrtable, 0, sizeof(EVS_event_ptrtable));
+	memset(EVS_event_strtable, 0, sizeof(EVS_event_strtable));
+}
+
+// --------------------------------
+// バイナリイベントログ : セッション開始出力処理
+// --------------------------------
+void event_session(unsigned int session_id, const char *addr_str, const char *database, const char *username)
+{
+	char                            event_buf[MAX_EVENT_LENGTH];
+	unsigned int                    event_len = 0;
+	struct timeval                  now_tv;
+
+	// 標準ログがバイナリイベントログではないなら
+	if (EVS_config.log_format != 1 || log_sink_ready(&EVS_logsink_list[0]) == 0)
+	{
+		return;
+	}
+
+	// "アドレス\0データベース名\0ユーザー名\0" (いずれも256バイト未満なので、溢れない)
+	event_len += snprintf(event_buf + event_len, 256, "%s", addr_str) + 1;
+	event_len += snprintf(event_buf + event_len, 256, "%s", database) + 1;
+	event_len += snprintf(event_buf + event_len, 256, "%s", username) + 1;
+
+	gettimeofday(&now_tv, NULL);
+	event_append(EVS_EVENT_SESSION, LOGLEVEL_INFO, &now_tv, session_id, event_buf, event_len);
+}
+
+// --------------------------------
+// バイナリイベントログ : メッセージ出力処理(0:出力した, -1:テキストでも出力してもらう)
+// --------------------------------
+// 詳細はvsnprintf()で文字列にせずに、書式文字列の文字列IDと引数の値だけを並べる(文字列にするのはevs_logcat)
+// 標準ログ以外のログ出力先にも振り分けられるなら、標準ログにだけ出力して-1を返す(次のlog_output()は標準ログを飛ばす)
+int event_message(int log_level, struct timeval *log_tv, unsigned int session_id, int from_client, int message_type, unsigned int message_len, const char *name_str, const char *detail_format, va_list detail_args)
+{
+	char                            event_buf[MAX_EVENT_LENGTH];
+	struct EVS_event_message_t      *event_msg = (struct EVS_event_message_t *)event_buf;
+	unsigned int                    event_len = sizeof(struct EVS_event_message_t);
+	struct timeval                  now_tv;
+	va_list                         pack_args;
+	unsigned int                    route_mask = EVS_log_route[EVS_log_event][log_level];  // 振り分け先のログ出力先
+
+	// 標準ログがバイナリイベントログではないか、標準ログに振り分けられないなら
+	if (EVS_config.log_format != 1 || (route_mask & 1) == 0 || log_sink_ready(&EVS_logsink_list[0]) == 0)
+	{
+		return -1;
+	}
+	if (log_tv == NULL)
+	{
+		gettimeofday(&now_tv, NULL);
+		log_tv = &now_tv;
+	}
+
+	EVS_event_building = 1;
+	event_msg->from_client = from_client;
+	event_msg->message_type = message_type;
+	event_msg->reserved = 0;
+	event_msg->message_len = message_len;
+	event_msg->name_id = event_string_static(log_tv, name_str);
+	event_msg->format_id = (detail_format != NULL) ? event_string_static(log_tv, detail_format) : 0;
+	// 文字列テーブルに登録できなかったら(テキストで出力してもらう)
+	if (event_msg->name_id == 0 || (detail_format != NULL && event_msg->format_id == 0))
+	{
+		EVS_event_building = 0;
+		return -1;
+	}
+
+	// 書式文字列の変換指定子の順番に、引数を並べる(テキストのログでも一行に収まらない分は要らない)
+	EVS_event_tv = log_tv;
+	va_copy(pack_args, detail_args);
+	event_len += event_pack(event_buf + event_len, MAX_EVENT_LENGTH - sizeof(struct EVS_event_t) - event_len, detail_format, &pack_args, MAX_LOG_LENGTH, event_string_strref);
+	va_end(pack_args);
+
+	event_append(EVS_EVENT_MESSAGE, log_level, log_tv, session_id, event_buf, event_len);
+	EVS_event_building = 0;
+	// 他のログ出力先にも振り分けられるなら、そちらにはテキストで出力してもらう
+	if ((route_mask & ~1U) != 0)
+	{
+		EVS_log_skipmask = 1;
+		return -1;
+	}
+	return 0;
+}
+
+// --------------------------------
+// ログ日時文字列生成処理("[YYYY/MM/DD hh:mm:ss.uuuuuu] LEVEL:  " をtime_strに生成して、その長さを返す)
+// --------------------------------
+static int log_timestr(char *time_str, struct timeval *system_tv, int log_level)
+{
+	struct tm                       *system_tm;
+	int                             time_len;
+	suseconds_t                     usec;                               // マイクロ秒(一桁ずつ文字にする)
+	int                             digit_pos;
+
+	// ログ日時(秒まで)が前回と違うなら、ログ日時を文字列に変換(localtime()とsnprintf()は一秒に一回で済ませる)
+	if (system_tv->tv_sec != EVS_logtime_sec)
+	{
+		system_tm = localtime(&system_tv->tv_sec);
+		EVS_logtime_len = snprintf(EVS_logtime_str, sizeof(EVS_logtime_str), "[%d/%02d/%02d %02d:%02d:%02d.",     // 現在時刻
+			system_tm->tm_year+1900,    // 年
+			system_tm->tm_mon+1,        // 月
+			system_tm->tm_mday,         // 日
+			system_tm->tm_hour,         // 時
+			system_tm->tm_min,          // 分
+			system_tm->tm_sec           // 秒
+			);
+		EVS_logtime_sec = system_tv->tv_sec;
+	}
+	// マイクロ秒とログレベルだけ毎回埋める
+	memcpy(time_str, EVS_logtime_str, EVS_logtime_len);
+	usec = system_tv->tv_usec;
+	for (digit_pos = EVS_logtime_len + 5; digit_pos >= EVS_logtime_len; digit_pos --)
+	{
+		time_str[digit_pos] = '0' + (usec % 10);
+		usec /= 10;
+	}
+	time_len = EVS_logtime_len + 6;
+	time_str[time_len ++] = ']';
+	time_str[time_len ++] = ' ';
+	memcpy(time_str + time_len, loglevel_list[log_level], strlen(loglevel_list[log_level]));
+	time_len += strlen(loglevel_list[log_level]);
+	time_str[time_len ++] = ':';
+	time_str[time_len ++] = ' ';
+	time_str[time_len ++] = ' ';
+	time_str[time_len] = '\0';
+	return time_len;
+}
+
 // --------------------------------
 // ログダイレクト出力処理
 // --------------------------------
+// ログ種別(EVS_log_event)とログレベルの振り分け表を引いて、該当するログ出力先のログバッファに追加する
 void log_output(int log_level, struct timeval *log_tv, char * logstr, int loglen)
 {
 	struct timeval                  system_tv;
-	struct tm                       *system_tm;
 	char                            time_str[MAX_LOG_LENGTH];
+	int                             time_len = 0;                       // ログ日時＋ログレベルの文字列長(0:まだ生成していない)
+	unsigned int                    route_mask;                         // 振り分け先のログ出力先
+	int                             sink_index;
+	int                             print_flag = 0;                     // 標準出力に出力するか
+
+	// 振り分け先のログ出力先を取得(バイナリイベントログに出力済みのログ出力先は飛ばす)
+	route_mask = EVS_log_route[EVS_log_event][log_level] & ~EVS_log_skipmask;
+	EVS_log_skipmask = 0;
+	if (route_mask == 0)
+	{
+		return;
+	}
 
 	// ログ日時の指定がNULLなら
 	if (log_tv == NULL)
@@ -357,46 +1435,42 @@ void log_output(int log_level, struct timeval *log_tv, char * logstr, int loglen
 		memcpy(&system_tv, log_tv, sizeof(struct timeval));
 	}
 
-	// ログ日時を文字列に変換
-	system_tm = localtime(&system_tv.tv_sec);
-	snprintf(time_str, MAX_LOG_LENGTH, "[%d/%02d/%02d %02d:%02d:%02d.%06d] %s: ",     // 現在時刻
-		system_tm->tm_year+1900,    // 年
-		system_tm->tm_mon+1,        // 月
-		system_tm->tm_mday,         // 日
-		system_tm->tm_hour,         // 時
-		system_tm->tm_min,          // 分
-		system_tm->tm_sec,          // 秒
-		system_tv.tv_usec,          // マイクロ秒
-		loglevel_list[log_level]        // ログレベル
-		);
-
-	// デーモンモードではないなら
-	if (EVS_config.daemon != 1)
+	for (sink_index = 0; sink_index < EVS_logsink_num; sink_index ++)
 	{
-		// 標準出力
-		printf("%s %s", time_str, logstr);
-	}
-	// デーモンモードなら
-	else
-	{
-		// ログファイル名の指定があるのにログファイルが開いていなければ
-		if (EVS_config.log_file != NULL && EVS_log_fd == 0)
+		if ((route_mask & (1 << sink_index)) == 0)
+		{
+			continue;
+		}
+		// ログファイルに出力できないなら(デーモンモードではないか、ログファイルが開けていない)、標準出力に一回だけ出力する
+		if (log_sink_ready(&EVS_logsink_list[sink_index]) == 0)
 		{
-			// ログファイルを書き込みで開く(ノンブロッキングにするなら「 | O_NONBLOCK」を追加)
-			EVS_log_fd = open(EVS_config.log_file, (O_WRONLY | O_CREAT | O_APPEND), (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH));
+			print_flag = 1;
+			continue;
 		}
-		// ログファイルが開けていないなら
-		if (EVS_log_fd == 0 || EVS_log_fd == -1)
+		// 標準ログがバイナリイベントログなら、ログ日時を文字列にせずに、そのままテキストのレコードにする
+		if (sink_index == 0 && EVS_config.log_format == 1)
 		{
-			// 標準出力
-			printf("%s %s", time_str, logstr);
+			event_append(EVS_EVENT_TEXT, log_level, &system_tv, 0, logstr, loglen);
+			continue;
 		}
-		else
+		// ログ日時の文字列は、ログ出力先が複数でも一回だけ生成する
+		if (time_len == 0)
 		{
-			// ログファイルに出力
-			write(EVS_log_fd, time_str, strlen(time_str));
-			write(EVS_log_fd, logstr, loglen);
+			time_len = log_timestr(time_str, &system_tv, log_level);
 		}
+		// ログバッファに追加
+		log_append(&EVS_logsink_list[sink_index], log_level, time_str, time_len, logstr, loglen);
+	}
+
+	// デーモンモードではないか、ログファイルが開けていないなら
+	if (print_flag == 1)
+	{
+		if (time_len == 0)
+		{
+			time_len = log_timestr(time_str, &system_tv, log_level);
+		}
+		// 標準出力
+		printf("%s%s", time_str, logstr);
 	}
 
 	// 戻る
@@ -409,8 +1483,8 @@ void log_output(int log_level, struct timeval *log_tv, char * logstr, int loglen
 // ※ログ出力の時系列をなるべく合わせたい(特にクライアントやPostgreSQLとの接続中)ので、単にログに出力するのではなく、いろいろな引数とともに出力方法を制御する
 void logging(int log_type, int from_to, struct timeval *log_tv, struct EVS_ev_client_t *this_client, struct EVS_ev_pgsql_t *this_pgsql, char * log_str, int log_len)
 {
-	// ログレベル(from_to)が設定値未満なら
-	if (from_to < EVS_config.log_level)
+	// ログレベル(from_to)が設定値(もしくはコンパイル時の最小値)未満なら
+	if (!LOGLEVEL_ENABLED(from_to))
 	{
 		// ログ出力しない
 		return;
@@ -474,8 +1548,7 @@ int gethashdata(const char *target_type, char *target_data, int target_len, char
 	if (md == NULL)
 	{
 		// エラー
-		snprintf(log_str, MAX_LOG_LENGTH, "%s(): Cannot get EVP_get_digestbyname(%s)!? %s\n", __func__, target_type, ERR_reason_error_string(ERR_get_error()));
-		logging(LOG_DIRECT, LOGLEVEL_ERROR, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_DIRECT, LOGLEVEL_ERROR, NULL, log_str, "%s(): Cannot get EVP_get_digestbyname(%s)!? %s\n", __func__, target_type, ERR_reason_error_string(ERR_get_error()));
 		return -1;
 	}
 
@@ -492,14 +1565,12 @@ int gethashdata(const char *target_type, char *target_data, int target_len, char
 	// ダイジェストコンテキストを解放
 	EVP_MD_CTX_free(mdctx);
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): md_len=%d\n", __func__, md_len);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): md_len=%d\n", __func__, md_len);
 
 	// バイナリHEX変換(PostgreSQLに暗号化パスワードを送信するときには、バイナリをHEXな文字列に変換してあげないといけない)
 	result_len = byte2hex(md_value, md_len, result_data);
 
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): result_data=%s (result_len=%d)\n", __func__, result_data, result_len);
-	logging(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_DEBUG, NULL, log_str, "%s(): result_data=%s (result_len=%d)\n", __func__, result_data, result_len);
 
 	return result_len;
 }
@@ -575,8 +1646,7 @@ int main (int argc, char *argv[])
 	if (result == 0)
 	{
 		// 標準ログに出力
-		snprintf(log_str, MAX_LOG_LENGTH, "Start. (log_level=%d)\n", EVS_config.log_level);
-		logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
+		LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "Start. (log_level=%d)\n", EVS_config.log_level);
 		// ----------------
 		// イベントループ開始(libev Ver4.x以降はev_run() 他にもいくつか変更点あり。flag=0がデフォルトで、ノンブロッキングはEVRUN_NOWAIT=1、一度きりはEVRUN_ONCE=2)
 		// ----------------
@@ -587,20 +1657,33 @@ int main (int argc, char *argv[])
 	// 終了処理
 	// --------------------------------
 	CLOSE_all();
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): CLOSE_all(): Go!\n", __func__);                // daemon(0, 0): を呼ぶ前にログを出力
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): CLOSE_all(): Go!\n", __func__);                // daemon(0, 0): を呼ぶ前にログを出力
 
 	// ----------------
 	// 作成したイベントループの破棄
 	// ----------------
 	ev_loop_destroy(EVS_loop);
-	snprintf(log_str, MAX_LOG_LENGTH, "%s(): ev_loop_destroy(): Go!\n", __func__);          // daemon(0, 0): を呼ぶ前にログを出力
-	logging(LOG_QUEUEING, LOGLEVEL_INFO, NULL, NULL, NULL, log_str, strlen(log_str));
+	LOGGING(LOG_QUEUEING, LOGLEVEL_INFO, NULL, log_str, "%s(): ev_loop_destroy(): Go!\n", __func__);          // daemon(0, 0): を呼ぶ前にログを出力
 
 	// 標準ログに出力
-	snprintf(log_str, MAX_LOG_LENGTH, "Stop.\n");
-	logging(LOG_QUEUEING, LOGLEVEL_LOG, NULL, NULL, NULL, log_str, strlen(log_str));
-
+	LOGGING(LOG_QUEUEING, LOGLEVEL_LOG, NULL, log_str, "Stop.\n");
+	// ログ書き出しスレッドを終了して、ログバッファに残っているログを書き出す
+	log_writer_stop();
+	log_flush();
+	dump_flush();
+	// キャプチャファイルを使った長さに切り詰めて閉じる
+	API_capture_end();
+	// スプールファイルを閉じて削除する
+	API_spool_end();
+	// フライトレコーダーに正常に終了したことを記録して閉じる
+	flight_end();
+
+	// ログバッファの領域を解放
+	for (result = 0; result < EVS_logsink_num; result ++)
+	{
+		free(EVS_logsink_list[result].logbuf[0]);
+		EVS_logsink_list[result].logbuf[0] = NULL;
+	}
 	// ログファイル名の領域を最後に解放
 	free(EVS_config.log_file);
 
@@ -25,6 +25,8 @@
 #include <stdlib.h>                                         // 標準処理関連
 #include <string.h>                                         // 文字列関連
 #include <ctype.h>                                          // 文字関連
+#include <stdarg.h>                                         // 可変長引数関連
+#include <limits.h>                                         // 上限値関連(PATH_MAX)
 #include <fcntl.h>                                          // ファイル関連
 
 #include <netdb.h>                                          // ネットワーク・データベース操作関連
@@ -35,6 +37,7 @@
 #include <sys/ioctl.h>                                      // I/O関連
 #include <sys/un.h>                                         // UNIXドメインソケット関連
 #include <sys/stat.h>                                       // ステータス関連
+#include <sys/mman.h>                                       // メモリマップ関連(キャプチャファイル、フライトレコーダー)
 #include <sys/time.h>                                       // 日時関連
 
 #include <arpa/inet.h>                                      // アドレス変換関連
@@ -45,11 +48,19 @@
 #include <openssl/ssl.h>                                    // OpenSSL関連
 #include <openssl/err.h>                                    // OpenSSL関連
 #include <openssl/crypto.h>                                 // OpenSSL関連
+#include <openssl/rand.h>                                   // OpenSSL関連(乱数)
+#include <openssl/hmac.h>                                   // OpenSSL関連(HMAC、SCRAM-SHA-256認証)
+#include <openssl/sha.h>                                    // OpenSSL関連(SHA-256、SCRAM-SHA-256認証)
+#include <openssl/md5.h>                                    // OpenSSL関連(MD5のダイジェスト長)
 
 #include <ev.h>                                             // libev関連
 
 #include <errno.h>                                          // エラー番号関連
 
+#include <pthread.h>                                        // スレッド関連(ログ書き出しスレッド)
+
+#include "evs_event.h"                                      // バイナリイベントログのレコード形式
+
 // --------------------------------
 // 定数宣言
 // --------------------------------
@@ -68,6 +79,23 @@
 #define MAX_SIZE_64K            65536                       // 定数64KB
 #define MAX_SIZE_128K           131072                      // 定数128KB
 
+#define MAX_LOGBUF_LENGTH       MAX_SIZE_128K               // ログファイルへまとめて書き出すログバッファの長さ
+#define MAX_LOGSINK_NUM         8                           // ログ出力先の最大数(標準ログを含む。振り分け表のビットマスクに収まること)
+#define DUMP_LINE_LENGTH        70                          // ダンプ文字列の一行(16バイト分)の長さ(改行含む)
+#define DUMP_HEX_LENGTH         52                          // ダンプ文字列の一行のHEX部分の長さ(後の空白含む)
+#define DUMP_LOG_BYTES          (((MAX_LOG_LENGTH - 5) / DUMP_LINE_LENGTH) * 16)    // ダンプファイルがない時に、ログの一行に収めるバイト数
+#define MAX_EVENT_STRING_NUM    4096                        // バイナリイベントログの文字列テーブルの大きさ
+#define MAX_EVENT_STRING_PROBE  8                           // バイナリイベントログの文字列テーブルで、空きを探す数(見つからなければ文字列テーブルを使わない)
+#define MAX_SAMPLE_HOLD_LENGTH  MAX_SIZE_128K               // ログサンプリングで保留する受信データの最大長(超えたら、保留をやめてキューに入れる)
+#define MAX_STREAM_SPLIT_LENGTH MAX_SIZE_128K               // 受信データの境界で分断されたメッセージを組み立てる最大長(超えたら、タイプと長さだけ出力して読み飛ばす)
+#define MAX_PGSQL_MESSAGE_LENGTH    0x3FFFFFFF              // メッセージ長の最大値(PostgreSQLのMaxAllocSize未満。これより長ければ境界を見失ったとみなす)
+#define MAX_SAMPLE_FINGERPRINT_NUM  4096                    // ログサンプリングの、フィンガープリント別の実行回数テーブルの大きさ
+#define FLIGHT_SLOT_LENGTH      128                         // フライトレコーダーの一スロット(一イベント)の長さ
+#define FLIGHT_ARGS_LENGTH      (FLIGHT_SLOT_LENGTH - 24)   // フライトレコーダーの一スロットに格納できる引数の長さ(スロットのヘッダ部分を除く)
+#define FLIGHT_STRING_LENGTH    32                          // フライトレコーダーに格納する文字列の引数の最大長(SQL文などは先頭だけ)
+#define FLIGHT_DUMP_INTERVAL    10                          // エラーでフライトレコーダーをダンプする最短間隔(秒)(シグナルでは制限しない)
+#define FLIGHT_MAGIC            "EVSFLT01"                  // フライトレコーダーファイルの識別子
+
 #define MAX_PF_NUM              16                          // 対応するプロトコルファミリーの最大数(PF_KEYまで…実際にはPF_UNIX、PF_INET、PF_INET6しか扱わない)
 
 enum    logtype  {                                          // ログ出力方法
@@ -85,6 +113,38 @@ enum    loglevel {                                          // ログレベル
 								LOGLEVEL_MAX,
 };
 
+enum    logevent {                                          // ログ種別(ログ出力先への振り分けに使う。※相対文字列はlogevent_list[])
+								LOG_EVENT_SYSTEM,                                           // 接続、タイムアウト、SSLエラー、統計など(以下以外の全部)
+								LOG_EVENT_QUERY,                                            // メッセージ用キューの解析処理で出力する、問い合わせ毎のログ
+								LOG_EVENT_DUMP,                                             // ダンプ
+								LOG_EVENT_MAX,
+};
+
+// ----------------
+// ログ出力マクロ
+// ----------------
+// ログレベルを先に判定して、出力しないログでは引数の評価や書式化(snprintf, strlen)を一切しない。
+// EVS_LOGLEVEL_MIN未満のログレベルは定数の比較で常に偽になるので、コンパイル時に取り除かれる。(configure --disable-debug-log で、LOGLEVEL_DEBUGを取り除く)
+#ifndef EVS_LOGLEVEL_MIN
+#define EVS_LOGLEVEL_MIN        0                           // コンパイル時のログレベルの最小値(0:LOGLEVEL_DEBUG, 1:LOGLEVEL_INFO, ...)
+#endif
+// 実行時の判定は、今のログ種別(EVS_log_event)とログレベルを振り分け表で引いて、出力するログ出力先があるかどうか。
+#define LOGLEVEL_ENABLED(target_level)  ((target_level) >= EVS_LOGLEVEL_MIN && EVS_log_route[EVS_log_event][(target_level)] != 0)
+// フライトレコーダーが動いていれば、ログに出力しないログレベルでも書式化せずに記録しておく(書式文字列は__VA_ARGS__の先頭)
+#define LOGGING(log_type, target_level, log_tv, log_buf, ...) \
+	do \
+	{ \
+		if ((target_level) >= EVS_LOGLEVEL_MIN && EVS_flight_ring != NULL) \
+		{ \
+			flight_record((target_level), __VA_ARGS__); \
+		} \
+		if (LOGLEVEL_ENABLED(target_level)) \
+		{ \
+			snprintf((log_buf), MAX_LOG_LENGTH, __VA_ARGS__); \
+			logging((log_type), (target_level), (log_tv), NULL, NULL, (log_buf), strlen(log_buf)); \
+		} \
+	} while (0)
+
 // ----------------
 // 以下、個別のAPI関連
 // ----------------
@@ -94,10 +154,35 @@ enum CLIENT_PARAM_LIST {
 								CLIENT_DATABASE,                                            // 接続したいデータベース名
 								CLIENT_USERNAME,                                            // 接続してきたユーザー名
 								CLIENT_ENCODING,                                            // クライアントが指定してきた文字コード
+								CLIENT_OPTIONS,                                             // クライアントが指定してきたコマンドラインオプション
+								CLIENT_READONLY,                                            // クライアントが指定してきた読み取り専用指定(読み書き分離で使う)
 
 								CLIENT_PARAM_END,                                           // 設定値の最後(これをfor分の最後までの判定などに使えばよい)
 };
 
+enum SERVER_SASL_LIST {                                                                     // PostgreSQLのSASL認証で送られてくるパラメータ(※相対文字列はPgSQL_server_SASL_list[])
+								SERVER_SASL_NONCE,                                          // サーバー側が指定してきたナンス
+								SERVER_SASL_SALT,                                           // サーバー側が指定してきたBASE64エンコードされたソルトキー
+								SERVER_SASL_ITERATION,                                      // サーバー側が指定してきたイテレーション(反復回数)
+								SERVER_SASL_VERIFIER,                                       // サーバー側が指定してきたベリファイデータ
+
+								SERVER_SASL_END,                                            // パラメータの最後
+};
+
+#define MAX_ERRFIELD_NUM        128                         // ErrorResponse/NoticeResponseのフィールド種別数(フィールド種別の1バイトをそのまま添字にする)
+#define MAX_ERRSTAT_NUM         1024                        // エラー集計テーブルの最大エントリ数(SQLSTATE、データベース名、ユーザー名、フィンガープリント別)
+#define MAX_REQUEST_NUM         128                         // セッション毎の応答待ちリクエスト(Query/Execute/Sync)の最大数(パイプラインの深さ)
+#define MAX_STATEMENT_NUM       16                          // セッション毎にフィンガープリントを覚えておくプリペアド文の数
+#define MAX_POOL_STARTUP_LENGTH MAX_SIZE_1K                 // プールする接続で保存しておく開始メッセージレスポンス(ParameterStatus、BackendKeyData)の最大長
+#define MAX_DB_HOST_NUM         8                           // データベース別設定毎に指定できる接続先ホストの最大数("|"区切り)
+#define MAX_DB_SCRAM_NUM        MAX_DB_HOST_NUM             // データベース別設定毎に覚えておくSCRAM-SHA-256の鍵の数(ホスト毎にソルトが違うことがある)
+#define MAX_SCRAM_SALT_LENGTH   64                          // 覚えておくSCRAM-SHA-256のソルトの最大長(PostgreSQLは16バイト)
+#define SCRAM_KEY_LENGTH        SHA256_DIGEST_LENGTH        // SCRAM-SHA-256の鍵の長さ
+#define MAX_DB_STARTUP_LENGTH   256                         // データベース別設定毎に作っておくStartupMessageの最大長(データベース名、ユーザー名、アプリケーション名)
+#define CANCEL_REQUEST_CODE     80877102                    // CancelRequestのリクエストコード(1234, 5678)
+#define MD5_HEX_LENGTH          (MD5_DIGEST_LENGTH * 2)     // MD5のダイジェストのHEX文字列の長さ
+#define SCRAM_NONCE_LENGTH      24                          // SCRAM-SHA-256のクライアント側のナンスの長さ(18バイトの乱数をBASE64エンコードした長さ)
+
 // --------------------------------
 // 型宣言
 // --------------------------------
@@ -109,9 +194,15 @@ struct EVS_value_t {                                        // 設定値のポ
 struct EVS_config_t {                                       // 各種設定用構造体
 	int             daemon;                                 // デーモン化(0:フロントプロセス、1:デーモン化)
 
+	char            *config_file;                           // 設定ファイル名のフルパス(SIGHUPでPostgreSQL設定を読み直す。NULLなら読み直さない)
+
 	char            *pid_file;                              // PIDファイル名のフルパス
 	char            *log_file;                              // ログファイル名のフルパス
+	char            *dump_file;                             // ダンプファイル名のフルパス(NULLならダンプはログの一行に収まる分だけ出力する)
 	int             log_level;                              // ログに出力するレベル(0:DEBUG, 1:INFO, 2:WARN, 3:ERROR)
+	int             log_format;                             // ログファイルの形式(0:テキスト, 1:バイナリイベントログ。evs_logcatでテキストにする)
+	int             log_events;                             // ログファイルに出力するログ種別のビットマスク(1 << LOG_EVENT_xxx。LogSinkで追加したログ出力先は別に持つ)
+	ev_tstamp       logstat_intval;                         // ログ書き出し統計(バイト数、書き出し時間)の出力間隔(秒)(0:出力しない)
 
 	char            *domain_socketfile;                     // UNIXドメインソケットファイル名のフルパス
 
@@ -129,6 +220,47 @@ struct EVS_config_t {                                       // 各種設定用
 	int             keepalive_idletime;                     // KeepAlive Idle(秒)
 	int             keepalive_intval;                       // KeepAlive Interval(秒)
 	int             keepalive_probes;                       // KeepAlive Probes(回数)
+
+	ev_tstamp       errorstat_intval;                       // エラー集計の出力間隔(秒、0:集計結果を出力しない)
+	int             errorstat_warncount;                    // エラー集計の出力間隔内の発生件数がこれ以上ならWARNで出力する(0:常にLOG)
+	ev_tstamp       transaction_warntime;                   // トランザクションがこれ以上(秒)開いたままならWARNで出力する(0:警告しない)
+	ev_tstamp       copystat_intval;                        // COPY中の途中経過(バイト数、スループット)の出力間隔(秒)(0:出力しない)
+
+	char            *capture_file;                          // キャプチャファイル(pcapng)名のフルパス(NULLならキャプチャしない)
+	size_t          capture_size;                           // キャプチャファイルの大きさ(バイト)(一杯になったら".1"に名前を変えて切り替える)
+	int             capture_sample;                         // キャプチャするセッションの間隔(1:全セッション, N:N個に一つ)
+
+	char            *spool_file;                            // スプールファイル名のフルパス(NULLならスプールしない)
+	size_t          spool_size;                             // スプールファイルの大きさ(バイト)(一杯なら、それ以降はメモリ上のキューに入れる)
+	size_t          spool_threshold;                        // メッセージ用キューのメモリ量がこれを超えたら、スプールファイルに書き出す(バイト)
+	ev_tstamp       spoolstat_intval;                       // スプール統計(深さ、遅れ)の出力間隔(秒)(0:出力しない)
+
+	int             pool_size;                              // データベース別設定毎にプールする、PostgreSQLとの接続の最大数(0:プールしない)
+	char            *pool_reset_query;                      // プールに戻す時にPostgreSQLに送るリセット用の問い合わせ(空ならリセットしない)
+	ev_tstamp       pool_idle_timeout;                      // プールで待機中の接続を閉じるまでの時間(秒)(0:閉じない)
+	ev_tstamp       pool_wait_timeout;                      // 接続の空き(プール、接続数の上限)を待つ最大時間(秒)(0:無制限)
+	ev_tstamp       pool_warm_jitter;                       // 事前接続の間隔の最大値(秒)(この範囲の乱数だけ間を空けて、一つずつ接続する)
+
+	ev_tstamp       host_probe_intval;                      // 接続先ホストの死活確認(TCP接続)の間隔(秒)(0:確認しない。切り離したホストは切り離し時間が過ぎたら戻す)
+	ev_tstamp       host_eject_time;                        // 接続できなくなったホストを切り離す時間(秒)(続けて切り離す度に倍、最大8倍)
+	ev_tstamp       host_ramp_time;                         // 戻したホストへの割り振りを、元に戻すまでにかける時間(秒)(0:すぐに戻す)
+	ev_tstamp       splitstat_intval;                       // 読み書き分離の統計(プライマリ、レプリカへの割り当て数)を出力する間隔(秒)(0:出力しない)
+
+	int             max_backend_conn;                       // PostgreSQLとの接続数の全体の上限(0:無制限)
+	int             max_database_conn;                      // データベース名毎のPostgreSQLとの接続数の上限(0:無制限)
+	int             admit_queue_length;                     // 接続の空きを待てるクライアント数の全体の上限(超えたら待たせずにエラーを返す)(0:無制限)
+	ev_tstamp       admitstat_intval;                       // 接続の受け入れ制御の統計(待ち行列の深さ、待ち時間の分布)を出力する間隔(秒)(0:出力しない)
+
+	int             max_wildcard_entries;                   // ワイルドカードの設定から作る設定の数の上限(0:無制限)
+
+	int             logsample_session;                      // 全メッセージを解析するセッションの間隔(1:全セッション, N:N個に一つ)
+	int             logsample_statement;                    // 対象外のセッションで、フィンガープリント別に解析する問い合わせの間隔(0:しない, N:N回に一回)
+	ev_tstamp       logsample_slowtime;                     // 対象外のセッションでも、これ以上(秒)かかった問い合わせは解析する(0:しない。エラーは常に解析する)
+
+	int             flight_recorder;                        // フライトレコーダーのスロット数(記録しておく直近のイベント数)(0:記録しない)
+	char            *flight_file;                           // フライトレコーダーファイル名のフルパス(mmapして異常終了後も残す。NULLならメモリ上だけ)
+	char            *flight_dump;                           // フライトレコーダーのダンプ先ファイル名のフルパス
+	char            *flight_sqlstate;                       // このSQLSTATEのErrorResponseでダンプする(","区切り、5文字ならコード、2文字ならクラス。NULLならダンプしない)
 };
 
 struct EVS_port_t {                                         // ポート別設定用構造体
@@ -139,6 +271,34 @@ struct EVS_port_t {                                         // ポート別設
 	TAILQ_ENTRY (EVS_port_t) entries;                       // 次のTAILQ構造体への接続 → man3/queue.3.html
 };
 
+struct EVS_host_t {                                         // 接続先ホスト別構造体(ホスト名・サービス名毎に一つ作り、同じホストを使うデータベース別設定で振り分け用の状態を共有する)
+	ev_io           probe_watcher;                          // 死活確認(ノンブロッキングのTCP接続)の書き込み監視。コールバック関数内でEVS_host_t*に型変換するので先頭に置く
+	char            hostname[128];                          // ホスト名
+	char            servicename[16];                        // サービス名(ポート番号)
+	struct sockaddr_storage probe_addr;                     // 死活確認の接続先アドレス(設定を読み込んだ時に名前解決しておく)
+	socklen_t       probe_addrlen;                          // 死活確認の接続先アドレスの長さ(0:名前解決できなかった)
+	int             db_num;                                 // このホストを使っているデータベース別設定の数(0になったら開放する)
+	int             balance_num;                            // このホストを使っている、複数のホストを指定したデータベース別設定の数(0なら死活確認しない)
+	int             outstanding;                            // 応答待ちの問い合わせ数
+	ev_tstamp       latency_ewma;                           // 問い合わせの応答時間の指数移動平均(秒)(0:まだ計っていない)
+	int             fail_count;                             // 問い合わせ中に接続が切れた回数(応答が返れば0に戻す)
+	int             eject_count;                            // 続けて切り離した回数(切り離す時間を倍にしていく。割り振りが元に戻れば0に戻す)
+	ev_tstamp       eject_until;                            // 切り離しを終える日時(0:切り離していない)
+	ev_tstamp       ramp_start;                             // 切り離しから戻した日時(HostRampTimeかけて割り振りを増やしていく。0:戻し中ではない)
+	ev_tstamp       probe_time;                             // 最後に死活確認を始めた日時
+	int             probe_fd;                               // 死活確認中のソケット(-1:確認中ではない)
+	TAILQ_ENTRY (EVS_host_t) entries;                       // 次のTAILQ構造体への接続 → man3/queue.3.html
+};
+
+struct EVS_scram_t {                                        // SCRAM-SHA-256の鍵(ソルトとイテレーション毎。PBKDF2を接続毎に計算しないように覚えておく)
+	unsigned char   salt[MAX_SCRAM_SALT_LENGTH];            // ソルト
+	int             salt_len;                               // ソルトの長さ(0:未使用)
+	int             iteration;                              // イテレーション(反復回数)
+	unsigned char   client_key[SCRAM_KEY_LENGTH];           // ClientKey = HMAC(SaltedPassword, "Client Key")
+	unsigned char   stored_key[SCRAM_KEY_LENGTH];           // StoredKey = SHA-256(ClientKey)
+	unsigned char   server_key[SCRAM_KEY_LENGTH];           // ServerKey = HMAC(SaltedPassword, "Server Key")
+};
+
 struct EVS_db_t {                                           // データベース別設定用構造体
 	char            database[64];                           // データベース名(PostgreSQLではデータベース名は最大63バイト)
 	char            username[32];                           // ユーザー名(PostgreSQLではデータベース名は最大20バイト)
@@ -146,6 +306,39 @@ struct EVS_db_t {                                           // データベー
 	char            hostname[128];                          // ホスト名
 	char            servicename[16];                        // パスワード(PostgreSQLではデータベース名は最大30バイト)
 	unsigned short  port;                                   // ポート番号(1～65535)
+	TAILQ_HEAD (EVS_pool_head, EVS_ev_pgsql_t) pool_tailq;  // プールで待機中のPostgreSQLとの接続(先頭が最後に戻した接続)
+	int             pool_num;                               // プールで待機中の接続数
+	int             pool_reset_num;                         // プールに戻すためにリセット中の接続数
+	unsigned long   pool_reuse_count;                       // プールの接続を割り当てた回数
+	int             pool_mode;                              // プールの単位(0:セッション単位, 1:トランザクション単位)
+	int             pgsql_num;                              // このデータベース別設定で開いているPostgreSQLとの接続数(接続処理中、割り当て中、プール待機中の合計)
+	TAILQ_HEAD (EVS_wait_head, EVS_ev_client_t) wait_tailq; // 接続の空き(プール、接続数の上限)を待っているクライアント(先に待った順)
+	int             wait_num;                               // 接続の空きを待っているクライアント数
+	int             pool_min;                               // プールで待機させておく接続の最小数(MinIdle、足りなければ事前に接続しておく)
+	int             pool_max;                               // プールの接続の最大数(MaxSize、0ならPoolSize)
+	int             warm_num;                               // 事前接続中(クライアントなしで接続処理中)の接続数
+	ev_tstamp       warm_time;                              // 次に事前接続してよい日時(0:まだ決めていない)
+	struct EVS_host_t *host_list[MAX_DB_HOST_NUM];          // 接続先ホスト別構造体へのポインタ(UNIXドメインソケットなら使わない)
+	double          host_credit[MAX_DB_HOST_NUM];           // ラウンドロビンの持ち点(重みを足していき、選ばれたら重みの合計を引く)
+	int             host_num;                               // 接続先ホストの数(0:UNIXドメインソケット)
+	int             host_next;                              // 次に振り分けを始めるホストの位置(ラウンドロビン、同点の時の順番)
+	int             balance_mode;                           // 振り分け方法(0:ラウンドロビン, 1:応答待ちの問い合わせ数が最少, 2:応答時間が最短)
+	char            startup_message[MAX_DB_STARTUP_LENGTH]; // PostgreSQLに送るStartupMessage(設定を読み込んだ時に作っておく)
+	int             startup_message_len;                    // PostgreSQLに送るStartupMessageの長さ
+	char            md5_password[MD5_HEX_LENGTH + 1];       // MD5認証のmd5(パスワード+ユーザー名)のHEX文字列(設定を読み込んだ時に求めておく)
+	struct EVS_scram_t scram_list[MAX_DB_SCRAM_NUM];        // SCRAM-SHA-256の鍵(ソルトとイテレーション毎)
+	int             scram_next;                             // 次にSCRAM-SHA-256の鍵を覚える位置(一杯なら古いものから置き換える)
+	int             split_mode;                             // 読み書き分離(0:しない, 1:最初のホストをプライマリ、残りをレプリカとして、読み取り専用の問い合わせをレプリカに送る)
+	unsigned long   split_primary_count;                    // 読み書き分離で、プライマリの接続を割り当てた回数(統計を出力したら0に戻す)
+	unsigned long   split_replica_count;                    // 読み書き分離で、レプリカの接続を割り当てた回数(統計を出力したら0に戻す)
+	struct EVS_db_t *admit_group;                           // 同じデータベース名の最初のデータベース別設定(データベース名毎の接続数は、この設定のadmit_numで数える)
+	int             admit_num;                              // 同じデータベース名のデータベース別設定で開いている、PostgreSQLとの接続数の合計
+	int             admit_queued;                           // 待っているクライアントがいるデータベース別設定の並び(admit_entries)に入っているか
+	TAILQ_ENTRY (EVS_db_t) admit_entries;                   // 待っているクライアントがいる次のデータベース別設定への接続(順番に一人ずつ割り当てる)
+	int             route_expanded;                         // ワイルドカードの設定から作った設定か(使われなくなったら開放する)
+	int             route_retired;                          // 経路表から外した設定か(設定の読み直しで無くなった、使われなくなった。新しいクライアントには使わず、接続がなくなったら開放する)
+	int             client_num;                             // この設定を使っているクライアント数
+	ev_tstamp       route_lasttime;                         // 最後にクライアントがこの設定を使い終わった日時
 	TAILQ_ENTRY (EVS_db_t) entries;                         // 次のTAILQ構造体への接続 → man3/queue.3.html
 };
 
@@ -167,7 +360,7 @@ struct EVS_ev_pgsql_t {                                     // PostgreSQL用構
 	ev_io           io_watcher;                             // libevのev_io、これをev_io_init()＆ev_io_start()に渡す
 	ev_tstamp       last_activity;                          // 最終アクティブ日時(PostgreSQLとのやり取りが最後にアクティブとなった日時)
 	int             socket_fd;                              // PostgreSQLに接続した際のファイルディスクリプタ
-	int             pgsql_status;                           // PostgreSQLへの接続状態(0:未接続、1:接続開始、2:接続中、3:レスポンスデータ待ちなど)
+	int             pgsql_status;                           // PostgreSQLへの接続状態(0:未接続、1:接続開始、2:接続中、3:レスポンスデータ待ち、10:透過モード、20:プール待機中、21:リセット中など)
 	int             ssl_status;                             // SSL接続状態(0:非SSL/SSL接続前、1:SSLハンドシェイク中、2:SSL接続中)
 	SSL_CTX         *ctx;                                   // SSL設定情報
 	SSL             *ssl;                                   // SSL接続情報
@@ -181,6 +374,20 @@ struct EVS_ev_pgsql_t {                                     // PostgreSQL用構
 	void            *db_info;                               // データベース別構造体へのポインタ
 	int             recv_len;                               // PostgreSQLから受信したメッセージ長
 	char            recv_buf[MAX_RECV_BUF_LENGTH];          // PostgreSQLから受信したメッセージ
+	char            ready_status;                           // 最後に受信したReadyForQueryのトランザクション状態('I', 'T', 'E'。0:問い合わせ中)
+	int             reset_count;                            // リセット中に、ReadyForQueryを待っている問い合わせの数
+	int             startup_len;                            // 保存した開始メッセージレスポンスの長さ(-1:保存しきれなかったので、プールしない)
+	int             pool_pending;                           // 接続を待っているクライアントのために開いた接続か(1:開始メッセージレスポンスをクライアントに送らない)
+	int             pool_warm;                              // 事前接続中の接続か(1:クライアントなしで接続処理中、終わったらプールに入れる)
+	int             host_index;                             // 接続したホストのdb_info->host_listの位置
+	ev_tstamp       request_time;                           // 応答待ちの問い合わせを送り始めた日時(0:応答待ちではない)
+	int             cancel_flag;                            // PostgreSQLからBackendKeyDataを受け取ったか(1:cancel_keyが有効)
+	char            cancel_key[8];                          // PostgreSQLから受け取ったBackendKeyData(プロセスIDと秘密鍵、ネットワークバイトオーダーのまま)
+	int             scram_status;                           // SCRAM-SHA-256認証の状態(0:していない, 1:client-first送信済み, 2:client-final送信済み, 3:サーバー署名確認済み)
+	char            scram_nonce[SCRAM_NONCE_LENGTH + 1];    // SCRAM-SHA-256認証で送ったクライアント側のナンス
+	unsigned char   scram_signature[SCRAM_KEY_LENGTH];      // SCRAM-SHA-256認証で、サーバーから返ってくるはずのServerSignature
+	char            startup_buf[MAX_POOL_STARTUP_LENGTH];   // 保存した開始メッセージレスポンス(ParameterStatus、BackendKeyData)
+	TAILQ_ENTRY (EVS_ev_pgsql_t) pool_entries;              // プールの次のTAILQ構造体への接続
 	TAILQ_ENTRY (EVS_ev_pgsql_t) entries;                   // 次のTAILQ構造体への接続 → man3/queue.3.html
 };
 
@@ -206,12 +413,22 @@ struct EVS_ev_client_t {                                    // コールバッ
 	char            recv_buf[MAX_RECV_BUF_LENGTH];          // クライアントから受信したメッセージ
 	char            param_buf[MAX_STRING_LENGTH];           // 各クライアントに必要な各種設定値用バッファ(ユーザー名、データベース名、文字エンコーディングなど…実際には128バイトもいらない)
 	char            *param_info[CLIENT_PARAM_END];          // 各種設定値ポインタの配列(各種設定値のparam_buf内のポインタを示す)
+	void            *session_info;                          // セッション別解析情報構造体へのポインタ(解放はメッセージ用キュー経由で行う)
+	void            *db_info;                               // 接続先のデータベース別設定へのポインタ
+	int             pool_wait;                              // PostgreSQLとの接続の空きを待っているか(1:待っている。待っている間は受信を止める)
+	ev_tstamp       wait_time;                              // PostgreSQLとの接続の空きを待ち始めた日時
+	int             route_readonly;                         // 読み取り専用のセッションか(1:開始メッセージでdefault_transaction_read_only=onが指定された)
+	int             route_replica;                          // 次に割り当てる接続の種類(0:プライマリ, 1:レプリカ)
+	unsigned int    cancel_pid;                             // クライアントに渡したBackendKeyDataのプロセスID(PgAnalyzerが割り当てる。0:まだ渡していない)
+	unsigned int    cancel_key;                             // クライアントに渡したBackendKeyDataの秘密鍵(乱数)
+	struct EVS_ev_client_t *cancel_next;                    // CancelRequest用のキー索引で、同じ位置にある次のクライアント
+	TAILQ_ENTRY (EVS_ev_client_t) wait_entries;             // 接続の空きを待っている次のTAILQ構造体への接続
 	TAILQ_ENTRY (EVS_ev_client_t) entries;                  // 次のTAILQ構造体への接続 → man3/queue.3.html
 };
 
 struct EVS_ev_message_t {                                   // メッセージ用構造体
 	unsigned int    MID;                                    // メッセージID(TBD)
-	int             from_to;                                // メッセージの方向(LOGLEVEL_MAX以下:そのままログに出力, 101:Client->PgAnalyzer, 102:PgAnalyzer->Client, 111:PgAnalyzer->PostgreSQL, 112:PostgreSQL->PgAnalyzer)
+	int             from_to;                                // メッセージの方向(LOGLEVEL_MAX以下:そのままログに出力, 100:セッション終了, 101:Client->PgAnalyzer, 102:PgAnalyzer->Client, 111:PgAnalyzer->PostgreSQL, 112:PostgreSQL->PgAnalyzer, 113:ログサンプリング対象外のReadyForQuery)
 	int             client_socket_fd;                       // PostgreSQLに接続した際のファイルディスクリプタ
 	int             client_status;                          // クライアント毎の状態(0:接続待ち、1:開始メッセージ応答待ち、2:クエリメッセージ待ち、3:クエリデータ待ち、など)
 	int             client_ssl_status;                      // SSL接続状態(0:非SSL/SSL接続前、1:SSLハンドシェイク中、2:SSL接続中)
@@ -223,9 +440,159 @@ struct EVS_ev_message_t {                                   // メッセージ
 	struct timeval  message_tv;                             // メッセージを受信した秒・マイクロ秒の構造体
 	void            *message_ptr;                           // malloc&memcpyしたメッセージへのポインタ
 	unsigned int    message_len;                            // malloc&memcpyしたメッセージの長さ
+	void            *session_info;                          // セッション別解析情報構造体へのポインタ
+	int             log_event;                              // ログ種別(from_toがLOGLEVEL_MAX以下の時、キューに入れた時のEVS_log_event)
 	TAILQ_ENTRY (EVS_ev_message_t) entries;                 // 次のTAILQ構造体への接続 → man3/queue.3.html
 };
 
+struct EVS_stream_t {                                       // メッセージ分断情報構造体(受信単位の境界で分断されたメッセージを、次の受信データで組み立てるか読み飛ばすための情報)
+	unsigned int    skip_len;                               // 次の受信データの先頭で読み飛ばす(split_lenが0以外なら組み立てる)べき、分断されたメッセージの残りの長さ
+	int             header_len;                             // 分断されたメッセージヘッダ(メッセージタイプ＋メッセージ長)のうち、受信済みの長さ
+	char            header_buf[5];                          // 分断されたメッセージヘッダの受信済み部分
+	char            *split_buf;                             // 分断されたメッセージを組み立てるバッファ(メッセージ用キューの解析処理でだけ使う)
+	unsigned int    split_len;                              // 組み立て中のメッセージの受信済みの長さ(0:組み立て中ではない)
+	unsigned int    split_size;                             // split_bufの確保済みの長さ
+};
+
+struct EVS_relay_t {                                        // COPY中継状態構造体(受信時の処理で参照して、CopyDataをメッセージ用キューに入れずに数えるだけにする)
+	struct EVS_stream_t stream[2];                          // 受信時のメッセージ境界情報(0:クライアント→PostgreSQL, 1:PostgreSQL→クライアント、header_buf[0]は処理中のメッセージタイプ)
+	int             relay_lost;                             // メッセージの境界を見失ったかどうか(1:以降はCopyDataを取り除かずにそのままキューに入れる)
+	char            copy_status;                            // COPY状態(0:COPY中ではない, G:COPY FROM STDIN, H:COPY TO STDOUT, W:COPY BOTH)
+	char            copy_end;                               // COPYの終了を示すメッセージ(0:未受信, c:CopyDone, f:CopyFail)
+	struct timeval  copy_start_tv;                          // COPYを開始した日時
+	unsigned long long copy_bytes;                          // COPYで中継したCopyDataの本文のバイト数
+	unsigned long   copy_chunks;                            // COPYで中継したCopyDataの数
+	ev_tstamp       report_time;                            // 直前に途中経過を出力した日時
+	unsigned long long report_bytes;                        // 直前に途中経過を出力した時点のバイト数
+	int             sync_count;                             // 応答待ちの問い合わせサイクル数(送ったQuery/Sync/FunctionCallの数 - 受信したReadyForQueryの数)
+	char            ready_status;                           // 最後に受信したReadyForQueryのトランザクション状態('I', 'T', 'E'。0:問い合わせ中)
+};
+
+struct EVS_capture_t {                                      // キャプチャ状態構造体(pcapngに出力する擬似TCPコネクションの情報)
+	int             capture_flag;                           // キャプチャ対象のセッションかどうか(1:対象)
+	uint32_t        addr[2];                                // 擬似IPv4アドレス(0:クライアント, 1:PostgreSQL、ネットワークバイトオーダー)
+	unsigned short  port[2];                                // 擬似ポート番号(0:クライアント, 1:PostgreSQL)
+	uint32_t        seq[2];                                 // 次のシーケンス番号(0:クライアント→PostgreSQL, 1:PostgreSQL→クライアント)
+};
+
+struct EVS_flight_slot_t {                                  // フライトレコーダーのスロット(一イベント分。FLIGHT_SLOT_LENGTHバイト)
+	uint32_t        seq;                                    // 書き込んだ通し番号＋1(最後に書き込む。0なら書き込み中か未使用)
+	uint8_t         log_level;                              // ログレベル
+	uint8_t         args_len;                               // 引数の長さ
+	uint16_t        reserved;                               // 予約
+	uint32_t        tv_sec;                                 // 日時(秒)
+	uint32_t        tv_usec;                                // 日時(マイクロ秒)
+	int64_t         format_off;                             // 書式文字列の位置(実行ファイルの先頭からのオフセット。同じ実行ファイルでなら書式化できる)
+	char            args[FLIGHT_ARGS_LENGTH];               // 書式文字列に対応する引数の並び(形式はevs_event.hを参照)
+};
+
+struct EVS_flight_t {                                       // フライトレコーダー(ヘッダ＋スロットの並び。FlightFileならそのままファイルにmmapする)
+	char            magic[8];                               // 識別子(FLIGHT_MAGIC)
+	int64_t         exe_size;                               // 記録した実行ファイルの大きさ(書式文字列の位置が同じ実行ファイルか判定する)
+	int64_t         exe_mtime;                              // 記録した実行ファイルの更新日時
+	uint32_t        slot_num;                               // スロット数(2のべき乗)
+	uint32_t        slot_size;                              // スロットの長さ(FLIGHT_SLOT_LENGTH)
+	uint32_t        next_seq;                               // 次に書き込む通し番号
+	uint32_t        running;                                // 記録中か(1:記録中。起動時にまだ1なら前回は異常終了)
+	char            reserved[FLIGHT_SLOT_LENGTH - 40];      // 予約(スロットの並びをFLIGHT_SLOT_LENGTHバイト境界に合わせる)
+	struct EVS_flight_slot_t slot[];                        // スロットの並び
+};
+
+struct EVS_sample_t {                                       // ログサンプリング状態構造体(受信時の処理で参照して、サンプリング対象外の問い合わせはメッセージ用キューに入れない)
+	int             sample_flag;                            // セッションの全メッセージを解析するか(1:全部, 0:遅いかエラーになった問い合わせと、フィンガープリント別に選ばれた問い合わせだけ)
+	int             hold_status;                            // 保留状態(0:保留なし, 1:保留中, 2:保留をやめてキューに入れている(ReadyForQueryまで))
+	unsigned int    hold_pending;                           // 保留中の問い合わせサイクル(Query/Sync/FunctionCall)のうち、ReadyForQuery待ちの数
+	int             hold_error;                             // 保留中にErrorResponseが来たか(1:来た)
+	struct timeval  hold_tv;                                // 保留を開始した日時
+	char            *hold_buf;                              // 保留バッファ(受信データをレコードにして並べる。セッション内で使い回す)
+	unsigned int    hold_len;                               // 保留バッファの使用長
+	unsigned int    hold_size;                              // 保留バッファの大きさ
+	unsigned int    record_pos;                             // 追記中のレコードの位置
+	char            txn_status;                             // 受信時に見た直近のReadyForQueryのトランザクション状態
+};
+
+struct EVS_request_t {                                      // 応答待ちリクエスト構造体(パイプラインで送られたリクエストと応答を順番に対応付ける)
+	int             request_type;                           // リクエスト種別('Q':Query, 'E':Execute, 'S':Sync)
+	unsigned int    fingerprint;                            // リクエストのフィンガープリント
+	unsigned int    depth;                                  // リクエストを送信した時点の応答待ちリクエスト数(このリクエストを含む)
+	unsigned long   row_count;                              // 受信したDataRowの数
+	struct timeval  request_tv;                             // リクエストを受信した日時
+};
+
+struct EVS_lexinfo_t {                                      // クエリの字句解析結果(フィンガープリント生成処理で一緒に求める、読み書き分離の判定用)
+	char            first_word[16];                         // 最初の単語(小文字)
+	int             statement_num;                          // 文の数(";"の後に続きがあれば2以上)
+	int             write_flag;                             // 書き込みを伴うかもしれない単語があったか(INTO、FOR UPDATE/SHARE、nextval()など。1:あった)
+};
+
+struct EVS_statement_t {                                    // プリペアド文構造体(Parseで送られたプリペアド文名とクエリのフィンガープリント)
+	char            name[64];                               // プリペアド文名(空文字列:無名のプリペアド文)
+	unsigned int    fingerprint;                            // クエリのフィンガープリント
+};
+
+struct EVS_session_t {                                      // セッション別解析情報構造体(クライアント毎に確保して、メッセージ用キューの解析処理から参照する)
+	unsigned int    session_id;                             // セッションID(バイナリイベントログでセッションを識別する。1から順に割り当て)
+	struct EVS_stream_t stream[2];                          // メッセージ分断情報(0:クライアント→PostgreSQL, 1:PostgreSQL→クライアント)
+	char            database[64];                           // クライアントが接続したデータベース名
+	char            username[32];                           // クライアントが接続したユーザー名
+	unsigned int    fingerprint;                            // 直近のクエリのフィンガープリント(定数部分を除いて正規化したクエリのハッシュ値)
+	char            txn_status;                             // トランザクション状態(ReadyForQueryの状態 I:トランザクション外, T:トランザクション中, E:失敗したトランザクション中)
+	int             cycle_flag;                             // 問い合わせサイクル中かどうか(0:ReadyForQuery待ちではない=アイドル, 1:クライアントからの問い合わせ後でReadyForQuery待ち)
+	int             txn_warned;                             // 現在のトランザクションについて長時間トランザクションの警告を出力済みかどうか
+	unsigned int    txn_statements;                         // 現在のトランザクション内の問い合わせサイクル数(ReadyForQueryの数)
+	struct timeval  query_tv;                               // 直近の問い合わせサイクルを開始した(クライアントからメッセージを受信した)日時
+	struct timeval  ready_tv;                               // 直近のReadyForQueryを受信した日時(トランザクション中ならアイドルの開始日時)
+	struct timeval  txn_start_tv;                           // 現在のトランザクションを開始した日時
+	double          txn_idle_time;                          // 現在のトランザクション内でアイドルだった時間の合計(秒)
+	struct EVS_request_t request_list[MAX_REQUEST_NUM];     // 応答待ちリクエストのFIFO(リングバッファ)
+	unsigned int    request_head;                           // 応答待ちリクエストのFIFOの先頭
+	unsigned int    request_num;                            // 応答待ちリクエストの数
+	unsigned int    statement_num;                          // 応答待ちリクエストのうち、QueryとExecuteの数(パイプラインの深さ)
+	unsigned int    max_depth;                              // パイプラインの深さの最大値
+	unsigned long   statement_count;                        // 完了したQueryとExecuteの数
+	unsigned long   pipelined_count;                        // 完了したQueryとExecuteのうち、他のリクエストの応答待ち中に送られたものの数
+	int             request_lost;                           // 応答待ちリクエストのFIFOが溢れて、対応付けができなくなったかどうか
+	struct EVS_statement_t statement_list[MAX_STATEMENT_NUM];   // プリペアド文とフィンガープリントの対応表
+	unsigned int    statement_next;                         // 次にプリペアド文を登録する位置
+	unsigned int    bind_fingerprint;                       // 直近のBindで指定されたプリペアド文のフィンガープリント
+	struct EVS_relay_t relay;                               // COPY中継状態(受信時の処理で参照する)
+	struct EVS_capture_t capture;                           // キャプチャ状態(受信時の処理で参照する)
+	struct EVS_sample_t sample;                             // ログサンプリング状態(受信時の処理で参照する)
+};
+
+struct EVS_pgmsg_t {                                        // PostgreSQLメッセージ解析用構造体(メッセージ内を直接指すだけで、コピーはしない)
+	int             from_client;                            // メッセージの方向(1:クライアント→PostgreSQL(F), 0:PostgreSQL→クライアント(B))
+	int             log_type;                               // ログ出力方法(LOG_DIRECT:メッセージ用キューの解析処理, LOG_QUEUEING:受信時の解析処理)
+	struct timeval  *log_tv;                                // ログ日時(NULLなら現在日時)
+	char            *addr_str;                              // クライアントのアドレス文字列
+	struct EVS_session_t *session_info;                     // セッション別解析情報構造体へのポインタ(なければNULL)
+	unsigned char   message_type;                           // メッセージタイプ
+	unsigned int    message_len;                            // メッセージ長(メッセージ長自身の4バイトを含み、メッセージタイプの1バイトは含まない)
+	char            *message_ptr;                           // メッセージの先頭(メッセージタイプ)へのポインタ
+	char            *read_ptr;                              // 次に読み込む位置
+	char            *end_ptr;                               // メッセージの終端(の次)
+	unsigned int    auth_type;                              // 解析結果 : Authentication(R)の認証方式
+	char            txn_status;                             // 解析結果 : ReadyForQuery(Z)のトランザクション状態
+	int             sample_out;                             // ログサンプリングの対象外か(1:対象外。LOGレベルのログは出力しない)
+};
+
+struct EVS_decoder_t {                                      // メッセージタイプ別デコーダ登録用構造体
+	int             (*decode_func)(struct EVS_pgmsg_t *);   // デコード処理(NULL:未定義のメッセージタイプ)
+	unsigned int    min_len;                                // メッセージ長の最小値(メッセージ長自身の4バイトを含む)
+};
+
+struct EVS_errstat_t {                                      // エラー集計用構造体(SQLSTATE、データベース名、ユーザー名、フィンガープリント別)
+	unsigned int    hash;                                   // 集計キーのハッシュ値(0:未使用)
+	char            sqlstate[6];                            // SQLSTATE(5文字)
+	char            severity[16];                           // 重要度(ERROR, FATAL, WARNINGなど)
+	char            database[64];                           // データベース名
+	char            username[32];                           // ユーザー名
+	unsigned int    fingerprint;                            // フィンガープリント
+	unsigned long   total_count;                            // 起動してからの発生件数
+	unsigned long   interval_count;                         // 前回の集計出力から今回までの発生件数
+	time_t          last_time;                              // 最後に発生した日時
+};
+
 struct EVS_timer_t {                                        // タイマー別構造体
 	ev_tstamp       timeout;                                // タイムアウト秒(ev_now + タイムアウト時間)
 	void            *target;                                // タイムアウトに必要な構造体のポインタ
@@ -249,6 +616,8 @@ extern ev_timer                         timeout_watcher;                // タ
 extern ev_signal                        signal_watcher_sighup;          // シグナルオブジェクト(シグナルごとにウォッチャーを分けないといけない)
 extern ev_signal                        signal_watcher_sigint;          // シグナルオブジェクト(シグナルごとにウォッチャーを分けないといけない)
 extern ev_signal                        signal_watcher_sigterm;         // シグナルオブジェクト(シグナルごとにウォッチャーを分けないといけない)
+extern ev_signal                        signal_watcher_sigusr1;         // シグナルオブジェクト(シグナルごとにウォッチャーを分けないといけない)
+extern ev_signal                        signal_watcher_sigusr2;         // シグナルオブジェクト(シグナルごとにウォッチャーを分けないといけない)
 
 extern struct ev_loop                   *EVS_loop;                      // イベントループ
 
@@ -269,8 +638,11 @@ extern SSL_CTX                          *EVS_ctx;                       // SSL
 // その他の変数
 // ----------------
 extern const char                       *loglevel_list[];               // ログレベル文字列テーブル
-extern int                              EVS_log_fd;                     // ログファイルディスクリプタ
+extern const char                       *logevent_list[];               // ログ種別文字列テーブル
 extern int                              EVS_log_mode;                   // ログモード(0:直接出力、1:キューイング)
+extern int                              EVS_log_event;                  // 今のログ種別(LOG_EVENT_xxx)
+extern unsigned int                     EVS_log_route[LOG_EVENT_MAX][LOGLEVEL_MAX + 1];     // ログ振り分け表(ログ種別とログレベル毎の、ログ出力先のビットマスク)
+extern struct EVS_flight_t              *EVS_flight_ring;               // フライトレコーダー(NULLなら記録しない)
 
 // ----------------
 // 以下、個別のAPI関連
@@ -282,11 +654,30 @@ extern int                              EVS_log_mode;                   // ロ
 // --------------------------------
 // プロトタイプ宣言
 // --------------------------------
-extern char *getdumpstr(void *, int);                                   // ダンプ文字列生成処理
+extern char *getdumpstr(void *, int, int *);                            // ダンプ文字列生成処理
 extern void dump2log(int, int, struct timeval *, void *, int);          // ダンプ出力
+extern void dump_flush(void);                                           // ダンプファイル書き出し処理
+extern void dump_reopen(void);                                          // ダンプファイル開き直し処理
+extern int flight_start(void);                                          // フライトレコーダー開始処理
+extern void flight_end(void);                                           // フライトレコーダー終了処理
+extern void flight_record(int, const char *, ...);                      // フライトレコーダー記録処理
+extern void flight_dump(const char *, int);                             // フライトレコーダーダンプ処理
+extern int flight_sqlstate(const char *);                               // フライトレコーダーダンプ対象SQLSTATE判定処理
 extern void log_queueing(int, struct EVS_ev_client_t *, struct EVS_ev_pgsql_t *, char *, int);                          // ログキューイング処理
 extern void log_output(int, struct timeval *, char *, int);                                                             // ログダイレクト出力処理
+extern int log_writer_start(void);                                      // ログ書き出しスレッド開始処理
+extern void log_writer_stop(void);                                      // ログ書き出しスレッド終了処理
+extern void log_flush(void);                                            // ログバッファ書き出し処理
+extern void log_reopen(void);                                           // ログファイル開き直し処理
+extern void log_close(void);                                            // 標準ログのログファイル終了処理
+extern int log_sink_add(const char *, int, int, const char *);          // ログ出力先追加処理
+extern void log_route_init(void);                                       // ログ振り分け表生成処理
+extern void log_report(ev_tstamp);                                      // ログ書き出し統計出力処理
+extern void event_reset(void);                                          // バイナリイベントログ : 文字列テーブル初期化処理
+extern void event_session(unsigned int, const char *, const char *, const char *);      // バイナリイベントログ : セッション開始出力処理
+extern int event_message(int, struct timeval *, unsigned int, int, int, unsigned int, const char *, const char *, va_list);  // バイナリイベントログ : メッセージ出力処理
 extern void logging(int, int, struct timeval *, struct EVS_ev_client_t *, struct EVS_ev_pgsql_t *, char * , int);       // ログ出力処理
+extern int byte2hex(unsigned char *, unsigned int, char *);              // バイナリHEX変換(バイナリデータ、バイナリデータ長、HEX文字列格納ポインタ)
 extern int gethashdata(const char *, char *, int , char *, int , char *);   // 暗号化データ生成(暗号化方式(文字列で"md5", "sha256"など)、暗号対象データ、暗号対象データ長、ソルトデータ、ソルトデータ長、ハッシュ化データ格納ポインタ)
 extern int memmemlist(void *, int, void *, int, int, struct EVS_value_t *); // データ分割処理(対象データ、対象データ長、セパレータ、セパレータ長、格納配列)
 
@@ -299,15 +690,125 @@ extern void CLOSE_client(struct ev_loop *, struct ev_io *, int);        // ク
 extern int CLOSE_all(void);                                             // 終了処理
 
 extern int API_pgsql_client_message(struct EVS_ev_message_t *);         // クライアントクエリメッセージ解析処理
-extern int API_pgsql_message_decodequeryresponse(struct EVS_ev_message_t *, char *, unsigned int);      // PostgreSQL側各種クエリレスポンス解析処理
 extern int API_pgsql_server_message(struct EVS_ev_message_t *);         // PostgreSQL側メッセージ処理
 
 extern int API_pgsql_server_send(struct EVS_ev_pgsql_t *, unsigned char *, int );   // PostgreSQL送信処理
 extern int API_start(struct EVS_ev_client_t *);                         // API開始処理(クライアント別処理分岐、スレッド生成など)
 extern int API_pgsql_server_start(struct EVS_ev_client_t *);            // サーバー接続開始処理
+extern int API_pgsql_server_open(struct EVS_ev_client_t *, struct EVS_db_t *);    // サーバー接続処理(PostgreSQL用構造体の確保と接続)
 extern int API_pgsql_SSLHandshake(struct EVS_ev_pgsql_t *);             // PostgreSQL SSLハンドシェイク処理
 extern int API_pgsql_send_StartupMessage(struct EVS_ev_pgsql_t *);      // PostgreSQL StartupMessage処理 (※この関数を呼ぶ時には、this_client->param_infoに完璧なデータが入っている前提)
 extern int API_pgsql_send_PasswordMessageMD5(struct EVS_ev_pgsql_t *);  // PostgreSQL PasswordMessage(MD5)処理
+extern int API_pgsql_prepare(struct EVS_db_t *);                         // PostgreSQL接続用データ事前生成処理(StartupMessage、md5(パスワード+ユーザー名))
+extern void API_pgsql_end(void);                                         // PostgreSQL接続用データ終了処理
+extern int API_scram_start(struct EVS_ev_pgsql_t *, struct EVS_pgmsg_t *);     // SCRAM-SHA-256認証開始処理(AuthenticationSASLを受けて、SASLInitialResponseを送る)
+extern int API_scram_continue(struct EVS_ev_pgsql_t *, struct EVS_pgmsg_t *);  // SCRAM-SHA-256認証継続処理(AuthenticationSASLContinueを受けて、SASLResponseを送る)
+extern int API_scram_final(struct EVS_ev_pgsql_t *, struct EVS_pgmsg_t *);     // SCRAM-SHA-256認証完了処理(AuthenticationSASLFinalのサーバー署名を確かめる)
+
+extern int API_session_start(struct EVS_ev_client_t *);                 // セッション別解析情報生成処理
+extern void API_session_close(struct EVS_ev_client_t *);                // セッション別解析情報解放依頼処理(メッセージ用キューに100:セッション終了を積む)
+extern void API_session_free(struct EVS_ev_message_t *);                // セッション別解析情報解放処理
+extern void API_session_activity(struct EVS_ev_message_t *);            // セッション別クライアント問い合わせ開始処理
+extern void API_session_ready(struct EVS_pgmsg_t *);                    // セッション別トランザクション状態遷移処理(ReadyForQuery)
+extern void API_session_check(ev_tstamp);                               // 長時間トランザクション確認処理
+extern void API_request_parse(struct EVS_pgmsg_t *, char *, unsigned int);                                              // プリペアド文登録処理(Parse)
+extern void API_request_bind(struct EVS_pgmsg_t *, char *);             // プリペアド文選択処理(Bind)
+extern void API_request_push(struct EVS_pgmsg_t *, int, unsigned int);  // 応答待ちリクエスト登録処理(Query/Execute/Sync)
+extern void API_request_datarow(struct EVS_pgmsg_t *);                  // 応答待ちリクエストの行数加算処理(DataRow)
+extern void API_request_complete(struct EVS_pgmsg_t *, char *);         // 応答待ちリクエスト完了処理(CommandComplete/EmptyQueryResponse/PortalSuspended)
+extern void API_request_error(struct EVS_pgmsg_t *);                    // 応答待ちリクエストエラー処理(ErrorResponse)
+extern void API_request_ready(struct EVS_pgmsg_t *);                    // 応答待ちリクエスト同期処理(ReadyForQuery)
+extern unsigned int API_pgsql_fingerprint(char *, int);                 // クエリのフィンガープリント生成処理
+extern unsigned int API_pgsql_fingerprint_lex(char *, int, struct EVS_lexinfo_t *);                                      // クエリのフィンガープリント生成処理(字句解析結果も返す)
+extern unsigned short API_pgsql_get_int16(const char *);                // ビッグエンディアンのint16取得処理
+extern unsigned int API_pgsql_get_int32(const char *);                  // ビッグエンディアンのint32取得処理
+extern void API_pgsql_set_int32(char *, unsigned int);                  // ビッグエンディアンのint32設定処理
+extern int API_pgsql_decode_header(struct EVS_pgmsg_t *, char *, char *);                                               // メッセージヘッダ解析処理
+extern int API_pgsql_decode_message(struct EVS_pgmsg_t *);              // メッセージタイプ別デコード処理
+extern int API_pgsql_decode_stream(struct EVS_pgmsg_t *, struct EVS_stream_t *, char *, unsigned int);                  // 受信データ内の全メッセージのデコード処理
+extern int API_pgsql_decode_errorfields(char *, unsigned int, struct EVS_value_t *);                                    // ErrorResponse/NoticeResponseのフィールド分解処理
+extern int API_pgsql_errorresponse(int, struct timeval *, struct EVS_session_t *, char *, unsigned int);                 // ErrorResponse/NoticeResponse解析処理
+extern void API_errstat_report(ev_tstamp);                              // エラー集計出力処理
+extern unsigned int API_copy_relay(struct EVS_ev_client_t *, int, char *, unsigned int);                                // COPY中継処理(CopyDataを数えて、キューに入れる受信データから取り除く)
+extern void API_copy_close(struct EVS_ev_client_t *);                   // COPY中継終了処理(セッション終了時)
+extern void API_copy_check(ev_tstamp);                                  // COPY途中経過出力処理
+extern void API_capture_start(struct EVS_ev_client_t *);                // キャプチャ開始処理
+extern void API_capture_data(struct EVS_ev_client_t *, int, const char *, unsigned int);    // キャプチャデータ出力処理
+extern void API_capture_close(struct EVS_ev_client_t *);                // キャプチャ終了処理
+extern void API_capture_end(void);                                      // キャプチャファイル終了処理
+extern void API_sample_start(struct EVS_session_t *);                   // ログサンプリング開始処理(セッション開始時)
+extern void API_sample_begin(struct EVS_session_t *, int, unsigned char);                             // ログサンプリング : メッセージ開始処理
+extern void API_sample_end(struct EVS_ev_client_t *, struct EVS_session_t *, int, unsigned char, char); // ログサンプリング : メッセージ終了処理
+extern int API_sample_hold(struct EVS_ev_client_t *, int, const char *, unsigned int, int);           // ログサンプリング : 受信データ保留処理
+extern void API_sample_lost(struct EVS_ev_client_t *, struct EVS_session_t *);                          // ログサンプリング : 中止処理(メッセージの境界を見失った時)
+extern void API_sample_close(struct EVS_ev_client_t *);                 // ログサンプリング終了処理(セッション終了時)
+extern void API_sample_ready(struct EVS_ev_message_t *);                // ログサンプリング : 対象外のReadyForQuery処理(113)
+extern void API_spool_insert(struct EVS_ev_message_t *);                // メッセージ用キュー追加処理(SpoolThresholdを超えていたら、スプールファイルに書き出す)
+extern void API_spool_remove(struct EVS_ev_message_t *);                // メッセージ用キュー削除処理
+extern int API_spool_load(void);                                        // スプール読み込み処理(メッセージ用キューが空なら、スプールから読み込む)
+extern void API_spool_report(ev_tstamp);                                // スプール統計出力処理
+extern void API_spool_end(void);                                        // スプールファイル終了処理
+extern void API_pool_startup(struct EVS_ev_pgsql_t *, struct EVS_pgmsg_t *);  // 開始メッセージレスポンス保存処理
+extern void API_pool_received(struct EVS_ev_pgsql_t *, const char *, int);     // 問い合わせ終了判定処理(透過モードでPostgreSQLから受信した時)
+extern int API_pool_sent(struct EVS_ev_pgsql_t *, const char *, int);          // クライアント送信判定処理(1:PostgreSQLに送らない)
+extern struct EVS_ev_pgsql_t *API_pool_get(struct EVS_db_t *, int);            // プール接続取得処理(0:プライマリ, 1:レプリカの接続を優先する)
+extern void API_pool_attach(struct EVS_ev_client_t *, struct EVS_ev_pgsql_t *);    // プール接続割り当て処理
+extern int API_pool_welcome(struct EVS_ev_client_t *);                         // プール接続開始メッセージレスポンス送信処理
+extern void API_pool_release(struct EVS_ev_client_t *);                        // プール接続返却処理(リセットしてプールに戻すか閉じる)
+extern int API_pool_server(struct EVS_ev_pgsql_t *);                           // プール接続受信処理(20:プール待機中、21:リセット中)
+extern void API_pool_close(struct EVS_ev_pgsql_t *);                           // プール接続終了処理
+extern void API_pool_check(ev_tstamp);                                         // プール接続タイムアウト確認処理
+extern int API_pool_acquire(struct EVS_ev_client_t *);                         // プール接続要求処理(トランザクション単位のプールで、問い合わせの最初に接続を割り当てる)
+extern void API_pool_idle(struct EVS_ev_pgsql_t *);                            // プール接続解放判定処理(トランザクション単位のプールで、トランザクションが終わったら接続を返す)
+extern int API_pool_limit(struct EVS_ev_client_t *, struct EVS_db_t *);        // プール接続数上限判定処理(1:空きを待つ)
+extern int API_pool_ready(struct EVS_ev_pgsql_t *);                            // プール事前接続完了処理(-1:プールできないので閉じる)
+
+extern int API_route_build(void);                                              // 経路表作成処理(データベース用テールキューから作り直して、差し替える)
+extern struct EVS_db_t *API_route_lookup(const char *, const char *);          // 経路表探索処理(データベース名、ユーザー名)
+extern void API_route_leave(struct EVS_ev_client_t *);                         // 経路表クライアント終了処理(データベース別設定の使用数を減らす)
+extern int API_route_reload(struct EVS_db_t *, int);                           // 経路表再読み込み処理(読み直した設定と入れ替える。-1:読み直しを取り消す)
+extern void API_route_check(ev_tstamp);                                        // 経路表確認処理(使われなくなった設定を開放する)
+extern void API_route_close(void);                                             // 経路表終了処理
+
+extern struct EVS_host_t *API_balance_host(const char *, const char *);        // 接続先ホスト別構造体取得処理(なければ作って、名前解決しておく)
+extern void API_balance_init(struct EVS_db_t *);                               // 接続先ホスト状態初期化処理
+extern void API_balance_free(struct EVS_db_t *);                               // 接続先ホスト使用終了処理(使われなくなったホストを開放する)
+extern void API_balance_reload(void);                                          // 接続先ホスト名前解決やり直し処理(設定を読み直す時)
+extern int API_balance_select(struct EVS_db_t *, int);                         // 接続先ホスト選択処理(host_listの位置を返す。読み書き分離では0:プライマリ, 1:レプリカから選ぶ)
+extern int API_balance_replica(struct EVS_ev_pgsql_t *);                       // 接続先ホスト種類判定処理(1:読み書き分離のレプリカへの接続)
+extern void API_balance_fail(struct EVS_ev_pgsql_t *);                         // 接続先ホスト接続失敗処理(切り離す)
+extern void API_balance_request(struct EVS_ev_pgsql_t *, const char *, int);   // 接続先ホスト問い合わせ開始処理(クライアントから送信した時)
+extern void API_balance_response(struct EVS_ev_pgsql_t *, const char *, int);  // 接続先ホスト応答処理(透過モードでPostgreSQLから受信した時)
+extern void API_balance_lost(struct EVS_ev_pgsql_t *);                         // 接続先ホスト切断処理(応答待ちのままPostgreSQL側から切断された時)
+extern void API_balance_close(struct EVS_ev_pgsql_t *);                        // 接続先ホスト接続終了処理
+extern void API_balance_check(ev_tstamp);                                      // 接続先ホスト死活確認処理
+extern void API_balance_end(void);                                             // 接続先ホスト終了処理(死活確認中のソケットを閉じて、接続先ホスト別構造体を開放する)
+
+extern int API_split_session(struct EVS_ev_client_t *, struct EVS_db_t *);     // 読み書き分離セッション開始処理(1:読み取り専用のセッション)
+extern int API_split_route(struct EVS_ev_client_t *);                          // 読み書き分離判定処理(1:レプリカに送る, 0:プライマリに送る)
+extern void API_split_count(struct EVS_ev_pgsql_t *);                          // 読み書き分離計数処理
+extern void API_split_report(ev_tstamp);                                       // 読み書き分離統計出力処理
+
+extern void API_admit_init(struct EVS_db_t *);                                 // 接続受け入れ制御初期化処理(同じデータベース名の設定をまとめる)
+extern void API_admit_release(struct EVS_db_t *);                              // 接続受け入れ制御開放処理(データベース別設定を開放する前に、まとめ役を引き継ぐ)
+extern void API_admit_open(struct EVS_db_t *);                                 // 接続受け入れ制御 : 接続開始処理
+extern void API_admit_close(struct EVS_db_t *);                                // 接続受け入れ制御 : 接続終了処理(待っているクライアントがいれば、割り当てを予約する)
+extern int API_admit_full(struct EVS_db_t *);                                  // 接続数上限判定処理(1:全体かデータベース名毎の上限)
+extern int API_admit_evict(struct EVS_db_t *);                                 // 待機中接続入れ替え処理(1:他の設定のプールの接続を閉じた)
+extern int API_admit_reject(struct EVS_ev_client_t *, struct EVS_db_t *);      // 待ち行列長判定処理(1:一杯なのでエラーを返した)
+extern void API_admit_enqueue(struct EVS_db_t *);                              // 接続受け入れ制御 : 待ち行列追加処理
+extern void API_admit_dequeue(struct EVS_ev_client_t *, struct EVS_db_t *, int);   // 接続受け入れ制御 : 待ち行列削除処理(1:割り当てた, 0:待つのをやめた)
+extern void API_admit_timeout(void);                                           // 接続受け入れ制御 : 待ち時間切れ計数処理
+extern void API_admit_dispatch(void);                                          // 接続受け入れ制御 : 公平配分処理(データベース別設定を順番に、一人ずつ割り当てる)
+extern void API_admit_report(ev_tstamp);                                       // 接続受け入れ制御統計出力処理
+extern void API_admit_end(void);                                               // 接続受け入れ制御終了処理
+
+extern void API_cancel_backend(struct EVS_ev_pgsql_t *, struct EVS_pgmsg_t *);  // BackendKeyData保存処理(PostgreSQLから受け取ったプロセスIDと秘密鍵)
+extern void API_cancel_rewrite(struct EVS_ev_client_t *, char *, int);          // BackendKeyData書き換え処理(クライアントに送る前に、PgAnalyzerのキーにする)
+extern void API_cancel_request(struct EVS_ev_client_t *);                      // CancelRequest転送処理
+extern void API_cancel_close(struct EVS_ev_client_t *);                        // CancelRequest用キー索引削除処理(クライアント接続終了時)
+extern void API_cancel_check(ev_tstamp);                                       // CancelRequest転送タイムアウト確認処理
+extern void API_cancel_end(void);                                              // CancelRequest転送終了処理
 
 // ----------------
 // テールキュー関連